@@ -1,6 +1,6 @@
 #!/usr/bin/env python
 
-import os, sys, argparse, struct, time, subprocess
+import os, sys, argparse, struct, time, subprocess, glob
 
 sys.path.append(os.path.join(os.path.abspath(
             os.path.dirname(__file__)), os.pardir))
@@ -13,7 +13,7 @@ def generate_cloudBurst_input(
   num_splits, num_input_disks, file_offset_index,
   reference_file_path, reference_file_total_sequences, query_file_path,
   query_file_total_sequences, output_file_path, host_input_directory,
-  executable_path):
+  executable_path, read_store_builder, read_store):
     """
       Generate binary coded input files for cloudburst MapReduce job. The
       script takes raw sequence file as input (in FASTA FORMAT) and split
@@ -24,6 +24,10 @@ def generate_cloudBurst_input(
       with file_offset_index = 0. Rest of experiment-nodes sleep till file
       is being splitted. Once split process is complete each host copies
       some subset of intermediate file to local directory.
+
+      With a read store, the master also packs the converted reads into a
+      read store with cloudburst_readstore, and every host copies the whole
+      store to the same local path.
     """
     # Create directory on DFS (recursively creating sub-directories) if it
     # doesn't already exist
@@ -70,6 +74,24 @@ def generate_cloudBurst_input(
                 if running_cmd.returncode != 0:
                     sys.exit("Command '%s' failed: %s" %
                         (' '.join(cloudburst_file_converter_hosts_cmd), stderr))
+            if read_store is not None:
+                query_files = glob.glob(os.path.join(
+                    output_file_path,
+                    "output_" + os.path.basename(query_file_path) + "*"))
+                read_store_cmd = "%s %s %s" % (
+                    read_store_builder,
+                    os.path.join(output_file_path, "read_store"),
+                    " ".join(sorted(query_files)))
+                print read_store_cmd
+                running_cmd = subprocess.Popen(read_store_cmd,
+                                               universal_newlines=True,
+                                               shell=True,
+                                               stdout=subprocess.PIPE,
+                                               stderr=subprocess.PIPE)
+                (stdout, stderr) = running_cmd.communicate()
+                if running_cmd.returncode != 0:
+                    sys.exit("Command '%s' failed: %s" % (
+                        read_store_cmd, stderr))
             # create a dummy file
             f = open(dummy_file, 'w')
             f.close()
@@ -97,6 +119,21 @@ def generate_cloudBurst_input(
               sys.exit("Command '%s' failed: %s" % (
                   ' '.join(cloudburst_scp_input_file_command), stderr))
 
+    if read_store is not None:
+        # Every node's reducers need every read
+        read_store_scp_command = "scp %s %s" % (
+            os.path.join(output_file_path, "read_store"), read_store)
+        print read_store_scp_command
+        running_cmd = subprocess.Popen(read_store_scp_command,
+                                       universal_newlines=True,
+                                       shell=True,
+                                       stdout=subprocess.PIPE,
+                                       stderr=subprocess.PIPE)
+        (stdout, stderr) = running_cmd.communicate()
+        if running_cmd.returncode != 0:
+            sys.exit("Command '%s' failed: %s" % (
+                read_store_scp_command, stderr))
+
 def main():
     parser = argparse.ArgumentParser(description="generate an input file per "
                                      "disk in the provided DFS directory "
@@ -129,7 +166,16 @@ def main():
                          "be copied to ")
     parser.add_argument('executable_path', type=str,
                         help="location of executable/jar file")
+    parser.add_argument('--read_store_builder', type=str,
+                        help="location of the cloudburst_readstore "
+                        "executable, required with --read_store")
+    parser.add_argument('--read_store', type=str,
+                        help="local path on every host to copy the job's "
+                        "read store to, for cloudburst.py --read_store "
+                        "(default: no read store)")
     args = parser.parse_args()
+    if args.read_store is not None and args.read_store_builder is None:
+        parser.error("--read_store requires --read_store_builder")
 
     generate_cloudBurst_input(**vars(args))
 
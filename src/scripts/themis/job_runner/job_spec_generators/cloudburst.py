@@ -1,25 +1,48 @@
 #!/usr/bin/env python
 
-import sys, argparse, utils, json
+import sys, os, argparse, utils, json, hashlib
 from merge_files import merge_files
 
-def cloudburst(
-    input_directory, output_directory, hdfs, min_read_len, max_read_len,
-    max_align_diff, redundancy, allow_differences, block_size, **kwargs):
+# Bump when the reference tuples a cache holds, or the layout of its files,
+# change for the same parameters
+REFERENCE_CACHE_VERSION = 2
 
-    if output_directory is None:
-        output_directory = utils.sibling_directory(
-            input_directory, "%(dirname)s_cloudburst_aligned")
-
-    intermediate_directory = utils.sibling_directory(
-        input_directory, "%(dirname)s_cloudburst_unmerged")
+def reference_cache_directory(
+    reference_cache, reference_checksum, max_align_diff, min_read_len,
+    max_read_len, redundancy, canonical_seeds, seed_masks,
+    read_length_classes, dust_threshold, repeat_mask):
+    # A cache is only valid for the reference and seed parameters it was
+    # written with, so each combination gets its own directory
+    seed_params = {
+        "reference_checksum" : reference_checksum,
+        "max_align_diff" : max_align_diff,
+        "min_read_len" : min_read_len,
+        "max_read_len" : max_read_len,
+        "redundancy" : redundancy,
+        "canonical_seeds" : bool(canonical_seeds),
+        "seed_masks" : seed_masks,
+        "read_length_classes" : read_length_classes
+        }
+    # Masking drops reference seeds; unmasked jobs keep their existing caches
+    if dust_threshold > 0 or repeat_mask:
+        seed_params["dust_threshold"] = dust_threshold
+        seed_params["repeat_mask"] = repeat_mask
+    digest = hashlib.md5(json.dumps(seed_params, sort_keys=True)).hexdigest()
+    return os.path.join(
+        reference_cache, "v%d_%s" % (REFERENCE_CACHE_VERSION, digest))
 
-    (input_url, intermediate_url) = utils.generate_urls(
-        input_directory, intermediate_directory, hdfs)
+def cloudburst_round(
+    input_urls, output_url, max_align_diff, query_source, min_read_len,
+    max_read_len, redundancy, allow_differences, block_size,
+    reference_memory_limit, scratch_directory, hash_grouping,
+    canonical_seeds, seed_masks, read_length_classes, filter_alignments,
+    max_hits_per_seed, reference_cache, reference_cache_mode,
+    reference_checksum, changed_intervals, read_store, dust_threshold,
+    repeat_mask, perf_counters):
 
     cloudburst_config = utils.mapreduce_job(
-        input_dir = input_url,
-        output_dir = intermediate_url,
+        input_dir = input_urls,
+        output_dir = output_url,
         map_function = "CloudBurstMapFunction",
         reduce_function = "CloudBurstReduceFunction",
         partition_function = "CloudBurstPartitionFunction")
@@ -27,6 +50,15 @@ def cloudburst(
     seed_len = min_read_len / (max_align_diff +1)
     flank_len = max_read_len - seed_len + max_align_diff
 
+    if reference_cache is None:
+        cache_directory = ""
+        reference_cache_mode = ""
+    else:
+        cache_directory = reference_cache_directory(
+            reference_cache, reference_checksum, max_align_diff,
+            min_read_len, max_read_len, redundancy, canonical_seeds,
+            seed_masks, read_length_classes, dust_threshold, repeat_mask)
+
     cloudburst_params = {
         "CLOUDBURST_MIN_READ_LEN" : min_read_len,
         "CLOUDBURST_MAX_READ_LEN" : max_read_len,
@@ -35,7 +67,23 @@ def cloudburst(
         "CLOUDBURST_FLANK_LEN" : flank_len,
         "CLOUDBURST_REDUNDANCY" : redundancy,
         "CLOUDBURST_ALLOW_DIFFERENCES" : int(allow_differences),
-        "CLOUDBURST_BLOCK_SIZE" : block_size
+        "CLOUDBURST_BLOCK_SIZE" : block_size,
+        "CLOUDBURST_REFERENCE_MEMORY_LIMIT" : reference_memory_limit,
+        "CLOUDBURST_SCRATCH_DIRECTORY" : scratch_directory,
+        "CLOUDBURST_HASH_GROUPING" : int(hash_grouping),
+        "CLOUDBURST_CANONICAL_SEEDS" : int(canonical_seeds),
+        "CLOUDBURST_SEED_MASKS" : seed_masks,
+        "CLOUDBURST_READ_LENGTH_CLASSES" : read_length_classes,
+        "CLOUDBURST_QUERY_SOURCE" : query_source,
+        "CLOUDBURST_FILTER_ALIGNMENTS" : filter_alignments,
+        "CLOUDBURST_MAX_HITS_PER_SEED" : max_hits_per_seed,
+        "CLOUDBURST_REFERENCE_CACHE" : cache_directory,
+        "CLOUDBURST_REFERENCE_CACHE_MODE" : reference_cache_mode,
+        "CLOUDBURST_CHANGED_INTERVALS" : changed_intervals,
+        "CLOUDBURST_READ_STORE" : read_store,
+        "CLOUDBURST_DUST_THRESHOLD" : dust_threshold,
+        "CLOUDBURST_REPEAT_MASK" : repeat_mask,
+        "CLOUDBURST_PERF_COUNTERS" : int(perf_counters)
         }
 
     if "params" not in cloudburst_config:
@@ -44,10 +92,304 @@ def cloudburst(
     for key, value in cloudburst_params.items():
         cloudburst_config["params"][key] = value
 
-    mergefiles_config = merge_files(
-        intermediate_directory, output_directory, hdfs)
+    return cloudburst_config
+
+def broadcast_join(
+    input_urls, output_url, broadcast, max_align_diff, min_read_len,
+    max_read_len, allow_differences, canonical_seeds, seed_masks,
+    read_length_classes, filter_alignments, max_hits_per_seed, dust_threshold,
+    repeat_mask):
+    # The broadcast side is seeded into memory by every map function, which
+    # aligns the other side's seeds as it makes them; only alignments are
+    # shuffled, and the reducers filter them.
+    broadcast_config = utils.mapreduce_job(
+        input_dir = input_urls,
+        output_dir = output_url,
+        map_function = "CloudBurstBroadcastMapFunction",
+        reduce_function = "CloudBurstFilterReduceFunction",
+        partition_function = "HashedBoundaryListPartitionFunction")
+
+    broadcast_params = {
+        "CLOUDBURST_MIN_READ_LEN" : min_read_len,
+        "CLOUDBURST_MAX_READ_LEN" : max_read_len,
+        "CLOUDBURST_MAX_ALIGN_DIFF" : max_align_diff,
+        "CLOUDBURST_SEED_LEN" : min_read_len / (max_align_diff + 1),
+        "CLOUDBURST_ALLOW_DIFFERENCES" : int(allow_differences),
+        "CLOUDBURST_CANONICAL_SEEDS" : int(canonical_seeds),
+        "CLOUDBURST_SEED_MASKS" : seed_masks,
+        "CLOUDBURST_READ_LENGTH_CLASSES" : read_length_classes,
+        "CLOUDBURST_FILTER_ALIGNMENTS" : filter_alignments,
+        "CLOUDBURST_MAX_HITS_PER_SEED" : max_hits_per_seed,
+        "CLOUDBURST_BROADCAST_FILE" : broadcast,
+        "CLOUDBURST_DUST_THRESHOLD" : dust_threshold,
+        "CLOUDBURST_REPEAT_MASK" : repeat_mask,
+        "CLOUDBURST_OUTPUT_FORMAT" : "records"
+        }
+
+    if "params" not in broadcast_config:
+        broadcast_config["params"] = {}
+
+    for key, value in broadcast_params.items():
+        broadcast_config["params"][key] = value
+
+    return broadcast_config
+
+def patch_alignments(input_urls, output_url, changed_intervals, delta_source):
+    patch_config = utils.mapreduce_job(
+        input_dir = input_urls,
+        output_dir = output_url,
+        map_function = "CloudBurstPatchMapFunction",
+        reduce_function = "CloudBurstFilterReduceFunction",
+        partition_function = "HashedBoundaryListPartitionFunction")
+
+    if "params" not in patch_config:
+        patch_config["params"] = {}
+
+    patch_config["params"]["CLOUDBURST_CHANGED_INTERVALS"] = changed_intervals
+    patch_config["params"]["CLOUDBURST_DELTA_SOURCE"] = delta_source
+    # Keep every alignment; the output jobs filter the patched alignments
+    patch_config["params"]["CLOUDBURST_FILTER_ALIGNMENTS"] = 0
+    patch_config["params"]["CLOUDBURST_OUTPUT_FORMAT"] = "records"
+
+    return patch_config
+
+def read_filter(input_urls, output_url, alignment_source, max_align_diff):
+    filter_config = utils.mapreduce_job(
+        input_dir = input_urls,
+        output_dir = output_url,
+        map_function = "CloudBurstReadFilterMapFunction",
+        reduce_function = "CloudBurstReadFilterReduceFunction",
+        partition_function = "CloudBurstPartitionFunction")
 
-    return utils.run_in_sequence(cloudburst_config, mergefiles_config)
+    if "params" not in filter_config:
+        filter_config["params"] = {}
+
+    filter_config["params"]["CLOUDBURST_ALIGNMENT_SOURCE"] = alignment_source
+    filter_config["params"]["CLOUDBURST_MAX_ALIGN_DIFF"] = max_align_diff
+
+    return filter_config
+
+def alignment_filter(
+    input_url, output_url, filter_alignments, output_format):
+    filter_config = utils.mapreduce_job(
+        input_dir = input_url,
+        output_dir = output_url,
+        map_function = "PassThroughMapFunction",
+        reduce_function = "CloudBurstFilterReduceFunction",
+        partition_function = "HashedBoundaryListPartitionFunction")
+
+    if "params" not in filter_config:
+        filter_config["params"] = {}
+
+    filter_config["params"]["CLOUDBURST_FILTER_ALIGNMENTS"] = filter_alignments
+    filter_config["params"]["CLOUDBURST_OUTPUT_FORMAT"] = output_format
+
+    return filter_config
+
+def coordinate_layout(input_url, output_url, coordinate_block_hits):
+    # Hits must reach the reducers in coordinate order, so this job keeps
+    # the job runner's default, order-preserving partitioning.
+    coordinate_config = utils.mapreduce_job(
+        input_dir = input_url,
+        output_dir = output_url,
+        map_function = "CloudBurstCoordinateMapFunction",
+        reduce_function = "CloudBurstCoordinateReduceFunction")
+
+    if "params" not in coordinate_config:
+        coordinate_config["params"] = {}
+
+    coordinate_config["params"]["CLOUDBURST_COORDINATE_BLOCK_HITS"] = \
+        coordinate_block_hits
+
+    return coordinate_config
+
+def aligned_output(
+    alignment_directory, output_directory, hdfs, filter_alignments,
+    output_format, coordinate_block_hits):
+    # Jobs that write the final, merged alignments
+    if filter_alignments == 0 and output_format == "records":
+        return [merge_files(alignment_directory, output_directory, hdfs)]
+
+    # Grouping needs all of a read's alignments together, so the other
+    # formats are written by the filter job, which may keep every alignment
+    filtered_directory = alignment_directory + "_filtered"
+    (alignment_url, filtered_url) = utils.generate_urls(
+        alignment_directory, filtered_directory, hdfs)
+
+    if output_format == "records":
+        filter_format = "records"
+    else:
+        filter_format = "grouped"
+
+    jobs = [alignment_filter(
+        alignment_url, filtered_url, filter_alignments, filter_format)]
+
+    if output_format == "sorted":
+        sorted_directory = alignment_directory + "_sorted"
+        (filtered_url, sorted_url) = utils.generate_urls(
+            filtered_directory, sorted_directory, hdfs)
+        jobs.append(coordinate_layout(
+            filtered_url, sorted_url, coordinate_block_hits))
+        filtered_directory = sorted_directory
+
+    jobs.append(merge_files(filtered_directory, output_directory, hdfs))
+    return jobs
+
+def cloudburst(
+    input_directory, output_directory, hdfs, min_read_len, max_read_len,
+    max_align_diff, redundancy, allow_differences, block_size,
+    reference_memory_limit, scratch_directory, hash_grouping,
+    canonical_seeds, seed_masks, read_length_classes, rounds,
+    filter_alignments, max_hits_per_seed, output_format,
+    coordinate_block_hits, reference_cache, reference_cache_mode,
+    reference_checksum, changed_intervals, previous_alignments, broadcast,
+    read_store, dust_threshold, repeat_mask, perf_counters, **kwargs):
+
+    if output_directory is None:
+        output_directory = utils.sibling_directory(
+            input_directory, "%(dirname)s_cloudburst_aligned")
+
+    round_params = {
+        "min_read_len" : min_read_len,
+        "max_read_len" : max_read_len,
+        "redundancy" : redundancy,
+        "allow_differences" : allow_differences,
+        "block_size" : block_size,
+        "reference_memory_limit" : reference_memory_limit,
+        "scratch_directory" : scratch_directory,
+        "hash_grouping" : hash_grouping,
+        "canonical_seeds" : canonical_seeds,
+        "seed_masks" : seed_masks,
+        "read_length_classes" : read_length_classes,
+        "filter_alignments" : filter_alignments,
+        "max_hits_per_seed" : max_hits_per_seed,
+        "reference_cache" : reference_cache,
+        "reference_cache_mode" : reference_cache_mode,
+        "reference_checksum" : reference_checksum,
+        "changed_intervals" : changed_intervals or "",
+        "read_store" : read_store or "",
+        "dust_threshold" : dust_threshold,
+        "repeat_mask" : repeat_mask or "",
+        "perf_counters" : perf_counters
+        }
+
+    if broadcast is not None:
+        intermediate_directory = utils.sibling_directory(
+            input_directory, "%(dirname)s_cloudburst_unmerged")
+
+        (input_url, intermediate_url) = utils.generate_urls(
+            input_directory, intermediate_directory, hdfs)
+
+        broadcast_config = broadcast_join(
+            input_url, intermediate_url, broadcast, max_align_diff,
+            min_read_len, max_read_len, allow_differences, canonical_seeds,
+            seed_masks, read_length_classes, filter_alignments,
+            max_hits_per_seed, dust_threshold, repeat_mask or "")
+
+        # The join's reducers have already filtered the alignments
+        return utils.run_in_sequence(broadcast_config, *aligned_output(
+            intermediate_directory, output_directory, hdfs, 0, output_format,
+            coordinate_block_hits))
+
+    if changed_intervals is not None:
+        # Delta mode: align against the updated reference only where it
+        # changed, then replace the previous alignments in the changed
+        # intervals with the new ones
+        delta_directory = utils.sibling_directory(
+            input_directory, "%(dirname)s_cloudburst_delta_unmerged")
+
+        (input_url, delta_url) = utils.generate_urls(
+            input_directory, delta_directory, hdfs)
+
+        jobs = [cloudburst_round(
+            input_url, delta_url, max_align_diff, "", **round_params)]
+
+        alignment_directory = delta_directory
+        if previous_alignments is not None:
+            alignment_directory = utils.sibling_directory(
+                input_directory, "%(dirname)s_cloudburst_patched_unmerged")
+            (previous_url, patched_url) = utils.generate_urls(
+                previous_alignments, alignment_directory, hdfs)
+            jobs.append(patch_alignments(
+                [previous_url, delta_url], patched_url, changed_intervals,
+                os.path.basename(delta_directory)))
+
+        jobs.extend(aligned_output(
+            alignment_directory, output_directory, hdfs, filter_alignments,
+            output_format, coordinate_block_hits))
+        return utils.run_in_sequence(*jobs)
+
+    if rounds is None:
+        intermediate_directory = utils.sibling_directory(
+            input_directory, "%(dirname)s_cloudburst_unmerged")
+
+        (input_url, intermediate_url) = utils.generate_urls(
+            input_directory, intermediate_directory, hdfs)
+
+        cloudburst_config = cloudburst_round(
+            input_url, intermediate_url, max_align_diff, "", **round_params)
+
+        return utils.run_in_sequence(cloudburst_config, *aligned_output(
+            intermediate_directory, output_directory, hdfs,
+            filter_alignments, output_format, coordinate_block_hits))
+
+    # Iterative deepening: each round aligns only the reads that every
+    # earlier round, with fewer differences, failed to align. A read filter
+    # job after each round writes those reads out for the next round and logs
+    # how many reads the round resolved. Every round reads the reference from
+    # the input directory, and rounds after the first take their reads from
+    # the previous filter's output.
+    jobs = []
+    reads_directory = input_directory
+    query_source = ""
+
+    for round_index, round_diff in enumerate(rounds):
+        intermediate_directory = utils.sibling_directory(
+            input_directory, "%%(dirname)s_cloudburst_k%d_unmerged" % (
+                round_diff))
+        if round_index + 1 < len(rounds):
+            unaligned_directory = utils.sibling_directory(
+                input_directory, "%%(dirname)s_cloudburst_k%d_reads" % (
+                    rounds[round_index + 1]))
+        else:
+            unaligned_directory = utils.sibling_directory(
+                input_directory, "%(dirname)s_cloudburst_unaligned")
+
+        (input_url, reads_url) = utils.generate_urls(
+            input_directory, reads_directory, hdfs)
+        (intermediate_url, unaligned_url) = utils.generate_urls(
+            intermediate_directory, unaligned_directory, hdfs)
+
+        if reads_directory == input_directory:
+            round_input_urls = input_url
+        else:
+            round_input_urls = [input_url, reads_url]
+
+        jobs.append(cloudburst_round(
+            round_input_urls, intermediate_url, round_diff, query_source,
+            **round_params))
+
+        jobs.append(read_filter(
+            [reads_url, intermediate_url], unaligned_url,
+            os.path.basename(intermediate_directory), round_diff))
+
+        jobs.extend(aligned_output(
+            intermediate_directory,
+            os.path.join(output_directory, "k%d" % (round_diff)), hdfs,
+            filter_alignments, output_format, coordinate_block_hits))
+
+        reads_directory = unaligned_directory
+        query_source = os.path.basename(unaligned_directory)
+
+    return utils.run_in_sequence(*jobs)
+
+def parse_rounds(rounds):
+    round_diffs = [int(k) for k in rounds.split(",")]
+    for round_index in xrange(1, len(round_diffs)):
+        if round_diffs[round_index] <= round_diffs[round_index - 1]:
+            raise argparse.ArgumentTypeError(
+                "rounds must allow increasing numbers of differences")
+    return round_diffs
 
 def main():
     parser = argparse.ArgumentParser(
@@ -85,10 +427,150 @@ def main():
     parser.add_argument(
         "--block_size", type=int,
         help="number of query and reference tuples to consider at a time in "
-        "the reduce phase. (default: %(default)s)", default=128)
-
+        "the reduce phase; 0 sizes query and reference tiles automatically "
+        "from the tuple footprint and cache sizes (default: %(default)s)",
+        default=128)
+    parser.add_argument(
+        "--reference_memory_limit", type=int, help="number of bytes of "
+        "reference tuples per seed that a reducer copies into its own memory "
+        "before spilling the rest to a scratch file; the reduce buffers "
+        "themselves are not counted; 0 copies every reference tuple "
+        "(default: %(default)s)", default=0)
+    parser.add_argument(
+        "--scratch_directory", help="local directory for reference spill "
+        "files (default: %(default)s)", default="/tmp")
+    parser.add_argument(
+        "--hash_grouping", help="group each reduce partition's tuples by "
+        "seed in a hash table and join them once the partition is read, "
+        "rather than relying on sorted seed order; every partition must fit "
+        "in memory", default=False, action="store_true")
+    parser.add_argument(
+        "--canonical_seeds", help="key seeds by the smaller of the seed and "
+        "its reverse complement so each read is seeded once instead of once "
+        "per strand", default=False, action="store_true")
+    parser.add_argument(
+        "--seed_masks", help="comma-separated spaced seed masks of 1's (care) "
+        "and 0's (don't care), at most 4, e.g. 1101101101101101; every "
+        "position of each read is seeded with every mask, so masks should "
+        "weigh more than a contiguous seed (default: contiguous seeds)",
+        default="")
+    parser.add_argument(
+        "--read_length_classes", help="comma-separated longest read length "
+        "of every read length class but the last, e.g. 50,100; each class "
+        "gets seeds and flanks sized for its own reads, and the reference is "
+        "seeded once per class (default: one class)", default="")
+    parser.add_argument(
+        "--rounds", type=parse_rounds, help="comma-separated, increasing "
+        "numbers of differences to align with in successive rounds, e.g. "
+        "0,1,3; each round only aligns the reads earlier rounds failed to "
+        "align, and its alignments go to a subdirectory of the output "
+        "directory named k<differences> (default: one round of "
+        "--max_align_diff differences)")
+    parser.add_argument(
+        "--filter_alignments", type=int, help="keep only this many of each "
+        "read's best alignments by number of differences, flagging them "
+        "ambiguous if they tie with alignments that were dropped; the "
+        "reducer prunes to what the filter needs and a filter job runs "
+        "before the merge (default: keep every alignment)", default=0)
+    parser.add_argument(
+        "--max_hits_per_seed", type=int, help="stop extending a read against "
+        "a seed's reference tuples once it has this many alignments there, "
+        "and write a repetitive read marker for it instead (default: no "
+        "limit)", default=0)
+    parser.add_argument(
+        "--output_format", choices=["records", "grouped", "sorted"],
+        help="'records' writes one fixed-size record per alignment; "
+        "'grouped' writes one varint-encoded record per read with all of "
+        "its alignments; 'sorted' lays alignments out by reference "
+        "coordinate in delta-encoded blocks keyed by their first hit "
+        "(default: %(default)s)", default="records")
+    parser.add_argument(
+        "--coordinate_block_hits", type=int, help="number of alignments per "
+        "block of sorted output (default: %(default)s)", default=1024)
+    parser.add_argument(
+        "--reference_cache", help="directory, visible to every node, under "
+        "which to keep the reference's seed tuples between jobs; each "
+        "reference and set of seed parameters gets its own subdirectory "
+        "(default: no cache)")
+    parser.add_argument(
+        "--reference_cache_mode", choices=["write", "read"],
+        help="'write' aligns as usual and saves the reference's seed tuples "
+        "to the cache; 'read' maps, shuffles and sorts only the reads and "
+        "aligns them against the cached reference (default: %(default)s)",
+        default="write")
+    parser.add_argument(
+        "--reference_checksum", help="checksum of the reference, such as "
+        "its md5sum, which names its cache; required with --reference_cache")
+    parser.add_argument(
+        "--changed_intervals", help="file, readable on every node, of the "
+        "'<reference id> <start> <end>' intervals of the reference that "
+        "changed since a previous alignment; only reference seeds whose "
+        "flanks reach them are emitted, so only reads that may align "
+        "differently are re-aligned (default: align against the whole "
+        "reference)")
+    parser.add_argument(
+        "--previous_alignments", help="directory of unfiltered alignment "
+        "records from the previous reference, such as its '_unmerged' "
+        "directory, to patch with --changed_intervals: previous alignments "
+        "overlapping a changed interval are replaced by the new ones")
+    parser.add_argument(
+        "--broadcast", help="local path, the same on every node, of a copy "
+        "of the converted input file of the smaller side, such as a "
+        "bacterial reference; its name must contain 'ref' if it is the "
+        "reference. Every map function holds that side's seeds in memory "
+        "and aligns the other side's seeds against them directly, so seeds "
+        "are neither partitioned, sorted nor shuffled (default: shuffle both "
+        "sides)")
+    parser.add_argument(
+        "--read_store", help="local path, the same on every node, of a copy "
+        "of the read store built from the converted reads by "
+        "cloudburst_readstore; the map functions shuffle each read seed "
+        "with only its read id, strand and position, and the reducers take "
+        "the read's bases from the store (default: shuffle whole reads)")
+    parser.add_argument(
+        "--dust_threshold", type=int, help="drop reference seeds in 64-base "
+        "windows whose DUST score, 10 times the average number of repeats of "
+        "each triplet, is above this; random sequence scores about 5 and "
+        "dinucleotide repeats about 150, and 20 is a common threshold "
+        "(default: no DUST masking)", default=0)
+    parser.add_argument(
+        "--repeat_mask", help="file, readable on every node, of "
+        "'<reference id> <start> <end>' reference intervals, such as "
+        "repeats found by RepeatMasker, whose seeds are dropped (default: "
+        "no repeat mask)")
+    parser.add_argument(
+        "--perf_counters", help="count cycles, instructions, last level "
+        "cache misses and branch misses with hardware counters while "
+        "seeding, parsing seed tuples and extending them, and log them with "
+        "each worker's statistics; needs a PMU and perf_event_paranoid at 2 "
+        "or lower on every node", default=False, action="store_true")
 
     args = parser.parse_args()
+    if args.reference_cache is not None and args.reference_checksum is None:
+        parser.error("--reference_cache requires --reference_checksum")
+    if args.changed_intervals is not None and (
+        args.rounds is not None or args.reference_cache_mode == "read" and
+        args.reference_cache is not None):
+        parser.error("--changed_intervals cannot be combined with --rounds or "
+                     "a reference cache in read mode")
+    if args.previous_alignments is not None and args.changed_intervals is None:
+        parser.error("--previous_alignments requires --changed_intervals")
+    if args.broadcast is not None and (
+        args.rounds is not None or args.changed_intervals is not None or
+        args.reference_cache is not None):
+        parser.error("--broadcast cannot be combined with --rounds, "
+                     "--changed_intervals or --reference_cache")
+    if args.broadcast is not None and args.max_hits_per_seed > 0 and \
+        "ref" not in os.path.basename(args.broadcast):
+        parser.error("--max_hits_per_seed requires the reference to be the "
+                     "broadcast side")
+    if args.read_store is not None and args.broadcast is not None:
+        parser.error("--read_store cannot be combined with --broadcast")
+    if args.perf_counters and args.broadcast is not None:
+        parser.error("--perf_counters cannot be combined with --broadcast")
+    if args.reference_cache is not None and args.hash_grouping:
+        parser.error("--reference_cache cannot be combined with "
+                     "--hash_grouping")
     config = cloudburst(**vars(args))
 
     with open(args.output_filename, 'w') as fp:
@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <string.h>
+
+#include "AlignmentSession.h"
+#include "core/MemoryUtils.h"
+#include "core/Timer.h"
+#include "mapreduce/common/KeyValuePair.h"
+#include "mapreduce/functions/map/cloudBurst/CloudBurstMapFunction.h"
+#include "mapreduce/functions/reduce/cloudBurst/AlignmentSink.h"
+
+/**
+   Seeds reads, passing each seed tuple to the session's join.
+ */
+class AlignmentSession::Seeder : public CloudBurstMapFunction {
+public:
+  Seeder(const ReferenceIndex& index, AlignmentSession& _session)
+    : CloudBurstMapFunction(
+        index.maxAlignDiff(), 1, index.minReadLen(), index.maxReadLen(),
+        index.canonicalSeeds(), index.seedMasks(), index.readLengthClasses(),
+        "", "", "", "", 0, "", false),
+      session(_session) {
+    configureSource("reads");
+  }
+
+protected:
+  void emitSeed(KeyValuePair& seedTuple) {
+    session.joinSeed(seedTuple);
+  }
+
+private:
+  AlignmentSession& session;
+};
+
+/// Orders a batch's reads by the bytes of their read id keys.
+class ReadKeyLess {
+public:
+  ReadKeyLess(const uint8_t* _batch)
+    : batch(_batch) {
+  }
+
+  inline bool operator()(uint64_t a, uint64_t b) const {
+    return memcmp(batch + a + 2 * sizeof(uint32_t),
+                  batch + b + 2 * sizeof(uint32_t), sizeof(int32_t)) < 0;
+  }
+
+private:
+  const uint8_t* batch;
+};
+
+/// Collects a read's alignments for the final filter.
+class AlignmentSession::FilterSink : public AlignmentSink {
+public:
+  FilterSink(AlignmentFilter& _filter)
+    : filter(_filter) {
+  }
+
+  void write(int32_t readID, AlignmentRecord& alignment) {
+    filter.add(readID, alignment);
+  }
+
+private:
+  AlignmentFilter& filter;
+};
+
+AlignmentSession::AlignmentSession(
+  const ReferenceIndex& _index, bool allowDifferences,
+  uint32_t maxAlignmentsPerRead, uint32_t maxHitsPerSeed,
+  const std::string& outputFormat)
+  : index(_index),
+    seeder(NULL),
+    // The job derives the seed length the same way.
+    aligner(
+      index.maxAlignDiff(), index.minReadLen() / (index.maxAlignDiff() + 1),
+      allowDifferences, index.seedMasks(), index.minReadLen(),
+      index.maxReadLen(), index.readLengthClasses(), maxAlignmentsPerRead,
+      maxHitsPerSeed),
+    alignmentFilter(maxAlignmentsPerRead),
+    writer(AlignmentCodec::parseFormat(outputFormat)),
+    readTuple(1),
+    numBatches(0),
+    numReads(0),
+    numAlignmentsWritten(0),
+    batchMicros(0),
+    longestBatchMicros(0) {
+  seeder = new (themis::memcheck) Seeder(index, *this);
+}
+
+AlignmentSession::~AlignmentSession() {
+  delete seeder;
+}
+
+bool AlignmentSession::alignBatch(
+  const uint8_t* batch, uint64_t batchLength,
+  std::vector<uint8_t>& alignments) {
+  // Check the whole batch before aligning any of it.
+  readOffsets.clear();
+  uint64_t offset = 0;
+  while (offset < batchLength) {
+    uint32_t keyLength;
+    uint32_t valueLength;
+    if (batchLength - offset < 2 * sizeof(uint32_t)) {
+      return false;
+    }
+    memcpy(&keyLength, batch + offset, sizeof(keyLength));
+    memcpy(&valueLength, batch + offset + sizeof(keyLength),
+           sizeof(valueLength));
+    if (keyLength != sizeof(int32_t) || valueLength == 0 ||
+        batchLength - offset - 2 * sizeof(uint32_t) <
+        static_cast<uint64_t>(keyLength) + valueLength) {
+      return false;
+    }
+    readOffsets.push_back(offset);
+    offset += 2 * sizeof(uint32_t) + keyLength + valueLength;
+  }
+
+  Timer timer;
+  timer.start();
+  // The job's filter stage sees reads in the sort order of their keys, which
+  // for little-endian read ids is not their numeric order.
+  std::stable_sort(readOffsets.begin(), readOffsets.end(), ReadKeyLess(batch));
+  KeyValuePair kvPair;
+  for (uint64_t i = 0; i < readOffsets.size(); i++) {
+    offset = readOffsets[i];
+    uint32_t valueLength;
+    memcpy(&valueLength, batch + offset + sizeof(uint32_t),
+           sizeof(valueLength));
+    const uint8_t* key = batch + offset + 2 * sizeof(uint32_t);
+    kvPair.setKey(key, sizeof(int32_t));
+    kvPair.setValue(key + sizeof(int32_t), valueLength);
+
+    int32_t readID;
+    memcpy(&readID, key, sizeof(readID));
+    seeder->seed(kvPair);
+    numAlignmentsWritten += writer.write(readID, alignmentFilter, alignments);
+    ++numReads;
+  }
+  timer.stop();
+
+  ++numBatches;
+  batchMicros += timer.getElapsed();
+  if (timer.getElapsed() > longestBatchMicros) {
+    longestBatchMicros = timer.getElapsed();
+  }
+  return true;
+}
+
+void AlignmentSession::joinSeed(KeyValuePair& seedTuple) {
+  // The seed is everything but the reference/query flag.
+  if (index.find(seedTuple.getKey(), seedTuple.getKeyLength() - 1,
+                 referenceTuples) == 0) {
+    return;
+  }
+  readTuple[0].fromBytes(seedTuple.getValue(), seedTuple.getValueLength());
+
+  // A batch is one read tuple against all of its seed's reference tuples, as
+  // in the broadcast join.
+  FilterSink sink(alignmentFilter);
+  aligner.startBatch(1);
+  aligner.alignBlock(
+    readTuple, referenceTuples, 1, referenceTuples.size(), sink);
+  aligner.finishBatch(sink);
+}
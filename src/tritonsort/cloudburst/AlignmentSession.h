@@ -0,0 +1,122 @@
+#ifndef CLOUDBURST_ALIGNMENT_SESSION_H
+#define CLOUDBURST_ALIGNMENT_SESSION_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "FilteredAlignmentWriter.h"
+#include "ReferenceIndex.h"
+#include "mapreduce/functions/map/cloudBurst/MerRecord.h"
+#include "mapreduce/functions/reduce/cloudBurst/AlignmentFilter.h"
+#include "mapreduce/functions/reduce/cloudBurst/CloudBurstAligner.h"
+
+class KeyValuePair;
+
+/**
+   Aligns batches of reads against a resident ReferenceIndex as they
+   arrive. Each read is seeded as the map function seeds reads, each seed
+   tuple is joined with the index's reference tuples for its seed by a
+   CloudBurstAligner as in the broadcast join, and the read's alignments are
+   filtered and written as CloudBurstFilterReduceFunction writes them. A
+   session is used by one thread at a time; any number of sessions can share
+   an index.
+ */
+class AlignmentSession {
+public:
+  /// Constructor
+  /**
+     \param index the reference index, whose seeding options the reads are
+     seeded with
+
+     \param allowDifferences whether indels are allowed, or only mismatches
+
+     \param maxAlignmentsPerRead the number of alignments to keep per read,
+     or 0 to keep every distinct alignment
+
+     \param maxHitsPerSeed if not 0, a read tuple stops being extended once
+     it has this many alignments against its seed's reference tuples
+
+     \param outputFormat "records" or "grouped". \sa AlignmentCodec
+   */
+  AlignmentSession(
+    const ReferenceIndex& index, bool allowDifferences,
+    uint32_t maxAlignmentsPerRead, uint32_t maxHitsPerSeed,
+    const std::string& outputFormat);
+
+  /// Destructor
+  virtual ~AlignmentSession();
+
+  /**
+     Align a batch of reads.
+
+     \param batch the reads, as tuples of 4-byte read id and FastaRecord laid
+     out as in a TupleFile
+
+     \param batchLength the length of the batch in bytes
+
+     \param[out] alignments the buffer to append the alignment tuples to,
+     laid out as in a TupleFile. Reads are written in the byte order of
+     their keys, as the job sorts them before its filter stage.
+
+     \return false if the batch is malformed, in which case none of it is
+     aligned
+   */
+  bool alignBatch(
+    const uint8_t* batch, uint64_t batchLength,
+    std::vector<uint8_t>& alignments);
+
+  /// \return the number of batches aligned
+  inline uint64_t batches() const {
+    return numBatches;
+  }
+
+  /// \return the number of reads aligned
+  inline uint64_t reads() const {
+    return numReads;
+  }
+
+  /// \return the number of alignments written
+  inline uint64_t alignmentsWritten() const {
+    return numAlignmentsWritten;
+  }
+
+  /// \return the total time spent aligning batches, in microseconds
+  inline uint64_t totalBatchMicros() const {
+    return batchMicros;
+  }
+
+  /// \return the longest time spent aligning a batch, in microseconds
+  inline uint64_t maxBatchMicros() const {
+    return longestBatchMicros;
+  }
+
+private:
+  class Seeder;
+  class FilterSink;
+
+  /**
+     Align a read's seed tuple against the index's tuples with its seed.
+
+     \param seedTuple the read's seed tuple
+   */
+  void joinSeed(KeyValuePair& seedTuple);
+
+  const ReferenceIndex& index;
+  Seeder* seeder;
+  CloudBurstAligner aligner;
+  AlignmentFilter alignmentFilter;
+  FilteredAlignmentWriter writer;
+  std::vector<MerRecord> referenceTuples;
+  std::vector<MerRecord> readTuple;
+  // The offsets of a batch's reads, in the order they are aligned
+  std::vector<uint64_t> readOffsets;
+
+  uint64_t numBatches;
+  uint64_t numReads;
+  uint64_t numAlignmentsWritten;
+  uint64_t batchMicros;
+  uint64_t longestBatchMicros;
+};
+
+#endif  // CLOUDBURST_ALIGNMENT_SESSION_H
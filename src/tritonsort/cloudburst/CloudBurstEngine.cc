@@ -0,0 +1,820 @@
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+
+#include "CloudBurstEngine.h"
+#include "FilteredAlignmentWriter.h"
+#include "core/MemoryUtils.h"
+#include "core/Timer.h"
+#include "core/TritonSortAssert.h"
+#include "mapreduce/common/KeyValuePair.h"
+#include "mapreduce/functions/map/cloudBurst/CloudBurstMapFunction.h"
+#include "mapreduce/functions/map/cloudBurst/FrontCodedRun.h"
+#include "mapreduce/functions/map/cloudBurst/PerfCounters.h"
+#include "mapreduce/functions/reduce/cloudBurst/AlignmentFilter.h"
+#include "mapreduce/functions/reduce/cloudBurst/CloudBurstAligner.h"
+#include "mapreduce/functions/reduce/cloudBurst/HotSeeds.h"
+
+const uint64_t CloudBurstEngine::MAP_TASK_BYTES = 1 << 20;
+const uint32_t CloudBurstEngine::SEED_BUCKETS = 4096;
+const uint32_t CloudBurstEngine::READ_BUCKETS = 256;
+
+// A seed tuple staged by a map task is the key and value lengths, the key
+// and the value.
+static const uint32_t SEED_HEADER_LENGTH = 2 * sizeof(uint32_t);
+
+// A seed bucket is a series of runs, one per map task that seeded the
+// bucket. Each run is the task's number, the length of the run and the
+// task's tuples for the bucket, sorted by key and front coded. Tuples with
+// the same key stay in the order the task emitted them, so merging the runs
+// by key, then task, restores the input order across threads.
+static const uint32_t SEED_RUN_HEADER_LENGTH = 2 * sizeof(uint64_t);
+
+// A read bucket entry is the read id key, the value length and the
+// AlignmentRecord.
+static const uint32_t READ_HEADER_LENGTH =
+  sizeof(int32_t) + sizeof(uint32_t);
+
+// The number of hottest seeds printStatistics() reports
+static const uint32_t NUM_HOT_SEEDS = 20;
+
+// Hardware counter regions' names, in PerfRegion order
+static const char* PERF_REGION_NAMES[] = {"seed", "parse", "extend"};
+
+/// Prints a hardware counter region as PerfCounters::logRegion would log it
+static void printPerfRegion(
+  FILE* file, const PerfCounters& counters, uint32_t region, uint64_t units,
+  const char* unitName) {
+  const char* name = PERF_REGION_NAMES[region];
+  for (uint32_t e = 0; e < PerfCounters::NUM_EVENTS; e++) {
+    PerfCounters::Event event = static_cast<PerfCounters::Event>(e);
+    if (!counters.counted(event)) {
+      continue;
+    }
+    fprintf(file, "perf_%s_%s\t%llu\n", name, PerfCounters::eventName(event),
+            static_cast<unsigned long long>(counters.count(region, event)));
+    fprintf(file, "perf_%s_%s_per_%s\t%s\n", name,
+            PerfCounters::eventName(event), unitName,
+            PerfCounters::ratio(counters.count(region, event), units).c_str());
+  }
+  fprintf(file, "perf_%s_ipc\t%s\n", name, PerfCounters::ratio(
+            counters.count(region, PerfCounters::INSTRUCTIONS),
+            counters.count(region, PerfCounters::CYCLES)).c_str());
+}
+
+static inline uint32_t loadUint32(const uint8_t* bytes) {
+  uint32_t value;
+  memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+/// Compares keys as the Themis sort would.
+static inline int compareKeys(
+  const uint8_t* a, uint32_t aLength, const uint8_t* b, uint32_t bLength) {
+  int cmp = memcmp(a, b, std::min(aLength, bLength));
+  if (cmp != 0) {
+    return cmp;
+  }
+  return aLength < bLength ? -1 : (aLength > bLength ? 1 : 0);
+}
+
+// Orders staged seed tuples by key. Sorting them stably keeps each key's
+// tuples in the order they were emitted.
+struct StagedSeedLess {
+  bool operator()(const uint8_t* a, const uint8_t* b) const {
+    return compareKeys(a + SEED_HEADER_LENGTH, loadUint32(a),
+                       b + SEED_HEADER_LENGTH, loadUint32(b)) < 0;
+  }
+};
+
+/// A seed run being merged, at its current tuple
+struct SeedRunCursor {
+  SeedRunCursor(const uint8_t* run, uint64_t length, uint64_t _task)
+    : reader(run, length),
+      task(_task) {
+  }
+
+  FrontCodedRunReader reader;
+  uint64_t task;
+};
+
+// Orders seed run cursors by their current key, then by task, with the
+// smallest at the top of a heap.
+struct SeedRunCursorGreater {
+  bool operator()(const SeedRunCursor* a, const SeedRunCursor* b) const {
+    int cmp = compareKeys(a->reader.key(), a->reader.keyLength(),
+                          b->reader.key(), b->reader.keyLength());
+    if (cmp != 0) {
+      return cmp > 0;
+    }
+    return a->task > b->task;
+  }
+};
+
+/**
+   Merges the runs of a seed bucket into one stream of tuples ordered by key,
+   then by task.
+ */
+class SeedRunMerger {
+public:
+  SeedRunMerger()
+    : current(NULL),
+      started(false),
+      repeated(false) {
+  }
+
+  /**
+     Add a run to merge. Every run must be added before the first call to
+     next().
+
+     \param run the run's first byte
+
+     \param length the length of the run in bytes
+
+     \param task the number of the map task that wrote the run
+   */
+  void addRun(const uint8_t* run, uint64_t length, uint64_t task) {
+    cursors.push_back(SeedRunCursor(run, length, task));
+  }
+
+  /**
+     Move to the next tuple; the first call moves to the first tuple.
+
+     \return false if there are no more tuples
+   */
+  bool next() {
+    repeated = false;
+    if (!started) {
+      started = true;
+      for (uint32_t i = 0; i < cursors.size(); i++) {
+        if (cursors[i].reader.next()) {
+          heap.push_back(&cursors[i]);
+        }
+      }
+      std::make_heap(heap.begin(), heap.end(), SeedRunCursorGreater());
+    } else if (current != NULL && current->reader.next()) {
+      if (current->reader.sameKey()) {
+        // A run's next tuple with the same key still sorts before every
+        // other run's tuples, since each run belongs to a different task.
+        repeated = true;
+        return true;
+      }
+      heap.push_back(current);
+      std::push_heap(heap.begin(), heap.end(), SeedRunCursorGreater());
+    }
+
+    if (heap.empty()) {
+      current = NULL;
+      return false;
+    }
+    std::pop_heap(heap.begin(), heap.end(), SeedRunCursorGreater());
+    current = heap.back();
+    heap.pop_back();
+    return true;
+  }
+
+  /// \return the current tuple's key, valid until the next call to next()
+  inline const uint8_t* key() const {
+    return current->reader.key();
+  }
+
+  /// \return the length of the current tuple's key
+  inline uint32_t keyLength() const {
+    return current->reader.keyLength();
+  }
+
+  /// \return the current tuple's value
+  inline const uint8_t* value() const {
+    return current->reader.value();
+  }
+
+  /// \return the length of the current tuple's value
+  inline uint32_t valueLength() const {
+    return current->reader.valueLength();
+  }
+
+  /**
+     \param groupKey the previous tuple's key
+
+     \return true if the current tuple has the same key
+   */
+  inline bool inGroup(const std::vector<uint8_t>& groupKey) const {
+    return repeated ||
+      (keyLength() == groupKey.size() &&
+       memcmp(key(), &groupKey[0], groupKey.size()) == 0);
+  }
+
+private:
+  std::vector<SeedRunCursor> cursors;
+  std::vector<SeedRunCursor*> heap;
+  SeedRunCursor* current;
+  bool started;
+  // Whether the current tuple came from the same run as the previous one,
+  // with the same key
+  bool repeated;
+};
+
+// Orders read bucket entries by key as the Themis sort would. Alignments of
+// the same read are ordered by their bytes, so that however the join was
+// spread over threads the filter sees them in the same order.
+struct ReadEntryLess {
+  bool operator()(const uint8_t* a, const uint8_t* b) const {
+    int cmp = memcmp(a, b, sizeof(int32_t));
+    if (cmp != 0) {
+      return cmp < 0;
+    }
+    uint32_t aLength = loadUint32(a + sizeof(int32_t));
+    uint32_t bLength = loadUint32(b + sizeof(int32_t));
+    cmp = memcmp(a + READ_HEADER_LENGTH, b + READ_HEADER_LENGTH,
+                 std::min(aLength, bLength));
+    if (cmp != 0) {
+      return cmp < 0;
+    }
+    return aLength < bLength;
+  }
+};
+
+/**
+   Seeds map tasks for one thread, putting each seed tuple in the thread's
+   seed bucket for its seed.
+ */
+class CloudBurstEngine::Seeder : public CloudBurstMapFunction {
+public:
+  Seeder(CloudBurstEngine& _engine, uint32_t _thread)
+    : CloudBurstMapFunction(
+        _engine.maxAlignDiff, 1, _engine.minReadLen, _engine.maxReadLen,
+        _engine.canonicalSeeds, _engine.seedMasks, _engine.readLengthClasses,
+        "", "", "", "", 0, "", false),
+      engine(_engine),
+      thread(_thread),
+      task(0),
+      stagedTuples(SEED_BUCKETS) {
+  }
+
+  /// Start seeding a map task.
+  void startTask(uint64_t _task) {
+    task = _task;
+  }
+
+  /// Sort the task's tuples in each bucket it seeded, and append them to the
+  /// thread's bucket as a run.
+  void finishTask() {
+    std::vector<const uint8_t*> tuples;
+    for (uint32_t i = 0; i < seededBuckets.size(); i++) {
+      uint32_t bucket = seededBuckets[i];
+      Bucket& staged = stagedTuples[bucket];
+      tuples.clear();
+      uint64_t offset = 0;
+      while (offset < staged.size()) {
+        const uint8_t* tuple = &staged[offset];
+        tuples.push_back(tuple);
+        offset += SEED_HEADER_LENGTH + loadUint32(tuple) +
+          loadUint32(tuple + sizeof(uint32_t));
+      }
+      std::stable_sort(tuples.begin(), tuples.end(), StagedSeedLess());
+
+      Bucket& runs = engine.seedBuckets[thread][bucket];
+      uint64_t runOffset = runs.size();
+      runs.resize(runOffset + SEED_RUN_HEADER_LENGTH);
+      FrontCodedRunWriter writer(runs);
+      for (uint64_t j = 0; j < tuples.size(); j++) {
+        uint32_t keyLength = loadUint32(tuples[j]);
+        writer.append(tuples[j] + SEED_HEADER_LENGTH, keyLength,
+                      tuples[j] + SEED_HEADER_LENGTH + keyLength,
+                      loadUint32(tuples[j] + sizeof(uint32_t)));
+      }
+      uint64_t runLength = runs.size() - runOffset - SEED_RUN_HEADER_LENGTH;
+      memcpy(&runs[runOffset], &task, sizeof(task));
+      memcpy(&runs[runOffset + sizeof(task)], &runLength, sizeof(runLength));
+
+      engine.seedTupleBytes[thread] += staged.size();
+      engine.seedRunBytes[thread] += runs.size() - runOffset;
+      staged.clear();
+    }
+    seededBuckets.clear();
+  }
+
+protected:
+  void emitSeed(KeyValuePair& seedTuple) {
+    const uint8_t* key = seedTuple.getKey();
+    uint32_t keyLength = seedTuple.getKeyLength();
+    uint32_t valueLength = seedTuple.getValueLength();
+
+    // FNV-1a of the seed, which is the key minus the reference/query flag,
+    // so that both sides of a seed land in the same bucket
+    uint64_t hash = 14695981039346656037ULL;
+    for (uint32_t i = 0; i + 1 < keyLength; i++) {
+      hash = (hash ^ key[i]) * 1099511628211ULL;
+    }
+
+    uint32_t bucketIndex = hash % SEED_BUCKETS;
+    Bucket& bucket = stagedTuples[bucketIndex];
+    if (bucket.empty()) {
+      seededBuckets.push_back(bucketIndex);
+    }
+    uint64_t offset = bucket.size();
+    bucket.resize(offset + SEED_HEADER_LENGTH + keyLength + valueLength);
+    uint8_t* entry = &bucket[offset];
+    memcpy(entry, &keyLength, sizeof(keyLength));
+    memcpy(entry + sizeof(keyLength), &valueLength, sizeof(valueLength));
+    memcpy(entry + SEED_HEADER_LENGTH, key, keyLength);
+    memcpy(entry + SEED_HEADER_LENGTH + keyLength, seedTuple.getValue(),
+           valueLength);
+    ++engine.seedTuples[thread];
+  }
+
+private:
+  CloudBurstEngine& engine;
+  const uint32_t thread;
+  uint64_t task;
+  // The current task's tuples, by bucket, and the buckets it has seeded
+  std::vector<Bucket> stagedTuples;
+  std::vector<uint32_t> seededBuckets;
+};
+
+/// Puts a thread's alignments in its read bucket for their key.
+class CloudBurstEngine::ReadBucketSink : public AlignmentSink {
+public:
+  ReadBucketSink(CloudBurstEngine& _engine, uint32_t _thread)
+    : engine(_engine),
+      thread(_thread) {
+  }
+
+  void write(int32_t readID, AlignmentRecord& alignment) {
+    // toBytes() sets outputSize
+    byte* value = alignment.toBytes();
+    uint32_t valueLength = alignment.outputSize;
+
+    // Buckets follow the key's first byte, so that concatenating them in
+    // order keeps the keys sorted.
+    uint8_t key[sizeof(readID)];
+    memcpy(key, &readID, sizeof(readID));
+    Bucket& bucket = engine.readBuckets[thread][key[0]];
+    uint64_t offset = bucket.size();
+    bucket.resize(offset + READ_HEADER_LENGTH + valueLength);
+    uint8_t* entry = &bucket[offset];
+    memcpy(entry, key, sizeof(readID));
+    memcpy(entry + sizeof(readID), &valueLength, sizeof(valueLength));
+    memcpy(entry + READ_HEADER_LENGTH, value, valueLength);
+    ++engine.joinAlignments[thread];
+  }
+
+private:
+  CloudBurstEngine& engine;
+  const uint32_t thread;
+};
+
+class CloudBurstEngine::SeedJob : public WorkStealingPool::Job {
+public:
+  SeedJob(CloudBurstEngine& _engine)
+    : engine(_engine) {
+  }
+
+  void run(uint64_t task, uint32_t thread) {
+    const MapTask& mapTask = engine.mapTasks[task];
+    const std::string& path = engine.inputPaths[mapTask.file];
+    Seeder& seeder = *engine.seeders[thread];
+    seeder.configureSource(path.substr(path.rfind('/') + 1));
+    seeder.startTask(task);
+    PerfCounters* perfCounters = engine.perfCounters.empty() ?
+      NULL : engine.perfCounters[thread];
+    if (perfCounters != NULL) {
+      perfCounters->enter(SEED_REGION);
+    }
+    KeyValuePair kvPair;
+    for (uint64_t i = mapTask.firstTuple; i < mapTask.lastTuple; i++) {
+      engine.inputs[mapTask.file]->get(i, kvPair);
+      seeder.seed(kvPair);
+    }
+    if (perfCounters != NULL) {
+      perfCounters->leave();
+    }
+    seeder.finishTask();
+  }
+
+private:
+  CloudBurstEngine& engine;
+};
+
+class CloudBurstEngine::JoinJob : public WorkStealingPool::Job {
+public:
+  JoinJob(CloudBurstEngine& _engine)
+    : engine(_engine) {
+  }
+
+  void run(uint64_t task, uint32_t thread) {
+    engine.joinBucket(task, thread);
+  }
+
+private:
+  CloudBurstEngine& engine;
+};
+
+class CloudBurstEngine::FilterJob : public WorkStealingPool::Job {
+public:
+  FilterJob(CloudBurstEngine& _engine)
+    : engine(_engine) {
+  }
+
+  void run(uint64_t task, uint32_t thread) {
+    engine.filterBucket(task, thread);
+  }
+
+private:
+  CloudBurstEngine& engine;
+};
+
+CloudBurstEngine::CloudBurstEngine(
+  uint32_t _maxAlignDiff, uint32_t _seedLength, bool _allowDifferences,
+  int32_t _minReadLen, int32_t _maxReadLen, bool _canonicalSeeds,
+  const std::string& _seedMasks, const std::string& _readLengthClasses,
+  uint32_t _blockSize, uint32_t _maxAlignmentsPerRead,
+  uint32_t _maxHitsPerSeed, const std::string& _outputFormat,
+  uint32_t numThreads, bool _perfCounters)
+  : maxAlignDiff(_maxAlignDiff),
+    seedLength(_seedLength),
+    allowDifferences(_allowDifferences),
+    minReadLen(_minReadLen),
+    maxReadLen(_maxReadLen),
+    canonicalSeeds(_canonicalSeeds),
+    seedMasks(_seedMasks),
+    readLengthClasses(_readLengthClasses),
+    // There is no tuner, so automatic sizing keeps its starting size.
+    blockSize(_blockSize > 0 ? _blockSize : 128),
+    maxAlignmentsPerRead(_maxAlignmentsPerRead),
+    maxHitsPerSeed(_maxHitsPerSeed),
+    outputFormat(AlignmentCodec::parseFormat(_outputFormat)),
+    pool(numThreads),
+    seedMicros(0),
+    joinMicros(0),
+    filterMicros(0) {
+  for (uint32_t thread = 0; thread < numThreads; thread++) {
+    seeders.push_back(new (themis::memcheck) Seeder(*this, thread));
+    aligners.push_back(new (themis::memcheck) CloudBurstAligner(
+      maxAlignDiff, seedLength, allowDifferences, seedMasks, minReadLen,
+      maxReadLen, readLengthClasses, maxAlignmentsPerRead, maxHitsPerSeed));
+    hotSeeds.push_back(new (themis::memcheck) HotSeeds(NUM_HOT_SEEDS));
+    if (_perfCounters) {
+      perfCounters.push_back(
+        new (themis::memcheck) PerfCounters(NUM_PERF_REGIONS));
+    }
+  }
+}
+
+CloudBurstEngine::~CloudBurstEngine() {
+  for (uint32_t thread = 0; thread < seeders.size(); thread++) {
+    delete seeders[thread];
+    delete aligners[thread];
+    delete hotSeeds[thread];
+  }
+  for (uint32_t thread = 0; thread < perfCounters.size(); thread++) {
+    delete perfCounters[thread];
+  }
+  for (uint32_t file = 0; file < inputs.size(); file++) {
+    delete inputs[file];
+  }
+}
+
+void CloudBurstEngine::addInput(const std::string& path) {
+  TupleFile* file = new (themis::memcheck) TupleFile();
+  file->load(path);
+  inputPaths.push_back(path);
+  inputs.push_back(file);
+}
+
+void CloudBurstEngine::run(const std::string& outputPath) {
+  uint32_t numThreads = pool.numThreads();
+  seedBuckets.assign(numThreads, std::vector<Bucket>(SEED_BUCKETS));
+  readBuckets.assign(numThreads, std::vector<Bucket>(READ_BUCKETS));
+  outputs.assign(READ_BUCKETS, Bucket());
+  seedTuples.assign(numThreads, 0);
+  seedTupleBytes.assign(numThreads, 0);
+  seedRunBytes.assign(numThreads, 0);
+  joinedSeeds.assign(numThreads, 0);
+  joinAlignments.assign(numThreads, 0);
+  pairsAttempted.assign(numThreads, 0);
+  pairsAligned.assign(numThreads, 0);
+  baezaYatesRejections.assign(numThreads, 0);
+  extendMicros.assign(numThreads, 0);
+  for (uint32_t thread = 0; thread < numThreads; thread++) {
+    hotSeeds[thread]->clear();
+  }
+  for (uint32_t thread = 0; thread < perfCounters.size(); thread++) {
+    delete perfCounters[thread];
+    perfCounters[thread] =
+      new (themis::memcheck) PerfCounters(NUM_PERF_REGIONS);
+  }
+  reads.assign(numThreads, 0);
+  alignmentsWritten.assign(numThreads, 0);
+
+  planMapTasks();
+
+  Timer timer;
+  timer.start();
+  SeedJob seedJob(*this);
+  pool.run(seedJob, mapTasks.size());
+  timer.stop();
+  seedMicros = timer.getElapsed();
+
+  timer.start();
+  JoinJob joinJob(*this);
+  pool.run(joinJob, SEED_BUCKETS);
+  timer.stop();
+  joinMicros = timer.getElapsed();
+
+  timer.start();
+  FilterJob filterJob(*this);
+  pool.run(filterJob, READ_BUCKETS);
+  timer.stop();
+  filterMicros = timer.getElapsed();
+
+  FILE* file = fopen(outputPath.c_str(), "wb");
+  ABORT_IF(file == NULL, "Failed to open %s: %s", outputPath.c_str(),
+           strerror(errno));
+  for (uint32_t bucket = 0; bucket < READ_BUCKETS; bucket++) {
+    Bucket& output = outputs[bucket];
+    ABORT_IF(!output.empty() &&
+             fwrite(&output[0], output.size(), 1, file) != 1,
+             "Failed to write %s: %s", outputPath.c_str(), strerror(errno));
+    Bucket().swap(output);
+  }
+  ABORT_IF(fclose(file) != 0, "Failed to close %s: %s", outputPath.c_str(),
+           strerror(errno));
+}
+
+void CloudBurstEngine::printStatistics(FILE* file) const {
+  uint64_t totalSeedTuples = 0;
+  uint64_t totalSeedTupleBytes = 0;
+  uint64_t totalSeedRunBytes = 0;
+  uint64_t totalJoinedSeeds = 0;
+  uint64_t totalJoinAlignments = 0;
+  uint64_t totalPairsAttempted = 0;
+  uint64_t totalPairsAligned = 0;
+  uint64_t totalBaezaYatesRejections = 0;
+  uint64_t totalExtendMicros = 0;
+  uint64_t totalReads = 0;
+  uint64_t totalAlignmentsWritten = 0;
+  for (uint32_t thread = 0; thread < seedTuples.size(); thread++) {
+    totalSeedTuples += seedTuples[thread];
+    totalSeedTupleBytes += seedTupleBytes[thread];
+    totalSeedRunBytes += seedRunBytes[thread];
+    totalJoinedSeeds += joinedSeeds[thread];
+    totalJoinAlignments += joinAlignments[thread];
+    totalPairsAttempted += pairsAttempted[thread];
+    totalPairsAligned += pairsAligned[thread];
+    totalBaezaYatesRejections += baezaYatesRejections[thread];
+    totalExtendMicros += extendMicros[thread];
+    totalReads += reads[thread];
+    totalAlignmentsWritten += alignmentsWritten[thread];
+  }
+  fprintf(file, "threads\t%u\n", pool.numThreads());
+  fprintf(file, "map_tasks\t%llu\n",
+          static_cast<unsigned long long>(mapTasks.size()));
+  fprintf(file, "seed_tuples\t%llu\n",
+          static_cast<unsigned long long>(totalSeedTuples));
+  fprintf(file, "seed_tuple_bytes\t%llu\n",
+          static_cast<unsigned long long>(totalSeedTupleBytes));
+  fprintf(file, "seed_run_bytes\t%llu\n",
+          static_cast<unsigned long long>(totalSeedRunBytes));
+  fprintf(file, "joined_seeds\t%llu\n",
+          static_cast<unsigned long long>(totalJoinedSeeds));
+  fprintf(file, "join_alignments\t%llu\n",
+          static_cast<unsigned long long>(totalJoinAlignments));
+  fprintf(file, "pairs_attempted\t%llu\n",
+          static_cast<unsigned long long>(totalPairsAttempted));
+  fprintf(file, "pairs_aligned\t%llu\n",
+          static_cast<unsigned long long>(totalPairsAligned));
+  fprintf(file, "baeza_yates_rejections\t%llu\n",
+          static_cast<unsigned long long>(totalBaezaYatesRejections));
+  fprintf(file, "extend_micros\t%llu\n",
+          static_cast<unsigned long long>(totalExtendMicros));
+  fprintf(file, "reads\t%llu\n", static_cast<unsigned long long>(totalReads));
+  fprintf(file, "alignments_written\t%llu\n",
+          static_cast<unsigned long long>(totalAlignmentsWritten));
+  fprintf(file, "tasks_stolen\t%llu\n",
+          static_cast<unsigned long long>(pool.tasksStolen()));
+  fprintf(file, "seed_micros\t%llu\n",
+          static_cast<unsigned long long>(seedMicros));
+  fprintf(file, "join_micros\t%llu\n",
+          static_cast<unsigned long long>(joinMicros));
+  fprintf(file, "filter_micros\t%llu\n",
+          static_cast<unsigned long long>(filterMicros));
+
+  if (!perfCounters.empty()) {
+    PerfCounters allPerfCounters(NUM_PERF_REGIONS);
+    for (uint32_t thread = 0; thread < perfCounters.size(); thread++) {
+      allPerfCounters.add(*perfCounters[thread]);
+      // Per-thread IPC shows whether one thread's extensions ran slower
+      for (uint32_t region = 0; region < NUM_PERF_REGIONS; region++) {
+        fprintf(file, "perf_%s_ipc_thread_%u\t%s\n", PERF_REGION_NAMES[region],
+                thread, PerfCounters::ratio(
+                  perfCounters[thread]->count(
+                    region, PerfCounters::INSTRUCTIONS),
+                  perfCounters[thread]->count(
+                    region, PerfCounters::CYCLES)).c_str());
+      }
+    }
+    printPerfRegion(file, allPerfCounters, SEED_REGION, totalSeedTuples,
+                    "seed");
+    printPerfRegion(file, allPerfCounters, PARSE_REGION, totalPairsAttempted,
+                    "attempted_pair");
+    printPerfRegion(file, allPerfCounters, EXTEND_REGION, totalPairsAligned,
+                    "aligned_pair");
+  }
+
+  HotSeeds allHotSeeds(NUM_HOT_SEEDS);
+  for (uint32_t thread = 0; thread < hotSeeds.size(); thread++) {
+    allHotSeeds.add(*hotSeeds[thread]);
+  }
+  std::vector<HotSeeds::Seed> hottest;
+  allHotSeeds.sorted(hottest);
+  for (uint32_t i = 0; i < hottest.size(); i++) {
+    fprintf(file, "hot_seed\t%s\t%llu\t%llu\n", hottest[i].hexKey().c_str(),
+            static_cast<unsigned long long>(hottest[i].referenceTuples),
+            static_cast<unsigned long long>(hottest[i].queryTuples));
+  }
+}
+
+uint64_t CloudBurstEngine::totalSeedTuples() const {
+  uint64_t total = 0;
+  for (uint32_t thread = 0; thread < seedTuples.size(); thread++) {
+    total += seedTuples[thread];
+  }
+  return total;
+}
+
+uint64_t CloudBurstEngine::totalAlignmentsWritten() const {
+  uint64_t total = 0;
+  for (uint32_t thread = 0; thread < alignmentsWritten.size(); thread++) {
+    total += alignmentsWritten[thread];
+  }
+  return total;
+}
+
+void CloudBurstEngine::planMapTasks() {
+  mapTasks.clear();
+  KeyValuePair kvPair;
+  for (uint32_t file = 0; file < inputs.size(); file++) {
+    MapTask task;
+    task.file = file;
+    task.firstTuple = 0;
+    uint64_t taskBytes = 0;
+    uint64_t numTuples = inputs[file]->size();
+    for (uint64_t i = 0; i < numTuples; i++) {
+      inputs[file]->get(i, kvPair);
+      taskBytes += kvPair.getValueLength();
+      if (taskBytes >= MAP_TASK_BYTES || i + 1 == numTuples) {
+        task.lastTuple = i + 1;
+        mapTasks.push_back(task);
+        task.firstTuple = i + 1;
+        taskBytes = 0;
+      }
+    }
+  }
+}
+
+void CloudBurstEngine::joinBucket(uint32_t bucket, uint32_t thread) {
+  SeedRunMerger merger;
+  for (uint32_t t = 0; t < seedBuckets.size(); t++) {
+    const Bucket& runs = seedBuckets[t][bucket];
+    uint64_t offset = 0;
+    while (offset < runs.size()) {
+      uint64_t task;
+      uint64_t runLength;
+      memcpy(&task, &runs[offset], sizeof(task));
+      memcpy(&runLength, &runs[offset + sizeof(task)], sizeof(runLength));
+      merger.addRun(&runs[offset + SEED_RUN_HEADER_LENGTH], runLength, task);
+      offset += SEED_RUN_HEADER_LENGTH + runLength;
+    }
+  }
+
+  // Merging and parsing tuples counts as parsing, and aligning them as
+  // extending
+  PerfCounters* threadPerfCounters =
+    perfCounters.empty() ? NULL : perfCounters[thread];
+  if (threadPerfCounters != NULL) {
+    threadPerfCounters->enter(PARSE_REGION);
+  }
+  CloudBurstAligner& aligner = *aligners[thread];
+  uint64_t startPairsAttempted = aligner.pairsAttempted();
+  uint64_t startPairsAligned = aligner.pairsAligned();
+  uint64_t startBaezaYatesRejections = aligner.baezaYatesRejections();
+  uint64_t startExtendMicros = aligner.extendMicros();
+  ReadBucketSink sink(*this, thread);
+  std::vector<MerRecord> referenceTuples;
+  std::vector<MerRecord> queryTuples;
+  std::vector<uint8_t> referenceKey;
+  std::vector<uint8_t> key;
+
+  bool more = merger.next();
+  while (more) {
+    key.assign(merger.key(), merger.key() + merger.keyLength());
+    uint32_t keyLength = key.size();
+
+    // As in the reducer, a seed's reference tuples sort just before its
+    // query tuples, since the key's last byte is 0 for the reference and 1
+    // for queries.
+    if (key[keyLength - 1] == 0) {
+      referenceTuples.clear();
+      do {
+        referenceTuples.push_back(MerRecord());
+        referenceTuples.back().fromBytes(merger.value(),
+                                         merger.valueLength());
+        more = merger.next();
+      } while (more && merger.inGroup(key));
+      referenceKey.swap(key);
+      continue;
+    }
+
+    ABORT_IF(key[keyLength - 1] != 1, "Last byte of the key should be 0 "
+             "(reference) or 1 (query). Got %u", key[keyLength - 1]);
+    if (referenceTuples.empty() || keyLength != referenceKey.size() ||
+        memcmp(&key[0], &referenceKey[0], keyLength - 1) != 0) {
+      // No reference tuples share this seed
+      do {
+        more = merger.next();
+      } while (more && merger.inGroup(key));
+      continue;
+    }
+
+    ++joinedSeeds[thread];
+    uint64_t groupQueryTuples = 0;
+    bool groupEnds = false;
+    while (!groupEnds) {
+      ++groupQueryTuples;
+      queryTuples.push_back(MerRecord());
+      queryTuples.back().fromBytes(merger.value(), merger.valueLength());
+      more = merger.next();
+      groupEnds = !more || !merger.inGroup(key);
+      if (queryTuples.size() >= blockSize || groupEnds) {
+        if (threadPerfCounters != NULL) {
+          threadPerfCounters->enter(EXTEND_REGION);
+        }
+        aligner.startBatch(queryTuples.size());
+        aligner.alignBlock(
+          queryTuples, referenceTuples, blockSize, blockSize, sink);
+        aligner.finishBatch(sink);
+        queryTuples.clear();
+        if (threadPerfCounters != NULL) {
+          threadPerfCounters->enter(PARSE_REGION);
+        }
+      }
+    }
+    hotSeeds[thread]->add(
+      &key[0], keyLength, referenceTuples.size(), groupQueryTuples);
+  }
+  pairsAttempted[thread] += aligner.pairsAttempted() - startPairsAttempted;
+  pairsAligned[thread] += aligner.pairsAligned() - startPairsAligned;
+  baezaYatesRejections[thread] +=
+    aligner.baezaYatesRejections() - startBaezaYatesRejections;
+  extendMicros[thread] += aligner.extendMicros() - startExtendMicros;
+  if (threadPerfCounters != NULL) {
+    threadPerfCounters->leave();
+  }
+
+  // The bucket's tuples are no longer needed by any thread.
+  for (uint32_t t = 0; t < seedBuckets.size(); t++) {
+    Bucket().swap(seedBuckets[t][bucket]);
+  }
+}
+
+void CloudBurstEngine::filterBucket(uint32_t bucket, uint32_t thread) {
+  std::vector<const uint8_t*> entries;
+  for (uint32_t t = 0; t < readBuckets.size(); t++) {
+    const Bucket& threadBucket = readBuckets[t][bucket];
+    uint64_t offset = 0;
+    while (offset < threadBucket.size()) {
+      const uint8_t* entry = &threadBucket[offset];
+      entries.push_back(entry);
+      offset += READ_HEADER_LENGTH + loadUint32(entry + sizeof(int32_t));
+    }
+  }
+  std::sort(entries.begin(), entries.end(), ReadEntryLess());
+
+  // Each read's alignments are filtered and written as
+  // CloudBurstFilterReduceFunction would.
+  AlignmentFilter alignmentFilter(maxAlignmentsPerRead);
+  FilteredAlignmentWriter writer(outputFormat);
+  AlignmentRecord alignment;
+  uint64_t i = 0;
+  while (i < entries.size()) {
+    const uint8_t* key = entries[i];
+    int32_t readID;
+    memcpy(&readID, key, sizeof(readID));
+    for (; i < entries.size() &&
+           memcmp(entries[i], key, sizeof(readID)) == 0; i++) {
+      alignment.fromBytes(entries[i] + READ_HEADER_LENGTH);
+      alignmentFilter.add(readID, alignment);
+    }
+
+    uint32_t written = writer.write(readID, alignmentFilter, outputs[bucket]);
+    if (written > 0) {
+      ++reads[thread];
+    }
+    alignmentsWritten[thread] += written;
+  }
+
+  for (uint32_t t = 0; t < readBuckets.size(); t++) {
+    Bucket().swap(readBuckets[t][bucket]);
+  }
+}
@@ -0,0 +1,255 @@
+#ifndef CLOUDBURST_CLOUD_BURST_ENGINE_H
+#define CLOUDBURST_CLOUD_BURST_ENGINE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "WorkStealingPool.h"
+#include "mapreduce/functions/map/cloudBurst/TupleFile.h"
+#include "mapreduce/functions/reduce/cloudBurst/AlignmentCodec.h"
+
+class CloudBurstAligner;
+class HotSeeds;
+class PerfCounters;
+
+/**
+   Runs a whole CloudBurst alignment on one machine, in memory, without the
+   Themis shuffle and sort.
+
+   The engine runs in three phases on a WorkStealingPool:
+
+   1. Seeding. The input is split into tasks of about MAP_TASK_BYTES of
+      sequence. Each thread seeds its tasks with its own
+      CloudBurstMapFunction, and radix-partitions the seed tuples by a hash of
+      the seed into SEED_BUCKETS buckets. At the end of a task, each bucket's
+      tuples are sorted by key and appended to the thread's bucket as one
+      FrontCodedRunWriter run, so that a seed group's tuples store its key
+      once.
+
+   2. Joining. Each task is one bucket. It merges that bucket's runs from
+      every thread by key, decoding them lazily, so that each seed's
+      reference tuples come just before its query tuples, as they would reach
+      a reducer. Then a
+      CloudBurstAligner joins each seed's tuples in batches of blockSize
+      queries, like CloudBurstReduceFunction does. The alignments are
+      partitioned by the first byte of their read id key into READ_BUCKETS
+      buckets per thread.
+
+   3. Filtering. Each task is one read bucket. It sorts the alignments by key
+      and filters each read's alignments as CloudBurstFilterReduceFunction
+      would.
+
+   Tuples with the same key keep the order of the input, whichever thread
+   made them. The read buckets are written out in order, so the output file
+   has exactly the tuples, in the same order, that a single
+   CloudBurstFilterReduceFunction partition would write for the distributed
+   job's alignments. Since there are no reducers, low complexity seeds get
+   no redundant copies, which leaves the alignments unchanged.
+ */
+class CloudBurstEngine {
+public:
+  /// Input is seeded in tasks of about this many bytes of sequence
+  static const uint64_t MAP_TASK_BYTES;
+
+  /// The number of seed buckets per thread
+  static const uint32_t SEED_BUCKETS;
+
+  /// The number of read buckets per thread, one per value of a key's first
+  /// byte
+  static const uint32_t READ_BUCKETS;
+
+  /// Constructor
+  /**
+     \param maxAlignDiff the maximum number of differences to allow
+
+     \param seedLength the length of a contiguous seed
+
+     \param allowDifferences whether indels are allowed, or only mismatches
+
+     \param minReadLen the length of the shortest read
+
+     \param maxReadLen the length of the longest read
+
+     \param canonicalSeeds if true, key seeds by the smaller of themselves
+     and their reverse complement
+
+     \param seedMasks the spaced seed masks, or an empty string for
+     contiguous seeds
+
+     \param readLengthClasses the read length classes, or an empty string
+     for a single class
+
+     \param blockSize the number of query tuples to align at a time, which
+     is also the number of reference tuples per tile
+
+     \param maxAlignmentsPerRead the number of alignments to keep per read,
+     or 0 to keep every distinct alignment
+
+     \param maxHitsPerSeed if not 0, a query tuple stops being extended once
+     it has this many alignments against its seed's reference tuples
+
+     \param outputFormat "records" or "grouped". \sa AlignmentCodec
+
+     \param numThreads the number of threads to run on
+
+     \param perfCounters if true, count cycles, instructions, cache misses
+     and branch misses per thread with hardware counters while seeding,
+     parsing seed tuples and extending them. \sa PerfCounters
+   */
+  CloudBurstEngine(
+    uint32_t maxAlignDiff, uint32_t seedLength, bool allowDifferences,
+    int32_t minReadLen, int32_t maxReadLen, bool canonicalSeeds,
+    const std::string& seedMasks, const std::string& readLengthClasses,
+    uint32_t blockSize, uint32_t maxAlignmentsPerRead,
+    uint32_t maxHitsPerSeed, const std::string& outputFormat,
+    uint32_t numThreads, bool perfCounters);
+
+  /// Destructor
+  virtual ~CloudBurstEngine();
+
+  /**
+     Add a converted input file. As for the map function's input buffers,
+     the file holds the reference if its name contains "ref".
+
+     \param path the file's path
+   */
+  void addInput(const std::string& path);
+
+  /**
+     Align the inputs and write the alignments.
+
+     \param outputPath the file to write alignment tuples to. \sa TupleFile
+   */
+  void run(const std::string& outputPath);
+
+  /**
+     Print the statistics of the last run(), followed by its hottest seeds.
+
+     \param file the file to print to
+   */
+  void printStatistics(FILE* file) const;
+
+  /// \return the time the last run() spent seeding, in microseconds
+  inline uint64_t seedPhaseMicros() const {
+    return seedMicros;
+  }
+
+  /// \return the time the last run() spent joining, in microseconds
+  inline uint64_t joinPhaseMicros() const {
+    return joinMicros;
+  }
+
+  /// \return the time the last run() spent filtering, in microseconds
+  inline uint64_t filterPhaseMicros() const {
+    return filterMicros;
+  }
+
+  /// \return the number of seed tuples the last run() joined
+  uint64_t totalSeedTuples() const;
+
+  /// \return the number of alignments the last run() wrote
+  uint64_t totalAlignmentsWritten() const;
+
+private:
+  class Seeder;
+  class ReadBucketSink;
+  class SeedJob;
+  class JoinJob;
+  class FilterJob;
+  friend class Seeder;
+  friend class ReadBucketSink;
+  friend class SeedJob;
+  friend class JoinJob;
+  friend class FilterJob;
+
+  /// A range of input tuples seeded as one task
+  struct MapTask {
+    uint32_t file;
+    uint64_t firstTuple;
+    uint64_t lastTuple;
+  };
+
+  /// A bucket of tuples, each prefixed by a header
+  typedef std::vector<uint8_t> Bucket;
+
+  /**
+     Split the inputs into seeding tasks.
+   */
+  void planMapTasks();
+
+  /**
+     Join one seed bucket.
+
+     \param bucket the bucket's index
+
+     \param thread the thread running the task
+   */
+  void joinBucket(uint32_t bucket, uint32_t thread);
+
+  /**
+     Filter one read bucket into its output.
+
+     \param bucket the bucket's index
+
+     \param thread the thread running the task
+   */
+  void filterBucket(uint32_t bucket, uint32_t thread);
+
+  const uint32_t maxAlignDiff;
+  const uint32_t seedLength;
+  const bool allowDifferences;
+  const int32_t minReadLen;
+  const int32_t maxReadLen;
+  const bool canonicalSeeds;
+  const std::string seedMasks;
+  const std::string readLengthClasses;
+  const uint32_t blockSize;
+  const uint32_t maxAlignmentsPerRead;
+  const uint32_t maxHitsPerSeed;
+  const AlignmentCodec::Format outputFormat;
+
+  WorkStealingPool pool;
+  std::vector<std::string> inputPaths;
+  std::vector<TupleFile*> inputs;
+  std::vector<MapTask> mapTasks;
+
+  // Per-thread state. Buckets are indexed by thread, then bucket.
+  std::vector<Seeder*> seeders;
+  std::vector<CloudBurstAligner*> aligners;
+  std::vector<HotSeeds*> hotSeeds;
+  // Hardware counters, if they are on
+  enum PerfRegion {
+    SEED_REGION,
+    PARSE_REGION,
+    EXTEND_REGION,
+    NUM_PERF_REGIONS
+  };
+  std::vector<PerfCounters*> perfCounters;
+  std::vector<std::vector<Bucket> > seedBuckets;
+  std::vector<std::vector<Bucket> > readBuckets;
+  // One output buffer per read bucket
+  std::vector<Bucket> outputs;
+
+  // Statistics, per thread where threads update them
+  std::vector<uint64_t> seedTuples;
+  // The bytes the seed tuples would take with whole keys, and the bytes
+  // their runs take
+  std::vector<uint64_t> seedTupleBytes;
+  std::vector<uint64_t> seedRunBytes;
+  std::vector<uint64_t> joinedSeeds;
+  std::vector<uint64_t> joinAlignments;
+  // The aligners' counters, for this run only
+  std::vector<uint64_t> pairsAttempted;
+  std::vector<uint64_t> pairsAligned;
+  std::vector<uint64_t> baezaYatesRejections;
+  std::vector<uint64_t> extendMicros;
+  std::vector<uint64_t> reads;
+  std::vector<uint64_t> alignmentsWritten;
+  uint64_t seedMicros;
+  uint64_t joinMicros;
+  uint64_t filterMicros;
+};
+
+#endif  // CLOUDBURST_CLOUD_BURST_ENGINE_H
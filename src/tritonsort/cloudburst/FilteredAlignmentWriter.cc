@@ -0,0 +1,41 @@
+#include <string.h>
+
+#include "FilteredAlignmentWriter.h"
+#include "mapreduce/functions/map/cloudBurst/TupleFile.h"
+
+FilteredAlignmentWriter::FilteredAlignmentWriter(
+  AlignmentCodec::Format _outputFormat)
+  : outputFormat(_outputFormat) {
+}
+
+uint32_t FilteredAlignmentWriter::write(
+  int32_t readID, AlignmentFilter& filter, std::vector<uint8_t>& output) {
+  uint8_t key[sizeof(readID)];
+  memcpy(key, &readID, sizeof(readID));
+
+  filter.filter(true);
+  uint32_t groupLength = 0;
+  if (outputFormat == AlignmentCodec::GROUPED) {
+    groupBytes.resize(
+      Varint::MAX_LENGTH + filter.size() * AlignmentCodec::MAX_HIT_LENGTH);
+    groupLength = Varint::encode(filter.size(), &groupBytes[0]);
+  }
+  for (uint32_t i = 0; i < filter.size(); i++) {
+    filter.get(i, alignment);
+    if (outputFormat == AlignmentCodec::GROUPED) {
+      groupLength += AlignmentCodec::encodeHit(
+        alignment, &groupBytes[groupLength]);
+    } else {
+      // toBytes() sets outputSize
+      byte* value = alignment.toBytes();
+      TupleFile::append(output, key, sizeof(key), value, alignment.outputSize);
+    }
+  }
+  if (groupLength > 0 && filter.size() > 0) {
+    TupleFile::append(output, key, sizeof(key), &groupBytes[0], groupLength);
+  }
+
+  uint32_t written = filter.size();
+  filter.clear();
+  return written;
+}
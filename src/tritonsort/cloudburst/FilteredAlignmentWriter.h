@@ -0,0 +1,44 @@
+#ifndef CLOUDBURST_FILTERED_ALIGNMENT_WRITER_H
+#define CLOUDBURST_FILTERED_ALIGNMENT_WRITER_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "mapreduce/functions/reduce/cloudBurst/AlignmentCodec.h"
+#include "mapreduce/functions/reduce/cloudBurst/AlignmentFilter.h"
+
+/**
+   Filters a read's alignments and appends the tuples that
+   CloudBurstFilterReduceFunction would write for them to a buffer, laid out
+   as in a TupleFile, for aligners that run outside a Themis job.
+ */
+class FilteredAlignmentWriter {
+public:
+  /// Constructor
+  /**
+     \param outputFormat the format to write alignments in
+   */
+  FilteredAlignmentWriter(AlignmentCodec::Format outputFormat);
+
+  /**
+     Filter one read's alignments, append them to a buffer and clear the
+     filter.
+
+     \param readID the read's id
+
+     \param filter the filter holding the read's alignments
+
+     \param[out] output the buffer to append tuples to
+
+     \return the number of alignments written
+   */
+  uint32_t write(
+    int32_t readID, AlignmentFilter& filter, std::vector<uint8_t>& output);
+
+private:
+  const AlignmentCodec::Format outputFormat;
+  AlignmentRecord alignment;
+  std::vector<uint8_t> groupBytes;
+};
+
+#endif  // CLOUDBURST_FILTERED_ALIGNMENT_WRITER_H
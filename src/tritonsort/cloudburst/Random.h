@@ -0,0 +1,42 @@
+#ifndef CLOUDBURST_RANDOM_H
+#define CLOUDBURST_RANDOM_H
+
+#include <stdint.h>
+
+/**
+   xorshift64*, a small random number generator for synthetic inputs. A seed
+   always gives the same numbers, whatever the C library's rand() does.
+ */
+class Random {
+public:
+  /// Constructor
+  /**
+     \param seed the seed
+   */
+  Random(uint64_t seed)
+    : state(seed * 2685821657736338717ULL + 1) {
+  }
+
+  /// \return the next 64 random bits
+  inline uint64_t next() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 2685821657736338717ULL;
+  }
+
+  /// \return a number in [0, n)
+  inline uint32_t below(uint32_t n) {
+    return next() % n;
+  }
+
+  /// \return a number in [0, 1)
+  inline double uniform() {
+    return (next() >> 11) * (1.0 / 9007199254740992.0);
+  }
+
+private:
+  uint64_t state;
+};
+
+#endif  // CLOUDBURST_RANDOM_H
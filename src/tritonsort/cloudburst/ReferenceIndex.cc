@@ -0,0 +1,293 @@
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ReferenceIndex.h"
+#include "core/TritonSortAssert.h"
+#include "mapreduce/common/KeyValuePair.h"
+#include "mapreduce/functions/map/cloudBurst/CloudBurstMapFunction.h"
+#include "mapreduce/functions/map/cloudBurst/TupleFile.h"
+#include "mapreduce/functions/reduce/cloudBurst/SeedHashTable.h"
+
+const uint32_t ReferenceIndex::VERSION = 1;
+
+static const uint8_t MAGIC[4] = {'C', 'B', 'R', 'I'};
+
+static inline uint64_t roundUp8(uint64_t offset) {
+  return (offset + 7) & ~static_cast<uint64_t>(7);
+}
+
+static uint64_t hashSeed(const uint8_t* seed, uint32_t seedLength) {
+  // 64-bit FNV-1a, as in SeedHashTable
+  uint64_t hash = 14695981039346656037ULL;
+  for (uint32_t i = 0; i < seedLength; i++) {
+    hash ^= seed[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/**
+   Seeds reference sequences into a SeedHashTable.
+ */
+class ReferenceIndex::Seeder : public CloudBurstMapFunction {
+public:
+  Seeder(
+    uint32_t maxAlignDiff, int32_t minReadLen, int32_t maxReadLen,
+    bool canonicalSeeds, const std::string& seedMasks,
+    const std::string& readLengthClasses, SeedHashTable& _table)
+    : CloudBurstMapFunction(
+        maxAlignDiff, 1, minReadLen, maxReadLen, canonicalSeeds, seedMasks,
+        readLengthClasses, "", "", "", "", 0, "", false),
+      table(_table),
+      tuples(0) {
+  }
+
+  uint64_t numTuples() const {
+    return tuples;
+  }
+
+protected:
+  void emitSeed(KeyValuePair& seedTuple) {
+    // The seed is everything but the reference/query flag.
+    table.insert(
+      seedTuple.getKey(), seedTuple.getKeyLength() - 1, seedTuple.getValue(),
+      seedTuple.getValueLength(), true);
+    ++tuples;
+  }
+
+private:
+  SeedHashTable& table;
+  uint64_t tuples;
+};
+
+ReferenceIndex::ReferenceIndex()
+  : image(NULL),
+    length(0),
+    mapping(NULL) {
+}
+
+ReferenceIndex::~ReferenceIndex() {
+  close();
+}
+
+void ReferenceIndex::build(
+  const std::vector<std::string>& referencePaths, uint32_t maxAlignDiff,
+  int32_t minReadLen, int32_t maxReadLen, bool canonicalSeeds,
+  const std::string& seedMasks, const std::string& readLengthClasses) {
+  close();
+
+  SeedHashTable table;
+  Seeder seeder(
+    maxAlignDiff, minReadLen, maxReadLen, canonicalSeeds, seedMasks,
+    readLengthClasses, table);
+  KeyValuePair kvPair;
+  for (uint32_t i = 0; i < referencePaths.size(); i++) {
+    const std::string& path = referencePaths[i];
+    std::string fileName = path.substr(path.rfind('/') + 1);
+    ABORT_IF(fileName.find("ref", 0) == std::string::npos, "%s does not hold "
+             "the reference; reference file names contain \"ref\"",
+             path.c_str());
+    TupleFile file;
+    file.load(path);
+    seeder.configureSource(fileName);
+    for (uint64_t tuple = 0; tuple < file.size(); tuple++) {
+      file.get(tuple, kvPair);
+      seeder.seed(kvPair);
+    }
+  }
+
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.maxAlignDiff = maxAlignDiff;
+  header.minReadLen = minReadLen;
+  header.maxReadLen = maxReadLen;
+  header.canonicalSeeds = canonicalSeeds;
+  // The table is never more than half full, so its capacity will do.
+  header.slots = table.capacity();
+  header.seeds = table.numSeeds();
+  header.tuples = seeder.numTuples();
+  header.masksLength = seedMasks.size();
+  header.classesLength = readLengthClasses.size();
+
+  builtImage.assign(sizeof(header), 0);
+  memcpy(&builtImage[0], &header, sizeof(header));
+  builtImage.insert(builtImage.end(), seedMasks.begin(), seedMasks.end());
+  builtImage.insert(
+    builtImage.end(), readLengthClasses.begin(), readLengthClasses.end());
+  builtImage.resize(roundUp8(builtImage.size()), 0);
+  uint64_t slotsStart = builtImage.size();
+  builtImage.resize(slotsStart + header.slots * sizeof(Slot), 0);
+
+  uint64_t mask = header.slots - 1;
+  std::vector<const uint8_t*> values;
+  std::vector<uint32_t> valueLengths;
+  for (uint64_t tableSlot = 0; tableSlot < table.capacity(); tableSlot++) {
+    if (!table.occupied(tableSlot)) {
+      continue;
+    }
+    const uint8_t* seed = table.seed(tableSlot);
+    uint32_t seedLength = table.seedLength(tableSlot);
+
+    // The table keeps each list newest first, so put the tuples back in the
+    // order they were seeded, in which the reducer would see them.
+    values.clear();
+    valueLengths.clear();
+    for (SeedHashTable::TupleHandle tuple = table.firstReference(tableSlot);
+         tuple != 0; tuple = table.next(tuple)) {
+      values.push_back(table.value(tuple));
+      valueLengths.push_back(table.valueLength(tuple));
+    }
+    std::reverse(values.begin(), values.end());
+    std::reverse(valueLengths.begin(), valueLengths.end());
+
+    Slot slot;
+    slot.hash = hashSeed(seed, seedLength);
+    slot.groupOffset = builtImage.size();
+    uint32_t tupleCount = values.size();
+    builtImage.insert(
+      builtImage.end(), reinterpret_cast<const uint8_t*>(&seedLength),
+      reinterpret_cast<const uint8_t*>(&seedLength) + sizeof(seedLength));
+    builtImage.insert(
+      builtImage.end(), reinterpret_cast<const uint8_t*>(&tupleCount),
+      reinterpret_cast<const uint8_t*>(&tupleCount) + sizeof(tupleCount));
+    builtImage.insert(builtImage.end(), seed, seed + seedLength);
+    for (uint32_t i = 0; i < tupleCount; i++) {
+      builtImage.insert(
+        builtImage.end(), reinterpret_cast<const uint8_t*>(&valueLengths[i]),
+        reinterpret_cast<const uint8_t*>(&valueLengths[i]) + sizeof(uint32_t));
+      builtImage.insert(
+        builtImage.end(), values[i], values[i] + valueLengths[i]);
+    }
+    builtImage.resize(roundUp8(builtImage.size()), 0);
+
+    // Linear probing, as in SeedHashTable
+    uint64_t position = slot.hash & mask;
+    while (true) {
+      Slot existing;
+      memcpy(&existing, &builtImage[slotsStart + position * sizeof(Slot)],
+             sizeof(existing));
+      if (existing.groupOffset == 0) {
+        break;
+      }
+      position = (position + 1) & mask;
+    }
+    memcpy(&builtImage[slotsStart + position * sizeof(Slot)], &slot,
+           sizeof(slot));
+  }
+
+  attach(&builtImage[0], builtImage.size());
+}
+
+void ReferenceIndex::write(const std::string& path) const {
+  ABORT_IF(image == NULL, "Cannot write an empty reference index");
+  FILE* file = fopen(path.c_str(), "wb");
+  ABORT_IF(file == NULL, "Failed to open %s: %s", path.c_str(),
+           strerror(errno));
+  ABORT_IF(fwrite(image, length, 1, file) != 1, "Failed to write %s: %s",
+           path.c_str(), strerror(errno));
+  ABORT_IF(fclose(file) != 0, "Failed to close %s: %s", path.c_str(),
+           strerror(errno));
+}
+
+void ReferenceIndex::open(const std::string& path) {
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  ABORT_IF(fd < 0, "Failed to open %s: %s", path.c_str(), strerror(errno));
+  struct stat fileStat;
+  ABORT_IF(fstat(fd, &fileStat) != 0, "Failed to stat %s: %s", path.c_str(),
+           strerror(errno));
+  ABORT_IF(static_cast<uint64_t>(fileStat.st_size) < sizeof(Header),
+           "%s is too short to be a reference index", path.c_str());
+  mapping = mmap(NULL, fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ABORT_IF(mapping == MAP_FAILED, "Failed to map %s: %s", path.c_str(),
+           strerror(errno));
+  ::close(fd);
+
+  attach(static_cast<const uint8_t*>(mapping), fileStat.st_size);
+}
+
+uint32_t ReferenceIndex::find(
+  const uint8_t* seed, uint32_t seedLength,
+  std::vector<MerRecord>& tuples) const {
+  tuples.clear();
+  uint64_t hash = hashSeed(seed, seedLength);
+  uint64_t mask = header().slots - 1;
+  const uint8_t* slots = image + slotsOffset();
+  uint64_t position = hash & mask;
+  while (true) {
+    Slot slot;
+    memcpy(&slot, slots + position * sizeof(Slot), sizeof(slot));
+    if (slot.groupOffset == 0) {
+      return 0;
+    }
+    const uint8_t* group = image + slot.groupOffset;
+    uint32_t groupSeedLength;
+    memcpy(&groupSeedLength, group, sizeof(groupSeedLength));
+    if (slot.hash == hash && groupSeedLength == seedLength &&
+        memcmp(group + 2 * sizeof(uint32_t), seed, seedLength) == 0) {
+      uint32_t tupleCount;
+      memcpy(&tupleCount, group + sizeof(uint32_t), sizeof(tupleCount));
+      const uint8_t* tuple = group + 2 * sizeof(uint32_t) + seedLength;
+      tuples.resize(tupleCount);
+      for (uint32_t i = 0; i < tupleCount; i++) {
+        uint32_t valueLength;
+        memcpy(&valueLength, tuple, sizeof(valueLength));
+        tuples[i].fromBytes(tuple + sizeof(valueLength), valueLength);
+        tuple += sizeof(valueLength) + valueLength;
+      }
+      return tupleCount;
+    }
+    position = (position + 1) & mask;
+  }
+}
+
+std::string ReferenceIndex::seedMasks() const {
+  const char* masks = reinterpret_cast<const char*>(image + sizeof(Header));
+  return std::string(masks, header().masksLength);
+}
+
+std::string ReferenceIndex::readLengthClasses() const {
+  const char* classes = reinterpret_cast<const char*>(
+    image + sizeof(Header) + header().masksLength);
+  return std::string(classes, header().classesLength);
+}
+
+uint64_t ReferenceIndex::slotsOffset() const {
+  return roundUp8(
+    sizeof(Header) + header().masksLength + header().classesLength);
+}
+
+void ReferenceIndex::close() {
+  if (mapping != NULL) {
+    munmap(mapping, length);
+    mapping = NULL;
+  }
+  std::vector<uint8_t>().swap(builtImage);
+  image = NULL;
+  length = 0;
+}
+
+void ReferenceIndex::attach(const uint8_t* _image, uint64_t _length) {
+  image = _image;
+  length = _length;
+  const Header& indexHeader = header();
+  ABORT_IF(memcmp(indexHeader.magic, MAGIC, sizeof(MAGIC)) != 0,
+           "Not a CloudBurst reference index");
+  ABORT_IF(indexHeader.version != VERSION, "Reference index version %u is "
+           "not supported; expected version %u", indexHeader.version,
+           VERSION);
+  ABORT_IF(indexHeader.slots == 0 ||
+           (indexHeader.slots & (indexHeader.slots - 1)) != 0,
+           "Reference index has %llu slots, which is not a power of 2",
+           indexHeader.slots);
+  ABORT_IF(slotsOffset() + indexHeader.slots * sizeof(Slot) > length,
+           "Reference index is truncated");
+}
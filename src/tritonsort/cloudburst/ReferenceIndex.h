@@ -0,0 +1,195 @@
+#ifndef CLOUDBURST_REFERENCE_INDEX_H
+#define CLOUDBURST_REFERENCE_INDEX_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "mapreduce/functions/map/cloudBurst/MerRecord.h"
+
+/**
+   A reference's CloudBurst seed tuples, grouped by seed in a read-only
+   image that can be written to a file and memory-mapped back, so that a
+   long-running aligner starts without seeding the reference again and
+   several processes can share one copy of it.
+
+   The image holds the seeding options, since reads must be seeded the same
+   way to meet the reference's seeds, followed by an open-addressing table of
+   seeds and each seed's reference tuples in the order they were seeded:
+
+     magic            4 bytes  "CBRI"
+     version          uint32
+     max align diff   uint32
+     min read length  int32
+     max read length  int32
+     canonical seeds  uint32
+     slots            uint64   a power of 2, at least twice the seeds
+     seeds            uint64
+     tuples           uint64
+     masks length     uint32
+     classes length   uint32
+     seed masks, read length classes, padding to 8 bytes
+     per slot:
+       hash           uint64   64-bit FNV-1a of the seed
+       group offset   uint64   0 for an empty slot
+     per seed, at its group offset:
+       seed length    uint32
+       tuple count    uint32
+       seed
+       per tuple:
+         length       uint32
+         MerRecord
+       padding to 8 bytes
+ */
+class ReferenceIndex {
+public:
+  /// Constructor
+  ReferenceIndex();
+
+  /// Destructor
+  virtual ~ReferenceIndex();
+
+  /**
+     Seed reference files into the index, replacing what it held.
+
+     \param referencePaths converted reference input files. \sa TupleFile
+
+     \param maxAlignDiff the maximum number of differences reads will be
+     aligned with
+
+     \param minReadLen the length of the shortest read
+
+     \param maxReadLen the length of the longest read
+
+     \param canonicalSeeds if true, key seeds by the smaller of themselves
+     and their reverse complement
+
+     \param seedMasks the spaced seed masks, or an empty string for
+     contiguous seeds
+
+     \param readLengthClasses the read length classes, or an empty string
+     for a single class
+   */
+  void build(
+    const std::vector<std::string>& referencePaths, uint32_t maxAlignDiff,
+    int32_t minReadLen, int32_t maxReadLen, bool canonicalSeeds,
+    const std::string& seedMasks, const std::string& readLengthClasses);
+
+  /**
+     Write the index to a file.
+
+     \param path the file's path
+   */
+  void write(const std::string& path) const;
+
+  /**
+     Memory-map an index file, replacing what the index held.
+
+     \param path the file's path
+   */
+  void open(const std::string& path);
+
+  /**
+     Look up a seed's reference tuples. The records point into the index.
+
+     \param seed the seed, which is a tuple's key minus the reference/query
+     flag byte
+
+     \param seedLength the length of the seed
+
+     \param[out] tuples the seed's reference tuples in seeding order, or
+     nothing if the reference does not have the seed
+
+     \return the number of tuples
+   */
+  uint32_t find(
+    const uint8_t* seed, uint32_t seedLength,
+    std::vector<MerRecord>& tuples) const;
+
+  /// \return the maximum number of differences the index was seeded for
+  inline uint32_t maxAlignDiff() const {
+    return header().maxAlignDiff;
+  }
+
+  /// \return the length of the shortest read the index was seeded for
+  inline int32_t minReadLen() const {
+    return header().minReadLen;
+  }
+
+  /// \return the length of the longest read the index was seeded for
+  inline int32_t maxReadLen() const {
+    return header().maxReadLen;
+  }
+
+  /// \return true if the index was seeded with canonical seeds
+  inline bool canonicalSeeds() const {
+    return header().canonicalSeeds != 0;
+  }
+
+  /// \return the spaced seed masks the index was seeded with
+  std::string seedMasks() const;
+
+  /// \return the read length classes the index was seeded for
+  std::string readLengthClasses() const;
+
+  /// \return the number of distinct seeds
+  inline uint64_t numSeeds() const {
+    return header().seeds;
+  }
+
+  /// \return the number of reference tuples
+  inline uint64_t numTuples() const {
+    return header().tuples;
+  }
+
+  /// \return the size of the image in bytes
+  inline uint64_t bytes() const {
+    return length;
+  }
+
+private:
+  struct Header {
+    uint8_t magic[4];
+    uint32_t version;
+    uint32_t maxAlignDiff;
+    int32_t minReadLen;
+    int32_t maxReadLen;
+    uint32_t canonicalSeeds;
+    uint64_t slots;
+    uint64_t seeds;
+    uint64_t tuples;
+    uint32_t masksLength;
+    uint32_t classesLength;
+  };
+
+  struct Slot {
+    uint64_t hash;
+    uint64_t groupOffset;
+  };
+
+  class Seeder;
+
+  static const uint32_t VERSION;
+
+  /// \return the image's header
+  inline const Header& header() const {
+    return *reinterpret_cast<const Header*>(image);
+  }
+
+  /// \return the offset of the slot table in the image
+  uint64_t slotsOffset() const;
+
+  /// Release the image.
+  void close();
+
+  /// Point at an image and check its header.
+  void attach(const uint8_t* image, uint64_t length);
+
+  const uint8_t* image;
+  uint64_t length;
+  // An image built in memory, or empty if the image is mapped
+  std::vector<uint8_t> builtImage;
+  void* mapping;
+};
+
+#endif  // CLOUDBURST_REFERENCE_INDEX_H
@@ -0,0 +1,95 @@
+#include <string.h>
+
+#include "WorkStealingPool.h"
+#include "core/TritonSortAssert.h"
+
+WorkStealingPool::WorkStealingPool(uint32_t numThreads)
+  : threadCount(numThreads),
+    workers(numThreads),
+    job(NULL),
+    stolen(0) {
+  ABORT_IF(threadCount == 0, "A work-stealing pool needs at least one thread");
+  for (uint32_t i = 0; i < threadCount; i++) {
+    workers[i].pool = this;
+    workers[i].thread = i;
+    workers[i].stolen = 0;
+    pthread_mutex_init(&workers[i].lock, NULL);
+  }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  for (uint32_t i = 0; i < threadCount; i++) {
+    pthread_mutex_destroy(&workers[i].lock);
+  }
+}
+
+void WorkStealingPool::run(Job& _job, uint64_t numTasks) {
+  job = &_job;
+
+  // Deal the tasks out in contiguous ranges, so that neighbouring tasks,
+  // which often touch neighbouring data, run on the same thread.
+  for (uint32_t i = 0; i < threadCount; i++) {
+    uint64_t first = numTasks * i / threadCount;
+    uint64_t last = numTasks * (i + 1) / threadCount;
+    for (uint64_t task = first; task < last; task++) {
+      workers[i].tasks.push_back(task);
+    }
+    workers[i].stolen = 0;
+  }
+
+  std::vector<pthread_t> threads(threadCount);
+  for (uint32_t i = 1; i < threadCount; i++) {
+    int status = pthread_create(&threads[i], NULL, workerMain, &workers[i]);
+    ABORT_IF(status != 0, "pthread_create() failed: %s", strerror(status));
+  }
+  workerMain(&workers[0]);
+  for (uint32_t i = 1; i < threadCount; i++) {
+    int status = pthread_join(threads[i], NULL);
+    ABORT_IF(status != 0, "pthread_join() failed: %s", strerror(status));
+  }
+
+  for (uint32_t i = 0; i < threadCount; i++) {
+    stolen += workers[i].stolen;
+  }
+  job = NULL;
+}
+
+void* WorkStealingPool::workerMain(void* arg) {
+  Worker* worker = static_cast<Worker*>(arg);
+  uint64_t task;
+  while (worker->pool->nextTask(worker->thread, task)) {
+    worker->pool->job->run(task, worker->thread);
+  }
+  return NULL;
+}
+
+bool WorkStealingPool::nextTask(uint32_t thread, uint64_t& task) {
+  Worker& self = workers[thread];
+  pthread_mutex_lock(&self.lock);
+  bool found = !self.tasks.empty();
+  if (found) {
+    task = self.tasks.back();
+    self.tasks.pop_back();
+  }
+  pthread_mutex_unlock(&self.lock);
+  if (found) {
+    return true;
+  }
+
+  // Steal the task its owner would get to last
+  for (uint32_t i = 1; i < threadCount; i++) {
+    Worker& victim = workers[(thread + i) % threadCount];
+    pthread_mutex_lock(&victim.lock);
+    found = !victim.tasks.empty();
+    if (found) {
+      task = victim.tasks.front();
+      victim.tasks.pop_front();
+    }
+    pthread_mutex_unlock(&victim.lock);
+    if (found) {
+      ++self.stolen;
+      return true;
+    }
+  }
+  return false;
+}
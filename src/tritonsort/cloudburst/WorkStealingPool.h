@@ -0,0 +1,93 @@
+#ifndef CLOUDBURST_WORK_STEALING_POOL_H
+#define CLOUDBURST_WORK_STEALING_POOL_H
+
+#include <deque>
+#include <pthread.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+   Runs the tasks of a job on a fixed number of threads, the calling thread
+   among them. Each thread starts with a contiguous range of the tasks in its
+   own deque and takes them from the back; once its deque is empty it steals
+   from the front of the others' deques, so a thread that drew large tasks
+   does not hold up the rest. Tasks don't create tasks, so a thread stops
+   once every deque is empty.
+ */
+class WorkStealingPool {
+public:
+  /// The work of a job, split into numbered tasks
+  class Job {
+  public:
+    /// Destructor
+    virtual ~Job() {}
+
+    /**
+       Run a task.
+
+       \param task the task's number
+
+       \param thread the number of the thread running it, below the pool's
+       numThreads()
+     */
+    virtual void run(uint64_t task, uint32_t thread) = 0;
+  };
+
+  /// Constructor
+  /**
+     \param numThreads the number of threads to run tasks on
+   */
+  WorkStealingPool(uint32_t numThreads);
+
+  /// Destructor
+  virtual ~WorkStealingPool();
+
+  /**
+     Run every task of a job and wait for them to finish.
+
+     \param job the job
+
+     \param numTasks the number of tasks, numbered from 0
+   */
+  void run(Job& job, uint64_t numTasks);
+
+  /// \return the number of threads
+  inline uint32_t numThreads() const {
+    return threadCount;
+  }
+
+  /// \return the number of tasks run by a thread other than the one first
+  /// given them, over every job so far
+  inline uint64_t tasksStolen() const {
+    return stolen;
+  }
+
+private:
+  struct Worker {
+    WorkStealingPool* pool;
+    uint32_t thread;
+    pthread_mutex_t lock;
+    std::deque<uint64_t> tasks;
+    uint64_t stolen;
+  };
+
+  static void* workerMain(void* arg);
+
+  /**
+     Take the next task for a thread, from its own deque or another's.
+
+     \param thread the thread
+
+     \param[out] task the task
+
+     \return false if there are no tasks left
+   */
+  bool nextTask(uint32_t thread, uint64_t& task);
+
+  const uint32_t threadCount;
+  std::vector<Worker> workers;
+  Job* job;
+  uint64_t stolen;
+};
+
+#endif  // CLOUDBURST_WORK_STEALING_POOL_H
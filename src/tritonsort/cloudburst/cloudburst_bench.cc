@@ -0,0 +1,863 @@
+#include <algorithm>
+#include <getopt.h>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "Random.h"
+#include "core/Timer.h"
+#include "core/TritonSortAssert.h"
+#include "mapreduce/functions/map/cloudBurst/DNAString.h"
+#include "mapreduce/functions/map/cloudBurst/MerRecord.h"
+#include "mapreduce/functions/reduce/cloudBurst/AlignInfo.h"
+#include "mapreduce/functions/reduce/cloudBurst/AlignmentSink.h"
+#include "mapreduce/functions/reduce/cloudBurst/CloudBurstAligner.h"
+#include "mapreduce/functions/reduce/cloudBurst/LandauVishkin.h"
+
+/**
+   Times the CloudBurst kernels in isolation on synthetic inputs: DNAString
+   conversions, MerRecord serialization, the Landau-Vishkin extensions, the
+   Baeza-Yates leftmost seed check and the aligner's batch join.
+
+   Every input is generated from a fixed random seed, so two runs of the
+   same build see the same bytes and report the same checksums. For each
+   combination of genome, read length, K and error rate, reads are sampled
+   from the genome's forward strand with substitutions at the error rate and
+   seeded at their first seed without errors, the way the map function
+   seeds them. Each kernel runs over the whole workload several times and
+   the fastest pass is reported, as nanoseconds per operation and per base,
+   and allocations per operation, on standard error and as JSON.
+ */
+
+// Every allocation through the global operator new is counted, which covers
+// new[], the STL and themis::memcheck allocations.
+static uint64_t allocations = 0;
+
+void* operator new(size_t size) {
+  ++allocations;
+  void* pointer = malloc(size > 0 ? size : 1);
+  if (pointer == NULL) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+// Not inlined, so that GCC does not mistake free() for a mismatched
+// deallocation of operator new's memory
+__attribute__((noinline)) void operator delete(void* pointer) throw() {
+  free(pointer);
+}
+
+static const byte BASES[4] = {'A', 'C', 'G', 'T'};
+
+/// Counts the alignments a CloudBurstAligner finds
+class CountingSink : public AlignmentSink {
+public:
+  CountingSink()
+    : alignments(0),
+      checksum(0) {
+  }
+
+  void write(int32_t readID, AlignmentRecord& alignment) {
+    ++alignments;
+    checksum += readID + alignment.refStart + alignment.differences;
+  }
+
+  uint64_t alignments;
+  uint64_t checksum;
+};
+
+/// The inputs for one combination of genome, read length, K and error rate
+struct Workload {
+  std::string genomeKind;
+  uint32_t readLength;
+  uint32_t maxAlignDiff;
+  double errorRate;
+  uint32_t seedLength;
+
+  std::vector<byte> genome;
+  // Reads, readLength bases each, and where each one's seed starts
+  std::vector<byte> reads;
+  std::vector<int32_t> seedStarts;
+  // Each read packed 2 bases per byte
+  std::vector<std::vector<byte> > packedReads;
+  // Each read's query tuple and the reference tuple of its true position
+  std::vector<std::vector<uint8_t> > queryBytes;
+  std::vector<std::vector<uint8_t> > referenceBytes;
+  std::vector<MerRecord> queries;
+  std::vector<MerRecord> references;
+  // Both flanks of each tuple as letters, for kdifference
+  std::vector<std::vector<byte> > queryLetters;
+  std::vector<std::vector<byte> > referenceLetters;
+
+  inline byte* read(uint32_t i) {
+    return &reads[i * readLength];
+  }
+};
+
+/// The timing of one kernel on one workload
+struct Result {
+  const char* kernel;
+  // What an operation is: a sequence, a record or a pair of tuples
+  const char* unit;
+  uint64_t ops;
+  uint64_t bases;
+  uint64_t micros;
+  uint64_t allocations;
+  uint64_t checksum;
+};
+
+/**
+   A kernel to time. run() makes one pass over the workload and returns a
+   checksum of what the kernel computed, which keeps the compiler from
+   dropping the work and changes if the kernel's results do.
+ */
+class Kernel {
+public:
+  virtual ~Kernel() {}
+  virtual uint64_t run() = 0;
+};
+
+static Result measure(
+  const char* name, const char* unit, uint64_t ops, uint64_t bases,
+  Kernel& kernel, uint32_t passes) {
+  Result result;
+  result.kernel = name;
+  result.unit = unit;
+  result.ops = ops;
+  result.bases = bases;
+  result.micros = 0;
+
+  Timer timer;
+  for (uint32_t pass = 0; pass < passes; pass++) {
+    uint64_t allocationsBefore = allocations;
+    timer.start();
+    uint64_t checksum = kernel.run();
+    timer.stop();
+    uint64_t micros = timer.getElapsed();
+    if (pass == 0 || micros < result.micros) {
+      result.micros = micros;
+    }
+    // Every pass does the same work
+    result.allocations = allocations - allocationsBefore;
+    result.checksum = checksum;
+  }
+  return result;
+}
+
+static void appendFlankLetters(
+  DNAString& dnaStringObj, const PackedFlank& flank,
+  std::vector<byte>& letters) {
+  size_t offset = letters.size();
+  letters.resize(offset + flank.length);
+  if (flank.length > 0) {
+    dnaStringObj.packedToArr(flank.bases, flank.length, flank.exceptions,
+                             flank.numExceptions, &letters[offset]);
+  }
+}
+
+static void generateGenome(
+  const std::string& kind, uint32_t length, Random& random,
+  std::vector<byte>& genome) {
+  genome.resize(length);
+  if (kind == "random") {
+    for (uint32_t i = 0; i < length; i++) {
+      genome[i] = BASES[random.below(4)];
+    }
+    return;
+  }
+
+  // Tandem copies of a 500 base unit, each copy diverging from the unit at
+  // 2% of its bases, as in a satellite repeat
+  const uint32_t unitLength = 500;
+  std::vector<byte> unit(unitLength);
+  for (uint32_t i = 0; i < unitLength; i++) {
+    unit[i] = BASES[random.below(4)];
+  }
+  for (uint32_t i = 0; i < length; i++) {
+    genome[i] = random.uniform() < 0.02 ?
+      BASES[random.below(4)] : unit[i % unitLength];
+  }
+}
+
+static void generateWorkload(
+  Workload& workload, uint32_t genomeLength, uint32_t numReads,
+  uint32_t seed) {
+  // Workloads with the same genome kind share the genome, and each
+  // workload's reads depend only on its own parameters
+  bool repetitive = workload.genomeKind == "repetitive";
+  Random genomeRandom(seed * 2ULL + repetitive);
+  Random random(((((seed * 2ULL + repetitive) * 1000003ULL +
+                   workload.readLength) * 1000003ULL +
+                  workload.maxAlignDiff) * 1000003ULL) +
+                static_cast<uint64_t>(workload.errorRate * 1000000));
+  DNAString dnaStringObj;
+  uint32_t readLength = workload.readLength;
+  uint32_t seedLength = workload.seedLength;
+  // The job's reference flank length
+  int32_t flankLength = readLength - seedLength + workload.maxAlignDiff;
+
+  generateGenome(
+    workload.genomeKind, genomeLength, genomeRandom, workload.genome);
+
+  workload.reads.resize(numReads * readLength);
+  workload.seedStarts.resize(numReads);
+  workload.packedReads.resize(numReads);
+  workload.queryBytes.resize(numReads);
+  workload.referenceBytes.resize(numReads);
+  workload.queryLetters.resize(numReads);
+  workload.referenceLetters.resize(numReads);
+  for (uint32_t i = 0; i < numReads; i++) {
+    uint32_t position = random.below(genomeLength - readLength + 1);
+    byte* read = workload.read(i);
+    memcpy(read, &workload.genome[position], readLength);
+    std::vector<bool> errors(readLength, false);
+    for (uint32_t j = 0; j < readLength; j++) {
+      if (random.uniform() < workload.errorRate) {
+        read[j] = BASES[(random.below(3) + 1 +
+                         (dnaStringObj.byteToSeed(read[j]) & 3)) % 4];
+        errors[j] = true;
+      }
+    }
+
+    // Seed the read at its first seed without errors, which is the seed its
+    // alignment is reported from
+    int32_t seedStart = 0;
+    for (uint32_t start = 0; start + seedLength <= readLength;
+         start += seedLength) {
+      bool clean = true;
+      for (uint32_t j = start; j < start + seedLength; j++) {
+        clean = clean && !errors[j];
+      }
+      if (clean) {
+        seedStart = start;
+        break;
+      }
+    }
+    workload.seedStarts[i] = seedStart;
+
+    byte* packed = dnaStringObj.arrToDNA(read, readLength);
+    workload.packedReads[i].assign(packed, packed + (readLength + 1) / 2);
+    delete[] packed;
+
+    MerRecord query;
+    query.isReference = false;
+    query.id = i;
+    query.offset = seedStart;
+    int32_t rightStart = seedStart + seedLength;
+    byte* bytes = query.toBytes(
+      read, 0, seedStart, rightStart, readLength - rightStart);
+    workload.queryBytes[i].assign(bytes, bytes + query.toBytesLen(
+      read, 0, seedStart, rightStart, readLength - rightStart));
+    delete[] bytes;
+
+    MerRecord reference;
+    reference.isReference = true;
+    reference.id = 0;
+    int32_t referenceStart = position + seedStart;
+    reference.offset = referenceStart;
+    int32_t leftStart = std::max(referenceStart - flankLength, 0);
+    int32_t referenceRightStart = referenceStart + seedLength;
+    int32_t rightLength = std::min<int32_t>(
+      referenceRightStart + flankLength, genomeLength) - referenceRightStart;
+    byte* genome = &workload.genome[0];
+    bytes = reference.toBytes(
+      genome, leftStart, referenceStart - leftStart, referenceRightStart,
+      rightLength);
+    workload.referenceBytes[i].assign(bytes, bytes + reference.toBytesLen(
+      genome, leftStart, referenceStart - leftStart, referenceRightStart,
+      rightLength));
+    delete[] bytes;
+  }
+
+  // The records point into their bytes, which no longer move
+  workload.queries.resize(numReads);
+  workload.references.resize(numReads);
+  for (uint32_t i = 0; i < numReads; i++) {
+    workload.queries[i].fromBytes(
+      &workload.queryBytes[i][0], workload.queryBytes[i].size());
+    workload.references[i].fromBytes(
+      &workload.referenceBytes[i][0], workload.referenceBytes[i].size());
+    appendFlankLetters(dnaStringObj, workload.queries[i].leftFlank,
+                       workload.queryLetters[i]);
+    appendFlankLetters(dnaStringObj, workload.queries[i].rightFlank,
+                       workload.queryLetters[i]);
+    appendFlankLetters(dnaStringObj, workload.references[i].leftFlank,
+                       workload.referenceLetters[i]);
+    appendFlankLetters(dnaStringObj, workload.references[i].rightFlank,
+                       workload.referenceLetters[i]);
+  }
+}
+
+class DNAToArrKernel : public Kernel {
+public:
+  DNAToArrKernel(Workload& _workload) : workload(_workload) {}
+
+  uint64_t run() {
+    uint64_t checksum = 0;
+    for (uint32_t i = 0; i < workload.packedReads.size(); i++) {
+      const std::vector<byte>& packed = workload.packedReads[i];
+      byte* read = dnaStringObj.dnaToArr(&packed[0], packed.size());
+      checksum += read[0] + read[workload.readLength - 1];
+      delete[] read;
+    }
+    return checksum;
+  }
+
+private:
+  Workload& workload;
+  DNAString dnaStringObj;
+};
+
+class ArrToDNAKernel : public Kernel {
+public:
+  ArrToDNAKernel(Workload& _workload) : workload(_workload) {}
+
+  uint64_t run() {
+    uint64_t checksum = 0;
+    for (uint32_t i = 0; i < workload.packedReads.size(); i++) {
+      byte* packed = dnaStringObj.arrToDNA(
+        workload.read(i), workload.readLength);
+      checksum += packed[0];
+      delete[] packed;
+    }
+    return checksum;
+  }
+
+private:
+  Workload& workload;
+  DNAString dnaStringObj;
+};
+
+/// Reverse complements every read twice, so that every pass sees the same
+/// reads
+class ReverseComplementKernel : public Kernel {
+public:
+  ReverseComplementKernel(Workload& _workload)
+    : workload(_workload),
+      scratch(_workload.reads) {
+  }
+
+  uint64_t run() {
+    uint64_t checksum = 0;
+    for (uint32_t i = 0; i < workload.packedReads.size(); i++) {
+      byte* read = &scratch[i * workload.readLength];
+      dnaStringObj.reverseComplementSequenceInPlace(read, workload.readLength);
+      checksum += read[0];
+      dnaStringObj.reverseComplementSequenceInPlace(read, workload.readLength);
+      checksum += read[0];
+    }
+    return checksum;
+  }
+
+private:
+  Workload& workload;
+  std::vector<byte> scratch;
+  DNAString dnaStringObj;
+};
+
+class MerToBytesKernel : public Kernel {
+public:
+  MerToBytesKernel(Workload& _workload) : workload(_workload) {}
+
+  uint64_t run() {
+    uint64_t checksum = 0;
+    MerRecord record;
+    record.isReference = false;
+    for (uint32_t i = 0; i < workload.packedReads.size(); i++) {
+      byte* read = workload.read(i);
+      int32_t leftLength = workload.seedStarts[i];
+      int32_t rightStart = leftLength + workload.seedLength;
+      int32_t rightLength = workload.readLength - rightStart;
+      record.id = i;
+      record.offset = leftLength;
+      // The map function sizes and serializes every tuple
+      byte* bytes = record.toBytes(
+        read, 0, leftLength, rightStart, rightLength);
+      checksum += record.toBytesLen(
+        read, 0, leftLength, rightStart, rightLength) + bytes[0];
+      delete[] bytes;
+    }
+    return checksum;
+  }
+
+private:
+  Workload& workload;
+};
+
+class MerFromBytesKernel : public Kernel {
+public:
+  MerFromBytesKernel(Workload& _workload) : workload(_workload) {}
+
+  uint64_t run() {
+    uint64_t checksum = 0;
+    MerRecord record;
+    for (uint32_t i = 0; i < workload.queryBytes.size(); i++) {
+      record.fromBytes(
+        &workload.queryBytes[i][0], workload.queryBytes[i].size());
+      checksum += record.offset + record.leftFlank.length;
+      record.fromBytes(
+        &workload.referenceBytes[i][0], workload.referenceBytes[i].size());
+      checksum += record.offset + record.rightFlank.length;
+    }
+    return checksum;
+  }
+
+private:
+  Workload& workload;
+};
+
+class KMismatchKernel : public Kernel {
+public:
+  KMismatchKernel(Workload& _workload)
+    : workload(_workload) {
+    landauVishkin.configure(workload.maxAlignDiff);
+  }
+
+  uint64_t run() {
+    uint64_t checksum = 0;
+    int32_t k = workload.maxAlignDiff;
+    for (uint32_t i = 0; i < workload.queries.size(); i++) {
+      const MerRecord& query = workload.queries[i];
+      const MerRecord& reference = workload.references[i];
+      AlignInfo& left = landauVishkin.kmismatch_bin(
+        reference.leftFlank, query.leftFlank, k);
+      checksum += left.alignlen + 1;
+      AlignInfo& right = landauVishkin.kmismatch_bin(
+        reference.rightFlank, query.rightFlank, k);
+      checksum += right.alignlen + 1;
+    }
+    return checksum;
+  }
+
+private:
+  Workload& workload;
+  LandauVishkin landauVishkin;
+};
+
+class KDifferenceKernel : public Kernel {
+public:
+  KDifferenceKernel(Workload& _workload)
+    : workload(_workload) {
+    landauVishkin.configure(workload.maxAlignDiff);
+  }
+
+  uint64_t run() {
+    uint64_t checksum = 0;
+    int32_t k = workload.maxAlignDiff;
+    for (uint32_t i = 0; i < workload.queries.size(); i++) {
+      const MerRecord& query = workload.queries[i];
+      const MerRecord& reference = workload.references[i];
+      const byte* queryLetters = &workload.queryLetters[i][0];
+      const byte* referenceLetters = &workload.referenceLetters[i][0];
+      AlignInfo& left = landauVishkin.kdifference(
+        referenceLetters, reference.leftFlank.length, queryLetters,
+        query.leftFlank.length, k);
+      checksum += left.alignlen + 1;
+      AlignInfo& right = landauVishkin.kdifference(
+        referenceLetters + reference.leftFlank.length,
+        reference.rightFlank.length, queryLetters + query.leftFlank.length,
+        query.rightFlank.length, k);
+      checksum += right.alignlen + 1;
+    }
+    return checksum;
+  }
+
+private:
+  Workload& workload;
+  LandauVishkin landauVishkin;
+};
+
+/// Checks the left flank alignments of the workload's pairs, saved from
+/// kmismatch_bin, for being their read's leftmost seed
+class BaezaYatesKernel : public Kernel {
+public:
+  BaezaYatesKernel(Workload& _workload)
+    : workload(_workload),
+      stride(_workload.maxAlignDiff + 1) {
+    LandauVishkin landauVishkin;
+    landauVishkin.configure(workload.maxAlignDiff);
+    for (uint32_t i = 0; i < workload.queries.size(); i++) {
+      const MerRecord& query = workload.queries[i];
+      if (query.leftFlank.length == 0) {
+        continue;
+      }
+      AlignInfo& left = landauVishkin.kmismatch_bin(
+        workload.references[i].leftFlank, query.leftFlank,
+        workload.maxAlignDiff);
+      if (left.alignlen == -1) {
+        continue;
+      }
+      int32_t differences = left.differences;
+      alignments.push_back(i);
+      alignLengths.push_back(left.alignlen);
+      differenceCounts.push_back(differences);
+      dist.insert(dist.end(), landauVishkin.dist,
+                  landauVishkin.dist + differences + 1);
+      dist.resize(alignments.size() * stride);
+      what.insert(what.end(), landauVishkin.what,
+                  landauVishkin.what + differences + 1);
+      what.resize(alignments.size() * stride);
+    }
+  }
+
+  /// \return the number of alignments checked per pass
+  inline uint64_t size() const {
+    return alignments.size();
+  }
+
+  uint64_t run() {
+    uint64_t checksum = 0;
+    for (uint32_t i = 0; i < alignments.size(); i++) {
+      AlignInfo info(alignLengths[i], differenceCounts[i], &dist[i * stride],
+                     &what[i * stride], differenceCounts[i] + 1);
+      checksum += info.isBazeaYatesSeed(
+        workload.queries[alignments[i]].leftFlank.length,
+        workload.seedLength);
+    }
+    return checksum;
+  }
+
+private:
+  Workload& workload;
+  const uint32_t stride;
+  std::vector<uint32_t> alignments;
+  std::vector<int32_t> alignLengths;
+  std::vector<int32_t> differenceCounts;
+  std::vector<int32_t> dist;
+  std::vector<int32_t> what;
+};
+
+/// Joins batches of blockSize query tuples against the reference tuples of
+/// their reads' true positions, as one seed group's batch would be joined
+class AlignBatchKernel : public Kernel {
+public:
+  AlignBatchKernel(Workload& _workload, uint32_t _blockSize)
+    : workload(_workload),
+      blockSize(_blockSize),
+      aligner(workload.maxAlignDiff, workload.seedLength, false, "",
+              workload.readLength, workload.readLength, "", 0, 0),
+      pairs(0) {
+    for (uint32_t start = 0; start < workload.queries.size();
+         start += blockSize) {
+      uint32_t end = std::min<uint32_t>(
+        start + blockSize, workload.queries.size());
+      queryBatches.push_back(std::vector<MerRecord>(
+        workload.queries.begin() + start, workload.queries.begin() + end));
+      referenceBatches.push_back(std::vector<MerRecord>(
+        workload.references.begin() + start,
+        workload.references.begin() + end));
+      pairs += static_cast<uint64_t>(end - start) * (end - start);
+    }
+  }
+
+  /// \return the number of pairs joined per pass
+  inline uint64_t size() const {
+    return pairs;
+  }
+
+  uint64_t run() {
+    CountingSink sink;
+    for (uint32_t batch = 0; batch < queryBatches.size(); batch++) {
+      aligner.startBatch(queryBatches[batch].size());
+      aligner.alignBlock(queryBatches[batch], referenceBatches[batch],
+                         blockSize, blockSize, sink);
+      aligner.finishBatch(sink);
+    }
+    return sink.alignments * 1000003ULL + sink.checksum;
+  }
+
+private:
+  Workload& workload;
+  const uint32_t blockSize;
+  CloudBurstAligner aligner;
+  std::vector<std::vector<MerRecord> > queryBatches;
+  std::vector<std::vector<MerRecord> > referenceBatches;
+  uint64_t pairs;
+};
+
+static void benchmarkWorkload(
+  Workload& workload, uint32_t passes, uint32_t blockSize,
+  std::vector<Result>& results) {
+  uint64_t numReads = workload.queries.size();
+  uint64_t readBases = numReads * workload.readLength;
+  uint64_t flankBases = 0;
+  for (uint32_t i = 0; i < numReads; i++) {
+    flankBases += workload.queries[i].leftFlank.length +
+      workload.queries[i].rightFlank.length;
+  }
+
+  DNAToArrKernel dnaToArr(workload);
+  results.push_back(measure(
+    "DNAString::dnaToArr", "sequence", numReads, readBases, dnaToArr,
+    passes));
+  ArrToDNAKernel arrToDNA(workload);
+  results.push_back(measure(
+    "DNAString::arrToDNA", "sequence", numReads, readBases, arrToDNA,
+    passes));
+  ReverseComplementKernel reverseComplement(workload);
+  results.push_back(measure(
+    "DNAString::reverseComplementSequenceInPlace", "sequence", 2 * numReads,
+    2 * readBases, reverseComplement, passes));
+  MerToBytesKernel merToBytes(workload);
+  results.push_back(measure(
+    "MerRecord::toBytes", "record", numReads, flankBases, merToBytes,
+    passes));
+  MerFromBytesKernel merFromBytes(workload);
+  results.push_back(measure(
+    "MerRecord::fromBytes", "record", 2 * numReads, 0, merFromBytes,
+    passes));
+  KMismatchKernel kmismatch(workload);
+  results.push_back(measure(
+    "LandauVishkin::kmismatch_bin", "pair", numReads, flankBases, kmismatch,
+    passes));
+  KDifferenceKernel kdifference(workload);
+  results.push_back(measure(
+    "LandauVishkin::kdifference", "pair", numReads, flankBases, kdifference,
+    passes));
+  BaezaYatesKernel baezaYates(workload);
+  results.push_back(measure(
+    "AlignInfo::isBazeaYatesSeed", "alignment", baezaYates.size(), 0,
+    baezaYates, passes));
+  AlignBatchKernel alignBatch(workload, blockSize);
+  results.push_back(measure(
+    "CloudBurstAligner::alignBlock", "pair", alignBatch.size(), 0, alignBatch,
+    passes));
+}
+
+static void usage(const char* program) {
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  --genomes KINDS          comma-separated genomes, random and/or "
+          "repetitive\n"
+          "                           (default random,repetitive)\n"
+          "  --genome_length N        bases per genome (default 1000000)\n"
+          "  --reads N                reads per workload (default 20000)\n"
+          "  --read_lengths L         comma-separated read lengths "
+          "(default 36,100)\n"
+          "  --max_align_diffs K      comma-separated K values (default 2,4)\n"
+          "  --error_rates R          comma-separated substitution rates "
+          "(default 0.01)\n"
+          "  --block_size N           query tuples per batch (default 128)\n"
+          "  --passes N               passes per kernel; the fastest is "
+          "reported (default 5)\n"
+          "  --seed N                 random seed (default 1)\n"
+          "  --output FILE            write JSON results to FILE instead of "
+          "standard output\n",
+          program);
+  exit(1);
+}
+
+static uint32_t parseNumber(const char* program, const char* value) {
+  char* end;
+  unsigned long number = strtoul(value, &end, 10);
+  if (*value == '\0' || *end != '\0') {
+    usage(program);
+  }
+  return static_cast<uint32_t>(number);
+}
+
+static void splitList(const std::string& list, std::vector<std::string>& out) {
+  out.clear();
+  size_t start = 0;
+  while (start <= list.size()) {
+    size_t comma = list.find(',', start);
+    if (comma == std::string::npos) {
+      comma = list.size();
+    }
+    out.push_back(list.substr(start, comma - start));
+    start = comma + 1;
+  }
+}
+
+static void parseNumbers(
+  const char* program, const std::string& list,
+  std::vector<uint32_t>& numbers) {
+  std::vector<std::string> items;
+  splitList(list, items);
+  numbers.clear();
+  for (uint32_t i = 0; i < items.size(); i++) {
+    numbers.push_back(parseNumber(program, items[i].c_str()));
+  }
+}
+
+static void parseRates(
+  const char* program, const std::string& list, std::vector<double>& rates) {
+  std::vector<std::string> items;
+  splitList(list, items);
+  rates.clear();
+  for (uint32_t i = 0; i < items.size(); i++) {
+    char* end;
+    double rate = strtod(items[i].c_str(), &end);
+    if (items[i].empty() || *end != '\0' || rate < 0.0 || rate > 1.0) {
+      usage(program);
+    }
+    rates.push_back(rate);
+  }
+}
+
+int main(int argc, char** argv) {
+  std::string genomeList("random,repetitive");
+  uint32_t genomeLength = 1000000;
+  uint32_t numReads = 20000;
+  std::string readLengthList("36,100");
+  std::string maxAlignDiffList("2,4");
+  std::string errorRateList("0.01");
+  uint32_t blockSize = 128;
+  uint32_t passes = 5;
+  uint32_t seed = 1;
+  std::string outputPath;
+
+  static const struct option options[] = {
+    {"genomes", required_argument, NULL, 'g'},
+    {"genome_length", required_argument, NULL, 'G'},
+    {"reads", required_argument, NULL, 'r'},
+    {"read_lengths", required_argument, NULL, 'l'},
+    {"max_align_diffs", required_argument, NULL, 'k'},
+    {"error_rates", required_argument, NULL, 'e'},
+    {"block_size", required_argument, NULL, 'b'},
+    {"passes", required_argument, NULL, 'p'},
+    {"seed", required_argument, NULL, 's'},
+    {"output", required_argument, NULL, 'o'},
+    {NULL, 0, NULL, 0}
+  };
+
+  int option;
+  while ((option = getopt_long(argc, argv, "", options, NULL)) != -1) {
+    switch (option) {
+    case 'g':
+      genomeList = optarg;
+      break;
+    case 'G':
+      genomeLength = parseNumber(argv[0], optarg);
+      break;
+    case 'r':
+      numReads = parseNumber(argv[0], optarg);
+      break;
+    case 'l':
+      readLengthList = optarg;
+      break;
+    case 'k':
+      maxAlignDiffList = optarg;
+      break;
+    case 'e':
+      errorRateList = optarg;
+      break;
+    case 'b':
+      blockSize = parseNumber(argv[0], optarg);
+      break;
+    case 'p':
+      passes = parseNumber(argv[0], optarg);
+      break;
+    case 's':
+      seed = parseNumber(argv[0], optarg);
+      break;
+    case 'o':
+      outputPath = optarg;
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+
+  std::vector<std::string> genomes;
+  std::vector<uint32_t> readLengths;
+  std::vector<uint32_t> maxAlignDiffs;
+  std::vector<double> errorRates;
+  splitList(genomeList, genomes);
+  parseNumbers(argv[0], readLengthList, readLengths);
+  parseNumbers(argv[0], maxAlignDiffList, maxAlignDiffs);
+  parseRates(argv[0], errorRateList, errorRates);
+  if (optind != argc || numReads == 0 || blockSize == 0 || passes == 0) {
+    usage(argv[0]);
+  }
+  for (uint32_t i = 0; i < genomes.size(); i++) {
+    if (genomes[i] != "random" && genomes[i] != "repetitive") {
+      usage(argv[0]);
+    }
+  }
+  for (uint32_t i = 0; i < readLengths.size(); i++) {
+    for (uint32_t j = 0; j < maxAlignDiffs.size(); j++) {
+      // Every read needs a seed of at least one base, and the genome must
+      // hold a read
+      if (readLengths[i] < maxAlignDiffs[j] + 1 ||
+          readLengths[i] > genomeLength) {
+        usage(argv[0]);
+      }
+    }
+  }
+
+  FILE* output = stdout;
+  if (!outputPath.empty()) {
+    output = fopen(outputPath.c_str(), "w");
+    ABORT_IF(output == NULL, "Failed to open %s", outputPath.c_str());
+  }
+
+  fprintf(output, "{\n  \"benchmark\": \"cloudburst_kernels\",\n"
+          "  \"genome_length\": %u,\n  \"reads\": %u,\n"
+          "  \"block_size\": %u,\n  \"passes\": %u,\n  \"seed\": %u,\n"
+          "  \"results\": [", genomeLength, numReads, blockSize, passes, seed);
+  fprintf(stderr, "%-11s %4s %2s %6s %-45s %12s %10s %10s\n", "genome",
+          "len", "k", "error", "kernel", "ops", "ns/op", "allocs/op");
+
+  bool first = true;
+  for (uint32_t g = 0; g < genomes.size(); g++) {
+    for (uint32_t l = 0; l < readLengths.size(); l++) {
+      for (uint32_t k = 0; k < maxAlignDiffs.size(); k++) {
+        for (uint32_t e = 0; e < errorRates.size(); e++) {
+          Workload workload;
+          workload.genomeKind = genomes[g];
+          workload.readLength = readLengths[l];
+          workload.maxAlignDiff = maxAlignDiffs[k];
+          workload.errorRate = errorRates[e];
+          // The job derives the seed length the same way
+          workload.seedLength = readLengths[l] / (maxAlignDiffs[k] + 1);
+          generateWorkload(workload, genomeLength, numReads, seed);
+
+          std::vector<Result> results;
+          benchmarkWorkload(workload, passes, blockSize, results);
+          for (uint32_t i = 0; i < results.size(); i++) {
+            const Result& result = results[i];
+            double nsPerOp = result.ops == 0 ? 0.0 :
+              result.micros * 1000.0 / result.ops;
+            double allocationsPerOp = result.ops == 0 ? 0.0 :
+              static_cast<double>(result.allocations) / result.ops;
+            fprintf(stderr, "%-11s %4u %2u %6.3f %-45s %12llu %10.2f "
+                    "%10.3f\n", genomes[g].c_str(), readLengths[l],
+                    maxAlignDiffs[k], errorRates[e], result.kernel,
+                    static_cast<unsigned long long>(result.ops), nsPerOp,
+                    allocationsPerOp);
+
+            fprintf(output, "%s\n    {\"genome\": \"%s\", \"read_length\": "
+                    "%u, \"max_align_diff\": %u, \"error_rate\": %g, "
+                    "\"kernel\": \"%s\", \"unit\": \"%s\", \"ops\": %llu, "
+                    "\"bases\": %llu, \"micros\": %llu, \"ns_per_op\": %.3f, ",
+                    first ? "" : ",", genomes[g].c_str(), readLengths[l],
+                    maxAlignDiffs[k], errorRates[e], result.kernel,
+                    result.unit, static_cast<unsigned long long>(result.ops),
+                    static_cast<unsigned long long>(result.bases),
+                    static_cast<unsigned long long>(result.micros), nsPerOp);
+            if (result.bases > 0) {
+              fprintf(output, "\"ns_per_base\": %.4f, ",
+                      result.micros * 1000.0 / result.bases);
+            } else {
+              fprintf(output, "\"ns_per_base\": null, ");
+            }
+            fprintf(output, "\"allocations_per_op\": %.4f, "
+                    "\"checksum\": %llu}", allocationsPerOp,
+                    static_cast<unsigned long long>(result.checksum));
+            first = false;
+          }
+        }
+      }
+    }
+  }
+  fprintf(output, "\n  ]\n}\n");
+  if (output != stdout) {
+    ABORT_IF(fclose(output) != 0, "Failed to close %s", outputPath.c_str());
+  }
+  return 0;
+}
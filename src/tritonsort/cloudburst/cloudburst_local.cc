@@ -0,0 +1,144 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+
+#include "CloudBurstEngine.h"
+
+/**
+   Aligns converted CloudBurst input files on this machine with a
+   CloudBurstEngine, instead of running a Themis job. The options match the
+   CloudBurst job's parameters; the output is what the job's filter stage
+   writes for one partition.
+ */
+
+static void usage(const char* program) {
+  fprintf(stderr,
+          "Usage: %s [options] output_file input_file...\n"
+          "Input files are converted CloudBurst inputs; files whose names "
+          "contain \"ref\"\nhold the reference.\n"
+          "  --min_read_len N         minimum read length (default 36)\n"
+          "  --max_read_len N         maximum read length (default 36)\n"
+          "  --max_align_diff N       differences to allow (default 3)\n"
+          "  --allow_differences      allow indels as well as mismatches\n"
+          "  --block_size N           query tuples per batch (default 128)\n"
+          "  --canonical_seeds        key seeds by the smaller strand\n"
+          "  --seed_masks MASKS       comma-separated spaced seed masks\n"
+          "  --read_length_classes L  comma-separated read length classes\n"
+          "  --filter_alignments N    keep each read's N best alignments\n"
+          "  --max_hits_per_seed N    cap a read's alignments per seed\n"
+          "  --output_format FORMAT   records or grouped (default records)\n"
+          "  --threads N              threads to run on (default: one per "
+          "core)\n"
+          "  --perf_counters          report hardware counters per phase\n",
+          program);
+  exit(1);
+}
+
+static uint32_t parseNumber(const char* program, const char* value) {
+  char* end;
+  unsigned long number = strtoul(value, &end, 10);
+  if (*value == '\0' || *end != '\0') {
+    usage(program);
+  }
+  return static_cast<uint32_t>(number);
+}
+
+int main(int argc, char** argv) {
+  uint32_t minReadLen = 36;
+  uint32_t maxReadLen = 36;
+  uint32_t maxAlignDiff = 3;
+  bool allowDifferences = false;
+  uint32_t blockSize = 128;
+  bool canonicalSeeds = false;
+  std::string seedMasks;
+  std::string readLengthClasses;
+  uint32_t filterAlignments = 0;
+  uint32_t maxHitsPerSeed = 0;
+  std::string outputFormat("records");
+  uint32_t numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+  bool perfCounters = false;
+
+  static const struct option options[] = {
+    {"min_read_len", required_argument, NULL, 'm'},
+    {"max_read_len", required_argument, NULL, 'M'},
+    {"max_align_diff", required_argument, NULL, 'k'},
+    {"allow_differences", no_argument, NULL, 'a'},
+    {"block_size", required_argument, NULL, 'b'},
+    {"canonical_seeds", no_argument, NULL, 'c'},
+    {"seed_masks", required_argument, NULL, 's'},
+    {"read_length_classes", required_argument, NULL, 'l'},
+    {"filter_alignments", required_argument, NULL, 'f'},
+    {"max_hits_per_seed", required_argument, NULL, 'h'},
+    {"output_format", required_argument, NULL, 'o'},
+    {"threads", required_argument, NULL, 't'},
+    {"perf_counters", no_argument, NULL, 'p'},
+    {NULL, 0, NULL, 0}
+  };
+
+  int option;
+  while ((option = getopt_long(argc, argv, "", options, NULL)) != -1) {
+    switch (option) {
+    case 'm':
+      minReadLen = parseNumber(argv[0], optarg);
+      break;
+    case 'M':
+      maxReadLen = parseNumber(argv[0], optarg);
+      break;
+    case 'k':
+      maxAlignDiff = parseNumber(argv[0], optarg);
+      break;
+    case 'a':
+      allowDifferences = true;
+      break;
+    case 'b':
+      blockSize = parseNumber(argv[0], optarg);
+      break;
+    case 'c':
+      canonicalSeeds = true;
+      break;
+    case 's':
+      seedMasks = optarg;
+      break;
+    case 'l':
+      readLengthClasses = optarg;
+      break;
+    case 'f':
+      filterAlignments = parseNumber(argv[0], optarg);
+      break;
+    case 'h':
+      maxHitsPerSeed = parseNumber(argv[0], optarg);
+      break;
+    case 'o':
+      outputFormat = optarg;
+      break;
+    case 't':
+      numThreads = parseNumber(argv[0], optarg);
+      break;
+    case 'p':
+      perfCounters = true;
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+
+  if (argc - optind < 2 || numThreads == 0 || minReadLen > maxReadLen ||
+      (outputFormat != "records" && outputFormat != "grouped")) {
+    usage(argv[0]);
+  }
+
+  // The job derives the seed length the same way.
+  CloudBurstEngine engine(
+    maxAlignDiff, minReadLen / (maxAlignDiff + 1), allowDifferences,
+    minReadLen, maxReadLen, canonicalSeeds, seedMasks, readLengthClasses,
+    blockSize, filterAlignments, maxHitsPerSeed, outputFormat, numThreads,
+    perfCounters);
+  for (int i = optind + 1; i < argc; i++) {
+    engine.addInput(argv[i]);
+  }
+  engine.run(argv[optind]);
+  engine.printStatistics(stderr);
+  return 0;
+}
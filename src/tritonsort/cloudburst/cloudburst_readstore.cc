@@ -0,0 +1,27 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "mapreduce/functions/reduce/cloudBurst/ReadStore.h"
+
+/**
+   Packs a job's converted reads into a ReadStore file, which is copied to
+   every node of a job run with a read store.
+ */
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s store_file query_file...\n", argv[0]);
+    return 1;
+  }
+
+  std::vector<std::string> queries(argv + 2, argv + argc);
+  ReadStore::build(queries, argv[1]);
+
+  ReadStore store;
+  store.open(argv[1]);
+  fprintf(stderr, "read store reads=%llu\n",
+          static_cast<unsigned long long>(store.numReads()));
+  return 0;
+}
@@ -0,0 +1,302 @@
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+#include "AlignmentSession.h"
+#include "ReferenceIndex.h"
+#include "core/MemoryUtils.h"
+#include "core/TritonSortAssert.h"
+
+/**
+   A long-running CloudBurst aligner that keeps a reference index resident
+   and aligns read batches as they arrive.
+
+   With --build_index, seeds converted reference files into an index file
+   and exits. Otherwise memory-maps an index file and serves sessions, on
+   standard input and output or, with --socket, on every connection to a
+   Unix domain socket.
+
+   A session is a series of requests, each answered before the next is read.
+   A request is a 64-bit byte count followed by a batch of reads, laid out as
+   tuples of 4-byte read id and FastaRecord as in a TupleFile. The response
+   is a 64-bit byte count followed by the batch's alignment tuples, laid out
+   the same way, as the job's filter stage would write them. An empty request
+   ends the session; a malformed batch ends it without a response.
+ */
+
+struct ServeOptions {
+  const ReferenceIndex* index;
+  bool allowDifferences;
+  uint32_t filterAlignments;
+  uint32_t maxHitsPerSeed;
+  std::string outputFormat;
+};
+
+struct Connection {
+  const ServeOptions* options;
+  int fd;
+};
+
+static void usage(const char* program) {
+  fprintf(stderr,
+          "Usage: %s --build_index index_file [seeding options] "
+          "reference_file...\n"
+          "       %s [alignment options] [--socket path] index_file\n"
+          "Seeding options:\n"
+          "  --min_read_len N         minimum read length (default 36)\n"
+          "  --max_read_len N         maximum read length (default 36)\n"
+          "  --max_align_diff N       differences to allow (default 3)\n"
+          "  --canonical_seeds        key seeds by the smaller strand\n"
+          "  --seed_masks MASKS       comma-separated spaced seed masks\n"
+          "  --read_length_classes L  comma-separated read length classes\n"
+          "Alignment options:\n"
+          "  --allow_differences      allow indels as well as mismatches\n"
+          "  --filter_alignments N    keep each read's N best alignments\n"
+          "  --max_hits_per_seed N    cap a read's alignments per seed\n"
+          "  --output_format FORMAT   records or grouped (default records)\n",
+          program, program);
+  exit(1);
+}
+
+static uint32_t parseNumber(const char* program, const char* value) {
+  char* end;
+  unsigned long number = strtoul(value, &end, 10);
+  if (*value == '\0' || *end != '\0') {
+    usage(program);
+  }
+  return static_cast<uint32_t>(number);
+}
+
+/// \return false if the stream ended before length bytes were read
+static bool readFully(int fd, uint8_t* buffer, uint64_t length) {
+  while (length > 0) {
+    ssize_t bytesRead = read(fd, buffer, length);
+    if (bytesRead < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytesRead <= 0) {
+      return false;
+    }
+    buffer += bytesRead;
+    length -= bytesRead;
+  }
+  return true;
+}
+
+/// \return false if the stream was closed
+static bool writeFully(int fd, const uint8_t* buffer, uint64_t length) {
+  while (length > 0) {
+    ssize_t bytesWritten = write(fd, buffer, length);
+    if (bytesWritten < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytesWritten <= 0) {
+      return false;
+    }
+    buffer += bytesWritten;
+    length -= bytesWritten;
+  }
+  return true;
+}
+
+static void serve(const ServeOptions& options, int inFD, int outFD) {
+  AlignmentSession session(
+    *options.index, options.allowDifferences, options.filterAlignments,
+    options.maxHitsPerSeed, options.outputFormat);
+  std::vector<uint8_t> batch;
+  std::vector<uint8_t> response;
+  while (true) {
+    uint64_t batchLength;
+    if (!readFully(inFD, reinterpret_cast<uint8_t*>(&batchLength),
+                   sizeof(batchLength)) || batchLength == 0) {
+      break;
+    }
+    batch.resize(batchLength);
+    if (!readFully(inFD, &batch[0], batchLength)) {
+      break;
+    }
+
+    // The response's length goes in front once it is known.
+    response.assign(sizeof(uint64_t), 0);
+    if (!session.alignBatch(&batch[0], batchLength, response)) {
+      fprintf(stderr, "Malformed read batch of %llu bytes; ending session\n",
+              static_cast<unsigned long long>(batchLength));
+      break;
+    }
+    uint64_t responseLength = response.size() - sizeof(uint64_t);
+    memcpy(&response[0], &responseLength, sizeof(responseLength));
+    if (!writeFully(outFD, &response[0], response.size())) {
+      break;
+    }
+  }
+
+  fprintf(stderr, "session batches=%llu reads=%llu alignments=%llu "
+          "batch_micros=%llu max_batch_micros=%llu\n",
+          static_cast<unsigned long long>(session.batches()),
+          static_cast<unsigned long long>(session.reads()),
+          static_cast<unsigned long long>(session.alignmentsWritten()),
+          static_cast<unsigned long long>(session.totalBatchMicros()),
+          static_cast<unsigned long long>(session.maxBatchMicros()));
+}
+
+static void* serveConnection(void* arg) {
+  Connection* connection = static_cast<Connection*>(arg);
+  serve(*connection->options, connection->fd, connection->fd);
+  close(connection->fd);
+  delete connection;
+  return NULL;
+}
+
+static void listenOn(const std::string& path, const ServeOptions& options) {
+  struct sockaddr_un address;
+  ABORT_IF(path.size() >= sizeof(address.sun_path),
+           "Socket path %s is too long", path.c_str());
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, path.c_str());
+
+  int listenFD = socket(AF_UNIX, SOCK_STREAM, 0);
+  ABORT_IF(listenFD < 0, "Failed to create socket: %s", strerror(errno));
+  unlink(path.c_str());
+  ABORT_IF(bind(listenFD, reinterpret_cast<struct sockaddr*>(&address),
+                sizeof(address)) != 0,
+           "Failed to bind %s: %s", path.c_str(), strerror(errno));
+  ABORT_IF(listen(listenFD, 16) != 0, "Failed to listen on %s: %s",
+           path.c_str(), strerror(errno));
+
+  // Every connection gets its own session and thread; they share the index.
+  while (true) {
+    int fd = accept(listenFD, NULL, NULL);
+    if (fd < 0) {
+      ABORT_IF(errno != EINTR && errno != ECONNABORTED,
+               "Failed to accept a connection: %s", strerror(errno));
+      continue;
+    }
+    Connection* connection = new (themis::memcheck) Connection;
+    connection->options = &options;
+    connection->fd = fd;
+    pthread_t thread;
+    ABORT_IF(pthread_create(&thread, NULL, serveConnection, connection) != 0,
+             "Failed to start a session thread");
+    pthread_detach(thread);
+  }
+}
+
+int main(int argc, char** argv) {
+  std::string buildIndex;
+  std::string socketPath;
+  uint32_t minReadLen = 36;
+  uint32_t maxReadLen = 36;
+  uint32_t maxAlignDiff = 3;
+  bool canonicalSeeds = false;
+  std::string seedMasks;
+  std::string readLengthClasses;
+  ServeOptions options;
+  options.index = NULL;
+  options.allowDifferences = false;
+  options.filterAlignments = 0;
+  options.maxHitsPerSeed = 0;
+  options.outputFormat = "records";
+
+  static const struct option longOptions[] = {
+    {"build_index", required_argument, NULL, 'B'},
+    {"socket", required_argument, NULL, 'S'},
+    {"min_read_len", required_argument, NULL, 'm'},
+    {"max_read_len", required_argument, NULL, 'M'},
+    {"max_align_diff", required_argument, NULL, 'k'},
+    {"canonical_seeds", no_argument, NULL, 'c'},
+    {"seed_masks", required_argument, NULL, 's'},
+    {"read_length_classes", required_argument, NULL, 'l'},
+    {"allow_differences", no_argument, NULL, 'a'},
+    {"filter_alignments", required_argument, NULL, 'f'},
+    {"max_hits_per_seed", required_argument, NULL, 'h'},
+    {"output_format", required_argument, NULL, 'o'},
+    {NULL, 0, NULL, 0}
+  };
+
+  int option;
+  while ((option = getopt_long(argc, argv, "", longOptions, NULL)) != -1) {
+    switch (option) {
+    case 'B':
+      buildIndex = optarg;
+      break;
+    case 'S':
+      socketPath = optarg;
+      break;
+    case 'm':
+      minReadLen = parseNumber(argv[0], optarg);
+      break;
+    case 'M':
+      maxReadLen = parseNumber(argv[0], optarg);
+      break;
+    case 'k':
+      maxAlignDiff = parseNumber(argv[0], optarg);
+      break;
+    case 'c':
+      canonicalSeeds = true;
+      break;
+    case 's':
+      seedMasks = optarg;
+      break;
+    case 'l':
+      readLengthClasses = optarg;
+      break;
+    case 'a':
+      options.allowDifferences = true;
+      break;
+    case 'f':
+      options.filterAlignments = parseNumber(argv[0], optarg);
+      break;
+    case 'h':
+      options.maxHitsPerSeed = parseNumber(argv[0], optarg);
+      break;
+    case 'o':
+      options.outputFormat = optarg;
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+
+  ReferenceIndex index;
+  if (!buildIndex.empty()) {
+    if (optind == argc || minReadLen > maxReadLen) {
+      usage(argv[0]);
+    }
+    std::vector<std::string> references(argv + optind, argv + argc);
+    index.build(
+      references, maxAlignDiff, minReadLen, maxReadLen, canonicalSeeds,
+      seedMasks, readLengthClasses);
+    index.write(buildIndex);
+    fprintf(stderr, "index seeds=%llu tuples=%llu bytes=%llu\n",
+            static_cast<unsigned long long>(index.numSeeds()),
+            static_cast<unsigned long long>(index.numTuples()),
+            static_cast<unsigned long long>(index.bytes()));
+    return 0;
+  }
+
+  if (argc - optind != 1 || (options.outputFormat != "records" &&
+                             options.outputFormat != "grouped")) {
+    usage(argv[0]);
+  }
+  index.open(argv[optind]);
+  options.index = &index;
+
+  // A client that goes away mid-response ends only its own session.
+  signal(SIGPIPE, SIG_IGN);
+  if (socketPath.empty()) {
+    serve(options, STDIN_FILENO, STDOUT_FILENO);
+  } else {
+    listenOn(socketPath, options);
+  }
+  return 0;
+}
@@ -0,0 +1,464 @@
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "CloudBurstEngine.h"
+#include "Random.h"
+#include "core/TritonSortAssert.h"
+#include "mapreduce/common/KeyValuePair.h"
+#include "mapreduce/functions/map/cloudBurst/DNAString.h"
+#include "mapreduce/functions/map/cloudBurst/FastaRecord.h"
+#include "mapreduce/functions/map/cloudBurst/TupleFile.h"
+#include "mapreduce/functions/reduce/cloudBurst/AlignmentRecord.h"
+
+/**
+   Checks CloudBurst's speed and accuracy end to end on one machine, without
+   a cluster or the Java converter.
+
+   It simulates a reference and reads with known substitutions and indels,
+   writes them as converted input files, aligns them in-process with a
+   CloudBurstEngine and scores the alignments against the simulated truth.
+   The engine runs the job's map function, partitions the seed tuples by
+   seed ignoring the key's reference/query byte as
+   CloudburstPartitionFunction does, sorts each partition and joins it with
+   the reducer's aligner, then filters each read's alignments.
+
+   A read is alignable if it was simulated with at most K edits, none of
+   them indels unless indels are allowed. An alignment is true if it is on
+   the read's reference and strand and starts within K bases of where the
+   read was drawn from. The report gives
+
+   - sensitivity: the fraction of alignable reads with a true alignment
+   - specificity: the fraction of reads that are not alignable and have no
+     alignment other than a true one, since a read's edits can cost fewer
+     differences than they number
+   - precision: the fraction of alignments that are true
+
+   together with each phase's time and throughput.
+ */
+
+static const byte BASES[4] = {'A', 'C', 'G', 'T'};
+
+/// A simulated read and where it came from
+struct SimulatedRead {
+  std::string sequence;
+  int32_t refID;
+  // The reference bases the read covers, [start, end)
+  int64_t start;
+  int64_t end;
+  bool isRC;
+  uint32_t substitutions;
+  uint32_t indelBases;
+  // The read positions of its edits, on the read as written
+  std::vector<uint32_t> editPositions;
+};
+
+/// \return a base other than the given one
+static byte mutate(byte base, Random& random) {
+  byte mutated;
+  do {
+    mutated = BASES[random.below(4)];
+  } while (mutated == base);
+  return mutated;
+}
+
+static void simulateReferences(
+  uint32_t numReferences, uint32_t referenceLength, double repeatFraction,
+  Random& random, std::vector<std::string>& references) {
+  references.assign(numReferences, std::string(referenceLength, 'A'));
+  for (uint32_t r = 0; r < numReferences; r++) {
+    for (uint32_t i = 0; i < referenceLength; i++) {
+      references[r][i] = BASES[random.below(4)];
+    }
+  }
+
+  // Copy 1000 base segments over other places with 1% divergence, so that
+  // some reads have near-identical alignments elsewhere
+  const uint32_t segmentLength = 1000;
+  if (referenceLength <= segmentLength) {
+    return;
+  }
+  uint64_t copies = static_cast<uint64_t>(
+    repeatFraction * numReferences * referenceLength / segmentLength);
+  for (uint64_t copy = 0; copy < copies; copy++) {
+    const std::string& source = references[random.below(numReferences)];
+    std::string& destination = references[random.below(numReferences)];
+    uint32_t from = random.below(referenceLength - segmentLength);
+    uint32_t to = random.below(referenceLength - segmentLength);
+    std::string segment = source.substr(from, segmentLength);
+    for (uint32_t i = 0; i < segmentLength; i++) {
+      destination[to + i] = random.uniform() < 0.01 ?
+        mutate(segment[i], random) : segment[i];
+    }
+  }
+}
+
+static void simulateRead(
+  const std::vector<std::string>& references, uint32_t readLength,
+  double substitutionRate, double indelRate, Random& random,
+  DNAString& dnaStringObj, SimulatedRead& read) {
+  read.refID = random.below(references.size());
+  const std::string& reference = references[read.refID];
+  // Leave room for a read's worth of deletions
+  read.start = random.below(reference.size() - 2 * readLength);
+  read.isRC = random.below(2) == 1;
+  read.substitutions = 0;
+  read.indelBases = 0;
+  read.sequence.clear();
+  read.editPositions.clear();
+
+  int64_t position = read.start;
+  while (read.sequence.size() < readLength) {
+    double draw = random.uniform();
+    if (draw < indelRate / 2) {
+      // An inserted base
+      read.editPositions.push_back(read.sequence.size());
+      read.sequence.push_back(BASES[random.below(4)]);
+      ++read.indelBases;
+    } else if (draw < indelRate) {
+      // A deleted reference base, noted at the read base after it
+      read.editPositions.push_back(read.sequence.size());
+      ++position;
+      ++read.indelBases;
+    } else {
+      byte base = reference[position++];
+      if (random.uniform() < substitutionRate) {
+        read.editPositions.push_back(read.sequence.size());
+        base = mutate(base, random);
+        ++read.substitutions;
+      }
+      read.sequence.push_back(base);
+    }
+  }
+  read.end = position;
+
+  if (read.isRC) {
+    dnaStringObj.reverseComplementSequenceInPlace(
+      reinterpret_cast<byte*>(&read.sequence[0]), readLength);
+    for (uint32_t i = 0; i < read.editPositions.size(); i++) {
+      read.editPositions[i] = readLength - 1 - read.editPositions[i];
+    }
+  }
+}
+
+/// Write a sequence as one converted input tuple keyed by its id.
+static void writeSequence(FILE* file, int32_t id, const std::string& sequence) {
+  FastaRecord record;
+  record.sequence =
+    reinterpret_cast<byte*>(const_cast<char*>(sequence.data()));
+  record.offset = 0;
+  record.lastChunk = true;
+  int32_t length;
+  byte* value = record.toBytes(sequence.size(), length);
+  // The record does not own the sequence
+  record.sequence = NULL;
+  TupleFile::write(file, reinterpret_cast<uint8_t*>(&id), sizeof(id), value,
+                   length);
+  delete[] value;
+}
+
+static FILE* openFile(const std::string& path, const char* mode) {
+  FILE* file = fopen(path.c_str(), mode);
+  ABORT_IF(file == NULL, "Failed to open %s: %s", path.c_str(),
+           strerror(errno));
+  return file;
+}
+
+static void closeFile(FILE* file, const std::string& path) {
+  ABORT_IF(fclose(file) != 0, "Failed to close %s: %s", path.c_str(),
+           strerror(errno));
+}
+
+static void usage(const char* program) {
+  fprintf(stderr,
+          "Usage: %s [options] work_directory\n"
+          "Simulates a reference and reads into work_directory, aligns them "
+          "and reports\nthe alignments' accuracy and each phase's "
+          "throughput.\n"
+          "  --references N           reference sequences (default 1)\n"
+          "  --reference_length N     bases per reference (default 1000000)\n"
+          "  --repeat_fraction F      fraction of the reference copied from "
+          "elsewhere\n"
+          "                           (default 0.05)\n"
+          "  --reads N                reads to simulate (default 100000)\n"
+          "  --read_length N          bases per read (default 36)\n"
+          "  --substitution_rate F    per base (default 0.01)\n"
+          "  --indel_rate F           per base (default 0.001)\n"
+          "  --max_align_diff N       differences to allow (default 3)\n"
+          "  --allow_differences      allow indels as well as mismatches\n"
+          "  --canonical_seeds        key seeds by the smaller strand\n"
+          "  --seed_masks MASKS       comma-separated spaced seed masks\n"
+          "  --threads N              threads to run on (default: one per "
+          "core)\n"
+          "  --seed N                 random seed (default 1)\n"
+          "  --truth FILE             write each read's origin and edits to "
+          "FILE\n"
+          "  --perf_counters          report hardware counters per phase\n",
+          program);
+  exit(1);
+}
+
+static uint32_t parseNumber(const char* program, const char* value) {
+  char* end;
+  unsigned long number = strtoul(value, &end, 10);
+  if (*value == '\0' || *end != '\0') {
+    usage(program);
+  }
+  return static_cast<uint32_t>(number);
+}
+
+static double parseRate(const char* program, const char* value) {
+  char* end;
+  double rate = strtod(value, &end);
+  if (*value == '\0' || *end != '\0' || rate < 0.0 || rate > 1.0) {
+    usage(program);
+  }
+  return rate;
+}
+
+/// \return events per second, given a time in microseconds
+static double perSecond(uint64_t events, uint64_t micros) {
+  return micros == 0 ? 0.0 : events * 1000000.0 / micros;
+}
+
+int main(int argc, char** argv) {
+  uint32_t numReferences = 1;
+  uint32_t referenceLength = 1000000;
+  double repeatFraction = 0.05;
+  uint32_t numReads = 100000;
+  uint32_t readLength = 36;
+  double substitutionRate = 0.01;
+  double indelRate = 0.001;
+  uint32_t maxAlignDiff = 3;
+  bool allowDifferences = false;
+  bool canonicalSeeds = false;
+  std::string seedMasks;
+  uint32_t numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+  uint32_t seed = 1;
+  std::string truthPath;
+  bool perfCounters = false;
+
+  static const struct option options[] = {
+    {"references", required_argument, NULL, 'n'},
+    {"reference_length", required_argument, NULL, 'G'},
+    {"repeat_fraction", required_argument, NULL, 'f'},
+    {"reads", required_argument, NULL, 'r'},
+    {"read_length", required_argument, NULL, 'l'},
+    {"substitution_rate", required_argument, NULL, 'S'},
+    {"indel_rate", required_argument, NULL, 'I'},
+    {"max_align_diff", required_argument, NULL, 'k'},
+    {"allow_differences", no_argument, NULL, 'a'},
+    {"canonical_seeds", no_argument, NULL, 'c'},
+    {"seed_masks", required_argument, NULL, 's'},
+    {"threads", required_argument, NULL, 't'},
+    {"seed", required_argument, NULL, 'R'},
+    {"truth", required_argument, NULL, 'T'},
+    {"perf_counters", no_argument, NULL, 'p'},
+    {NULL, 0, NULL, 0}
+  };
+
+  int option;
+  while ((option = getopt_long(argc, argv, "", options, NULL)) != -1) {
+    switch (option) {
+    case 'n':
+      numReferences = parseNumber(argv[0], optarg);
+      break;
+    case 'G':
+      referenceLength = parseNumber(argv[0], optarg);
+      break;
+    case 'f':
+      repeatFraction = parseRate(argv[0], optarg);
+      break;
+    case 'r':
+      numReads = parseNumber(argv[0], optarg);
+      break;
+    case 'l':
+      readLength = parseNumber(argv[0], optarg);
+      break;
+    case 'S':
+      substitutionRate = parseRate(argv[0], optarg);
+      break;
+    case 'I':
+      indelRate = parseRate(argv[0], optarg);
+      break;
+    case 'k':
+      maxAlignDiff = parseNumber(argv[0], optarg);
+      break;
+    case 'a':
+      allowDifferences = true;
+      break;
+    case 'c':
+      canonicalSeeds = true;
+      break;
+    case 's':
+      seedMasks = optarg;
+      break;
+    case 't':
+      numThreads = parseNumber(argv[0], optarg);
+      break;
+    case 'R':
+      seed = parseNumber(argv[0], optarg);
+      break;
+    case 'T':
+      truthPath = optarg;
+      break;
+    case 'p':
+      perfCounters = true;
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+
+  if (argc - optind != 1 || numReferences == 0 || numThreads == 0 ||
+      readLength < maxAlignDiff + 1 ||
+      referenceLength <= 2 * static_cast<uint64_t>(readLength)) {
+    usage(argv[0]);
+  }
+  std::string directory(argv[optind]);
+  std::string referencePath = directory + "/reference";
+  std::string readsPath = directory + "/reads";
+  std::string alignmentsPath = directory + "/alignments";
+
+  // Simulate the inputs
+  Random random(seed);
+  DNAString dnaStringObj;
+  std::vector<std::string> references;
+  simulateReferences(
+    numReferences, referenceLength, repeatFraction, random, references);
+  FILE* file = openFile(referencePath, "wb");
+  for (uint32_t r = 0; r < numReferences; r++) {
+    writeSequence(file, r, references[r]);
+  }
+  closeFile(file, referencePath);
+
+  std::vector<SimulatedRead> reads(numReads);
+  file = openFile(readsPath, "wb");
+  FILE* truth = truthPath.empty() ? NULL : openFile(truthPath, "w");
+  for (uint32_t i = 0; i < numReads; i++) {
+    SimulatedRead& read = reads[i];
+    simulateRead(references, readLength, substitutionRate, indelRate, random,
+                 dnaStringObj, read);
+    writeSequence(file, i, read.sequence);
+    if (truth != NULL) {
+      fprintf(truth, "%u\t%d\t%lld\t%lld\t%c\t%u\t%u\t", i, read.refID,
+              static_cast<long long>(read.start),
+              static_cast<long long>(read.end), read.isRC ? '-' : '+',
+              read.substitutions, read.indelBases);
+      for (uint32_t e = 0; e < read.editPositions.size(); e++) {
+        fprintf(truth, "%s%u", e == 0 ? "" : ",", read.editPositions[e]);
+      }
+      fprintf(truth, "%s\n", read.editPositions.empty() ? "-" : "");
+    }
+  }
+  closeFile(file, readsPath);
+  if (truth != NULL) {
+    closeFile(truth, truthPath);
+  }
+
+  // Align, keeping every alignment so that the true one is never filtered
+  // out
+  CloudBurstEngine engine(
+    maxAlignDiff, readLength / (maxAlignDiff + 1), allowDifferences,
+    readLength, readLength, canonicalSeeds, seedMasks, "", 128, 0, 0,
+    "records", numThreads, perfCounters);
+  engine.addInput(referencePath);
+  engine.addInput(readsPath);
+  engine.run(alignmentsPath);
+  engine.printStatistics(stderr);
+
+  // Score the alignments
+  std::vector<uint8_t> aligned(numReads, 0);
+  std::vector<uint8_t> alignedTruly(numReads, 0);
+  std::vector<uint8_t> alignedFalsely(numReads, 0);
+  uint64_t alignments = 0;
+  uint64_t trueAlignments = 0;
+  TupleFile output;
+  output.load(alignmentsPath);
+  KeyValuePair kvPair;
+  AlignmentRecord alignment;
+  for (uint64_t i = 0; i < output.size(); i++) {
+    output.get(i, kvPair);
+    int32_t readID;
+    ABORT_IF(kvPair.getKeyLength() != sizeof(readID), "Expected a 4-byte "
+             "read id key but got %u bytes", kvPair.getKeyLength());
+    memcpy(&readID, kvPair.getKey(), sizeof(readID));
+    ABORT_IF(readID < 0 || static_cast<uint32_t>(readID) >= numReads,
+             "Alignment of unknown read %d", readID);
+    alignment.fromBytes(kvPair.getValue());
+    if (alignment.isRepetitiveMarker()) {
+      continue;
+    }
+    const SimulatedRead& read = reads[readID];
+    ++alignments;
+    aligned[readID] = 1;
+    int64_t shift = alignment.refStart - read.start;
+    if (alignment.refID == read.refID && alignment.isRC == read.isRC &&
+        shift <= static_cast<int64_t>(maxAlignDiff) &&
+        -shift <= static_cast<int64_t>(maxAlignDiff)) {
+      ++trueAlignments;
+      alignedTruly[readID] = 1;
+    } else {
+      alignedFalsely[readID] = 1;
+    }
+  }
+
+  uint64_t alignableReads = 0;
+  uint64_t alignedReads = 0;
+  uint64_t trulyAlignedReads = 0;
+  uint64_t unalignableReads = 0;
+  uint64_t trueNegativeReads = 0;
+  for (uint32_t i = 0; i < numReads; i++) {
+    const SimulatedRead& read = reads[i];
+    bool alignable = read.substitutions + read.indelBases <= maxAlignDiff &&
+      (allowDifferences || read.indelBases == 0);
+    alignedReads += aligned[i];
+    if (alignable) {
+      ++alignableReads;
+      trulyAlignedReads += alignedTruly[i];
+    } else {
+      ++unalignableReads;
+      trueNegativeReads += !alignedFalsely[i];
+    }
+  }
+
+  uint64_t inputBases =
+    static_cast<uint64_t>(numReferences) * referenceLength +
+    static_cast<uint64_t>(numReads) * readLength;
+  printf("reads\t%u\n", numReads);
+  printf("alignable_reads\t%llu\n",
+         static_cast<unsigned long long>(alignableReads));
+  printf("aligned_reads\t%llu\n",
+         static_cast<unsigned long long>(alignedReads));
+  printf("alignments\t%llu\n", static_cast<unsigned long long>(alignments));
+  printf("true_alignments\t%llu\n",
+         static_cast<unsigned long long>(trueAlignments));
+  printf("sensitivity\t%.4f\n", alignableReads == 0 ? 0.0 :
+         static_cast<double>(trulyAlignedReads) / alignableReads);
+  printf("specificity\t%.4f\n", unalignableReads == 0 ? 1.0 :
+         static_cast<double>(trueNegativeReads) / unalignableReads);
+  printf("precision\t%.4f\n", alignments == 0 ? 1.0 :
+         static_cast<double>(trueAlignments) / alignments);
+  printf("seed_micros\t%llu\n",
+         static_cast<unsigned long long>(engine.seedPhaseMicros()));
+  printf("seed_bases_per_second\t%.0f\n",
+         perSecond(inputBases, engine.seedPhaseMicros()));
+  printf("join_micros\t%llu\n",
+         static_cast<unsigned long long>(engine.joinPhaseMicros()));
+  printf("join_seed_tuples_per_second\t%.0f\n",
+         perSecond(engine.totalSeedTuples(), engine.joinPhaseMicros()));
+  printf("filter_micros\t%llu\n",
+         static_cast<unsigned long long>(engine.filterPhaseMicros()));
+  printf("filter_alignments_per_second\t%.0f\n",
+         perSecond(engine.totalAlignmentsWritten(),
+                   engine.filterPhaseMicros()));
+  printf("reads_per_second\t%.0f\n",
+         perSecond(numReads, engine.seedPhaseMicros() +
+                   engine.joinPhaseMicros() + engine.filterPhaseMicros()));
+  return 0;
+}
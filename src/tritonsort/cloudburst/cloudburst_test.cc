@@ -0,0 +1,741 @@
+#include <algorithm>
+#include <errno.h>
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#include "Random.h"
+#include "core/MemoryUtils.h"
+#include "core/TritonSortAssert.h"
+#include "mapreduce/common/KVPairWriterInterface.h"
+#include "mapreduce/common/KeyValuePair.h"
+#include "mapreduce/functions/map/cloudBurst/CloudBurstCoordinateMapFunction.h"
+#include "mapreduce/functions/map/cloudBurst/CloudBurstMapFunction.h"
+#include "mapreduce/functions/map/cloudBurst/DNAString.h"
+#include "mapreduce/functions/map/cloudBurst/FastaRecord.h"
+#include "mapreduce/functions/reduce/cloudBurst/AlignmentCodec.h"
+#include "mapreduce/functions/reduce/cloudBurst/AlignmentRecord.h"
+#include "mapreduce/functions/reduce/cloudBurst/CloudBurstCoordinateReduceFunction.h"
+#include "mapreduce/functions/reduce/cloudBurst/CloudBurstReduceFunction.h"
+
+/**
+   Checks that CloudBurstReduceFunction finds the same alignments however
+   Themis splits its partitions into reduce buffers.
+
+   It simulates a reference with repeated segments, so that some seeds have
+   large reference groups, and reads drawn from it with substitutions. The
+   job's map function seeds them, and the seed tuples are partitioned by
+   ranges of a hash of the seed, ignoring the key's reference/query byte, as
+   CloudburstPartitionFunction does, and sorted. Each configuration below
+   then reduces every partition in buffers cut at tuple counts rather than
+   group boundaries, so reference and query groups straddle buffers. Each
+   buffer is a fresh copy that is overwritten and freed before the next
+   configure(), as Themis may do, so a reducer that keeps pointers into an
+   old buffer reads garbage.
+
+   Every configuration's alignments must match those of the first, which
+   reduces each partition as one buffer. The configurations cover sorted
+   grouping, spilling reference groups past a small memory limit, hash
+   grouping, and writing then reading a reference cache. The job that reads
+   the cache partitions the reads with other boundaries than the job that
+   wrote it, as its own sample would give it. The number of reference groups
+   each sorted configuration reports as carried over to a later buffer must
+   also match the number of buffers whose query tuples join a reference
+   group from before the buffer.
+
+   It also checks that reads are seeded with spaced seeds at every offset,
+   with a read whose alignment is only found from offsets that are not
+   multiples of the mask's span, and that the alignments laid out in
+   coordinate blocks by the coordinate map and reduce functions decode to
+   the same hits. The program prints the result of each check and exits
+   with status 1 if any fails.
+ */
+
+static const byte BASES[4] = {'A', 'C', 'G', 'T'};
+
+static const uint32_t REFERENCE_LENGTH = 50000;
+static const uint32_t REPEAT_LENGTH = 200;
+static const uint32_t REPEAT_COPIES = 30;
+static const uint32_t NUM_READS = 2000;
+static const uint32_t READ_LENGTH = 36;
+static const double SUBSTITUTION_RATE = 0.02;
+static const uint32_t MAX_ALIGN_DIFF = 2;
+static const uint32_t BLOCK_SIZE = 16;
+
+// Partition boundaries as fractions of the hash space, for the job that
+// writes the reference cache and for the jobs that read it
+static const double WRITE_BOUNDARIES[] = {0.25, 0.5, 0.75};
+static const double READ_BOUNDARIES[] = {0.1, 0.4, 0.45, 0.8, 0.95};
+
+// Small enough that the repeats' reference groups spill
+static const uint64_t SPILL_MEMORY_LIMIT = 2000;
+
+// Hits per coordinate block, small enough that there are many blocks
+static const uint32_t COORDINATE_BLOCK_HITS = 7;
+
+typedef std::pair<std::string, std::string> Tuple;
+typedef std::vector<Tuple> Tuples;
+typedef std::vector<double> Boundaries;
+
+/// Orders tuples by key as the Themis sort would
+static bool keyLess(const Tuple& a, const Tuple& b) {
+  return a.first < b.first;
+}
+
+/// The parameters the map and reduce functions share
+struct Parameters {
+  uint32_t maxAlignDiff;
+  bool allowDifferences;
+  const char* seedMasks;
+};
+
+static const Parameters CONTIGUOUS_SEEDS = {MAX_ALIGN_DIFF, false, ""};
+
+/// A way of reducing the seed tuples
+struct Configuration {
+  const char* name;
+  // The number of buffers each partition is cut into, or 0 for one tuple
+  // per buffer
+  uint32_t buffersPerPartition;
+  uint64_t referenceMemoryLimit;
+  bool hashGrouping;
+  // "", "write" or "read"
+  const char* referenceCacheMode;
+};
+
+static const Configuration CONFIGURATIONS[] = {
+  {"one buffer", 1, 0, false, ""},
+  {"2 buffers", 2, 0, false, ""},
+  {"7 buffers", 7, 0, false, ""},
+  {"1 tuple buffers", 0, 0, false, ""},
+  {"spill, one buffer", 1, SPILL_MEMORY_LIMIT, false, ""},
+  {"spill, 7 buffers", 7, SPILL_MEMORY_LIMIT, false, ""},
+  {"spill, 1 tuple buffers", 0, SPILL_MEMORY_LIMIT, false, ""},
+  {"hash, one buffer", 1, 0, true, ""},
+  {"hash, 7 buffers", 7, 0, true, ""},
+  {"cache write, 3 buffers", 3, 0, false, "write"},
+  {"cache read, one buffer", 1, 0, false, "read"},
+  {"cache read, 7 buffers", 7, SPILL_MEMORY_LIMIT, false, "read"}
+};
+
+static const uint32_t NUM_CONFIGURATIONS =
+  sizeof(CONFIGURATIONS) / sizeof(CONFIGURATIONS[0]);
+
+/// Collects the seed tuples of the job's map function
+class SeedCollector : public CloudBurstMapFunction {
+public:
+  SeedCollector(
+    const Parameters& parameters, const std::string& referenceCacheMode,
+    Tuples& _seedTuples)
+    : CloudBurstMapFunction(
+        parameters.maxAlignDiff, 1, READ_LENGTH, READ_LENGTH, false,
+        parameters.seedMasks, "", "", referenceCacheMode, "", "", 0, "",
+        false),
+      seedTuples(_seedTuples) {
+  }
+
+protected:
+  void emitSeed(KeyValuePair& seedTuple) {
+    const char* key = reinterpret_cast<const char*>(seedTuple.getKey());
+    const char* value = reinterpret_cast<const char*>(seedTuple.getValue());
+    seedTuples.push_back(Tuple(
+      std::string(key, seedTuple.getKeyLength()),
+      std::string(value, seedTuple.getValueLength())));
+  }
+
+private:
+  Tuples& seedTuples;
+};
+
+/// Iterates over the tuples of one key in a reduce buffer
+class BufferIterator : public KVPairIterator {
+public:
+  BufferIterator(const Tuples& _buffer, uint64_t _next, uint64_t _end)
+    : buffer(_buffer),
+      nextTuple(_next),
+      end(_end) {
+  }
+
+  bool next(KeyValuePair& kvPair) {
+    if (nextTuple == end) {
+      return false;
+    }
+    const Tuple& tuple = buffer[nextTuple++];
+    kvPair.setKey(reinterpret_cast<const uint8_t*>(tuple.first.data()),
+                  tuple.first.size());
+    kvPair.setValue(reinterpret_cast<const uint8_t*>(tuple.second.data()),
+                    tuple.second.size());
+    return true;
+  }
+
+private:
+  const Tuples& buffer;
+  uint64_t nextTuple;
+  const uint64_t end;
+};
+
+/// Collects the tuples a map or reduce function writes
+class AlignmentCollector : public KVPairWriterInterface {
+public:
+  AlignmentCollector()
+    : bytesWritten(0) {
+  }
+
+  void write(KeyValuePair& kvPair) {
+    const char* key = reinterpret_cast<const char*>(kvPair.getKey());
+    const char* value = reinterpret_cast<const char*>(kvPair.getValue());
+    alignments.push_back(Tuple(
+      std::string(key, kvPair.getKeyLength()),
+      std::string(value, kvPair.getValueLength())));
+    bytesWritten += kvPair.getKeyLength() + kvPair.getValueLength();
+  }
+
+  uint8_t* setupWrite(
+    const uint8_t* key, uint32_t keyLength, uint32_t maxValueLength) {
+    pendingKey.assign(reinterpret_cast<const char*>(key), keyLength);
+    pendingValue.resize(maxValueLength);
+    return reinterpret_cast<uint8_t*>(&pendingValue[0]);
+  }
+
+  void commitWrite(uint32_t valueLength) {
+    pendingValue.resize(valueLength);
+    alignments.push_back(Tuple(pendingKey, pendingValue));
+    bytesWritten += pendingKey.size() + valueLength;
+  }
+
+  uint64_t getNumBytesCallerTriedToWrite() const {
+    return bytesWritten;
+  }
+
+  uint64_t getNumBytesWritten() const {
+    return bytesWritten;
+  }
+
+  uint64_t getNumTuplesWritten() const {
+    return alignments.size();
+  }
+
+  void flushBuffers() {
+  }
+
+  /// The tuples written so far, in the order they were written
+  const Tuples& tuples() const {
+    return alignments;
+  }
+
+  /// The alignments written so far, sorted so that runs can be compared
+  Tuples& sortedAlignments() {
+    std::sort(alignments.begin(), alignments.end());
+    return alignments;
+  }
+
+private:
+  Tuples alignments;
+  uint64_t bytesWritten;
+  std::string pendingKey;
+  std::string pendingValue;
+};
+
+/// \return a base other than the given one
+static byte mutate(byte base, Random& random) {
+  byte mutated;
+  do {
+    mutated = BASES[random.below(4)];
+  } while (mutated == base);
+  return mutated;
+}
+
+/// Seed a sequence as the converted input tuple keyed by its id.
+static void seedSequence(
+  SeedCollector& seeder, int32_t id, const std::string& sequence) {
+  FastaRecord record;
+  record.sequence =
+    reinterpret_cast<byte*>(const_cast<char*>(sequence.data()));
+  record.offset = 0;
+  record.lastChunk = true;
+  int32_t length;
+  byte* value = record.toBytes(sequence.size(), length);
+  // The record does not own the sequence
+  record.sequence = NULL;
+
+  KeyValuePair kvPair;
+  kvPair.setKey(reinterpret_cast<uint8_t*>(&id), sizeof(id));
+  kvPair.setValue(value, length);
+  seeder.seed(kvPair);
+  delete[] value;
+}
+
+/**
+   Seed the reference and reads with the job's map function, and partition
+   and sort the seed tuples.
+ */
+static void seedAndPartition(
+  const Parameters& parameters, const std::string& reference,
+  const std::vector<std::string>& reads,
+  const std::string& referenceCacheMode, const Boundaries& boundaries,
+  std::vector<Tuples>& partitions) {
+  Tuples seedTuples;
+  SeedCollector seeder(parameters, referenceCacheMode, seedTuples);
+  seeder.configureSource("reference");
+  seedSequence(seeder, 0, reference);
+  seeder.configureSource("queries");
+  for (uint32_t i = 0; i < reads.size(); i++) {
+    seedSequence(seeder, i, reads[i]);
+  }
+
+  partitions.assign(boundaries.size() + 1, Tuples());
+  for (Tuples::iterator iter = seedTuples.begin(); iter != seedTuples.end();
+       iter++) {
+    // FNV-1a of the seed, which is the key minus the reference/query flag
+    const std::string& key = iter->first;
+    uint64_t hash = 14695981039346656037ULL;
+    for (uint32_t i = 0; i + 1 < key.size(); i++) {
+      hash = (hash ^ static_cast<uint8_t>(key[i])) * 1099511628211ULL;
+    }
+    uint32_t partition = std::upper_bound(
+      boundaries.begin(), boundaries.end(),
+      hash / 18446744073709551616.0) - boundaries.begin();
+    partitions[partition].push_back(*iter);
+  }
+  for (uint32_t p = 0; p < partitions.size(); p++) {
+    std::stable_sort(partitions[p].begin(), partitions[p].end(), keyLess);
+  }
+}
+
+/// \return the seed of a tuple, which is its key minus the reference/query flag
+static std::string seedOf(const Tuple& tuple) {
+  return tuple.first.substr(0, tuple.first.size() - 1);
+}
+
+/**
+   Count the buffers in which query tuples should be joined with a reference
+   group kept from an earlier buffer. Such a buffer starts in the middle of a
+   seed's tuples, the seed has reference tuples before the buffer or a cached
+   reference group, and the buffer holds query tuples of the seed.
+
+   \param cachedSeeds the seeds whose reference groups are read from the
+   cache, for partitions without reference tuples
+ */
+static uint64_t countCarriedOverGroups(
+  const std::vector<Tuples>& partitions, uint32_t buffersPerPartition,
+  const std::set<std::string>& cachedSeeds) {
+  uint64_t count = 0;
+  for (uint32_t p = 0; p < partitions.size(); p++) {
+    const Tuples& partition = partitions[p];
+    uint64_t numBuffers = buffersPerPartition == 0 ?
+      partition.size() : buffersPerPartition;
+    for (uint64_t b = 1; b < numBuffers; b++) {
+      uint64_t start = partition.size() * b / numBuffers;
+      uint64_t end = partition.size() * (b + 1) / numBuffers;
+      if (start == 0 || start == end) {
+        continue;
+      }
+      std::string seed = seedOf(partition[start]);
+      if (seedOf(partition[start - 1]) != seed) {
+        continue;
+      }
+      uint64_t first = start - 1;
+      while (first > 0 && seedOf(partition[first - 1]) == seed) {
+        first--;
+      }
+      bool hasReference = *partition[first].first.rbegin() == 0 ||
+        cachedSeeds.count(seed) > 0;
+      bool hasQuery = false;
+      for (uint64_t i = start;
+           i < end && !hasQuery && seedOf(partition[i]) == seed; i++) {
+        hasQuery = *partition[i].first.rbegin() == 1;
+      }
+      if (hasReference && hasQuery) {
+        count++;
+      }
+    }
+  }
+  return count;
+}
+
+/// Overwrite and free a buffer the reducer is done with.
+static void freeBuffer(Tuples* buffer) {
+  for (Tuples::iterator iter = buffer->begin(); iter != buffer->end();
+       iter++) {
+    std::fill(iter->first.begin(), iter->first.end(), '\xff');
+    std::fill(iter->second.begin(), iter->second.end(), '\xff');
+  }
+  delete buffer;
+}
+
+/**
+   Reduce every partition in one configuration's buffers.
+
+   \param[out] groupsCarriedOver the number of reference groups the reducer
+   joined with query tuples from a later buffer
+
+   \return the sorted alignments
+ */
+static Tuples align(
+  const Parameters& parameters, const Configuration& configuration,
+  const std::vector<Tuples>& partitions, const std::string& directory,
+  const std::string& cacheDirectory, uint64_t& groupsCarriedOver) {
+  bool caching = configuration.referenceCacheMode[0] != '\0';
+  CloudBurstReduceFunction reducer(
+    parameters.maxAlignDiff, READ_LENGTH / (parameters.maxAlignDiff + 1),
+    parameters.allowDifferences, BLOCK_SIZE, 1,
+    configuration.referenceMemoryLimit, directory,
+    configuration.hashGrouping, parameters.seedMasks, READ_LENGTH,
+    READ_LENGTH, "", 0, 0,
+    caching ? cacheDirectory : "", configuration.referenceCacheMode, "",
+    false);
+  AlignmentCollector writer;
+
+  Tuples* previousBuffer = NULL;
+  for (uint32_t p = 0; p < partitions.size(); p++) {
+    const Tuples& partition = partitions[p];
+    uint64_t numBuffers = configuration.buffersPerPartition == 0 ?
+      partition.size() : configuration.buffersPerPartition;
+    for (uint64_t b = 0; b < numBuffers; b++) {
+      Tuples* buffer = new (themis::memcheck) Tuples(
+        partition.begin() + partition.size() * b / numBuffers,
+        partition.begin() + partition.size() * (b + 1) / numBuffers);
+      if (previousBuffer != NULL) {
+        freeBuffer(previousBuffer);
+      }
+      reducer.configure();
+
+      uint64_t start = 0;
+      while (start < buffer->size()) {
+        const std::string& key = (*buffer)[start].first;
+        uint64_t end = start + 1;
+        while (end < buffer->size() && (*buffer)[end].first == key) {
+          end++;
+        }
+        BufferIterator iterator(*buffer, start, end);
+        reducer.reduce(reinterpret_cast<const uint8_t*>(key.data()),
+                       key.size(), iterator, writer);
+        start = end;
+      }
+      previousBuffer = buffer;
+    }
+  }
+  reducer.teardown(writer);
+  groupsCarriedOver = reducer.referenceGroupsCarriedOver();
+  if (previousBuffer != NULL) {
+    freeBuffer(previousBuffer);
+  }
+  return writer.sortedAlignments();
+}
+
+/**
+   Check that every configuration finds the same alignments.
+
+   \param[out] expected the sorted alignments of the first configuration,
+   which the others must match
+
+   \return true if they all do
+ */
+static bool checkReduceBuffers(
+  const std::string& directory, const std::string& cacheDirectory,
+  Tuples& expected) {
+  // Simulate a reference, with copies of one segment so that its seeds'
+  // reference groups are large, and reads from both strands
+  Random random(1);
+  DNAString dnaStringObj;
+  std::string reference(REFERENCE_LENGTH, 'A');
+  for (uint32_t i = 0; i < REFERENCE_LENGTH; i++) {
+    reference[i] = BASES[random.below(4)];
+  }
+  std::string segment = reference.substr(0, REPEAT_LENGTH);
+  for (uint32_t copy = 0; copy < REPEAT_COPIES; copy++) {
+    reference.replace(
+      random.below(REFERENCE_LENGTH - REPEAT_LENGTH), REPEAT_LENGTH, segment);
+  }
+
+  std::vector<std::string> reads(NUM_READS);
+  for (uint32_t i = 0; i < NUM_READS; i++) {
+    std::string& read = reads[i];
+    read = reference.substr(
+      random.below(REFERENCE_LENGTH - READ_LENGTH), READ_LENGTH);
+    for (uint32_t j = 0; j < READ_LENGTH; j++) {
+      if (random.uniform() < SUBSTITUTION_RATE) {
+        read[j] = mutate(read[j], random);
+      }
+    }
+    if (random.below(2) == 1) {
+      dnaStringObj.reverseComplementSequenceInPlace(
+        reinterpret_cast<byte*>(&read[0]), READ_LENGTH);
+    }
+  }
+
+  Boundaries writeBoundaries(
+    WRITE_BOUNDARIES, WRITE_BOUNDARIES + sizeof(WRITE_BOUNDARIES) /
+    sizeof(WRITE_BOUNDARIES[0]));
+  std::vector<Tuples> partitions;
+  seedAndPartition(
+    CONTIGUOUS_SEEDS, reference, reads, "", writeBoundaries, partitions);
+  // A job reading the cache drops the reference in its map function.
+  Boundaries readBoundaries(
+    READ_BOUNDARIES, READ_BOUNDARIES + sizeof(READ_BOUNDARIES) /
+    sizeof(READ_BOUNDARIES[0]));
+  std::vector<Tuples> queryPartitions;
+  seedAndPartition(
+    CONTIGUOUS_SEEDS, reference, reads, "read", readBoundaries,
+    queryPartitions);
+  std::set<std::string> cachedSeeds;
+  for (uint32_t p = 0; p < partitions.size(); p++) {
+    for (Tuples::iterator iter = partitions[p].begin();
+         iter != partitions[p].end(); iter++) {
+      if (*iter->first.rbegin() == 0) {
+        cachedSeeds.insert(seedOf(*iter));
+      }
+    }
+  }
+
+  bool passed = true;
+  for (uint32_t i = 0; i < NUM_CONFIGURATIONS; i++) {
+    const Configuration& configuration = CONFIGURATIONS[i];
+    bool readingCache = strcmp(configuration.referenceCacheMode, "read") == 0;
+    const std::vector<Tuples>& reduced =
+      readingCache ? queryPartitions : partitions;
+    uint64_t groupsCarriedOver;
+    Tuples alignments = align(
+      CONTIGUOUS_SEEDS, configuration, reduced, directory, cacheDirectory,
+      groupsCarriedOver);
+    // Hash grouping joins whole partitions at teardown
+    uint64_t expectedCarriedOver = configuration.hashGrouping ? 0 :
+      countCarriedOverGroups(
+        reduced, configuration.buffersPerPartition,
+        readingCache ? cachedSeeds : std::set<std::string>());
+    if (i == 0) {
+      ABORT_IF(alignments.empty(), "The reads had no alignments");
+      expected.swap(alignments);
+      fprintf(stderr, "%-24s %llu alignments\n", configuration.name,
+              static_cast<unsigned long long>(expected.size()));
+    } else if (alignments == expected) {
+      fprintf(stderr, "%-24s ok\n", configuration.name);
+    } else {
+      fprintf(stderr, "%-24s MISMATCH: %llu alignments\n", configuration.name,
+              static_cast<unsigned long long>(alignments.size()));
+      passed = false;
+    }
+    if (groupsCarriedOver != expectedCarriedOver) {
+      fprintf(stderr, "%-24s CARRIED OVER %llu GROUPS, expected %llu\n",
+              configuration.name,
+              static_cast<unsigned long long>(groupsCarriedOver),
+              static_cast<unsigned long long>(expectedCarriedOver));
+      passed = false;
+    }
+  }
+  return passed;
+}
+
+/// Orders coordinate hits by every field, so that sets of them can be compared
+static bool hitLess(const CoordinateHit& a, const CoordinateHit& b) {
+  if (a.refID != b.refID) {
+    return a.refID < b.refID;
+  } else if (a.refStart != b.refStart) {
+    return a.refStart < b.refStart;
+  } else if (a.refEnd != b.refEnd) {
+    return a.refEnd < b.refEnd;
+  } else if (a.readID != b.readID) {
+    return a.readID < b.readID;
+  } else if (a.differences != b.differences) {
+    return a.differences < b.differences;
+  }
+  return a.flags < b.flags;
+}
+
+/// \return true if the hits are the same
+static bool hitEqual(const CoordinateHit& a, const CoordinateHit& b) {
+  return !hitLess(a, b) && !hitLess(b, a);
+}
+
+/**
+   Check that alignments laid out in coordinate blocks decode to the same
+   hits, in coordinate order.
+
+   The alignments are grouped by read as the filter stage writes them, then
+   re-keyed by the coordinate map function, sorted and packed into blocks
+   by the coordinate reduce function.
+
+   \param alignments alignment records keyed by read id, sorted
+
+   \return true if the blocks' hits match the alignments
+ */
+static bool checkCoordinateBlocks(const Tuples& alignments) {
+  Tuples groupedRecords;
+  std::vector<CoordinateHit> expected;
+  std::vector<uint8_t> value;
+  uint64_t start = 0;
+  while (start < alignments.size()) {
+    uint64_t end = start + 1;
+    while (end < alignments.size() &&
+           alignments[end].first == alignments[start].first) {
+      end++;
+    }
+    int32_t readID;
+    memcpy(&readID, alignments[start].first.data(), sizeof(readID));
+    value.resize(
+      Varint::MAX_LENGTH + (end - start) * AlignmentCodec::MAX_HIT_LENGTH);
+    uint32_t length = Varint::encode(end - start, &value[0]);
+    for (uint64_t i = start; i < end; i++) {
+      AlignmentRecord alignment;
+      alignment.fromBytes(
+        reinterpret_cast<const byte*>(alignments[i].second.data()));
+      length += AlignmentCodec::encodeHit(alignment, &value[length]);
+      if (!alignment.isRepetitiveMarker()) {
+        CoordinateHit hit;
+        hit.refID = alignment.refID;
+        hit.refStart = alignment.refStart;
+        hit.refEnd = alignment.refEnd;
+        hit.readID = readID;
+        hit.differences = alignment.differences;
+        hit.flags = alignment.flags();
+        expected.push_back(hit);
+      }
+    }
+    groupedRecords.push_back(Tuple(
+      alignments[start].first,
+      std::string(reinterpret_cast<const char*>(&value[0]), length)));
+    start = end;
+  }
+  ABORT_IF(expected.size() <= COORDINATE_BLOCK_HITS,
+           "The alignments fit in one coordinate block");
+
+  CloudBurstCoordinateMapFunction mapper;
+  AlignmentCollector hitTuples;
+  for (Tuples::iterator iter = groupedRecords.begin();
+       iter != groupedRecords.end(); iter++) {
+    KeyValuePair kvPair;
+    kvPair.setKey(reinterpret_cast<const uint8_t*>(iter->first.data()),
+                  iter->first.size());
+    kvPair.setValue(reinterpret_cast<const uint8_t*>(iter->second.data()),
+                    iter->second.size());
+    mapper.map(kvPair, hitTuples);
+  }
+
+  // The reducer sees one partition, sorted by coordinate key
+  Tuples& sortedHits = hitTuples.sortedAlignments();
+  CloudBurstCoordinateReduceFunction reducer(COORDINATE_BLOCK_HITS);
+  AlignmentCollector blockTuples;
+  start = 0;
+  while (start < sortedHits.size()) {
+    const std::string& key = sortedHits[start].first;
+    uint64_t end = start + 1;
+    while (end < sortedHits.size() && sortedHits[end].first == key) {
+      end++;
+    }
+    BufferIterator iterator(sortedHits, start, end);
+    reducer.reduce(reinterpret_cast<const uint8_t*>(key.data()), key.size(),
+                   iterator, blockTuples);
+    start = end;
+  }
+  reducer.teardown(blockTuples);
+
+  // The blocks are written in coordinate order, so their hits must be too
+  const Tuples& blocks = blockTuples.tuples();
+  std::vector<CoordinateHit> decoded;
+  for (Tuples::const_iterator iter = blocks.begin(); iter != blocks.end();
+       iter++) {
+    AlignmentCodec::decodeBlock(
+      reinterpret_cast<const uint8_t*>(iter->first.data()),
+      reinterpret_cast<const uint8_t*>(iter->second.data()),
+      iter->second.size(), decoded);
+  }
+  bool ordered = true;
+  for (uint64_t i = 1; i < decoded.size(); i++) {
+    ordered = ordered &&
+      (decoded[i - 1].refID < decoded[i].refID ||
+       (decoded[i - 1].refID == decoded[i].refID &&
+        decoded[i - 1].refStart <= decoded[i].refStart));
+  }
+
+  std::sort(expected.begin(), expected.end(), hitLess);
+  std::sort(decoded.begin(), decoded.end(), hitLess);
+  bool passed = ordered && decoded.size() == expected.size() &&
+    std::equal(decoded.begin(), decoded.end(), expected.begin(), hitEqual);
+  if (passed) {
+    fprintf(stderr, "%-24s ok, %llu hits in %llu blocks\n",
+            "coordinate blocks",
+            static_cast<unsigned long long>(decoded.size()),
+            static_cast<unsigned long long>(blocks.size()));
+  } else {
+    fprintf(stderr, "%-24s MISMATCH: %llu hits, expected %llu%s\n",
+            "coordinate blocks",
+            static_cast<unsigned long long>(decoded.size()),
+            static_cast<unsigned long long>(expected.size()),
+            ordered ? "" : ", out of order");
+  }
+  return passed;
+}
+
+/**
+   Check that spaced seeds find an alignment whose only exact windows start
+   at offsets that are not multiples of the mask's span.
+
+   The read has a base inserted after the first three bases of its reference
+   interval. With the mask below and K = 2, the alignment of the read to
+   that interval with two differences matches exactly only at windows that
+   start between the multiples of the span of 12, so the reads must be
+   seeded at every offset to find it.
+
+   \return true if the alignment is found
+ */
+static bool checkSpacedSeedOffsets(const std::string& directory) {
+  static const Parameters SPACED_SEEDS = {2, true, "110111011011"};
+  std::string reference(
+    "CTCCGCGAGATTTATGCATGAGATTGATGTAAGCCCTTCCTAATCTCGTAATTCTGTTGC"
+    "TGCCATGTGTAGAACCTGTTTAGGCCAACGCACTCCGAAAATGGGGACTCTTACATGTCC"
+    "GTCGATGATCCTCTGTCGAATATTCTTTTAACACAAAGCAAGTAATAGTAGAGTACTGGT"
+    "ATACACACCGAGATGAGTTCTCCCCGGAAATAAAGACGCGACAAATAGGTACCCGGTAGT");
+  std::vector<std::string> reads(
+    1, std::string("AAAGATGGGGACTCTTACATGTCCGTCGATGATCCT"));
+  const int64_t refStart = 97;
+  const int64_t refEnd = 132;
+
+  std::vector<Tuples> partitions;
+  seedAndPartition(
+    SPACED_SEEDS, reference, reads, "", Boundaries(), partitions);
+  uint64_t groupsCarriedOver;
+  Tuples alignments = align(
+    SPACED_SEEDS, CONFIGURATIONS[0], partitions, directory, "",
+    groupsCarriedOver);
+
+  bool found = false;
+  for (Tuples::iterator iter = alignments.begin(); iter != alignments.end();
+       iter++) {
+    AlignmentRecord alignment;
+    alignment.fromBytes(reinterpret_cast<const byte*>(iter->second.data()));
+    found = found || (alignment.refStart == refStart &&
+                      alignment.refEnd == refEnd &&
+                      alignment.differences == 2 && !alignment.isRC);
+  }
+  fprintf(stderr, "%-24s %s\n", "spaced seed offsets",
+          found ? "ok" : "MISSING ALIGNMENT");
+  return found;
+}
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s work_directory\n"
+            "Scratch files and a new reference cache are written to "
+            "work_directory, which\nis created if it does not exist.\n",
+            argv[0]);
+    return 1;
+  }
+  std::string directory(argv[1]);
+  ABORT_IF(mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST,
+           "Failed to create %s: %s", directory.c_str(), strerror(errno));
+  // The cache must start empty, since a writer adds runs to what is there
+  std::string cacheTemplate = directory + "/cacheXXXXXX";
+  ABORT_IF(mkdtemp(&cacheTemplate[0]) == NULL, "Failed to create a reference "
+           "cache directory in %s: %s", directory.c_str(), strerror(errno));
+  std::string cacheDirectory(cacheTemplate.c_str());
+
+  Tuples alignments;
+  bool passed = checkReduceBuffers(directory, cacheDirectory, alignments);
+  passed = checkCoordinateBlocks(alignments) && passed;
+  passed = checkSpacedSeedOffsets(directory) && passed;
+  return passed ? 0 : 1;
+}
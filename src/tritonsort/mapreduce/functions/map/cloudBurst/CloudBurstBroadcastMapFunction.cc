@@ -0,0 +1,161 @@
+#include <algorithm>
+
+#include "CloudBurstBroadcastMapFunction.h"
+#include "TupleFile.h"
+#include "mapreduce/common/KeyValuePair.h"
+#include "mapreduce/functions/reduce/cloudBurst/AlignmentSink.h"
+
+// The side is decided by the file's own name, not the directories above it
+static bool isReferenceFile(const std::string& path) {
+  std::string fileName = path.substr(path.rfind('/') + 1);
+  return fileName.find("ref", 0) != std::string::npos;
+}
+
+CloudBurstBroadcastMapFunction::CloudBurstBroadcastMapFunction(
+  uint32_t maxAlignDiff, uint32_t seedLength, uint32_t allowDifferences,
+  int32_t minReadLen, int32_t maxReadLen, bool canonicalSeeds,
+  const std::string& seedMasks, const std::string& readLengthClasses,
+  uint32_t maxAlignmentsPerRead, uint32_t maxHitsPerSeed,
+  const std::string& _broadcastFile, uint32_t dustThreshold,
+  const std::string& repeatMaskFile)
+  : CloudBurstMapFunction(
+      maxAlignDiff, 1, minReadLen, maxReadLen, canonicalSeeds, seedMasks,
+      readLengthClasses, "", "", "", "", dustThreshold, repeatMaskFile,
+      false),
+    broadcastFile(_broadcastFile),
+    broadcastReference(isReferenceFile(_broadcastFile)),
+    skipSource(false),
+    indexLoaded(false),
+    loadingIndex(false),
+    alignmentWriter(NULL),
+    aligner(
+      maxAlignDiff, seedLength, allowDifferences, seedMasks, minReadLen,
+      maxReadLen, readLengthClasses, maxAlignmentsPerRead, maxHitsPerSeed),
+    streamedTuple(1),
+    logger("CloudBurstBroadcastMapFunction"),
+    tuplesIndexed(0),
+    streamedSeeds(0),
+    joinedSeeds(0) {
+  ABORT_IF(broadcastFile.empty(), "CloudBurst broadcast mode needs the file "
+           "of the side to hold in memory");
+  // Streamed reference tuples arrive in no particular order, so a read's
+  // hits against a seed can't be counted across them
+  ABORT_IF(maxHitsPerSeed > 0 && !broadcastReference, "CloudBurst can only "
+           "cap hits per seed when the reference is broadcast");
+}
+
+void CloudBurstBroadcastMapFunction::configure(KVPairBuffer* buffer) {
+  sourceName = buffer->getSourceName();
+  ABORT_IF(sourceName.empty(),
+           "CloudBurst requires a FileByteStreamConverter to set filenames on "
+           "map input buffers");
+  // The broadcast side is already in the index on every node
+  skipSource = isReferenceFile(sourceName) == broadcastReference;
+  if (!skipSource) {
+    CloudBurstMapFunction::configure(buffer);
+  }
+}
+
+void CloudBurstBroadcastMapFunction::map(
+  KeyValuePair& kvPair, KVPairWriterInterface& writer) {
+  if (skipSource) {
+    return;
+  }
+  if (!indexLoaded) {
+    loadIndex();
+    configureSource(sourceName);
+  }
+  alignmentWriter = &writer;
+  seed(kvPair);
+  alignmentWriter = NULL;
+}
+
+void CloudBurstBroadcastMapFunction::teardown(KVPairWriterInterface& writer) {
+  CloudBurstMapFunction::teardown(writer);
+  logger.logDatum("broadcast_tuples_indexed", tuplesIndexed);
+  logger.logDatum("broadcast_seeds_indexed", seedIndex.numSeeds());
+  logger.logDatum("broadcast_index_bytes", seedIndex.bytes());
+  logger.logDatum("streamed_seed_tuples", streamedSeeds);
+  logger.logDatum("joined_seed_tuples", joinedSeeds);
+  if (aligner.capsHits()) {
+    logger.logDatum("repetitive_query_tuples", aligner.repetitiveQueryTuples());
+  }
+  if (aligner.filtersAlignments()) {
+    logger.logDatum("alignments_found", aligner.alignmentsFound());
+    logger.logDatum("alignments_written", aligner.alignmentsWritten());
+  }
+}
+
+void CloudBurstBroadcastMapFunction::emitSeed(KeyValuePair& seedTuple) {
+  if (loadingIndex) {
+    // The seed is everything but the reference/query flag.
+    seedIndex.insert(
+      seedTuple.getKey(), seedTuple.getKeyLength() - 1, seedTuple.getValue(),
+      seedTuple.getValueLength(), broadcastReference);
+    ++tuplesIndexed;
+  } else {
+    joinSeed(seedTuple, *alignmentWriter);
+  }
+}
+
+void CloudBurstBroadcastMapFunction::loadIndex() {
+  TupleFile file;
+  file.load(broadcastFile);
+
+  // Seed the file's sequences as the map function would seed a buffer of
+  // them, catching the seed tuples in emitSeed().
+  configureSource(broadcastFile.substr(broadcastFile.rfind('/') + 1));
+  loadingIndex = true;
+  KeyValuePair kvPair;
+  for (uint64_t i = 0; i < file.size(); i++) {
+    file.get(i, kvPair);
+    seed(kvPair);
+  }
+  loadingIndex = false;
+  indexLoaded = true;
+}
+
+void CloudBurstBroadcastMapFunction::joinSeed(
+  KeyValuePair& seedTuple, KVPairWriterInterface& writer) {
+  ++streamedSeeds;
+  uint64_t slot = seedIndex.find(
+    seedTuple.getKey(), seedTuple.getKeyLength() - 1);
+  if (slot == seedIndex.capacity()) {
+    return;
+  }
+  SeedHashTable::TupleHandle tuple = broadcastReference ?
+    seedIndex.firstReference(slot) : seedIndex.firstQuery(slot);
+  if (tuple == 0) {
+    return;
+  }
+  ++joinedSeeds;
+
+  // Records only point into the index and the streamed tuple, so parsing
+  // them for every lookup is cheap.
+  indexedTuples.clear();
+  for (; tuple != 0; tuple = seedIndex.next(tuple)) {
+    indexedTuples.push_back(MerRecord());
+    indexedTuples.back().fromBytes(
+      seedIndex.value(tuple), seedIndex.valueLength(tuple));
+  }
+  // The table keeps each list newest first. Put the tuples back in the order
+  // they were seeded, in which the reducer would see them, so that the hit
+  // cap keeps the same alignments.
+  std::reverse(indexedTuples.begin(), indexedTuples.end());
+  streamedTuple[0].fromBytes(
+    seedTuple.getValue(), seedTuple.getValueLength());
+
+  // Either way round, a batch is one seed's query tuples against all of its
+  // reference tuples that are at hand, as in the reducer.
+  KVPairAlignmentSink sink(writer);
+  if (broadcastReference) {
+    aligner.startBatch(1);
+    aligner.alignBlock(
+      streamedTuple, indexedTuples, 1, indexedTuples.size(), sink);
+  } else {
+    aligner.startBatch(indexedTuples.size());
+    aligner.alignBlock(
+      indexedTuples, streamedTuple, indexedTuples.size(), 1, sink);
+  }
+  aligner.finishBatch(sink);
+}
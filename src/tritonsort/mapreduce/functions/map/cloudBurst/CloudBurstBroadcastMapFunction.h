@@ -0,0 +1,128 @@
+#ifndef MAPRED_CLOUD_BURST_BROADCAST_MAP_FUNCTION_H
+#define MAPRED_CLOUD_BURST_BROADCAST_MAP_FUNCTION_H
+
+#include <string>
+#include <vector>
+
+#include "CloudBurstMapFunction.h"
+#include "MerRecord.h"
+#include "core/StatLogger.h"
+#include "mapreduce/functions/reduce/cloudBurst/CloudBurstAligner.h"
+#include "mapreduce/functions/reduce/cloudBurst/SeedHashTable.h"
+
+/**
+   Map-side CloudBurst join for jobs where one side, usually a small
+   reference such as a bacterial genome or an amplicon panel, fits in memory
+   on every node.
+
+   Before its first tuple, each map function seeds the whole small side from
+   a local copy of its converted input file into a SeedHashTable, an
+   open-addressing table of packed seed tuples. Tuples of the small side in
+   the job's input are dropped. Every seed tuple of the streamed side is then
+   looked up in the table and aligned against the other side's tuples for the
+   same seed by a CloudBurstAligner, exactly as the reducer would align them,
+   and the alignments are written keyed by read id. Seed tuples are never
+   partitioned, sorted or shuffled; only alignments are.
+
+   Low complexity seeds need no redundant copies, since there are no
+   reducers to spread them over.
+ */
+class CloudBurstBroadcastMapFunction : public CloudBurstMapFunction {
+public:
+  /// Constructor
+  /**
+     \param maxAlignDiff the maximum number of differences to allow
+
+     \param seedLength the length of a contiguous seed
+
+     \param allowDifferences whether indels are allowed, or only mismatches
+
+     \param minReadLen the length of the shortest read
+
+     \param maxReadLen the length of the longest read
+
+     \param canonicalSeeds if true, key seeds by the smaller of themselves
+     and their reverse complement. \sa CloudBurstMapFunction
+
+     \param seedMasks the spaced seed masks, or an empty string for
+     contiguous seeds. \sa SeedMask
+
+     \param readLengthClasses the read length classes, or an empty string
+     for a single class. \sa ReadLengthClass
+
+     \param maxAlignmentsPerRead if not 0, write only the alignments a
+     CloudBurstFilterReduceFunction keeping this many alignments per read
+     could keep
+
+     \param maxHitsPerSeed if not 0, a read tuple stops being extended once
+     it has this many alignments against its seed's reference tuples, and a
+     repetitive read marker is written for it instead of the rest. Only
+     supported when the reference is broadcast.
+
+     \param broadcastFile a local copy of the small side's converted input
+     file. \sa TupleFile. As for map input buffers, the side is the
+     reference if the file's name contains "ref".
+
+     \param dustThreshold the DUST threshold reference seeds are masked
+     with, or 0. \sa LowComplexityMask
+
+     \param repeatMaskFile a file of reference intervals to mask, or an
+     empty string. \sa LowComplexityMask
+   */
+  CloudBurstBroadcastMapFunction(
+    uint32_t maxAlignDiff, uint32_t seedLength, uint32_t allowDifferences,
+    int32_t minReadLen, int32_t maxReadLen, bool canonicalSeeds,
+    const std::string& seedMasks, const std::string& readLengthClasses,
+    uint32_t maxAlignmentsPerRead, uint32_t maxHitsPerSeed,
+    const std::string& broadcastFile, uint32_t dustThreshold,
+    const std::string& repeatMaskFile);
+
+  /// Drop buffers of the broadcast side, and configure for the others.
+  void configure(KVPairBuffer* buffer);
+
+  /// Align a streamed sequence's seeds, loading the index first if needed.
+  void map(KeyValuePair& kvPair, KVPairWriterInterface& writer);
+
+  /// Log index and join statistics
+  void teardown(KVPairWriterInterface& writer);
+
+protected:
+  /// Index the seed tuple while loading, otherwise align it.
+  void emitSeed(KeyValuePair& seedTuple);
+
+private:
+  /// Seed every sequence of the broadcast file into the index.
+  void loadIndex();
+
+  /**
+     Align a streamed seed tuple against the indexed tuples with its seed.
+
+     \param seedTuple the streamed seed tuple
+
+     \param writer the writer to write alignments to
+   */
+  void joinSeed(KeyValuePair& seedTuple, KVPairWriterInterface& writer);
+
+  const std::string broadcastFile;
+  const bool broadcastReference;
+
+  // Name of the buffer being streamed, so that it can be configured again
+  // once the index is loaded
+  std::string sourceName;
+  bool skipSource;
+  bool indexLoaded;
+  bool loadingIndex;
+  KVPairWriterInterface* alignmentWriter;
+
+  SeedHashTable seedIndex;
+  CloudBurstAligner aligner;
+  std::vector<MerRecord> indexedTuples;
+  std::vector<MerRecord> streamedTuple;
+
+  StatLogger logger;
+  uint64_t tuplesIndexed;
+  uint64_t streamedSeeds;
+  uint64_t joinedSeeds;
+};
+
+#endif  // MAPRED_CLOUD_BURST_BROADCAST_MAP_FUNCTION_H
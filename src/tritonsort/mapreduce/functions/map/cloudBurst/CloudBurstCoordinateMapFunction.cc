@@ -0,0 +1,42 @@
+#include <string.h>
+
+#include "CloudBurstCoordinateMapFunction.h"
+#include "mapreduce/common/KeyValuePair.h"
+#include "mapreduce/functions/reduce/cloudBurst/AlignmentCodec.h"
+
+void CloudBurstCoordinateMapFunction::map(
+  KeyValuePair& kvPair, KVPairWriterInterface& writer) {
+  int32_t readID;
+  ABORT_IF(kvPair.getKeyLength() != sizeof(readID), "Expected a %u byte read "
+           "id key, but got %u bytes", static_cast<uint32_t>(sizeof(readID)),
+           kvPair.getKeyLength());
+  memcpy(&readID, kvPair.getKey(), sizeof(readID));
+
+  const uint8_t* value = kvPair.getValue();
+  uint64_t hits;
+  uint64_t offset = Varint::decode(value, hits);
+
+  uint8_t key[AlignmentCodec::COORDINATE_KEY_LENGTH];
+  uint8_t hitBytes[3 * Varint::MAX_LENGTH + 1];
+  for (uint64_t i = 0; i < hits; i++) {
+    ABORT_IF(offset >= kvPair.getValueLength(), "Grouped alignment record of "
+             "read %d is truncated", readID);
+    offset += AlignmentCodec::decodeHit(value + offset, alignment);
+    if (alignment.isRepetitiveMarker()) {
+      continue;
+    }
+
+    AlignmentCodec::encodeCoordinateKey(
+      alignment.refID, alignment.refStart, key);
+    uint32_t length = Varint::encode(readID, hitBytes);
+    length += Varint::encode(
+      alignment.refEnd - alignment.refStart, hitBytes + length);
+    length += Varint::encode(alignment.differences, hitBytes + length);
+    hitBytes[length++] = alignment.flags();
+
+    KeyValuePair outputKVPair;
+    outputKVPair.setKey(key, sizeof(key));
+    outputKVPair.setValue(hitBytes, length);
+    writer.write(outputKVPair);
+  }
+}
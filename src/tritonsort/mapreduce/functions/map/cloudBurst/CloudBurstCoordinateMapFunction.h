@@ -0,0 +1,30 @@
+#ifndef MAPRED_CLOUD_BURST_COORDINATE_MAP_FUNCTION_H
+#define MAPRED_CLOUD_BURST_COORDINATE_MAP_FUNCTION_H
+
+#include "mapreduce/functions/map/MapFunction.h"
+#include "mapreduce/functions/reduce/cloudBurst/AlignmentRecord.h"
+
+/**
+   Map side of the job that lays CloudBurst alignments out by reference
+   coordinate. Its input is grouped alignment records keyed by read id (see
+   AlignmentCodec), and every hit is re-keyed by its reference id and start
+   so that the sort orders hits by position. The value carries the rest of
+   the hit:
+
+     read id          varint
+     length           varint
+     differences      varint
+     flags            1 byte
+
+   Repetitive read markers have no position and are dropped.
+ */
+class CloudBurstCoordinateMapFunction : public MapFunction {
+public:
+  /// \sa MapFunction::map
+  void map(KeyValuePair& kvPair, KVPairWriterInterface& writer);
+
+private:
+  AlignmentRecord alignment;
+};
+
+#endif  // MAPRED_CLOUD_BURST_COORDINATE_MAP_FUNCTION_H
@@ -1,20 +1,93 @@
+#include <algorithm>
 #include <string>
 #include "CloudBurstMapFunction.h"
+#include "core/MemoryUtils.h"
 
 typedef uint8_t byte;
 
 //constructor
 CloudBurstMapFunction::CloudBurstMapFunction(
   uint32_t _maxAlignDiff, uint32_t _redundancy, int32_t _minReadLen,
-  int32_t _maxReadLen)
+  int32_t _maxReadLen, bool _canonicalSeeds, const std::string& _seedMasks,
+  const std::string& _readLengthClasses, const std::string& _querySource,
+  const std::string& referenceCacheMode,
+  const std::string& changedIntervalsFile, const std::string& readStoreFile,
+  uint32_t dustThreshold, const std::string& repeatMaskFile,
+  bool _perfCounters)
   : chunkOverlap(1024),
     maxAlignDiff(_maxAlignDiff),
     maxReadLen(_maxReadLen),
     minReadLen(_minReadLen),
-    redundancy(_redundancy) {
-    //calculate seedLength based on min read len and K
-  seedLen = minReadLen/(maxAlignDiff + 1);
-  flankLen = maxReadLen - seedLen + maxAlignDiff;
+    redundancy(_redundancy),
+    spacedLeftFlankLen(0),
+    spacedRightFlankLen(0),
+    canonicalSeeds(_canonicalSeeds),
+    isRef(false),
+    skipBuffer(false),
+    querySource(_querySource),
+    skipReference(
+      ReferenceCache::parseMode(referenceCacheMode) == ReferenceCache::READ),
+    deltaMode(!changedIntervalsFile.empty()),
+    storedReads(!readStoreFile.empty()),
+    lowComplexityMask(dustThreshold, repeatMaskFile),
+    maskingChunk(false),
+    logger("CloudBurstMapFunction"),
+    maskedReferenceBases(0),
+    maskedReferenceSeeds(0),
+    redundantSeedCopies(0),
+    readsDroppedForN(0),
+    perfCounters(NULL),
+    seedWriter(NULL) {
+  for (uint32_t side = 0; side < 2; side++) {
+    seedsEmitted[side] = 0;
+    seedBytesEmitted[side] = 0;
+    seedsSkippedForN[side] = 0;
+  }
+  // calculate each class's seed and flank length from its read lengths and K
+  ReadLengthClass::parseClasses(
+    _readLengthClasses, minReadLen, maxReadLen, maxAlignDiff, lengthClasses);
+
+  // Room for the packed bases plus the class, redundancy and ref/qry bytes
+  int32_t maxSeedBases = 0;
+  for (uint32_t c = 0; c < lengthClasses.size(); c++) {
+    maxSeedBases = std::max(maxSeedBases, lengthClasses[c].seedLength());
+  }
+  SeedMask::parseMasks(_seedMasks, masks);
+  if (!masks.empty()) {
+    ABORT_IF(canonicalSeeds, "CloudBurst canonical seeds cannot be combined "
+             "with spaced seed masks");
+    ABORT_IF(lengthClasses.size() > 1, "CloudBurst read length classes "
+             "cannot be combined with spaced seed masks");
+    uint32_t minSpan = masks[0].span();
+    for (uint32_t m = 0; m < masks.size(); m++) {
+      ABORT_IF(masks[m].span() > minReadLen, "Seed mask %u spans %u bases, "
+               "more than the shortest read (%u bases)", m, masks[m].span(),
+               minReadLen);
+      minSpan = std::min(minSpan, masks[m].span());
+      maxSeedBases = std::max<int32_t>(maxSeedBases, masks[m].weight());
+    }
+    spacedLeftFlankLen = maxReadLen - minSpan + maxAlignDiff;
+    spacedRightFlankLen = maxReadLen + maxAlignDiff;
+  }
+  seedBufferLength = (maxSeedBases + 3)/4 + 3;
+  // Seeds are encoded one at a time, so the buffers are reused for each
+  seedBuffer = new (themis::memcheck) byte[seedBufferLength];
+  rcSeedBuffer = new (themis::memcheck) byte[seedBufferLength];
+
+  if (deltaMode) {
+    ABORT_IF(skipReference, "CloudBurst delta mode seeds the reference, so it "
+             "cannot read the reference from a cache");
+    changedIntervals.load(changedIntervalsFile);
+  }
+  if (_perfCounters) {
+    perfCounters = new (themis::memcheck) PerfCounters(1);
+  }
+}
+
+CloudBurstMapFunction::~CloudBurstMapFunction() {
+  delete[] seedBuffer;
+  delete[] rcSeedBuffer;
+  delete perfCounters;
 }
 
 // Get source of buffer to figure out whether
@@ -24,20 +97,57 @@ void CloudBurstMapFunction::configure(KVPairBuffer* buffer) {
   ABORT_IF(fileName.empty(),
            "CloudBurst requires a FileByteStreamConverter to set filenames on "
            "map input buffers");
+  configureSource(fileName);
+}
+
+void CloudBurstMapFunction::configureSource(const std::string& fileName) {
   isRef = fileName.find("ref", 0) != std::string::npos;
+  // In reference cache read mode the reference is dropped, and in later
+  // rounds of an iterative job reads from other rounds are dropped
+  skipBuffer = isRef ? skipReference : !querySource.empty() &&
+    fileName.find(querySource, 0) == std::string::npos;
+}
+
+void CloudBurstMapFunction::teardown(KVPairWriterInterface& writer) {
+  logger.logDatum("reference_seeds_emitted", seedsEmitted[1]);
+  logger.logDatum("query_seeds_emitted", seedsEmitted[0]);
+  logger.logDatum("reference_seed_bytes_emitted", seedBytesEmitted[1]);
+  logger.logDatum("query_seed_bytes_emitted", seedBytesEmitted[0]);
+  logger.logDatum("reference_seeds_skipped_for_n", seedsSkippedForN[1]);
+  logger.logDatum("query_seeds_skipped_for_n", seedsSkippedForN[0]);
+  logger.logDatum("redundant_seed_copies", redundantSeedCopies);
+  logger.logDatum("reads_dropped_for_n", readsDroppedForN);
+  if (lowComplexityMask.enabled()) {
+    logger.logDatum("masked_reference_bases_total", maskedReferenceBases);
+    logger.logDatum("masked_reference_seeds", maskedReferenceSeeds);
+  }
+  if (perfCounters != NULL) {
+    perfCounters->logRegion(
+      logger, 0, "seed", seedsEmitted[0] + seedsEmitted[1], "seed");
+  }
 }
 
 void CloudBurstMapFunction::map(
   KeyValuePair& kvPair, KVPairWriterInterface& writer) {
+  seedWriter = &writer;
+  if (perfCounters != NULL) {
+    perfCounters->enter(0);
+  }
+  seed(kvPair);
+  if (perfCounters != NULL) {
+    perfCounters->leave();
+  }
+  seedWriter = NULL;
+}
 
+void CloudBurstMapFunction::seed(KeyValuePair& kvPair) {
+  if (skipBuffer) {
+    // These reads belong to another round
+    return;
+  }
   MerRecord seedInfo;
   DNAString dnaStringObj;
   byte* merInfo;
-  if (redundancy > 1) {
-    seedBuffer = new byte[(seedLen + 3)/4 + 2];
-  } else {
-    seedBuffer = new byte[(seedLen + 3)/4 + 1];
-  }
   // DNA sequences stores as KV Pair (id, Seqinfo)
   // Seqinfo is tuple (sequence, start_offset)
   // Map function emits KV pairs(seed, MerInfo)
@@ -46,71 +156,50 @@ void CloudBurstMapFunction::map(
   FastaRecord fastaRecord(kvPair.getValue(), kvPair.getValueLength());
   byte* seq = fastaRecord.sequence;
 
-  int32_t realOffsetStart = fastaRecord.offset;
+  int64_t realOffsetStart = fastaRecord.offset;
   bool isLast = fastaRecord.lastChunk;
   int32_t seqLen = fastaRecord.sequenceLength;
-  memcpy(&seedInfo.id, kvPair.getKey(), sizeof(seedInfo.id));
+  // Reference ids may be 8-byte keys for references with more than 2^31
+  // sequences. Alignments are keyed by 4-byte read id, so read ids may not.
+  if (isRef && kvPair.getKeyLength() == sizeof(int64_t)) {
+    memcpy(&seedInfo.id, kvPair.getKey(), sizeof(int64_t));
+  } else {
+    ABORT_IF(kvPair.getKeyLength() != sizeof(int32_t), "Expected a 4-byte "
+             "sequence id key, but got %u bytes", kvPair.getKeyLength());
+    int32_t narrowID;
+    memcpy(&narrowID, kvPair.getKey(), sizeof(narrowID));
+    seedInfo.id = narrowID;
+  }
 
   seedInfo.isReference = isRef;
   seedInfo.isRC = false;
 
-  if (isRef) {
-    // Sequence is chunk of the reference
-    int32_t startOffset = 0;
+  // Only the reference is masked; reads are always seeded in full
+  maskingChunk = isRef && lowComplexityMask.enabled();
+  if (maskingChunk) {
+    int32_t maskedBases = lowComplexityMask.maskChunk(
+      seedInfo.id, realOffsetStart, seq, seqLen);
+    logger.logDatum("masked_reference_bases", maskedBases);
+    maskedReferenceBases += maskedBases;
+  }
 
-    // If I'm not the first chunk, shift over so there is room for left flank
-    if (realOffsetStart != 0) {
-      startOffset = chunkOverlap + 1 - flankLen - seedLen;
-      realOffsetStart += startOffset;
+  if (!masks.empty()) {
+    mapSpacedSeeds(
+      seedInfo, dnaStringObj, seq, seqLen, realOffsetStart, isLast);
+    delete[] seq;
+    return;
+  }
+
+  // Keys carry the class index only if there is more than one class
+  bool tagClasses = lengthClasses.size() > 1;
+  if (isRef) {
+    // Sequence is chunk of the reference, which is seeded once per class
+    for (uint32_t c = 0; c < lengthClasses.size(); c++) {
+      mapReferenceClass(
+        lengthClasses[c], tagClasses, seedInfo, dnaStringObj, seq, seqLen,
+        realOffsetStart, isLast);
     }
-    // stop so the last mer will just fit
-    int32_t end = seqLen - seedLen + 1;
-    // If I'm not the last chunk, stop so the right flank will fit as well
-    if (!isLast) {
-      end -= flankLen;
-    }
-    // emit the mers starting at every position in the range
-    for (int32_t start = startOffset, realOffset = realOffsetStart;
-      start < end; start++, realOffset++) {
-      // don't bother with seeds with N's
-      // DNA is expressed as combination of A,D,G,C
-      if (dnaStringObj.arrHasN(seq, start, seedLen)) {
-        continue;
-      }
-      seedInfo.offset = realOffset;
-      // figure out the ranges for the flanking sequence
-      int32_t leftStart = start - flankLen;
-      if (leftStart < 0) {
-        leftStart = 0;
-      }
-      int32_t leftLen = start - leftStart;
-      int32_t rightStart = start + seedLen;
-      int32_t rightEnd = rightStart + flankLen;
-      if (rightEnd > seqLen) {
-        rightEnd = seqLen;
-      }
-      int32_t rightLen = rightEnd - rightStart;
-      KeyValuePair outputKVPair;
-      merInfo = seedInfo.toBytes(seq, leftStart, leftLen, rightStart, rightLen);
-      int32_t outputLen = seedInfo.toBytesLen(leftLen, rightLen);
-      outputKVPair.setValue(static_cast<byte*>(merInfo), outputLen);
-      if ((redundancy >1) && (dnaStringObj.repSeed(seq, start, seedLen))) {
-        for (uint32_t r = 0; r < redundancy; r++) {
-          int32_t length = dnaStringObj.arrToSeed
-            (seq, start, seedLen, seedBuffer, 0 , r , redundancy, 0);
-          outputKVPair.setKey(seedBuffer, length);
-          writer.write(outputKVPair);
-        }
-      } else {
-        int32_t length = dnaStringObj.arrToSeed(seq,
-          start, seedLen, seedBuffer, 0, 0, redundancy, 0);
-        outputKVPair.setKey(seedBuffer, length);
-        writer.write(outputKVPair);
-      }
-      delete[] merInfo;
-    }  // END OF FOR
     delete[] seq;
-    delete[] seedBuffer;
   } else {
     // Skip reads that can't possibly align end-to-end with<= K differences
     uint32_t numN = 0;
@@ -120,9 +209,19 @@ void CloudBurstMapFunction::map(
       }
     }
     if (numN > maxAlignDiff) {
+      ++readsDroppedForN;
+      delete[] seq;
       return;
     }
-    for (int32_t rc = 0; rc < 2 ; rc++) {
+    const ReadLengthClass& lengthClass =
+      lengthClasses[ReadLengthClass::classify(lengthClasses, seqLen)];
+    int32_t seedLen = lengthClass.seedLength();
+    int32_t tag = tagClasses ? lengthClass.index() : -1;
+    seedInfo.seedClass = lengthClass.index();
+    // Canonical seeds find alignments to both strands from the forward read,
+    // so the reverse complement is only seeded without them.
+    int32_t strands = canonicalSeeds ? 1 : 2;
+    for (int32_t rc = 0; rc < strands ; rc++) {
       if (rc == 1) {
         // reverse complement the sequence
         dnaStringObj.reverseComplementSequenceInPlace(seq, seqLen);
@@ -132,14 +231,19 @@ void CloudBurstMapFunction::map(
       for (int32_t i = 0; i + seedLen <= seqLen; i += seedLen) {
         int32_t len;
         if (dnaStringObj.arrHasN(seq, i, seedLen)) {
+          ++seedsSkippedForN[0];
           continue;
         }
+        bool isPalindrome;
+        seedInfo.isSeedRC =
+          useSeedRC(dnaStringObj, seq, i, seedLen, isPalindrome);
         if ((redundancy > 1) && (dnaStringObj.repSeed(seq, i, seedLen))) {
-          len = dnaStringObj.arrToSeed(seq, i,
-            seedLen, seedBuffer, 0, seedInfo.id, redundancy, 1);
+          len = encodeSeed(
+            dnaStringObj, seq, i, seedLen, seedInfo.id, 1, seedInfo.isSeedRC,
+            tag);
         } else {
-          len = dnaStringObj.arrToSeed(seq, i,
-            seedLen, seedBuffer, 0, 0, redundancy, 1);
+          len = encodeSeed(
+            dnaStringObj, seq, i, seedLen, 0, 1, seedInfo.isSeedRC, tag);
         }
         seedInfo.offset = i;
         // figure out the ranges for the flanking sequence
@@ -147,17 +251,272 @@ void CloudBurstMapFunction::map(
         int32_t leftLen = i;
         int32_t rightStart = i + seedLen;
         int32_t rightLen = seqLen - rightStart;
+        // A seed that is its own reverse complement shares its key with
+        // reference seeds on both strands, so emit it once for each strand.
+        int32_t copies = isPalindrome ? 2 : 1;
+        for (int32_t copy = 0; copy < copies; copy++) {
+          if (copy == 1) {
+            seedInfo.isSeedRC = true;
+          }
+          KeyValuePair outputKVPair;
+          int32_t outputLen;
+          if (storedReads) {
+            // The reducer takes the flanks from the read store
+            merInfo = seedInfo.toStubBytes(leftLen, rightLen);
+            outputLen = seedInfo.toStubBytesLen();
+          } else {
+            merInfo = seedInfo.toBytes(
+              seq, leftStart, leftLen, rightStart, rightLen);
+            outputLen = seedInfo.toBytesLen(
+              seq, leftStart, leftLen, rightStart, rightLen);
+          }
+          outputKVPair.setKey(seedBuffer, len);
+          outputKVPair.setValue(static_cast<uint8_t*>(merInfo), outputLen);
+          countAndEmitSeed(outputKVPair);
+          delete[] merInfo;
+        }
+      }
+    }
+    delete[] seq;
+  }
+}
+
+void CloudBurstMapFunction::mapSpacedSeeds(
+  MerRecord& seedInfo, DNAString& dnaStringObj, byte* seq, int32_t seqLen,
+  int64_t realOffsetStart, bool isLast) {
+  // Keys carry the mask index only if there is more than one mask
+  int32_t tagMasks = masks.size() > 1;
+  byte* merInfo;
+
+  if (isRef) {
+    // Same chunk layout as contiguous seeds, except that the right flank
+    // already covers the seed.
+    int32_t startOffset = 0;
+    if (realOffsetStart != 0) {
+      startOffset = chunkOverlap + 1 - spacedRightFlankLen;
+      realOffsetStart += startOffset;
+    }
+    int32_t end = seqLen;
+    if (!isLast) {
+      end = seqLen - spacedRightFlankLen + 1;
+    }
+    int64_t realOffset = realOffsetStart;
+    for (int32_t start = startOffset; start < end; start++, realOffset++) {
+      int32_t leftStart = std::max(start - spacedLeftFlankLen, 0);
+      int32_t leftLen = start - leftStart;
+      int32_t rightLen = std::min(start + spacedRightFlankLen, seqLen) - start;
+      if (deltaMode && !changedIntervals.overlaps(
+            seedInfo.id, realOffset - spacedLeftFlankLen,
+            realOffset + spacedRightFlankLen)) {
+        continue;
+      }
+      seedInfo.offset = realOffset;
+      for (uint32_t m = 0; m < masks.size(); m++) {
+        const SeedMask& mask = masks[m];
+        if (start + static_cast<int32_t>(mask.span()) > seqLen) {
+          continue;
+        }
+        if (dnaStringObj.arrHasN(seq, start, mask.care())) {
+          ++seedsSkippedForN[1];
+          continue;
+        }
+        if (maskingChunk && lowComplexityMask.masked(start, mask.span())) {
+          ++maskedReferenceSeeds;
+          continue;
+        }
+        seedInfo.seedClass = m;
         KeyValuePair outputKVPair;
-        merInfo = seedInfo.toBytes(
-          seq, leftStart, leftLen, rightStart, rightLen);
-        int32_t outputLen = seedInfo.toBytesLen(leftLen, rightLen);
-        outputKVPair.setKey(seedBuffer, len);
-        outputKVPair.setValue(static_cast<uint8_t*>(merInfo), outputLen);
-        writer.write(outputKVPair);
+        merInfo = seedInfo.toBytes(seq, leftStart, leftLen, start, rightLen);
+        outputKVPair.setValue(merInfo, seedInfo.toBytesLen(
+          seq, leftStart, leftLen, start, rightLen));
+        uint32_t copies = 1;
+        if (redundancy > 1 && dnaStringObj.repSeed(seq, start, mask.care())) {
+          copies = redundancy;
+          redundantSeedCopies += redundancy - 1;
+        }
+        for (uint32_t r = 0; r < copies; r++) {
+          int32_t length = dnaStringObj.arrToSpacedSeed(
+            seq, start, mask.care(), seedBuffer, 0, r, redundancy, 0,
+            tagMasks ? m : -1);
+          outputKVPair.setKey(seedBuffer, length);
+          countAndEmitSeed(outputKVPair);
+        }
         delete[] merInfo;
       }
     }
-    delete[] seq;
-    delete[] seedBuffer;
+  } else {
+    uint32_t numN = 0;
+    for (int32_t i = 0; i < seqLen; i++) {
+      if (seq[i] == 'N') {
+        numN++;
+      }
+    }
+    if (numN > maxAlignDiff) {
+      ++readsDroppedForN;
+      return;
+    }
+    // Every window of the read is a seed. The reducer keeps an alignment only
+    // for the first window, by position and then mask, that matches exactly.
+    for (int32_t rc = 0; rc < 2; rc++) {
+      if (rc == 1) {
+        dnaStringObj.reverseComplementSequenceInPlace(seq, seqLen);
+        seedInfo.isRC = true;
+      }
+      for (int32_t i = 0; i < seqLen; i++) {
+        seedInfo.offset = i;
+        for (uint32_t m = 0; m < masks.size(); m++) {
+          const SeedMask& mask = masks[m];
+          if (i + static_cast<int32_t>(mask.span()) > seqLen) {
+            continue;
+          }
+          if (dnaStringObj.arrHasN(seq, i, mask.care())) {
+            ++seedsSkippedForN[0];
+            continue;
+          }
+          int32_t id = 0;
+          if (redundancy > 1 && dnaStringObj.repSeed(seq, i, mask.care())) {
+            id = seedInfo.id % redundancy;
+          }
+          int32_t length = dnaStringObj.arrToSpacedSeed(
+            seq, i, mask.care(), seedBuffer, 0, id, redundancy, 1,
+            tagMasks ? m : -1);
+          seedInfo.seedClass = m;
+          KeyValuePair outputKVPair;
+          outputKVPair.setKey(seedBuffer, length);
+          if (storedReads) {
+            merInfo = seedInfo.toStubBytes(i, seqLen - i);
+            outputKVPair.setValue(merInfo, seedInfo.toStubBytesLen());
+          } else {
+            merInfo = seedInfo.toBytes(seq, 0, i, i, seqLen - i);
+            outputKVPair.setValue(
+              merInfo, seedInfo.toBytesLen(seq, 0, i, i, seqLen - i));
+          }
+          countAndEmitSeed(outputKVPair);
+          delete[] merInfo;
+        }
+      }
+    }
   }
 }
+
+void CloudBurstMapFunction::mapReferenceClass(
+  const ReadLengthClass& lengthClass, bool tagClasses, MerRecord& seedInfo,
+  DNAString& dnaStringObj, byte* seq, int32_t seqLen, int64_t realOffsetStart,
+  bool isLast) {
+  int32_t seedLen = lengthClass.seedLength();
+  int32_t flankLen = lengthClass.flankLength();
+  int32_t tag = tagClasses ? lengthClass.index() : -1;
+  seedInfo.seedClass = lengthClass.index();
+  byte* merInfo;
+  int32_t startOffset = 0;
+
+  // If I'm not the first chunk, shift over so there is room for left flank
+  if (realOffsetStart != 0) {
+    startOffset = chunkOverlap + 1 - flankLen - seedLen;
+    realOffsetStart += startOffset;
+  }
+  // stop so the last mer will just fit
+  int32_t end = seqLen - seedLen + 1;
+  // If I'm not the last chunk, stop so the right flank will fit as well
+  if (!isLast) {
+    end -= flankLen;
+  }
+  // emit the mers starting at every position in the range
+  int64_t realOffset = realOffsetStart;
+  for (int32_t start = startOffset; start < end; start++, realOffset++) {
+    // don't bother with seeds with N's
+    // DNA is expressed as combination of A,D,G,C
+    if (dnaStringObj.arrHasN(seq, start, seedLen)) {
+      ++seedsSkippedForN[1];
+      continue;
+    }
+    if (maskingChunk && lowComplexityMask.masked(start, seedLen)) {
+      ++maskedReferenceSeeds;
+      continue;
+    }
+    // In delta mode, only seeds whose flanks reach a changed region can
+    // find alignments that differ from the previous reference's
+    if (deltaMode && !changedIntervals.overlaps(
+          seedInfo.id, realOffset - flankLen,
+          realOffset + seedLen + flankLen)) {
+      continue;
+    }
+    seedInfo.offset = realOffset;
+    bool isPalindrome;
+    seedInfo.isSeedRC =
+      useSeedRC(dnaStringObj, seq, start, seedLen, isPalindrome);
+    // figure out the ranges for the flanking sequence
+    int32_t leftStart = start - flankLen;
+    if (leftStart < 0) {
+      leftStart = 0;
+    }
+    int32_t leftLen = start - leftStart;
+    int32_t rightStart = start + seedLen;
+    int32_t rightEnd = rightStart + flankLen;
+    if (rightEnd > seqLen) {
+      rightEnd = seqLen;
+    }
+    int32_t rightLen = rightEnd - rightStart;
+    KeyValuePair outputKVPair;
+    merInfo = seedInfo.toBytes(seq, leftStart, leftLen, rightStart, rightLen);
+    int32_t outputLen = seedInfo.toBytesLen(
+      seq, leftStart, leftLen, rightStart, rightLen);
+    outputKVPair.setValue(static_cast<byte*>(merInfo), outputLen);
+    if ((redundancy >1) && (dnaStringObj.repSeed(seq, start, seedLen))) {
+      redundantSeedCopies += redundancy - 1;
+      for (uint32_t r = 0; r < redundancy; r++) {
+        int32_t length = encodeSeed(
+          dnaStringObj, seq, start, seedLen, r, 0, seedInfo.isSeedRC, tag);
+        outputKVPair.setKey(seedBuffer, length);
+        countAndEmitSeed(outputKVPair);
+      }
+    } else {
+      int32_t length = encodeSeed(
+        dnaStringObj, seq, start, seedLen, 0, 0, seedInfo.isSeedRC, tag);
+      outputKVPair.setKey(seedBuffer, length);
+      countAndEmitSeed(outputKVPair);
+    }
+    delete[] merInfo;
+  }
+}
+
+bool CloudBurstMapFunction::useSeedRC(
+  DNAString& dnaStringObj, byte* seq, int32_t start, int32_t seedLen,
+  bool& isPalindrome) {
+  isPalindrome = false;
+  if (!canonicalSeeds) {
+    return false;
+  }
+  // Seeds pack 2 bits per base in A < C < G < T order, so comparing the
+  // packed bytes compares the seeds lexicographically.
+  dnaStringObj.arrToSeed(seq, start, seedLen, seedBuffer, 0, 0, 1, 0);
+  dnaStringObj.arrToSeedRC(seq, start, seedLen, rcSeedBuffer, 0, 0, 1, 0);
+  int comparison = memcmp(rcSeedBuffer, seedBuffer, (seedLen + 3)/4);
+  isPalindrome = comparison == 0;
+  return comparison < 0;
+}
+
+int32_t CloudBurstMapFunction::encodeSeed(
+  DNAString& dnaStringObj, byte* seq, int32_t start, int32_t seedLen,
+  int64_t id, int32_t isQuery, bool rc, int32_t tag) {
+  // Only the id's residue picks the redundant copy
+  int32_t copy = id % redundancy;
+  if (rc) {
+    return dnaStringObj.arrToSeedRC(
+      seq, start, seedLen, seedBuffer, 0, copy, redundancy, isQuery, tag);
+  }
+  return dnaStringObj.arrToSeed(
+    seq, start, seedLen, seedBuffer, 0, copy, redundancy, isQuery, tag);
+}
+
+void CloudBurstMapFunction::countAndEmitSeed(KeyValuePair& seedTuple) {
+  ++seedsEmitted[isRef];
+  seedBytesEmitted[isRef] +=
+    seedTuple.getKeyLength() + seedTuple.getValueLength();
+  emitSeed(seedTuple);
+}
+
+void CloudBurstMapFunction::emitSeed(KeyValuePair& seedTuple) {
+  ASSERT(seedWriter != NULL, "Seed tuples can only be written from map()");
+  seedWriter->write(seedTuple);
+}
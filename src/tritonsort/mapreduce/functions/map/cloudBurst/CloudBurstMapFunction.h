@@ -3,8 +3,15 @@
 
 #include "DNAString.h"
 #include "FastaRecord.h"
+#include "LowComplexityMask.h"
 #include "MerRecord.h"
+#include "PerfCounters.h"
+#include "ReadLengthClass.h"
+#include "ReferenceIntervalSet.h"
+#include "SeedMask.h"
+#include "core/StatLogger.h"
 #include "mapreduce/functions/map/MapFunction.h"
+#include "mapreduce/functions/reduce/cloudBurst/ReferenceCache.h"
 
 /**
    CloudBurst map function and associated helper classes based on the
@@ -13,22 +20,229 @@
  */
 class CloudBurstMapFunction : public MapFunction {
 public:
+  /// Constructor
+  /**
+     \param _maxAlignDiff the maximum number of differences to allow
+
+     \param _redundancy the number of copies of low complexity seeds to use
+
+     \param _minReadLen the length of the shortest read
+
+     \param _maxReadLen the length of the longest read
+
+     \param _canonicalSeeds if true, key every seed by the smaller of itself
+     and its reverse complement and seed each read only once; the reducer
+     orients the flanks when the strands differ
+
+     \param _seedMasks a comma-separated list of spaced seed masks such as
+     "110110110111,111011001011", or an empty string for contiguous seeds.
+     Spaced seeds are taken from every position of each read rather than from
+     K+1 disjoint windows. \sa SeedMask
+
+     \param _readLengthClasses a comma-separated list of the longest read
+     length in every read length class but the last, or an empty string for a
+     single class. \sa ReadLengthClass
+
+     \param _querySource if not empty, only query buffers whose file names
+     contain this string are seeded, so a later round of an iterative job can
+     take the reference from the original input and the reads still to be
+     aligned from the previous round
+
+     \param referenceCacheMode the reducer's reference cache mode; in "read"
+     mode the reducer takes the reference from the cache, so reference
+     buffers are dropped. \sa ReferenceCache
+
+     \param changedIntervalsFile if not empty, a file of the reference
+     intervals that changed since a previous alignment, and the map function
+     runs in delta mode: only reference seeds whose flanks reach a changed
+     interval are emitted, so only reads that may align differently are
+     re-aligned. \sa ReferenceIntervalSet
+
+     \param readStoreFile if not empty, the ReadStore the reducer takes reads
+     from, and query tuples are emitted as stubs without flanks. \sa
+     MerRecord::toStubBytes
+
+     \param dustThreshold if not 0, reference seeds in windows whose DUST
+     score is above this are not emitted. \sa LowComplexityMask
+
+     \param repeatMaskFile if not empty, a file of reference intervals whose
+     seeds are not emitted. \sa LowComplexityMask
+
+     \param perfCounters if true, count cycles, instructions, cache misses
+     and branch misses in map() with hardware counters. \sa PerfCounters
+   */
   CloudBurstMapFunction(
     uint32_t _maxAlignDiff, uint32_t _redundancy, int32_t _minReadLen,
-    int32_t _maxReadLen);
+    int32_t _maxReadLen, bool _canonicalSeeds, const std::string& _seedMasks,
+    const std::string& _readLengthClasses, const std::string& _querySource,
+    const std::string& referenceCacheMode,
+    const std::string& changedIntervalsFile,
+    const std::string& readStoreFile, uint32_t dustThreshold,
+    const std::string& repeatMaskFile, bool perfCounters);
+
+  /// Destructor
+  virtual ~CloudBurstMapFunction();
+
+  /// \sa MapFunction::map
+  void map(KeyValuePair& kvPair, KVPairWriterInterface& writer);
+
+  /**
+     Seed one sequence, passing every seed tuple to emitSeed().
+
+     \param kvPair the sequence's id and FastaRecord
+   */
+  void seed(KeyValuePair& kvPair);
+
+  /// Decide from the buffer's file name which side its sequences are on.
+  void configure(KVPairBuffer* buffer);
+
+  /**
+     Decide which side the sequences that follow are on, and whether they
+     are seeded at all.
+
+     \param fileName the name of the file the sequences come from; files
+     whose names contain "ref" hold the reference
+   */
+  void configureSource(const std::string& fileName);
+
+  /// Log seeding and masking statistics
+  void teardown(KVPairWriterInterface& writer);
+
+protected:
+  /**
+     Emit a seed tuple. The default writes it to the writer passed to map();
+     subclasses may consume seed tuples themselves instead of shuffling them.
+
+     \param seedTuple the seed tuple
+   */
+  virtual void emitSeed(KeyValuePair& seedTuple);
+
 private:
+  /**
+     Emit a contiguous seed tuple at every position of a reference chunk,
+     with the seed and flank lengths of one read length class.
+
+     \param lengthClass the class to seed for
+
+     \param tagClasses true if keys carry the class index
+
+     \param seedInfo the MerRecord describing the chunk, with its id set
+
+     \param dnaStringObj the DNAString used for encoding
+
+     \param seq the chunk's sequence
+
+     \param seqLen the length of the chunk
+
+     \param realOffsetStart the offset of the chunk in the reference
+
+     \param isLast true if this is the last chunk of the reference
+   */
+  void mapReferenceClass(
+    const ReadLengthClass& lengthClass, bool tagClasses, MerRecord& seedInfo,
+    DNAString& dnaStringObj, byte* seq, int32_t seqLen,
+    int64_t realOffsetStart, bool isLast);
+
+  /**
+     Emit a spaced seed tuple for every mask at every position of a reference
+     chunk or read.
+
+     \param seedInfo the MerRecord describing the sequence, with its id and
+     strand set
+
+     \param dnaStringObj the DNAString used for encoding
+
+     \param seq the sequence
+
+     \param seqLen the length of the sequence
+
+     \param realOffsetStart the offset of a reference chunk in the reference
+
+     \param isLast true if this is the last chunk of a reference
+   */
+  void mapSpacedSeeds(
+    MerRecord& seedInfo, DNAString& dnaStringObj, byte* seq, int32_t seqLen,
+    int64_t realOffsetStart, bool isLast);
+
+  /**
+     Decide whether a seed is keyed by its reverse complement.
+
+     \param dnaStringObj the DNAString used for encoding
+
+     \param seq the sequence holding the seed
+
+     \param start the position of the seed in seq
+
+     \param seedLen the length of the seed
+
+     \param[out] isPalindrome set if the seed is its own reverse complement
+
+     \return true if canonical seeds are in use and the seed's reverse
+     complement is smaller than the seed
+   */
+  bool useSeedRC(
+    DNAString& dnaStringObj, byte* seq, int32_t start, int32_t seedLen,
+    bool& isPalindrome);
+
+  /**
+     Count a seed tuple and pass it to emitSeed().
+
+     \param seedTuple the seed tuple
+   */
+  void countAndEmitSeed(KeyValuePair& seedTuple);
+
+  /**
+     Encode a seed or its reverse complement into seedBuffer, followed by the
+     tag byte if tag is not negative.
+
+     \return the length of the encoded key
+   */
+  int32_t encodeSeed(
+    DNAString& dnaStringObj, byte* seq, int32_t start, int32_t seedLen,
+    int64_t id, int32_t isQuery, bool rc, int32_t tag);
+
   uint32_t chunkOverlap;
-  uint32_t flankLen;
   uint32_t maxAlignDiff;
   uint32_t maxReadLen;
   uint32_t minReadLen;
   uint32_t  redundancy;
-  int32_t seedLen;
+  std::vector<ReadLengthClass> lengthClasses;
+  int32_t seedBufferLength;
+  // Spaced seed masks, if any, and the flank lengths they need. The right
+  // flank of a spaced seed starts at the seed itself, so the reducer verifies
+  // its don't-care positions.
+  std::vector<SeedMask> masks;
+  int32_t spacedLeftFlankLen;
+  int32_t spacedRightFlankLen;
+  // Seed keys are encoded here, in buffers of seedBufferLength bytes
   unsigned char* seedBuffer;
+  unsigned char* rcSeedBuffer;
+  bool canonicalSeeds;
   bool isRef;
+  bool skipBuffer;
+  std::string querySource;
+  bool skipReference;
+  bool deltaMode;
+  ReferenceIntervalSet changedIntervals;
+  bool storedReads;
+  // Reference seeds overlapping masked bases of the chunk being seeded are
+  // dropped. Each chunk's masked bases are logged as it is masked.
+  LowComplexityMask lowComplexityMask;
+  bool maskingChunk;
+  StatLogger logger;
+  uint64_t maskedReferenceBases;
+  uint64_t maskedReferenceSeeds;
+  // Seeding statistics, indexed by isRef where there is one per side
+  uint64_t seedsEmitted[2];
+  uint64_t seedBytesEmitted[2];
+  uint64_t seedsSkippedForN[2];
+  uint64_t redundantSeedCopies;
+  uint64_t readsDroppedForN;
+  // Hardware counters for map(), or NULL if they are off
+  PerfCounters* perfCounters;
   std::string refPath;
-  void map(KeyValuePair& kvPair, KVPairWriterInterface& writer);
-  void configure(KVPairBuffer* buffer);
+  // The writer of the current map() call
+  KVPairWriterInterface* seedWriter;
 };
 
 #endif  // MAPRED_CLOUD_BURST_MAP_FUNCTION_H
@@ -0,0 +1,66 @@
+#include "CloudBurstPatchMapFunction.h"
+#include "mapreduce/common/KeyValuePair.h"
+
+CloudBurstPatchMapFunction::CloudBurstPatchMapFunction(
+  const std::string& changedIntervalsFile, const std::string& _deltaSource)
+  : deltaSource(_deltaSource),
+    isDelta(false),
+    logger("CloudBurstPatchMapFunction"),
+    previousAlignmentsKept(0),
+    previousAlignmentsInvalidated(0),
+    deltaAlignmentsKept(0),
+    deltaAlignmentsDropped(0) {
+  ABORT_IF(changedIntervalsFile.empty(), "CloudBurst alignment patching needs "
+           "the file of changed reference intervals");
+  ABORT_IF(deltaSource.empty(), "CloudBurst alignment patching needs the name "
+           "of the delta alignment input");
+  changedIntervals.load(changedIntervalsFile);
+}
+
+void CloudBurstPatchMapFunction::configure(KVPairBuffer* buffer) {
+  const std::string &fileName = buffer->getSourceName();
+  ABORT_IF(fileName.empty(),
+           "CloudBurst requires a FileByteStreamConverter to set filenames on "
+           "map input buffers");
+  isDelta = fileName.find(deltaSource, 0) != std::string::npos;
+}
+
+void CloudBurstPatchMapFunction::map(
+  KeyValuePair& kvPair, KVPairWriterInterface& writer) {
+  ABORT_IF(kvPair.getKeyLength() != sizeof(int32_t), "Expected a %u byte read "
+           "id key, but got %u bytes", static_cast<uint32_t>(sizeof(int32_t)),
+           kvPair.getKeyLength());
+  ABORT_IF(kvPair.getValueLength() == 0 ||
+           kvPair.getValueLength() != static_cast<uint64_t>(
+             AlignmentRecord::sizeOf(kvPair.getValue()[0])),
+           "Expected an alignment record, but got %llu bytes; patching needs "
+           "alignments in the records format", kvPair.getValueLength());
+  alignment.fromBytes(kvPair.getValue());
+
+  if (!alignment.isRepetitiveMarker()) {
+    bool changed = changedIntervals.overlaps(
+      alignment.refID, alignment.refStart, alignment.refEnd);
+    if (isDelta) {
+      if (!changed) {
+        deltaAlignmentsDropped++;
+        return;
+      }
+      deltaAlignmentsKept++;
+    } else {
+      if (changed) {
+        previousAlignmentsInvalidated++;
+        return;
+      }
+      previousAlignmentsKept++;
+    }
+  }
+  writer.write(kvPair);
+}
+
+void CloudBurstPatchMapFunction::teardown(KVPairWriterInterface& writer) {
+  logger.logDatum("previous_alignments_kept", previousAlignmentsKept);
+  logger.logDatum(
+    "previous_alignments_invalidated", previousAlignmentsInvalidated);
+  logger.logDatum("delta_alignments_kept", deltaAlignmentsKept);
+  logger.logDatum("delta_alignments_dropped", deltaAlignmentsDropped);
+}
@@ -0,0 +1,57 @@
+#ifndef MAPRED_CLOUD_BURST_PATCH_MAP_FUNCTION_H
+#define MAPRED_CLOUD_BURST_PATCH_MAP_FUNCTION_H
+
+#include <string>
+
+#include "core/StatLogger.h"
+#include "mapreduce/functions/map/MapFunction.h"
+#include "mapreduce/functions/map/cloudBurst/ReferenceIntervalSet.h"
+#include "mapreduce/functions/reduce/cloudBurst/AlignmentRecord.h"
+
+/**
+   Map side of the job that patches the alignments of a previous reference
+   assembly with the alignments of a delta mode CloudBurst job against the
+   updated assembly (see CloudBurstMapFunction).
+
+   Both inputs are alignment records keyed by read id. A previous alignment
+   that overlaps a changed interval is invalidated and dropped, and every
+   other one is kept. A delta alignment is kept only if it overlaps a changed
+   interval, since the rest were already found against the previous
+   assembly. Repetitive read markers are always kept.
+ */
+class CloudBurstPatchMapFunction : public MapFunction {
+public:
+  /// Constructor
+  /**
+     \param changedIntervalsFile the file of reference intervals that changed
+     between the assemblies. \sa ReferenceIntervalSet
+
+     \param deltaSource input files whose names contain this string hold the
+     delta job's alignments; all others hold previous alignments
+   */
+  CloudBurstPatchMapFunction(
+    const std::string& changedIntervalsFile, const std::string& deltaSource);
+
+  /// Find out whether the buffer holds previous or delta alignments
+  void configure(KVPairBuffer* buffer);
+
+  /// \sa MapFunction::map
+  void map(KeyValuePair& kvPair, KVPairWriterInterface& writer);
+
+  /// Log how many alignments were kept and dropped
+  void teardown(KVPairWriterInterface& writer);
+
+private:
+  const std::string deltaSource;
+  ReferenceIntervalSet changedIntervals;
+  AlignmentRecord alignment;
+  bool isDelta;
+
+  StatLogger logger;
+  uint64_t previousAlignmentsKept;
+  uint64_t previousAlignmentsInvalidated;
+  uint64_t deltaAlignmentsKept;
+  uint64_t deltaAlignmentsDropped;
+};
+
+#endif  // MAPRED_CLOUD_BURST_PATCH_MAP_FUNCTION_H
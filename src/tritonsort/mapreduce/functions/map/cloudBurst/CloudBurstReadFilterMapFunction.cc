@@ -0,0 +1,50 @@
+#include <string.h>
+
+#include "CloudBurstReadFilterMapFunction.h"
+#include "mapreduce/common/KeyValuePair.h"
+
+const uint8_t CloudBurstReadFilterMapFunction::ALIGNMENT_FLAG;
+const uint8_t CloudBurstReadFilterMapFunction::READ_FLAG;
+
+CloudBurstReadFilterMapFunction::CloudBurstReadFilterMapFunction(
+  const std::string& _alignmentSource)
+  : alignmentSource(_alignmentSource),
+    isRef(false),
+    isAlignment(false) {
+  ABORT_IF(alignmentSource.empty(), "CloudBurst read filtering needs the name "
+           "of the alignment input");
+}
+
+void CloudBurstReadFilterMapFunction::configure(KVPairBuffer* buffer) {
+  const std::string &fileName = buffer->getSourceName();
+  ABORT_IF(fileName.empty(),
+           "CloudBurst requires a FileByteStreamConverter to set filenames on "
+           "map input buffers");
+  isAlignment = fileName.find(alignmentSource, 0) != std::string::npos;
+  isRef = !isAlignment && fileName.find("ref", 0) != std::string::npos;
+}
+
+void CloudBurstReadFilterMapFunction::map(
+  KeyValuePair& kvPair, KVPairWriterInterface& writer) {
+  if (isRef) {
+    return;
+  }
+
+  int32_t readID;
+  ABORT_IF(kvPair.getKeyLength() != sizeof(readID), "Expected a %u byte read "
+           "id key, but got %u bytes", static_cast<uint32_t>(sizeof(readID)),
+           kvPair.getKeyLength());
+
+  uint8_t key[sizeof(readID) + 1];
+  memcpy(key, kvPair.getKey(), sizeof(readID));
+  key[sizeof(readID)] = isAlignment ? ALIGNMENT_FLAG : READ_FLAG;
+
+  KeyValuePair outputKVPair;
+  outputKVPair.setKey(key, sizeof(key));
+  if (isAlignment) {
+    outputKVPair.setValue(NULL, 0);
+  } else {
+    outputKVPair.setValue(kvPair.getValue(), kvPair.getValueLength());
+  }
+  writer.write(outputKVPair);
+}
@@ -0,0 +1,47 @@
+#ifndef MAPRED_CLOUD_BURST_READ_FILTER_MAP_FUNCTION_H
+#define MAPRED_CLOUD_BURST_READ_FILTER_MAP_FUNCTION_H
+
+#include <string>
+
+#include "mapreduce/functions/map/MapFunction.h"
+
+/**
+   Map side of the job that runs between rounds of an iterative CloudBurst
+   job and finds the reads a round failed to align.
+
+   The input is the round's reads, keyed by read id, and the round's
+   alignments, which CloudBurstReduceFunction keys by the id of the aligned
+   read. Both are re-keyed by read id followed by a flag byte, 0 for an
+   alignment and 1 for a read, so that a read's alignments sort just before
+   it and CloudburstPartitionFunction, which ignores the last byte, sends
+   them to the same reducer. Reference records are dropped, and alignments
+   are emitted without their values since only their presence matters.
+ */
+class CloudBurstReadFilterMapFunction : public MapFunction {
+public:
+  /// Key flag of an alignment
+  static const uint8_t ALIGNMENT_FLAG = 0;
+
+  /// Key flag of a read
+  static const uint8_t READ_FLAG = 1;
+
+  /// Constructor
+  /**
+     \param alignmentSource input files whose names contain this string hold
+     alignments; all other files that are not reference files hold reads
+   */
+  CloudBurstReadFilterMapFunction(const std::string& alignmentSource);
+
+  /// Find out whether the buffer holds reference, read or alignment records
+  void configure(KVPairBuffer* buffer);
+
+  /// \sa MapFunction::map
+  void map(KeyValuePair& kvPair, KVPairWriterInterface& writer);
+
+private:
+  const std::string alignmentSource;
+  bool isRef;
+  bool isAlignment;
+};
+
+#endif  // MAPRED_CLOUD_BURST_READ_FILTER_MAP_FUNCTION_H
@@ -146,10 +146,11 @@ int32_t DNAString::arrToSeedLen(int32_t len, int32_t REDUNDANCY) {
 }
 
 //  arrTOseed
-//  change sequence to seed type for next phase
+//  change sequence to seed type for next phase. If TAG is not negative it is
+//  written as an extra key byte ahead of the redundancy and ref/qry bytes.
 int32_t DNAString::arrToSeed(
   byte* arr, int32_t arrPos, int32_t len, byte* seed, int32_t seedPos,
-  int32_t id, int32_t REDUNDANCY, int32_t ISQRY) {
+  int32_t id, int32_t REDUNDANCY, int32_t ISQRY, int32_t TAG) {
 
   int32_t seedlen = (len+3)/4+1;
   int32_t arrend = arrPos + len;
@@ -178,6 +179,78 @@ int32_t DNAString::arrToSeed(
     seedPos++;
   }
 
+  if (TAG >= 0) {
+    seed[seedPos] = (byte) (TAG & 0xFF);
+    seedPos++;
+    seedlen++;
+  }
+  if (REDUNDANCY > 1) {
+    seed[seedPos] = (byte) ((id % REDUNDANCY) & 0xFF);
+    seedPos++;
+    seedlen++;
+  }
+  seed[seedPos] = (byte) ISQRY;
+  return seedlen;
+}
+
+//  arrToSeedRC
+//  Like arrToSeed, but encodes the reverse complement of the sequence. With
+//  2 bits per base the complement of a base is 3 minus its code.
+int32_t DNAString::arrToSeedRC(
+  byte* arr, int32_t arrPos, int32_t len, byte* seed, int32_t seedPos,
+  int32_t id, int32_t REDUNDANCY, int32_t ISQRY, int32_t TAG) {
+
+  int32_t seedlen = (len+3)/4+1;
+  int32_t arrLast = arrPos + len - 1;
+  for (int32_t i = 0; i < len; i += 4) {
+    byte packed = 0;
+    for (int32_t j = 0; j < 4 && i + j < len; j++) {
+      packed |= (3 - byteToSeed(arr[arrLast - i - j])) << (6 - 2 * j);
+    }
+    seed[seedPos] = packed;
+    seedPos++;
+  }
+
+  if (TAG >= 0) {
+    seed[seedPos] = (byte) (TAG & 0xFF);
+    seedPos++;
+    seedlen++;
+  }
+  if (REDUNDANCY > 1) {
+    seed[seedPos] = (byte) ((id % REDUNDANCY) & 0xFF);
+    seedPos++;
+    seedlen++;
+  }
+  seed[seedPos] = (byte) ISQRY;
+  return seedlen;
+}
+
+//  arrToSpacedSeed
+//  Like arrToSeed, but only packs the bases at the care offsets of a spaced
+//  seed mask. If TAG is not negative it is written as an extra key byte ahead
+//  of the redundancy and ref/qry bytes, so seeds of different masks don't
+//  share keys.
+int32_t DNAString::arrToSpacedSeed(
+  byte* arr, int32_t arrPos, const std::vector<int32_t>& care, byte* seed,
+  int32_t seedPos, int32_t id, int32_t REDUNDANCY, int32_t ISQRY,
+  int32_t TAG) {
+
+  int32_t len = care.size();
+  int32_t seedlen = (len+3)/4+1;
+  for (int32_t i = 0; i < len; i += 4) {
+    byte packed = 0;
+    for (int32_t j = 0; j < 4 && i + j < len; j++) {
+      packed |= byteToSeed(arr[arrPos + care[i + j]]) << (6 - 2 * j);
+    }
+    seed[seedPos] = packed;
+    seedPos++;
+  }
+
+  if (TAG >= 0) {
+    seed[seedPos] = (byte) (TAG & 0xFF);
+    seedPos++;
+    seedlen++;
+  }
   if (REDUNDANCY > 1) {
     seed[seedPos] = (byte) ((id % REDUNDANCY) & 0xFF);
     seedPos++;
@@ -199,6 +272,19 @@ bool DNAString::repSeed(byte* sequence, int32_t start, int32_t SEED_LEN) {
   return true;
 }
 
+//  check if the care positions of a spaced seed are bunch of repeats
+bool DNAString::repSeed(
+  byte* sequence, int32_t start, const std::vector<int32_t>& care) {
+  byte first = sequence[start + care[0]];
+
+  for (uint32_t i = 1; i < care.size(); i++) {
+    if (sequence[start + care[i]] != first) {
+      return false;
+    }
+  }
+  return true;
+}
+
 //  seedToDNAStr
 byte* DNAString::seedToArr(byte* seed, int32_t SEEDLEN, int32_t REDUNDANCY) {
   byte* retval = new (themis::memcheck) byte[SEEDLEN];
@@ -275,6 +361,76 @@ int32_t DNAString::arrToDNAStrRev(
   return dnaLen;
 }
 
+//  arrToPackedLen
+//  Bytes needed to pack len bases at 2 bits per base
+int32_t DNAString::arrToPackedLen(int32_t len) {
+  return (len + 3)/4;
+}
+
+//  arrToPacked
+//  Pack bases 2 bits per base, first base in the high bits. N's are packed as
+//  A's; callers record their positions separately.
+int32_t DNAString::arrToPacked(
+  byte* arr, int32_t arrPos, int32_t len, byte* out, int32_t outPos) {
+  int32_t packedLen = arrToPackedLen(len);
+  int32_t arrend = arrPos + len;
+  while (arrPos + 3 < arrend) {
+    out[outPos] = (byte) ((byteToSeed(arr[arrPos]) << 6) |
+      (byteToSeed(arr[arrPos+1]) << 4) |
+      (byteToSeed(arr[arrPos+2]) << 2) |
+      (byteToSeed(arr[arrPos+3])));
+    outPos++;
+    arrPos += 4;
+  }
+  if (arrPos < arrend) {
+    byte last = 0;
+    for (int32_t shift = 6; arrPos < arrend; arrPos++, shift -= 2) {
+      last |= byteToSeed(arr[arrPos]) << shift;
+    }
+    out[outPos] = last;
+  }
+  return packedLen;
+}
+
+//  arrToPackedRev
+//  Pack bases 2 bits per base starting from the end of the range
+int32_t DNAString::arrToPackedRev(
+  byte* arr, int32_t arrStart, int32_t len, byte* out, int32_t outPos) {
+  int32_t packedLen = arrToPackedLen(len);
+  int32_t arrPos = arrStart + len - 1;
+  while (arrPos - 3 >= arrStart) {
+    out[outPos] = (byte) ((byteToSeed(arr[arrPos]) << 6) |
+      (byteToSeed(arr[arrPos-1]) << 4) |
+      (byteToSeed(arr[arrPos-2]) << 2) |
+      (byteToSeed(arr[arrPos-3])));
+    outPos++;
+    arrPos -= 4;
+  }
+  if (arrPos >= arrStart) {
+    byte last = 0;
+    for (int32_t shift = 6; arrPos >= arrStart; arrPos--, shift -= 2) {
+      last |= byteToSeed(arr[arrPos]) << shift;
+    }
+    out[outPos] = last;
+  }
+  return packedLen;
+}
+
+//  packedToArr
+//  Unpack len 2-bit bases into letters, restoring N's from the exception list
+//  of unaligned uint16_t positions
+void DNAString::packedToArr(
+  const byte* packed, int32_t len, const byte* exceptions,
+  int32_t numExceptions, byte* out) {
+  for (int32_t i = 0; i < len; i++) {
+    out[i] = seedToByte(packed[i / 4] >> (6 - 2 * (i % 4)));
+  }
+  for (int32_t i = 0; i < numExceptions; i++) {
+    uint16_t position;
+    memcpy(&position, exceptions + i * sizeof(position), sizeof(position));
+    out[position] = 'N';
+  }
+}
 
 byte* DNAString::arrToDNA(byte* arr, int32_t start, int32_t len) {
   int32_t dnaLen = (len + 1)/2;
@@ -345,3 +501,14 @@ bool DNAString::arrHasN(byte* sequence, int32_t start, int32_t len) {
   }
   return false;
 }
+
+//  check if any care position of a spaced seed is an N
+bool DNAString::arrHasN(
+  byte* sequence, int32_t start, const std::vector<int32_t>& care) {
+  for (uint32_t i = 0; i < care.size(); i++) {
+    if (letterToDNA[sequence[start + care[i]]] == dnaN) {
+      return true;
+    }
+  }
+  return false;
+}
@@ -4,6 +4,7 @@
 #include<stdio.h>
 #include<stdint.h>
 #include<string>
+#include<vector>
 
 typedef uint8_t byte;
 class DNAString {
@@ -39,13 +40,29 @@ public:
   int32_t arrToSeedLen(int32_t len, int32_t REDUNDANCY);
   int32_t arrToSeed(
     byte* arr, int32_t arrpos, int32_t len, byte* seed, int32_t seedpos,
-    int32_t id, int32_t REDUNDANCY, int32_t ISQRY);
+    int32_t id, int32_t REDUNDANCY, int32_t ISQRY, int32_t TAG = -1);
+  int32_t arrToSeedRC(
+    byte* arr, int32_t arrpos, int32_t len, byte* seed, int32_t seedpos,
+    int32_t id, int32_t REDUNDANCY, int32_t ISQRY, int32_t TAG = -1);
+  int32_t arrToSpacedSeed(
+    byte* arr, int32_t arrpos, const std::vector<int32_t>& care, byte* seed,
+    int32_t seedpos, int32_t id, int32_t REDUNDANCY, int32_t ISQRY,
+    int32_t TAG);
   bool repSeed(byte* seq, int32_t start, int32_t SEED_LEN);
+  bool repSeed(byte* seq, int32_t start, const std::vector<int32_t>& care);
   byte* seedToArr(byte* seed, int32_t SEEDLEN, int32_t REDUNDANCY);
   int32_t arrToDNAStr(
     byte* arr, int32_t arrpos, int32_t len, byte* out, int32_t outpos);
   int32_t arrToDNAStrRev(
     byte* arr, int32_t arrstart, int32_t len, byte* out, int32_t outpos);
+  int32_t arrToPackedLen(int32_t len);
+  int32_t arrToPacked(
+    byte* arr, int32_t arrpos, int32_t len, byte* out, int32_t outpos);
+  int32_t arrToPackedRev(
+    byte* arr, int32_t arrstart, int32_t len, byte* out, int32_t outpos);
+  void packedToArr(
+    const byte* packed, int32_t len, const byte* exceptions,
+    int32_t numExceptions, byte* out);
   byte* arrToDNA(byte* arr, int32_t start, int32_t len);
   byte* arrToDNA(byte* arr, int32_t len);
   byte* dnaToArr(const byte* dna, int32_t dnapos, int32_t dnalen);
@@ -53,6 +70,7 @@ public:
   int32_t dnaToArrLen(const byte* dna, int32_t dnapos, int32_t dnalen);
   byte* stringToBytes(std::string src);
   bool arrHasN(byte* seq, int32_t start, int32_t len);
+  bool arrHasN(byte* seq, int32_t start, const std::vector<int32_t>& care);
 private:
 };
 #endif  //  DNA_STRING_H
@@ -4,10 +4,15 @@
 #include<string.h>
 
 #include "FastaRecord.h"
+#include "Varint.h"
 #include "core/MemoryUtils.h"
+#include "core/TritonSortAssert.h"
 
 typedef uint8_t byte;
 
+const byte FastaRecord::LAST_CHUNK_FLAG;
+const byte FastaRecord::WIDE_OFFSET_FLAG;
+
 FastaRecord::FastaRecord()
   : dnaStartPos(5),
     sequence(NULL),
@@ -23,31 +28,47 @@ FastaRecord::~FastaRecord() {
 //  DNA sequences are available in fasta format
 //  Input file is compressed in byte format and read back in ascii
 //  chars
-FastaRecord::FastaRecord(const uint8_t* rawByteString, int32_t valueLength)
-  : dnaStartPos(5) {
-  lastChunk = rawByteString[0];
-  memcpy(&offset, &rawByteString[1], sizeof(offset));
-  //  we need htonl here because of ordering assumption made in input file
-  offset = htonl(offset);
+FastaRecord::FastaRecord(const uint8_t* rawByteString, int32_t valueLength) {
+  lastChunk = (rawByteString[0] & LAST_CHUNK_FLAG) != 0;
+  if (rawByteString[0] & WIDE_OFFSET_FLAG) {
+    uint64_t wideOffset;
+    dnaStartPos = 1 + Varint::decode(rawByteString + 1, wideOffset);
+    offset = wideOffset;
+  } else {
+    uint32_t narrowOffset;
+    memcpy(&narrowOffset, &rawByteString[1], sizeof(narrowOffset));
+    //  we need ntohl here because of ordering assumption made in input file
+    offset = ntohl(narrowOffset);
+    // offset (4) + lastChunk (1)
+    dnaStartPos = 5;
+  }
+  ABORT_IF(dnaStartPos > valueLength, "FastaRecord of %d bytes is shorter "
+           "than its header", valueLength);
   // sequence is double the string size
-  // pos 5 marks begining of dna string
-  // offset (4) + lastChunk (1)
   sequence = dnaStringObj.dnaToArr(
     rawByteString, dnaStartPos, valueLength - dnaStartPos);
   sequenceLength = dnaStringObj.dnaToArrLen(
     rawByteString, dnaStartPos, valueLength - dnaStartPos);
 }
 
-// Convert FastaFormat in byte format
-byte* FastaRecord::toBytes(int32_t arrLen) {
+// Convert FastaFormat in byte format, with a wide offset only if the offset
+// needs one
+byte* FastaRecord::toBytes(int32_t arrLen, int32_t& length) {
   DNAString dnaStringObj;
   byte* dna = dnaStringObj.arrToDNA(sequence, arrLen);
   int32_t dnaLen = (arrLen + 1)/2;
-  int32_t len = dnaStartPos +  dnaLen;
-  byte* buffer = new (themis::memcheck) byte[len];
-  buffer[0] = (byte) (lastChunk ? 1 : 0);
-  memcpy(buffer, &offset, sizeof(offset));
-  memcpy(buffer + dnaStartPos, dna, dnaLen);
+  bool wide = offset > 0x7FFFFFFF;
+  int32_t headerLen = wide ? 1 + Varint::length(offset) : 5;
+  length = headerLen + dnaLen;
+  byte* buffer = new (themis::memcheck) byte[length];
+  buffer[0] = (lastChunk ? LAST_CHUNK_FLAG : 0) | (wide ? WIDE_OFFSET_FLAG : 0);
+  if (wide) {
+    Varint::encode(offset, buffer + 1);
+  } else {
+    uint32_t narrowOffset = htonl(static_cast<uint32_t>(offset));
+    memcpy(buffer + 1, &narrowOffset, sizeof(narrowOffset));
+  }
+  memcpy(buffer + headerLen, dna, dnaLen);
   delete[] dna;
   return buffer;
 }
@@ -4,21 +4,37 @@
 #include"DNAString.h"
 typedef uint8_t byte;
 
+/**
+   A chunk of a reference or a read, as written by the input converter:
+
+     flags            1 byte   bit 0 last chunk of its sequence, bit 7 wide
+                               offset
+     offset           4 bytes big-endian, or a varint if the wide offset
+                      bit is set
+     sequence         2 bases per byte
+
+   Wide offsets let references longer than 2^31 bases be converted without
+   splitting them into separate jobs.
+ */
 class FastaRecord {
 public:
+  /// Flag byte bits
+  static const byte LAST_CHUNK_FLAG = 0x01;
+  static const byte WIDE_OFFSET_FLAG = 0x80;
+
   FastaRecord();
 
   FastaRecord(const uint8_t* rawByteString, int32_t valueLength);
 
   virtual ~FastaRecord();
 
-  byte* toBytes(int32_t arrLen);
+  byte* toBytes(int32_t arrLen, int32_t& length);
 
   ///\todo(AR) All these non-const public members make my brain bleed
-  const int dnaStartPos;
+  int32_t dnaStartPos;
   byte* sequence;
   bool lastChunk;
-  int32_t offset;
+  int64_t offset;
   int32_t sequenceLength;
   DNAString dnaStringObj;
 };
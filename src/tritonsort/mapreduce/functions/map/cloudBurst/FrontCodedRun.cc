@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <string.h>
+
+#include "FrontCodedRun.h"
+#include "Varint.h"
+#include "core/TritonSortAssert.h"
+
+FrontCodedRunWriter::FrontCodedRunWriter(std::vector<uint8_t>& _run)
+  : run(_run) {
+}
+
+void FrontCodedRunWriter::append(
+  const uint8_t* key, uint32_t keyLength, const uint8_t* value,
+  uint32_t valueLength) {
+  uint32_t shared = 0;
+  uint32_t limit = std::min<uint32_t>(keyLength, previousKey.size());
+  while (shared < limit && previousKey[shared] == key[shared]) {
+    shared++;
+  }
+  uint32_t suffixLength = keyLength - shared;
+
+  uint8_t lengths[3 * Varint::MAX_LENGTH];
+  uint32_t lengthsLength = Varint::encode(shared, lengths);
+  lengthsLength += Varint::encode(suffixLength, lengths + lengthsLength);
+  lengthsLength += Varint::encode(valueLength, lengths + lengthsLength);
+
+  uint64_t offset = run.size();
+  run.resize(offset + lengthsLength + suffixLength + valueLength);
+  uint8_t* tuple = &run[offset];
+  memcpy(tuple, lengths, lengthsLength);
+  memcpy(tuple + lengthsLength, key + shared, suffixLength);
+  memcpy(tuple + lengthsLength + suffixLength, value, valueLength);
+
+  previousKey.resize(keyLength);
+  if (suffixLength > 0) {
+    memcpy(&previousKey[shared], key + shared, suffixLength);
+  }
+}
+
+FrontCodedRunReader::FrontCodedRunReader(const uint8_t* run, uint64_t length)
+  : position(run),
+    end(run + length),
+    // Keep key() valid for an empty key
+    currentKey(1),
+    currentKeyLength(0),
+    currentValue(NULL),
+    currentValueLength(0),
+    keyUnchanged(false) {
+}
+
+bool FrontCodedRunReader::next() {
+  if (position == end) {
+    return false;
+  }
+
+  uint64_t shared;
+  uint64_t suffixLength;
+  uint64_t valueLength;
+  position += Varint::decode(position, shared);
+  position += Varint::decode(position, suffixLength);
+  position += Varint::decode(position, valueLength);
+  ABORT_IF(shared > currentKeyLength, "Front coded tuple shares %llu bytes "
+           "with a %u byte key", shared, currentKeyLength);
+  ABORT_IF(position > end ||
+           static_cast<uint64_t>(end - position) < suffixLength + valueLength,
+           "Front coded run ends in a partial tuple");
+
+  keyUnchanged = currentValue != NULL && shared == currentKeyLength &&
+    suffixLength == 0;
+  if (!keyUnchanged) {
+    currentKeyLength = shared + suffixLength;
+    if (currentKey.size() < currentKeyLength) {
+      currentKey.resize(currentKeyLength);
+    }
+    if (suffixLength > 0) {
+      memcpy(&currentKey[shared], position, suffixLength);
+    }
+  }
+  currentValue = position + suffixLength;
+  currentValueLength = valueLength;
+  position = currentValue + valueLength;
+  return true;
+}
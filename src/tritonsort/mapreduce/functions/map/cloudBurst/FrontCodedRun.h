@@ -0,0 +1,113 @@
+#ifndef MAPRED_FRONT_CODED_RUN_H
+#define MAPRED_FRONT_CODED_RUN_H
+
+#include <stdint.h>
+#include <vector>
+
+/**
+   A run of tuples sorted by key, with each key front coded against the key
+   before it. Sorted CloudBurst keys share long prefixes: every tuple of a
+   seed group has the same key, and a seed's query key differs from its
+   reference key only in the last byte. So instead of its whole key, each
+   tuple stores
+
+   - the length of the prefix it shares with the previous key,
+   - the length of the rest of its key,
+   - the length of its value,
+
+   all as Varints, followed by the rest of its key and its value. A tuple
+   with the same key as the one before it stores three bytes of lengths and
+   no key at all, so a hot seed group pays for its key once.
+
+   Values are stored as they are. Tuples may be appended in any order, but
+   only sorted runs compress well.
+ */
+class FrontCodedRunWriter {
+public:
+  /// Constructor
+  /**
+     \param run the buffer to append tuples to
+   */
+  FrontCodedRunWriter(std::vector<uint8_t>& run);
+
+  /**
+     Append a tuple to the run.
+
+     \param key the key
+
+     \param keyLength the length of the key
+
+     \param value the value
+
+     \param valueLength the length of the value
+   */
+  void append(
+    const uint8_t* key, uint32_t keyLength, const uint8_t* value,
+    uint32_t valueLength);
+
+private:
+  std::vector<uint8_t>& run;
+  std::vector<uint8_t> previousKey;
+};
+
+/**
+   Iterates over the tuples of a FrontCodedRunWriter's run. Keys are decoded
+   lazily: moving to a tuple copies only the part of its key that differs
+   from the previous key, and a tuple with the same key as the one before it
+   is recognized from its lengths alone. Values point into the run, which
+   must outlive the reader.
+ */
+class FrontCodedRunReader {
+public:
+  /// Constructor
+  /**
+     \param run the run's first byte
+
+     \param length the length of the run in bytes
+   */
+  FrontCodedRunReader(const uint8_t* run, uint64_t length);
+
+  /**
+     Move to the next tuple; the first call moves to the first tuple.
+
+     \return false if the run has no more tuples
+   */
+  bool next();
+
+  /// \return the current tuple's key, which is valid until the next call to
+  /// next()
+  inline const uint8_t* key() const {
+    return &currentKey[0];
+  }
+
+  /// \return the length of the current tuple's key
+  inline uint32_t keyLength() const {
+    return currentKeyLength;
+  }
+
+  /// \return the current tuple's value
+  inline const uint8_t* value() const {
+    return currentValue;
+  }
+
+  /// \return the length of the current tuple's value
+  inline uint32_t valueLength() const {
+    return currentValueLength;
+  }
+
+  /// \return true if the current tuple has the same key as the one before it
+  inline bool sameKey() const {
+    return keyUnchanged;
+  }
+
+private:
+  const uint8_t* position;
+  const uint8_t* end;
+  std::vector<uint8_t> currentKey;
+  uint32_t currentKeyLength;
+  const uint8_t* currentValue;
+  uint32_t currentValueLength;
+  bool keyUnchanged;
+};
+
+#endif  // MAPRED_FRONT_CODED_RUN_H
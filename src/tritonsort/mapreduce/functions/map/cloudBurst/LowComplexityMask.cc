@@ -0,0 +1,94 @@
+#include <algorithm>
+
+#include "LowComplexityMask.h"
+
+const int32_t LowComplexityMask::WINDOW;
+
+/// \return the 2-bit code of a base, or -1 if it is not A, C, G or T
+static inline int32_t baseCode(byte base) {
+  switch (base) {
+  case 'A':
+    return 0;
+  case 'C':
+    return 1;
+  case 'G':
+    return 2;
+  case 'T':
+    return 3;
+  default:
+    return -1;
+  }
+}
+
+LowComplexityMask::LowComplexityMask(
+  uint32_t dustThreshold, const std::string& repeatMaskFile)
+  : threshold(dustThreshold) {
+  if (!repeatMaskFile.empty()) {
+    repeats.load(repeatMaskFile);
+  }
+}
+
+int32_t LowComplexityMask::maskChunk(
+  int64_t refID, int64_t chunkOffset, const byte* seq, int32_t seqLen) {
+  maskedBases.assign(seqLen, 0);
+  if (threshold > 0) {
+    dust(seq, seqLen);
+  }
+  repeats.clip(refID, chunkOffset, chunkOffset + seqLen, chunkRepeats);
+  for (uint32_t i = 0; i < chunkRepeats.size(); i++) {
+    std::fill(maskedBases.begin() + (chunkRepeats[i].first - chunkOffset),
+              maskedBases.begin() + (chunkRepeats[i].second - chunkOffset), 1);
+  }
+
+  maskedBefore.resize(seqLen + 1);
+  maskedBefore[0] = 0;
+  for (int32_t i = 0; i < seqLen; i++) {
+    maskedBefore[i + 1] = maskedBefore[i] + maskedBases[i];
+  }
+  return maskedBefore[seqLen];
+}
+
+void LowComplexityMask::dust(const byte* seq, int32_t seqLen) {
+  int32_t windowLength = std::min(WINDOW, seqLen);
+  // A window needs at least 2 triplets to be scored
+  int32_t windowTriplets = windowLength - 2;
+  if (windowTriplets < 2) {
+    return;
+  }
+
+  // Code every triplet by its bases, or -1 if it has an N
+  triplets.resize(seqLen - 2);
+  for (int32_t i = 0; i + 2 < seqLen; i++) {
+    int32_t first = baseCode(seq[i]);
+    int32_t second = baseCode(seq[i + 1]);
+    int32_t third = baseCode(seq[i + 2]);
+    triplets[i] = first < 0 || second < 0 || third < 0 ?
+      -1 : (first << 4) | (second << 2) | third;
+  }
+
+  // Slide the window along the chunk, keeping each kind's triplet count
+  // and the number of pairs of equal triplets in the window
+  uint32_t counts[64] = {0};
+  uint64_t pairs = 0;
+  int32_t maskedEnd = 0;
+  for (int32_t i = 0; i < windowTriplets - 1; i++) {
+    if (triplets[i] >= 0) {
+      pairs += counts[triplets[i]]++;
+    }
+  }
+  for (int32_t start = 0; start + windowLength <= seqLen; start++) {
+    int32_t added = triplets[start + windowTriplets - 1];
+    if (added >= 0) {
+      pairs += counts[added]++;
+    }
+    if (10 * pairs > static_cast<uint64_t>(threshold) * (windowTriplets - 1)) {
+      std::fill(maskedBases.begin() + std::max(start, maskedEnd),
+                maskedBases.begin() + start + windowLength, 1);
+      maskedEnd = start + windowLength;
+    }
+    int32_t removed = triplets[start];
+    if (removed >= 0) {
+      pairs -= --counts[removed];
+    }
+  }
+}
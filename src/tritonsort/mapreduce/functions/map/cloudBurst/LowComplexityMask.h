@@ -0,0 +1,95 @@
+#ifndef _LOW_COMPLEXITY_MASK_H_
+#define _LOW_COMPLEXITY_MASK_H_
+
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ReferenceIntervalSet.h"
+
+typedef uint8_t byte;
+
+/**
+   Masks the low complexity and repetitive stretches of reference chunks, so
+   that the map function does not emit their seeds. Dinucleotide and other
+   short tandem repeats make huge seed groups that are joined against every
+   read sharing the seed, yet rarely place a read anywhere useful.
+
+   Two kinds of masking can be combined:
+
+   - DUST scoring: every window of WINDOW bases is scored by how often its
+     triplets repeat, as 10 * sum(c * (c - 1) / 2) / (l - 1) over the counts
+     c of each of the l triplets' kinds. Random sequence scores about 5, a
+     dinucleotide repeat about 150 and a homopolymer about 300. Every base of
+     a window scoring above the threshold is masked.
+
+   - A repeat mask: a file of precomputed intervals, such as RepeatMasker's
+     output, in the format of a ReferenceIntervalSet. Every base in one of
+     its intervals is masked.
+
+   Windows are scored within a chunk, so a chunk shorter than WINDOW is
+   scored as one window.
+ */
+class LowComplexityMask {
+public:
+  /// The length of a DUST window
+  static const int32_t WINDOW = 64;
+
+  /// Constructor
+  /**
+     \param dustThreshold the DUST score above which a window is masked, or
+     0 to skip DUST scoring
+
+     \param repeatMaskFile a file of reference intervals to mask, or an
+     empty string for none. \sa ReferenceIntervalSet
+   */
+  LowComplexityMask(uint32_t dustThreshold, const std::string& repeatMaskFile);
+
+  /// \return true if the mask masks anything at all
+  inline bool enabled() const {
+    return threshold > 0 || !repeats.empty();
+  }
+
+  /**
+     Mask a reference chunk, replacing the chunk masked before.
+
+     \param refID the id of the chunk's reference
+
+     \param chunkOffset the position of the chunk's first base in the
+     reference
+
+     \param seq the chunk's sequence
+
+     \param seqLen the length of the chunk
+
+     \return the number of masked bases in the chunk
+   */
+  int32_t maskChunk(
+    int64_t refID, int64_t chunkOffset, const byte* seq, int32_t seqLen);
+
+  /**
+     \param start the position of a range in the chunk
+
+     \param length the length of the range
+
+     \return true if any base in the range is masked
+   */
+  inline bool masked(int32_t start, int32_t length) const {
+    return maskedBefore[start + length] != maskedBefore[start];
+  }
+
+private:
+  /// Mark the bases of every DUST window above the threshold.
+  void dust(const byte* seq, int32_t seqLen);
+
+  const uint32_t threshold;
+  ReferenceIntervalSet repeats;
+  std::vector<std::pair<int64_t, int64_t> > chunkRepeats;
+  std::vector<int8_t> triplets;
+  std::vector<uint8_t> maskedBases;
+  // The number of masked bases before each position of the chunk
+  std::vector<int32_t> maskedBefore;
+};
+
+#endif  // _LOW_COMPLEXITY_MASK_H_
@@ -3,43 +3,108 @@
 #include<string.h>
 
 #include "MerRecord.h"
+#include "Varint.h"
 #include "core/MemoryUtils.h"
+#include "core/TritonSortAssert.h"
 
 typedef uint8_t byte;
+
+// Header field positions
+static const int32_t LEFT_LENGTH_INDEX = 1;
+static const int32_t RIGHT_LENGTH_INDEX = 3;
+static const int32_t LEFT_N_COUNT_INDEX = 5;
+static const int32_t RIGHT_N_COUNT_INDEX = 7;
+
+static const uint8_t REFERENCE_FLAG = 0x01;
+static const uint8_t SEED_RC_FLAG = 0x02;
+static const uint8_t SEED_CLASS_BITS = 0x0C;
+static const int32_t SEED_CLASS_SHIFT = 2;
+static const uint8_t RC_FLAG = 0x10;
+static const int32_t VERSION_SHIFT = 5;
+
+// DNAString builds its lookup tables on construction, so records share one
+// instead of building them for every tuple.
+static DNAString& dnaString() {
+  static DNAString dnaStringObj;
+  return dnaStringObj;
+}
+
+static inline void writeUInt16(byte* out, int32_t value) {
+  ABORT_IF(value > 0xFFFF, "MerRecord field %d does not fit in 16 bits",
+           value);
+  uint16_t shortValue = value;
+  memcpy(out, &shortValue, sizeof(shortValue));
+}
+
+static inline uint16_t readUInt16(const byte* in) {
+  uint16_t value;
+  memcpy(&value, in, sizeof(value));
+  return value;
+}
+
 // constructor
 MerRecord::MerRecord()
-  : offsetIndex(sizeof(isReference)),
-    idIndex(offsetIndex+sizeof(offset)),
-    isReference(false),
+  : isReference(false),
+    isStub(false),
     isRC(false),
+    isSeedRC(false),
+    seedClass(0),
     offset(0),
     id(0),
-    leftFlank(NULL),
-    rightFlank(NULL),
-    sbuffer(NULL) {
+    serialized(NULL),
+    serializedLength(0) {
+  memset(&leftFlank, 0, sizeof(leftFlank));
+  memset(&rightFlank, 0, sizeof(rightFlank));
 }
 //  constructor
-MerRecord::MerRecord(byte* t, int32_t len)
-  : offsetIndex(sizeof(isReference)),
-    idIndex(offsetIndex+sizeof(offset)) {
+MerRecord::MerRecord(byte* t, int32_t len) {
   fromBytes(t, len);
 }
 
 MerRecord::~MerRecord() {
 }
 
-// Convert MerRecord to Bytes
-int32_t MerRecord::toBytesLen(int32_t leftlen, int32_t rightlen) {
-  DNAString dnaStringObj;
-  // +1 for hardstop between left and right flank
-  int32_t len = sizeof(isReference) + sizeof(offset) + sizeof(id) + 1;
-  if (leftlen > 0)  {
-    len += dnaStringObj.arrToDNALen(leftlen);
+int32_t MerRecord::headerSize() const {
+  ABORT_IF(offset < 0 || id < 0, "MerRecord offset %lld and id %lld must not "
+           "be negative", offset, id);
+  return fixedHeaderSize + Varint::length(offset) + Varint::length(id);
+}
+
+int32_t MerRecord::countNs(byte* seq, int32_t start, int32_t len) {
+  DNAString& dnaStringObj = dnaString();
+  int32_t numNs = 0;
+  for (int32_t i = start; i < start + len; i++) {
+    if (dnaStringObj.byteToDNA(seq[i]) == dnaStringObj.dnaN) {
+      numNs++;
+    }
   }
-  if (rightlen > 0) {
-    len += dnaStringObj.arrToDNALen(rightlen);
+  return numNs;
+}
+
+// Write the positions of the N's in seq[start, start + len), counted outward
+// from the seed if reverse is set.
+int32_t MerRecord::writeNs(
+  byte* seq, int32_t start, int32_t len, bool reverse, byte* out) {
+  DNAString& dnaStringObj = dnaString();
+  int32_t written = 0;
+  for (int32_t i = 0; i < len; i++) {
+    int32_t position = reverse ? start + len - 1 - i : start + i;
+    if (dnaStringObj.byteToDNA(seq[position]) == dnaStringObj.dnaN) {
+      writeUInt16(out + written, i);
+      written += sizeof(uint16_t);
+    }
   }
-  return len;
+  return written;
+}
+
+// Convert MerRecord to Bytes
+int32_t MerRecord::toBytesLen(
+  byte* seq, int32_t leftstart, int32_t leftlen, int32_t rightstart,
+  int32_t rightlen) {
+  int32_t numNs = countNs(seq, leftstart, leftlen) +
+    countNs(seq, rightstart, rightlen);
+  return headerSize() + dnaString().arrToPackedLen(leftlen) +
+    dnaString().arrToPackedLen(rightlen) + numNs * sizeof(uint16_t);
 }
 
 // Pack the MerRecord information into a BytesWritable
@@ -47,36 +112,54 @@ int32_t MerRecord::toBytesLen(int32_t leftlen, int32_t rightlen) {
 byte* MerRecord::toBytes(
   byte* seq, int32_t leftstart, int32_t leftlen, int32_t rightstart,
   int32_t rightlen) {
-  DNAString dnaStringObj;
-  // +1 for hardstop between left and right flank
-  int32_t len = sizeof(isReference) + sizeof(offset) + sizeof(id) + 1;
-  if (leftlen > 0)  {
-    len += dnaStringObj.arrToDNALen(leftlen);
-  }
-  if (rightlen > 0) {
-    len += dnaStringObj.arrToDNALen(rightlen);
-  }
+  int32_t leftNs = countNs(seq, leftstart, leftlen);
+  int32_t rightNs = countNs(seq, rightstart, rightlen);
+  int32_t header = headerSize();
+  int32_t len = header + dnaString().arrToPackedLen(leftlen) +
+    dnaString().arrToPackedLen(rightlen) +
+    (leftNs + rightNs) * sizeof(uint16_t);
   byte* sbuffer = new (themis::memcheck) byte[len];
-  // byte is used to indicate whether the given sequence is from
-  // reference string and whether the sequence is replicated
-  // 0x11 - indicate  reference and rc set
-  // 0x00 - indicate rederence and rc not set
-  sbuffer[0] = (byte) ((isReference ? 0x01 : 0x00) |
-    (isRC ? 0x10 : 0x00));
-  memcpy(&sbuffer[offsetIndex], &offset, sizeof(offset));
-  memcpy(&sbuffer[idIndex], &id, sizeof(id));
-  int32_t pos = 9;
-  if (leftlen > 0) {
-    pos += dnaStringObj.arrToDNAStrRev(seq, leftstart, leftlen, sbuffer, pos);
-  }
-  sbuffer[pos] = dnaStringObj.hardstop;
-  pos++;
-  if (rightlen > 0) {
-    pos += dnaStringObj.arrToDNAStr(seq, rightstart, rightlen, sbuffer, pos);
-  }
+  int32_t pos = writeHeader(
+    sbuffer, VERSION, leftlen, rightlen, leftNs, rightNs);
+  assert(pos == header);
+
+  // The left flank is stored reversed so both flanks read outward from the
+  // seed.
+  pos += dnaString().arrToPackedRev(seq, leftstart, leftlen, sbuffer, pos);
+  pos += dnaString().arrToPacked(seq, rightstart, rightlen, sbuffer, pos);
+  pos += writeNs(seq, leftstart, leftlen, true, sbuffer + pos);
+  pos += writeNs(seq, rightstart, rightlen, false, sbuffer + pos);
+  assert(pos == len);
   return sbuffer;
 }
 
+int32_t MerRecord::toStubBytesLen() {
+  return headerSize();
+}
+
+byte* MerRecord::toStubBytes(int32_t leftlen, int32_t rightlen) {
+  byte* sbuffer = new (themis::memcheck) byte[headerSize()];
+  writeHeader(sbuffer, STUB_VERSION, leftlen, rightlen, 0, 0);
+  return sbuffer;
+}
+
+int32_t MerRecord::writeHeader(
+  byte* out, uint8_t version, int32_t leftlen, int32_t rightlen,
+  int32_t leftNs, int32_t rightNs) {
+  out[0] = (byte) ((isReference ? REFERENCE_FLAG : 0x00) |
+    (isSeedRC ? SEED_RC_FLAG : 0x00) |
+    ((seedClass << SEED_CLASS_SHIFT) & SEED_CLASS_BITS) |
+    (isRC ? RC_FLAG : 0x00) | (version << VERSION_SHIFT));
+  writeUInt16(&out[LEFT_LENGTH_INDEX], leftlen);
+  writeUInt16(&out[RIGHT_LENGTH_INDEX], rightlen);
+  writeUInt16(&out[LEFT_N_COUNT_INDEX], leftNs);
+  writeUInt16(&out[RIGHT_N_COUNT_INDEX], rightNs);
+  int32_t pos = fixedHeaderSize;
+  pos += Varint::encode(offset, out + pos);
+  pos += Varint::encode(id, out + pos);
+  return pos;
+}
+
 //  change MerRecord tobytes
 byte* MerRecord::toBytes(int32_t id) {
   byte* buffer = new (themis::memcheck) byte[4];
@@ -86,33 +169,52 @@ byte* MerRecord::toBytes(int32_t id) {
 
 // Unpack the raw bytes and set the MerRecord fields
 void MerRecord::fromBytes(const byte* bytes, int32_t length) {
-  DNAString dnaStringObj;
-
-  // byte is used to indicate whether the given sequence is from
-  // reference string and whether the sequence is replicated
-  // 0x11 - indicate  reference and rc set
-  // 0x00 - indicate reference and rc not set
-  isReference = (bytes[0] & 0x01) == 0x01;
-  isRC        = (bytes[0] & 0x10) == 0x10;
-  offset = *reinterpret_cast<const int32_t*>(bytes + offsetIndex);
-  id = *reinterpret_cast<const int32_t*>(bytes + idIndex);
-
-  // Flanks are formatted as left;right, after all of the header information.
-  uint32_t flankStart = sizeof(isReference) + sizeof(offset) + sizeof(id);
-
-  // Left flank begins immediately after headers.
-  leftFlank = bytes + flankStart;
-  leftFlankLength = 0;
-  for (int32_t i = flankStart; i < length; ++i) {
-    if (bytes[i] == dnaStringObj.hardstop) {
-      leftFlankLength = i - flankStart;
-      // The right flank will start after the hardstop.
-      flankStart = i + 1;
-      break;
-    }
+  uint8_t version = bytes[0] >> VERSION_SHIFT;
+  ABORT_IF(version != VERSION && version != STUB_VERSION,
+           "Expected a version %u MerRecord but got version %u", VERSION,
+           version);
+  ABORT_IF(length < fixedHeaderSize, "MerRecord of %d bytes is shorter than "
+           "its %d byte header", length, fixedHeaderSize);
+
+  isReference = (bytes[0] & REFERENCE_FLAG) != 0;
+  isStub      = version == STUB_VERSION;
+  isRC        = (bytes[0] & RC_FLAG) != 0;
+  isSeedRC    = (bytes[0] & SEED_RC_FLAG) != 0;
+  seedClass   = (bytes[0] & SEED_CLASS_BITS) >> SEED_CLASS_SHIFT;
+  int32_t header = fixedHeaderSize;
+  uint64_t value;
+  header += Varint::decode(bytes + header, value);
+  offset = value;
+  header += Varint::decode(bytes + header, value);
+  id = value;
+
+  leftFlank.length = readUInt16(bytes + LEFT_LENGTH_INDEX);
+  rightFlank.length = readUInt16(bytes + RIGHT_LENGTH_INDEX);
+  leftFlank.numExceptions = readUInt16(bytes + LEFT_N_COUNT_INDEX);
+  rightFlank.numExceptions = readUInt16(bytes + RIGHT_N_COUNT_INDEX);
+
+  serialized = bytes;
+  serializedLength = length;
+  if (isStub) {
+    // A stub has no flank bases, only their lengths
+    leftFlank.bases = NULL;
+    rightFlank.bases = NULL;
+    leftFlank.exceptions = NULL;
+    rightFlank.exceptions = NULL;
+    ASSERT(leftFlank.numExceptions == 0 && rightFlank.numExceptions == 0 &&
+           header == length, "MerRecord stub has flank data");
+    return;
   }
-  // Right flank begins after the hardstop, or is the entire portion after the
-  // header if no hardstop was found.
-  rightFlank = bytes + flankStart;
-  rightFlankLength = length - flankStart;
+
+  leftFlank.bases = bytes + header;
+  rightFlank.bases =
+    leftFlank.bases + dnaString().arrToPackedLen(leftFlank.length);
+  leftFlank.exceptions =
+    rightFlank.bases + dnaString().arrToPackedLen(rightFlank.length);
+  rightFlank.exceptions =
+    leftFlank.exceptions + leftFlank.numExceptions * sizeof(uint16_t);
+
+  ASSERT(rightFlank.exceptions + rightFlank.numExceptions * sizeof(uint16_t)
+         == bytes + length, "MerRecord lengths don't add up to %d bytes",
+         length);
 }
@@ -1,33 +1,123 @@
 #ifndef _MER_RECORD_H_
 #define _MER_RECORD_H_
 
+#include<string.h>
+
 #include"DNAString.h"
 
 typedef uint8_t byte;
+
+/**
+   A view of one flank of a serialized MerRecord. Bases are packed 2 bits per
+   base with the first base in the high bits of the first byte. N's are
+   stored as A's and listed separately as exceptions.
+ */
+struct PackedFlank {
+  const uint8_t* bases;
+  /// Length of the flank in bases
+  uint32_t length;
+  /// Positions of N's within the flank, as unaligned uint16_t values
+  const uint8_t* exceptions;
+  uint32_t numExceptions;
+
+  /// \return the position of the i'th N in the flank
+  inline uint16_t exception(uint32_t i) const {
+    uint16_t position;
+    memcpy(&position, exceptions + i * sizeof(position), sizeof(position));
+    return position;
+  }
+};
+
+/**
+   A reference or query tuple's value: the position of the seed and the flanks
+   on either side of it.
+
+   Wire format (version 3), a header followed by the packed flanks and the N
+   exception list:
+
+     flags            1 byte   bit 0 reference, bit 1 seed reverse
+                               complemented, bits 2-3 seed class,
+                               bit 4 reverse complement, bits 5-7 format
+                               version
+     left length      2 bytes  in bases
+     right length     2 bytes  in bases
+     left N count     2 bytes
+     right N count    2 bytes
+     offset           varint
+     id               varint
+     left flank       (left length + 3) / 4 bytes, read outward from the seed
+     right flank      (right length + 3) / 4 bytes
+     N positions      2 bytes each, left flank's then right flank's
+
+   The offset and id are 64-bit, so a single job can seed references far
+   longer than 2^31 bases, but small values still take only a few bytes.
+   Since every length is in the header, fromBytes() is O(1).
+
+   A stub (format version 4) is just the header of a query tuple, with N
+   counts of 0 and no flanks. Jobs with a ReadStore shuffle stubs instead of
+   whole reads, and the reducer rebuilds the flanks from the store.
+ */
 class MerRecord {
 public:
   MerRecord();
   ~MerRecord();
   MerRecord(byte* t, int32_t len);
-  int32_t toBytesLen(int32_t leftlen, int32_t rightlen);
+  int32_t toBytesLen(
+    byte* seq, int32_t leftstart, int32_t leftlen, int32_t rightstart,
+    int32_t rightlen);
   byte* toBytes(byte* seq, int32_t leftstart, int32_t leftlen,
       int32_t rightstart, int32_t rightlen);
+  /// \return the length of the stub toStubBytes() writes
+  int32_t toStubBytesLen();
+  /**
+     Serialize a stub of the record.
+
+     \param leftlen the length of the left flank in bases
+
+     \param rightlen the length of the right flank in bases
+
+     \return the stub, allocated with new[]
+   */
+  byte* toStubBytes(int32_t leftlen, int32_t rightlen);
   void fromBytes(const byte* bytes, int32_t length);
   byte* toBytes(int32_t id);
 
+  /// The format version written by toBytes()
+  static const uint8_t VERSION = 3;
+
+  /// The format version written by toStubBytes()
+  static const uint8_t STUB_VERSION = 4;
+
   /// \todo(AR) These fields should be private or const
-  int32_t offsetIndex;
-  int32_t idIndex;
   bool isReference;
+  /// True if the record is a stub, whose flanks have lengths but no bases
+  bool isStub;
   bool isRC;
-  int32_t offset;
-  int32_t id;
-  const uint8_t* leftFlank;
-  uint32_t leftFlankLength;
-  const uint8_t* rightFlank;
-  uint32_t rightFlankLength;
+  /// True if the tuple's key is the reverse complement of its seed, which
+  /// happens when canonical seeds are in use
+  bool isSeedRC;
+  /// The index of the spaced seed mask or read length class the tuple's key
+  /// was built with, or 0 if the job uses neither
+  uint8_t seedClass;
+  int64_t offset;
+  int64_t id;
+  PackedFlank leftFlank;
+  PackedFlank rightFlank;
+  /// The serialized record the flanks point into
+  const uint8_t* serialized;
+  uint32_t serializedLength;
 
 private:
-  byte* sbuffer;
+  /// The size of the fixed part of the header
+  static const int32_t fixedHeaderSize = 9;
+  /// \return the size of the header, including the offset and id
+  int32_t headerSize() const;
+  /// Write the header, returning its length
+  int32_t writeHeader(
+    byte* out, uint8_t version, int32_t leftlen, int32_t rightlen,
+    int32_t leftNs, int32_t rightNs);
+  int32_t countNs(byte* seq, int32_t start, int32_t len);
+  int32_t writeNs(
+    byte* seq, int32_t start, int32_t len, bool reverse, byte* out);
 };
 #endif  // _MER_RECORD_H
@@ -0,0 +1,194 @@
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "PerfCounters.h"
+#include "core/StatLogger.h"
+#include "core/TritonSortAssert.h"
+
+static const uint64_t EVENT_CONFIGS[PerfCounters::NUM_EVENTS] = {
+  PERF_COUNT_HW_CPU_CYCLES,
+  PERF_COUNT_HW_INSTRUCTIONS,
+  // The kernel maps the generic cache miss event to last level cache misses
+  PERF_COUNT_HW_CACHE_MISSES,
+  PERF_COUNT_HW_BRANCH_MISSES
+};
+
+static const char* EVENT_NAMES[PerfCounters::NUM_EVENTS] = {
+  "cycles",
+  "instructions",
+  "llc_misses",
+  "branch_misses"
+};
+
+PerfCounters::PerfCounters(uint32_t _numRegions)
+  : numRegions(_numRegions),
+    opened(false),
+    thread(0),
+    currentRegion(-1),
+    counts(_numRegions * NUM_EVENTS, 0) {
+  for (uint32_t event = 0; event < NUM_EVENTS; event++) {
+    fds[event] = -1;
+    supported[event] = true;
+    regionStart[event] = 0;
+  }
+}
+
+PerfCounters::~PerfCounters() {
+  close();
+}
+
+void PerfCounters::enter(uint32_t region) {
+  ASSERT(region < numRegions, "Region %u out of range; there are %u regions",
+         region, numRegions);
+  pid_t caller = syscall(SYS_gettid);
+  if (!opened || caller != thread) {
+    // A region another thread left open can't be read from this one
+    currentRegion = -1;
+    close();
+    open();
+    thread = caller;
+  }
+
+  uint64_t values[NUM_EVENTS];
+  read(values);
+  if (currentRegion >= 0) {
+    for (uint32_t event = 0; event < NUM_EVENTS; event++) {
+      counts[currentRegion * NUM_EVENTS + event] +=
+        values[event] - regionStart[event];
+    }
+  }
+  memcpy(regionStart, values, sizeof(regionStart));
+  currentRegion = region;
+}
+
+void PerfCounters::leave() {
+  if (currentRegion < 0) {
+    return;
+  }
+  uint64_t values[NUM_EVENTS];
+  read(values);
+  for (uint32_t event = 0; event < NUM_EVENTS; event++) {
+    counts[currentRegion * NUM_EVENTS + event] +=
+      values[event] - regionStart[event];
+  }
+  currentRegion = -1;
+}
+
+void PerfCounters::add(const PerfCounters& other) {
+  ASSERT(other.numRegions == numRegions, "Can't add counters for %u regions "
+         "to counters for %u regions", other.numRegions, numRegions);
+  for (uint32_t i = 0; i < counts.size(); i++) {
+    counts[i] += other.counts[i];
+  }
+  if (other.opened) {
+    for (uint32_t event = 0; event < NUM_EVENTS; event++) {
+      supported[event] = supported[event] && other.supported[event];
+    }
+    opened = true;
+  }
+}
+
+void PerfCounters::logRegion(
+  StatLogger& logger, uint32_t region, const std::string& name,
+  uint64_t units, const std::string& unitName) const {
+  std::string prefix = "perf_" + name + "_";
+  for (uint32_t e = 0; e < NUM_EVENTS; e++) {
+    Event event = static_cast<Event>(e);
+    if (!counted(event)) {
+      continue;
+    }
+    logger.logDatum(prefix + eventName(event), count(region, event));
+    logger.logDatum(prefix + eventName(event) + "_per_" + unitName,
+                    ratio(count(region, event), units));
+  }
+  if (counted(CYCLES) && counted(INSTRUCTIONS)) {
+    logger.logDatum(prefix + "ipc", ratio(
+      count(region, INSTRUCTIONS), count(region, CYCLES)));
+  }
+}
+
+std::string PerfCounters::ratio(uint64_t numerator, uint64_t denominator) {
+  if (denominator == 0) {
+    return "-";
+  }
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.3f",
+           static_cast<double>(numerator) / denominator);
+  return buffer;
+}
+
+const char* PerfCounters::eventName(Event event) {
+  return EVENT_NAMES[event];
+}
+
+void PerfCounters::open() {
+  for (uint32_t event = 0; event < NUM_EVENTS; event++) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = EVENT_CONFIGS[event];
+    // The group starts disabled and is enabled once all of it is open
+    attr.disabled = event == CYCLES;
+    // User-space counting is allowed at the default perf_event_paranoid
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+      PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    fds[event] = syscall(
+      __NR_perf_event_open, &attr, 0, -1, event == CYCLES ? -1 : fds[CYCLES],
+      0);
+    ABORT_IF(event == CYCLES && fds[event] == -1, "perf_event_open() failed "
+             "to count cycles: %s. Hardware counters need a PMU, and "
+             "/proc/sys/kernel/perf_event_paranoid at 2 or lower",
+             strerror(errno));
+    if (fds[event] == -1) {
+      supported[event] = false;
+    }
+  }
+  ABORT_IF(ioctl(fds[CYCLES], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) != 0,
+           "Failed to enable performance counters: %s", strerror(errno));
+  opened = true;
+}
+
+void PerfCounters::close() {
+  for (uint32_t event = 0; event < NUM_EVENTS; event++) {
+    if (fds[event] != -1) {
+      ::close(fds[event]);
+      fds[event] = -1;
+    }
+  }
+}
+
+void PerfCounters::read(uint64_t* values) {
+  // The group reads as the number of events, the times the group was
+  // enabled and running, then each open event's value in the order opened
+  uint64_t group[3 + NUM_EVENTS];
+  ssize_t bytesRead = ::read(fds[CYCLES], group, sizeof(group));
+  ABORT_IF(bytesRead < static_cast<ssize_t>(3 * sizeof(uint64_t)),
+           "Failed to read performance counters: %s", strerror(errno));
+
+  uint64_t enabled = group[1];
+  uint64_t running = group[2];
+  uint32_t value = 0;
+  for (uint32_t event = 0; event < NUM_EVENTS; event++) {
+    values[event] = 0;
+    if (fds[event] == -1) {
+      continue;
+    }
+    ASSERT(value < group[0], "Read %llu performance counters, expected more",
+           group[0]);
+    values[event] = group[3 + value++];
+    if (running > 0 && running < enabled) {
+      // The group was multiplexed with others, so extrapolate
+      values[event] = static_cast<uint64_t>(
+        static_cast<double>(values[event]) * enabled / running);
+    }
+  }
+}
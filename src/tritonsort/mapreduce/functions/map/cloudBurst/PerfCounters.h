@@ -0,0 +1,128 @@
+#ifndef MAPRED_PERF_COUNTERS_H
+#define MAPRED_PERF_COUNTERS_H
+
+#include <stdint.h>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+class StatLogger;
+
+/**
+   Hardware performance counters for the CloudBurst hot loops, read with
+   perf_event_open(2) so that no external profiler is needed.
+
+   The counters count user-space cycles, instructions, last level cache
+   misses and branch misses of one thread, and attribute them to regions of
+   code: enter() starts counting a region, leaving the previous one, and
+   leave() stops counting. Each transition reads the counters once, so
+   regions should be coarse, such as a whole map() call or a whole alignment
+   batch. Counts are scaled up if the kernel had to multiplex the counters.
+
+   The counters follow the thread that uses them. They are opened for the
+   thread that first enters a region, and reopened if a region is entered
+   from another thread, so an object may be handed from one short-lived
+   worker thread to the next as long as only one uses it at a time.
+
+   Events the hardware or kernel doesn't support are left uncounted; if not
+   even cycles can be counted, enter() aborts, since counters were asked for.
+ */
+class PerfCounters {
+public:
+  enum Event {
+    CYCLES,
+    INSTRUCTIONS,
+    LLC_MISSES,
+    BRANCH_MISSES,
+    NUM_EVENTS
+  };
+
+  /// Constructor
+  /**
+     \param numRegions the number of regions to count
+   */
+  PerfCounters(uint32_t numRegions);
+
+  /// Destructor
+  virtual ~PerfCounters();
+
+  /**
+     Start counting a region, leaving the current one if any.
+
+     \param region the region
+   */
+  void enter(uint32_t region);
+
+  /// Stop counting the current region.
+  void leave();
+
+  /**
+     Add another PerfCounters' counts to this one's.
+
+     \param other counters for the same regions
+   */
+  void add(const PerfCounters& other);
+
+  /**
+     \param region a region
+
+     \param event an event
+
+     \return the number of times the event happened in the region
+   */
+  inline uint64_t count(uint32_t region, Event event) const {
+    return counts[region * NUM_EVENTS + event];
+  }
+
+  /// \return true if the event could be counted on every thread that
+  /// entered a region, and at least one did
+  inline bool counted(Event event) const {
+    return opened && supported[event];
+  }
+
+  /**
+     Log a region's counts, its instructions per cycle, and its misses per
+     unit of work.
+
+     \param logger the logger to log to
+
+     \param region the region
+
+     \param name the region's name, which prefixes the stat names
+
+     \param units the amount of work done in the region
+
+     \param unitName the name of a unit of work, such as "aligned_pair"
+   */
+  void logRegion(
+    StatLogger& logger, uint32_t region, const std::string& name,
+    uint64_t units, const std::string& unitName) const;
+
+  /**
+     \return a ratio of counts with three decimal places, or "-" if the
+     denominator is 0
+   */
+  static std::string ratio(uint64_t numerator, uint64_t denominator);
+
+  /// \return an event's name, for stat names
+  static const char* eventName(Event event);
+
+private:
+  void open();
+  void close();
+  void read(uint64_t* values);
+
+  const uint32_t numRegions;
+  // Counter file descriptors, -1 for events that aren't counted. The cycle
+  // counter leads the group, so the events are scheduled together.
+  int fds[NUM_EVENTS];
+  bool supported[NUM_EVENTS];
+  bool opened;
+  pid_t thread;
+  int32_t currentRegion;
+  // The scaled counter values when the current region was entered
+  uint64_t regionStart[NUM_EVENTS];
+  std::vector<uint64_t> counts;
+};
+
+#endif  // MAPRED_PERF_COUNTERS_H
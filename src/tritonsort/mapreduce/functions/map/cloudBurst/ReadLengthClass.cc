@@ -0,0 +1,54 @@
+#include <stdlib.h>
+
+#include "ReadLengthClass.h"
+#include "core/TritonSortAssert.h"
+
+ReadLengthClass::ReadLengthClass(
+  int32_t _minReadLen, int32_t _maxReadLen, uint32_t maxAlignDiff,
+  uint32_t index)
+  : minReadLen(_minReadLen),
+    maxReadLen(_maxReadLen),
+    classIndex(index) {
+  // Same sizing as a single-class job with these read lengths
+  seedLen = minReadLen/(maxAlignDiff + 1);
+  flankLen = maxReadLen - seedLen + maxAlignDiff;
+  ABORT_IF(seedLen < 1, "Reads of %d bases are too short to seed with %u "
+           "differences", minReadLen, maxAlignDiff);
+}
+
+void ReadLengthClass::parseClasses(
+  const std::string& specification, int32_t minReadLen, int32_t maxReadLen,
+  uint32_t maxAlignDiff, std::vector<ReadLengthClass>& classes) {
+  classes.clear();
+  int32_t classMin = minReadLen;
+  size_t start = 0;
+  while (start < specification.size()) {
+    size_t end = specification.find(',', start);
+    if (end == std::string::npos) {
+      end = specification.size();
+    }
+    int32_t classMax = atoi(specification.substr(start, end - start).c_str());
+    ABORT_IF(classMax < classMin || classMax >= maxReadLen,
+             "Read length class bound %d must be between %d and %d", classMax,
+             classMin, maxReadLen - 1);
+    classes.push_back(
+      ReadLengthClass(classMin, classMax, maxAlignDiff, classes.size()));
+    classMin = classMax + 1;
+    start = end + 1;
+  }
+  classes.push_back(
+    ReadLengthClass(classMin, maxReadLen, maxAlignDiff, classes.size()));
+  ABORT_IF(classes.size() > MAX_CLASSES, "Got %u read length classes, but at "
+           "most %u are supported", static_cast<uint32_t>(classes.size()),
+           MAX_CLASSES);
+}
+
+uint32_t ReadLengthClass::classify(
+  const std::vector<ReadLengthClass>& classes, int32_t readLength) {
+  uint32_t index = 0;
+  while (index + 1 < classes.size() &&
+         readLength > classes[index].maxReadLen) {
+    index++;
+  }
+  return index;
+}
@@ -0,0 +1,102 @@
+#ifndef _READ_LENGTH_CLASS_H_
+#define _READ_LENGTH_CLASS_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+   A range of read lengths that share a seed length and flank length.
+
+   Seeds must be short enough that a read of the shortest length in the range
+   splits into K+1 of them, and reference flanks long enough to cover a read
+   of the longest length. With a single class those are sized for the
+   shortest and longest reads in the whole dataset, so splitting a mixed
+   dataset into classes gives long reads longer, more selective seeds and
+   short reads shorter flanks.
+
+   Every class is seeded separately: the reference emits one set of tuples per
+   class, and when there is more than one class every key carries its class
+   index so classes are never grouped together. Each read belongs to exactly
+   one class, so the classes' alignments merge without duplicates.
+ */
+class ReadLengthClass {
+public:
+  /// The most classes a job may use, limited by the MerRecord header
+  static const uint32_t MAX_CLASSES = 4;
+
+  /// Constructor
+  /**
+     \param minReadLen the length of the shortest read in the class
+
+     \param maxReadLen the length of the longest read in the class
+
+     \param maxAlignDiff the maximum number of differences to allow
+
+     \param index the class's position in the job's list of classes
+   */
+  ReadLengthClass(
+    int32_t minReadLen, int32_t maxReadLen, uint32_t maxAlignDiff,
+    uint32_t index);
+
+  /**
+     Split the job's read lengths into classes.
+
+     \param specification a comma-separated, increasing list of the longest
+     read length in every class but the last, such as "50,100" for the
+     classes [minReadLen, 50], [51, 100] and [101, maxReadLen]; an empty list
+     means a single class
+
+     \param minReadLen the length of the shortest read
+
+     \param maxReadLen the length of the longest read
+
+     \param maxAlignDiff the maximum number of differences to allow
+
+     \param[out] classes the classes, in order of read length
+   */
+  static void parseClasses(
+    const std::string& specification, int32_t minReadLen, int32_t maxReadLen,
+    uint32_t maxAlignDiff, std::vector<ReadLengthClass>& classes);
+
+  /**
+     \return the index of the class a read belongs to; reads outside the job's
+     read lengths go to the first or last class
+   */
+  static uint32_t classify(
+    const std::vector<ReadLengthClass>& classes, int32_t readLength);
+
+  /// \return the length of the seeds of reads in this class
+  inline int32_t seedLength() const {
+    return seedLen;
+  }
+
+  /// \return the length of the reference flanks this class needs
+  inline int32_t flankLength() const {
+    return flankLen;
+  }
+
+  /// \return the length of the shortest read in this class
+  inline int32_t minReadLength() const {
+    return minReadLen;
+  }
+
+  /// \return the length of the longest read in this class
+  inline int32_t maxReadLength() const {
+    return maxReadLen;
+  }
+
+  /// \return the class's position in the job's list of classes
+  inline uint32_t index() const {
+    return classIndex;
+  }
+
+private:
+  int32_t minReadLen;
+  int32_t maxReadLen;
+  int32_t seedLen;
+  int32_t flankLen;
+  uint32_t classIndex;
+};
+
+#endif  // _READ_LENGTH_CLASS_H_
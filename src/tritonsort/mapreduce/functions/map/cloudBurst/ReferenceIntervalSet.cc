@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <errno.h>
+#include <fstream>
+#include <sstream>
+#include <string.h>
+
+#include "ReferenceIntervalSet.h"
+#include "core/TritonSortAssert.h"
+
+ReferenceIntervalSet::ReferenceIntervalSet() {
+}
+
+void ReferenceIntervalSet::load(const std::string& path) {
+  std::ifstream file(path.c_str());
+  ABORT_IF(!file.is_open(), "Failed to open CloudBurst reference interval "
+           "file %s: %s", path.c_str(), strerror(errno));
+
+  std::string line;
+  for (uint64_t lineNumber = 1; std::getline(file, line); lineNumber++) {
+    std::string::size_type first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos || line[first] == '#') {
+      continue;
+    }
+    std::istringstream fields(line);
+    int64_t refID;
+    int64_t start;
+    int64_t end;
+    ABORT_IF(!(fields >> refID >> start >> end) || start < 0 || end < start,
+             "Line %llu of CloudBurst reference interval file %s is not "
+             "'<reference id> <start> <end>'", lineNumber, path.c_str());
+    add(refID, start, end);
+  }
+}
+
+void ReferenceIntervalSet::add(int64_t refID, int64_t start, int64_t end) {
+  if (start >= end) {
+    return;
+  }
+  IntervalList& list = intervals[refID];
+
+  // Absorb every interval that overlaps or touches the new one
+  IntervalList::iterator first = std::lower_bound(
+    list.begin(), list.end(), std::make_pair(start, start));
+  if (first != list.begin() && (first - 1)->second >= start) {
+    first--;
+  }
+  IntervalList::iterator last = first;
+  while (last != list.end() && last->first <= end) {
+    start = std::min(start, last->first);
+    end = std::max(end, last->second);
+    last++;
+  }
+  first = list.erase(first, last);
+  list.insert(first, std::make_pair(start, end));
+}
+
+bool ReferenceIntervalSet::overlaps(
+  int64_t refID, int64_t start, int64_t end) const {
+  IntervalMap::const_iterator iter = intervals.find(refID);
+  if (iter == intervals.end() || start >= end) {
+    return false;
+  }
+  const IntervalList& list = iter->second;
+
+  // Intervals are disjoint, so only the last one starting before end can
+  // reach past start
+  IntervalList::const_iterator next = std::lower_bound(
+    list.begin(), list.end(), std::make_pair(end, end));
+  return next != list.begin() && (next - 1)->second > start;
+}
+
+void ReferenceIntervalSet::clip(
+  int64_t refID, int64_t start, int64_t end,
+  std::vector<std::pair<int64_t, int64_t> >& clipped) const {
+  clipped.clear();
+  IntervalMap::const_iterator iter = intervals.find(refID);
+  if (iter == intervals.end() || start >= end) {
+    return;
+  }
+  const IntervalList& list = iter->second;
+
+  IntervalList::const_iterator interval = std::lower_bound(
+    list.begin(), list.end(), std::make_pair(start, start));
+  if (interval != list.begin() && (interval - 1)->second > start) {
+    interval--;
+  }
+  for (; interval != list.end() && interval->first < end; interval++) {
+    clipped.push_back(std::make_pair(
+      std::max(interval->first, start), std::min(interval->second, end)));
+  }
+}
+
+uint64_t ReferenceIntervalSet::length() const {
+  uint64_t total = 0;
+  for (IntervalMap::const_iterator iter = intervals.begin();
+       iter != intervals.end(); iter++) {
+    for (IntervalList::const_iterator interval = iter->second.begin();
+         interval != iter->second.end(); interval++) {
+      total += interval->second - interval->first;
+    }
+  }
+  return total;
+}
@@ -0,0 +1,86 @@
+#ifndef _REFERENCE_INTERVAL_SET_H_
+#define _REFERENCE_INTERVAL_SET_H_
+
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+   A set of half-open intervals of reference sequences, such as the regions
+   of a reference assembly that changed in a patch. Intervals are read from a
+   text file with one interval per line:
+
+     <reference id> <start> <end>
+
+   Offsets are 0-based positions in the reference sequence with the given
+   id. Blank lines and lines starting with '#' are skipped. Overlapping and
+   adjacent intervals are merged.
+ */
+class ReferenceIntervalSet {
+public:
+  /// Constructor; the set starts out empty
+  ReferenceIntervalSet();
+
+  /**
+     Add the intervals in a file to the set.
+
+     \param path the file to read
+   */
+  void load(const std::string& path);
+
+  /**
+     Add an interval to the set.
+
+     \param refID the reference id
+
+     \param start the first position of the interval
+
+     \param end one past the last position of the interval
+   */
+  void add(int64_t refID, int64_t start, int64_t end);
+
+  /**
+     \param refID the reference id
+
+     \param start the first position of a range
+
+     \param end one past the last position of the range
+
+     \return true if the range overlaps an interval in the set
+   */
+  bool overlaps(int64_t refID, int64_t start, int64_t end) const;
+
+  /**
+     Find the parts of the set's intervals that fall within a range.
+
+     \param refID the reference id
+
+     \param start the first position of the range
+
+     \param end one past the last position of the range
+
+     \param[out] clipped the intervals within the range, in order
+   */
+  void clip(
+    int64_t refID, int64_t start, int64_t end,
+    std::vector<std::pair<int64_t, int64_t> >& clipped) const;
+
+  /// \return true if the set has no intervals
+  bool empty() const {
+    return intervals.empty();
+  }
+
+  /// \return the total length of the intervals in the set
+  uint64_t length() const;
+
+private:
+  typedef std::vector<std::pair<int64_t, int64_t> > IntervalList;
+  typedef std::map<int64_t, IntervalList> IntervalMap;
+
+  // Each reference's intervals are kept sorted, merged and disjoint
+  IntervalMap intervals;
+};
+
+#endif  // _REFERENCE_INTERVAL_SET_H_
@@ -0,0 +1,47 @@
+#include "SeedMask.h"
+#include "core/TritonSortAssert.h"
+
+SeedMask::SeedMask(const std::string& _pattern, uint32_t index)
+  : pattern(_pattern),
+    maskIndex(index) {
+  ABORT_IF(pattern.empty(), "Seed mask %u is empty", index);
+  ABORT_IF(pattern[0] != '1' || pattern[pattern.size() - 1] != '1',
+           "Seed mask '%s' must start and end with a care position",
+           pattern.c_str());
+  for (uint32_t i = 0; i < pattern.size(); i++) {
+    ABORT_IF(pattern[i] != '0' && pattern[i] != '1',
+             "Seed mask '%s' may only contain 0's and 1's", pattern.c_str());
+    if (pattern[i] == '1') {
+      carePositions.push_back(i);
+    }
+  }
+}
+
+void SeedMask::parseMasks(
+  const std::string& specification, std::vector<SeedMask>& masks) {
+  masks.clear();
+  size_t start = 0;
+  while (start < specification.size()) {
+    size_t end = specification.find(',', start);
+    if (end == std::string::npos) {
+      end = specification.size();
+    }
+    masks.push_back(
+      SeedMask(specification.substr(start, end - start), masks.size()));
+    start = end + 1;
+  }
+  ABORT_IF(masks.size() > MAX_MASKS, "Got %u seed masks, but at most %u are "
+           "supported", static_cast<uint32_t>(masks.size()), MAX_MASKS);
+}
+
+bool SeedMask::hits(
+  const std::vector<uint8_t>& badPositions, int32_t start) const {
+  for (uint32_t i = 0; i < pattern.size(); i++) {
+    uint8_t flags = badPositions[start + i];
+    if (((flags & DIFFERENT_BASE) && pattern[i] == '1') ||
+        ((flags & DIAGONAL_CHANGE) && i > 0)) {
+      return false;
+    }
+  }
+  return true;
+}
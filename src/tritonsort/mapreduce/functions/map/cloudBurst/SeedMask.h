@@ -0,0 +1,90 @@
+#ifndef _SEED_MASK_H_
+#define _SEED_MASK_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+typedef uint8_t byte;
+
+/**
+   A spaced seed: a pattern of care ('1') and don't-care ('0') positions laid
+   over a window of a sequence. Only the bases at care positions are part of
+   the seed, so two windows share a seed even if they differ at don't-care
+   positions. A mask of all 1's is an ordinary contiguous seed.
+
+   A job can use several masks at once. Each is identified by its index in the
+   mask specification, which is recorded in every MerRecord and, if there is
+   more than one mask, appended to every key so seeds from different masks are
+   never grouped together.
+ */
+class SeedMask {
+public:
+  /// The most masks a job may use, limited by the MerRecord header
+  static const uint32_t MAX_MASKS = 4;
+
+  /// Constructor
+  /**
+     \param pattern a string of 1's and 0's that starts and ends with a 1
+
+     \param index the mask's position in the job's list of masks
+   */
+  SeedMask(const std::string& pattern, uint32_t index);
+
+  /**
+     Parse a comma-separated list of mask patterns, such as
+     "1101101101,1110010111".
+
+     \param specification the list of patterns; an empty list means
+     contiguous seeds
+
+     \param[out] masks the parsed masks, in order
+   */
+  static void parseMasks(
+    const std::string& specification, std::vector<SeedMask>& masks);
+
+  /// \return the number of bases the mask covers
+  inline uint32_t span() const {
+    return pattern.size();
+  }
+
+  /// \return the number of care positions
+  inline uint32_t weight() const {
+    return carePositions.size();
+  }
+
+  /// \return the mask's position in the job's list of masks
+  inline uint32_t index() const {
+    return maskIndex;
+  }
+
+  /// \return true if position i of the window is a care position
+  inline bool isCare(uint32_t i) const {
+    return pattern[i] == '1';
+  }
+
+  /// \return the offsets of the care positions within the window, ascending
+  inline const std::vector<int32_t>& care() const {
+    return carePositions;
+  }
+
+  /// Flags for hits(): the read base differs from the reference
+  static const uint8_t DIFFERENT_BASE = 0x01;
+  /// Flags for hits(): the alignment changes diagonal before this position
+  static const uint8_t DIAGONAL_CHANGE = 0x02;
+
+  /**
+     \return true if the window starting at position start of a read has no
+     care position flagged DIFFERENT_BASE and no position after its first
+     flagged DIAGONAL_CHANGE in badPositions, so the read's seed there matches
+     the reference exactly
+   */
+  bool hits(const std::vector<uint8_t>& badPositions, int32_t start) const;
+
+private:
+  std::string pattern;
+  std::vector<int32_t> carePositions;
+  uint32_t maskIndex;
+};
+
+#endif  // _SEED_MASK_H_
@@ -0,0 +1,81 @@
+#include <errno.h>
+#include <string.h>
+
+#include "TupleFile.h"
+#include "core/TritonSortAssert.h"
+#include "mapreduce/common/KeyValuePair.h"
+
+TupleFile::TupleFile() {
+}
+
+void TupleFile::load(const std::string& _path) {
+  path = _path;
+  bytes.clear();
+  offsets.clear();
+
+  FILE* file = fopen(path.c_str(), "rb");
+  ABORT_IF(file == NULL, "Failed to open tuple file %s: %s", path.c_str(),
+           strerror(errno));
+  uint8_t chunk[65536];
+  size_t bytesRead;
+  while ((bytesRead = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+    bytes.insert(bytes.end(), chunk, chunk + bytesRead);
+  }
+  ABORT_IF(ferror(file), "Failed to read tuple file %s: %s", path.c_str(),
+           strerror(errno));
+  fclose(file);
+
+  uint64_t offset = 0;
+  while (offset < bytes.size()) {
+    uint32_t keyLength;
+    uint32_t valueLength;
+    ABORT_IF(bytes.size() - offset < 2 * sizeof(uint32_t),
+             "Tuple file %s ends in a partial tuple header", path.c_str());
+    memcpy(&keyLength, &bytes[offset], sizeof(keyLength));
+    memcpy(&valueLength, &bytes[offset + sizeof(keyLength)],
+           sizeof(valueLength));
+    ABORT_IF(bytes.size() - offset - 2 * sizeof(uint32_t) <
+             static_cast<uint64_t>(keyLength) + valueLength,
+             "Tuple file %s ends in a partial tuple", path.c_str());
+    offsets.push_back(offset);
+    offset += 2 * sizeof(uint32_t) + keyLength + valueLength;
+  }
+}
+
+void TupleFile::get(uint64_t index, KeyValuePair& kvPair) const {
+  const uint8_t* tuple = &bytes[offsets[index]];
+  uint32_t keyLength;
+  uint32_t valueLength;
+  memcpy(&keyLength, tuple, sizeof(keyLength));
+  memcpy(&valueLength, tuple + sizeof(keyLength), sizeof(valueLength));
+  tuple += 2 * sizeof(uint32_t);
+  kvPair.setKey(tuple, keyLength);
+  kvPair.setValue(tuple + keyLength, valueLength);
+}
+
+void TupleFile::write(
+  FILE* file, const uint8_t* key, uint32_t keyLength, const uint8_t* value,
+  uint32_t valueLength) {
+  ABORT_IF(fwrite(&keyLength, sizeof(keyLength), 1, file) != 1 ||
+           fwrite(&valueLength, sizeof(valueLength), 1, file) != 1 ||
+           (keyLength > 0 && fwrite(key, keyLength, 1, file) != 1) ||
+           (valueLength > 0 && fwrite(value, valueLength, 1, file) != 1),
+           "Failed to write tuple: %s", strerror(errno));
+}
+
+void TupleFile::append(
+  std::vector<uint8_t>& buffer, const uint8_t* key, uint32_t keyLength,
+  const uint8_t* value, uint32_t valueLength) {
+  uint64_t offset = buffer.size();
+  buffer.resize(offset + 2 * sizeof(uint32_t) + keyLength + valueLength);
+  uint8_t* tuple = &buffer[offset];
+  memcpy(tuple, &keyLength, sizeof(keyLength));
+  memcpy(tuple + sizeof(keyLength), &valueLength, sizeof(valueLength));
+  tuple += 2 * sizeof(uint32_t);
+  if (keyLength > 0) {
+    memcpy(tuple, key, keyLength);
+  }
+  if (valueLength > 0) {
+    memcpy(tuple + keyLength, value, valueLength);
+  }
+}
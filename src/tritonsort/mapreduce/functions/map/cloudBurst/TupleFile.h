@@ -0,0 +1,82 @@
+#ifndef MAPRED_TUPLE_FILE_H
+#define MAPRED_TUPLE_FILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+class KeyValuePair;
+
+/**
+   A file of tuples read whole into memory, such as a converted CloudBurst
+   input file or an alignment output file. Each tuple is laid out as a 32-bit
+   key length, a 32-bit value length, the key and the value.
+ */
+class TupleFile {
+public:
+  /// Constructor
+  TupleFile();
+
+  /**
+     Read a file, replacing any tuples read before.
+
+     \param path the file's path
+   */
+  void load(const std::string& path);
+
+  /// \return the number of tuples in the file
+  inline uint64_t size() const {
+    return offsets.size();
+  }
+
+  /**
+     Point a KeyValuePair at a tuple. It stays valid until the next load().
+
+     \param index the tuple's index
+
+     \param[out] kvPair the tuple
+   */
+  void get(uint64_t index, KeyValuePair& kvPair) const;
+
+  /**
+     Append a tuple to a file.
+
+     \param file the file
+
+     \param key the key
+
+     \param keyLength the length of the key
+
+     \param value the value
+
+     \param valueLength the length of the value
+   */
+  static void write(
+    FILE* file, const uint8_t* key, uint32_t keyLength, const uint8_t* value,
+    uint32_t valueLength);
+
+  /**
+     Append a tuple, laid out as in a file, to a buffer.
+
+     \param buffer the buffer
+
+     \param key the key
+
+     \param keyLength the length of the key
+
+     \param value the value
+
+     \param valueLength the length of the value
+   */
+  static void append(
+    std::vector<uint8_t>& buffer, const uint8_t* key, uint32_t keyLength,
+    const uint8_t* value, uint32_t valueLength);
+
+private:
+  std::string path;
+  std::vector<uint8_t> bytes;
+  std::vector<uint64_t> offsets;
+};
+
+#endif  // MAPRED_TUPLE_FILE_H
@@ -0,0 +1,68 @@
+#ifndef _VARINT_H_
+#define _VARINT_H_
+
+#include <stdint.h>
+
+/**
+   LEB128 variable-length integers: 7 bits per byte, least significant group
+   first, with the high bit set on every byte but the last. Values below 128
+   take one byte and a uint64_t takes at most MAX_LENGTH bytes.
+ */
+class Varint {
+public:
+  /// The most bytes a uint64_t can take
+  static const uint32_t MAX_LENGTH = 10;
+
+  /**
+     Encode a value.
+
+     \param value the value to encode
+
+     \param[out] out the buffer to write to, with room for MAX_LENGTH bytes
+
+     \return the number of bytes written
+   */
+  static inline uint32_t encode(uint64_t value, uint8_t* out) {
+    uint32_t length = 0;
+    while (value >= 0x80) {
+      out[length++] = static_cast<uint8_t>(value) | 0x80;
+      value >>= 7;
+    }
+    out[length++] = static_cast<uint8_t>(value);
+    return length;
+  }
+
+  /**
+     Decode a value.
+
+     \param in the encoded value
+
+     \param[out] value the decoded value
+
+     \return the number of bytes read
+   */
+  static inline uint32_t decode(const uint8_t* in, uint64_t& value) {
+    value = 0;
+    uint32_t length = 0;
+    uint32_t shift = 0;
+    uint8_t byte;
+    do {
+      byte = in[length++];
+      value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+      shift += 7;
+    } while ((byte & 0x80) && length < MAX_LENGTH);
+    return length;
+  }
+
+  /// \return the number of bytes encode() would write for a value
+  static inline uint32_t length(uint64_t value) {
+    uint32_t length = 1;
+    while (value >= 0x80) {
+      value >>= 7;
+      length++;
+    }
+    return length;
+  }
+};
+
+#endif  // _VARINT_H_
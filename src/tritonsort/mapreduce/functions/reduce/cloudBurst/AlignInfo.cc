@@ -56,3 +56,21 @@ bool AlignInfo::isBazeaYatesSeed(int32_t qlen, int32_t kmerlen) {
   return (lastbucket == numBuckets-1);
 }
 
+// differencePositions
+// Walk the differences the way isBazeaYatesSeed does, recording where each
+// one falls in the query
+int32_t AlignInfo::differencePositions(int32_t* positions, int32_t* kinds) {
+  int32_t count = 0;
+  int32_t pos = 0;
+  for (int32_t i = 0; i < distlen; i++) {
+    pos += dist[i];
+    if (weightMatrix[i] == 2) {
+      // end of string
+      continue;
+    }
+    positions[count] = pos;
+    kinds[count] = weightMatrix[i];
+    count++;
+  }
+  return count;
+}
@@ -17,6 +17,13 @@ public:
   // see if the current alignment is the leftmost alignment by checking for
   // differences in the proceeding chunks of the query
   bool isBazeaYatesSeed(int32_t qlen, int32_t kmerlen);
+  // ------------------------ differencePositions -------------------------
+  // Write the query position of every difference to positions and its kind
+  // to kinds: 0 for a mismatch, -1 for a text base missing from the query
+  // (between positions - 1 and positions) and +1 for a query base missing
+  // from the text. Both need room for differences entries. Returns the
+  // number written.
+  int32_t differencePositions(int32_t* positions, int32_t* kinds);
 private:
   int32_t* dist;
   int32_t* weightMatrix;
@@ -0,0 +1,134 @@
+#include "AlignmentCodec.h"
+#include "core/TritonSortAssert.h"
+
+const uint8_t AlignmentCodec::NO_POSITION;
+
+AlignmentCodec::Format AlignmentCodec::parseFormat(const std::string& name) {
+  if (name == "records") {
+    return RECORDS;
+  } else if (name == "grouped") {
+    return GROUPED;
+  }
+  ABORT("Unknown CloudBurst alignment format '%s'; expected 'records' or "
+        "'grouped'", name.c_str());
+  return RECORDS;
+}
+
+uint32_t AlignmentCodec::encodeHit(
+  const AlignmentRecord& alignment, uint8_t* out) {
+  uint32_t length = 1;
+  if (alignment.isRepetitiveMarker()) {
+    out[0] = AlignmentRecord::REPETITIVE_FLAG | NO_POSITION;
+  } else {
+    out[0] = alignment.flags();
+    length += Varint::encode(alignment.refID, out + length);
+    length += Varint::encode(alignment.refStart, out + length);
+    length += Varint::encode(
+      alignment.refEnd - alignment.refStart, out + length);
+  }
+  length += Varint::encode(alignment.differences, out + length);
+  return length;
+}
+
+uint32_t AlignmentCodec::decodeHit(
+  const uint8_t* in, AlignmentRecord& alignment) {
+  uint8_t flags = in[0];
+  uint32_t length = 1;
+  uint64_t value;
+  alignment.isRC = (flags & AlignmentRecord::RC_FLAG) != 0;
+  alignment.isAmbiguous = (flags & AlignmentRecord::AMBIGUOUS_FLAG) != 0;
+  alignment.isRepetitive = (flags & AlignmentRecord::REPETITIVE_FLAG) != 0;
+  if (flags & NO_POSITION) {
+    alignment.refID = -1;
+    alignment.refStart = -1;
+    alignment.refEnd = -1;
+  } else {
+    length += Varint::decode(in + length, value);
+    alignment.refID = value;
+    length += Varint::decode(in + length, value);
+    alignment.refStart = value;
+    length += Varint::decode(in + length, value);
+    alignment.refEnd = alignment.refStart + value;
+  }
+  length += Varint::decode(in + length, value);
+  alignment.differences = value;
+  return length;
+}
+
+void AlignmentCodec::encodeCoordinateKey(
+  int64_t refID, int64_t refStart, uint8_t* key) {
+  ASSERT(refID >= 0 && refStart >= 0, "Coordinates must not be negative");
+  for (int32_t i = 0; i < 8; i++) {
+    key[i] = static_cast<uint8_t>(refID >> (8 * (7 - i)));
+    key[8 + i] = static_cast<uint8_t>(refStart >> (8 * (7 - i)));
+  }
+}
+
+void AlignmentCodec::decodeCoordinateKey(
+  const uint8_t* key, int64_t& refID, int64_t& refStart) {
+  refID = 0;
+  refStart = 0;
+  for (int32_t i = 0; i < 8; i++) {
+    refID = (refID << 8) | key[i];
+    refStart = (refStart << 8) | key[8 + i];
+  }
+}
+
+uint32_t AlignmentCodec::encodeBlockHit(
+  const CoordinateHit& hit, const CoordinateHit& previous, uint8_t* out) {
+  ASSERT(hit.refID > previous.refID ||
+         (hit.refID == previous.refID && hit.refStart >= previous.refStart),
+         "Coordinate block hits must be in order");
+  uint32_t length = Varint::encode(hit.refID - previous.refID, out);
+  if (hit.refID == previous.refID) {
+    length += Varint::encode(hit.refStart - previous.refStart, out + length);
+  } else {
+    length += Varint::encode(hit.refStart, out + length);
+  }
+  length += Varint::encode(hit.readID, out + length);
+  length += Varint::encode(hit.refEnd - hit.refStart, out + length);
+  length += Varint::encode(hit.differences, out + length);
+  out[length++] = hit.flags;
+  return length;
+}
+
+uint32_t AlignmentCodec::decodeBlockHit(
+  const uint8_t* in, const CoordinateHit& previous, CoordinateHit& hit) {
+  uint64_t value;
+  uint32_t length = Varint::decode(in, value);
+  hit.refID = previous.refID + value;
+  length += Varint::decode(in + length, value);
+  hit.refStart = value;
+  if (hit.refID == previous.refID) {
+    hit.refStart += previous.refStart;
+  }
+  length += Varint::decode(in + length, value);
+  hit.readID = value;
+  length += Varint::decode(in + length, value);
+  hit.refEnd = hit.refStart + value;
+  length += Varint::decode(in + length, value);
+  hit.differences = value;
+  hit.flags = in[length++];
+  return length;
+}
+
+void AlignmentCodec::decodeBlock(
+  const uint8_t* key, const uint8_t* value, uint64_t valueLength,
+  std::vector<CoordinateHit>& hits) {
+  // The first hit is encoded relative to the block key
+  CoordinateHit previous;
+  decodeCoordinateKey(key, previous.refID, previous.refStart);
+
+  uint64_t count;
+  uint64_t offset = Varint::decode(value, count);
+  for (uint64_t i = 0; i < count; i++) {
+    ABORT_IF(offset >= valueLength, "Coordinate block is truncated after "
+             "%llu of %llu hits", i, count);
+    CoordinateHit hit;
+    offset += decodeBlockHit(value + offset, previous, hit);
+    hits.push_back(hit);
+    previous = hit;
+  }
+  ABORT_IF(offset != valueLength, "Coordinate block of %llu hits is %llu "
+           "bytes but its hits take %llu", count, valueLength, offset);
+}
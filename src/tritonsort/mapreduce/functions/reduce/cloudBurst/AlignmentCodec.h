@@ -0,0 +1,180 @@
+#ifndef _ALIGNMENT_CODEC_H_
+#define _ALIGNMENT_CODEC_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "AlignmentRecord.h"
+#include "mapreduce/functions/map/cloudBurst/Varint.h"
+
+/**
+   One alignment in the coordinate-sorted layout, which also carries the id
+   of the aligned read.
+ */
+struct CoordinateHit {
+  int64_t refID;
+  int64_t refStart;
+  int64_t refEnd;
+  int64_t readID;
+  int32_t differences;
+  /// AlignmentRecord flag bits
+  uint8_t flags;
+};
+
+/**
+   Compact encodings of CloudBurst alignments.
+
+   Grouped format: the value of one record per read, keyed by read id like
+   AlignmentRecord output, holding all of the read's alignments:
+
+     hit count        varint
+     per hit:
+       flags          1 byte   AlignmentRecord flag bits, plus NO_POSITION
+                               for a repetitive read marker
+       reference id   varint   omitted for markers
+       start          varint   omitted for markers
+       length         varint   end - start, omitted for markers
+       differences    varint
+
+   Coordinate-sorted format: hits are keyed by reference id and start, as
+   8-byte big-endian integers so that the sort orders them by position, and
+   packed into blocks. A block is keyed by its first hit's coordinates, so
+   the keys of a file of blocks form a sparse index that a reader can search,
+   skipping the values of blocks before the range it wants. Hits may start up
+   to a read length before a range and still overlap it. A block's value is:
+
+     hit count        varint
+     per hit:
+       reference id   varint   minus the previous hit's, or the block key's
+       start          varint   minus the previous hit's if the reference id
+                               is the same, otherwise absolute
+       read id        varint
+       length         varint
+       differences    varint
+       flags          1 byte
+ */
+class AlignmentCodec {
+public:
+  /// Alignment output formats
+  enum Format {
+    /// One AlignmentRecord per alignment
+    RECORDS,
+    /// One grouped record per read
+    GROUPED
+  };
+
+  /// Grouped format flag for a hit with no position
+  static const uint8_t NO_POSITION = 0x80;
+
+  /// The most bytes encodeHit() writes
+  static const uint32_t MAX_HIT_LENGTH = 1 + 4 * Varint::MAX_LENGTH;
+
+  /// The length of a coordinate key
+  static const uint32_t COORDINATE_KEY_LENGTH = 16;
+
+  /// The most bytes encodeBlockHit() writes
+  static const uint32_t MAX_BLOCK_HIT_LENGTH = 1 + 5 * Varint::MAX_LENGTH;
+
+  /**
+     \param name "records" or "grouped"
+
+     \return the format with that name
+   */
+  static Format parseFormat(const std::string& name);
+
+  /**
+     Encode one hit of a grouped record.
+
+     \param alignment the alignment
+
+     \param[out] out the buffer to write to, with room for MAX_HIT_LENGTH
+     bytes
+
+     \return the number of bytes written
+   */
+  static uint32_t encodeHit(const AlignmentRecord& alignment, uint8_t* out);
+
+  /**
+     Decode one hit of a grouped record. A marker decodes with a reference
+     id, start and end of -1.
+
+     \param in the encoded hit
+
+     \param[out] alignment the decoded alignment
+
+     \return the number of bytes read
+   */
+  static uint32_t decodeHit(const uint8_t* in, AlignmentRecord& alignment);
+
+  /**
+     Encode a coordinate key.
+
+     \param refID the reference id
+
+     \param refStart the start of the alignment in the reference
+
+     \param[out] key the buffer to write COORDINATE_KEY_LENGTH bytes to
+   */
+  static void encodeCoordinateKey(
+    int64_t refID, int64_t refStart, uint8_t* key);
+
+  /**
+     Decode a coordinate key.
+
+     \param key the key
+
+     \param[out] refID the reference id
+
+     \param[out] refStart the start of the alignment in the reference
+   */
+  static void decodeCoordinateKey(
+    const uint8_t* key, int64_t& refID, int64_t& refStart);
+
+  /**
+     Encode a hit of a coordinate block.
+
+     \param hit the hit
+
+     \param previous the previous hit in the block; for the first hit, its
+     reference id and start must be the block key's
+
+     \param[out] out the buffer to write to, with room for
+     MAX_BLOCK_HIT_LENGTH bytes
+
+     \return the number of bytes written
+   */
+  static uint32_t encodeBlockHit(
+    const CoordinateHit& hit, const CoordinateHit& previous, uint8_t* out);
+
+  /**
+     Decode a hit of a coordinate block.
+
+     \param in the encoded hit
+
+     \param previous the previous hit in the block, as for encodeBlockHit()
+
+     \param[out] hit the decoded hit
+
+     \return the number of bytes read
+   */
+  static uint32_t decodeBlockHit(
+    const uint8_t* in, const CoordinateHit& previous, CoordinateHit& hit);
+
+  /**
+     Decode every hit of a coordinate block.
+
+     \param key the block key
+
+     \param value the block value
+
+     \param valueLength the length of the block value
+
+     \param[out] hits the vector the block's hits are appended to
+   */
+  static void decodeBlock(
+    const uint8_t* key, const uint8_t* value, uint64_t valueLength,
+    std::vector<CoordinateHit>& hits);
+};
+
+#endif  // _ALIGNMENT_CODEC_H_
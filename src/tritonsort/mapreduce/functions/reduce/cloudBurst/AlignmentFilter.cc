@@ -0,0 +1,105 @@
+#include <algorithm>
+
+#include "AlignmentFilter.h"
+
+AlignmentFilter::AlignmentFilter(uint32_t _maxAlignments)
+  : maxAlignments(_maxAlignments) {
+}
+
+void AlignmentFilter::add(int32_t readID, const AlignmentRecord& alignment) {
+  Alignment entry;
+  entry.readID = readID;
+  entry.refID = alignment.refID;
+  entry.refStart = alignment.refStart;
+  entry.refEnd = alignment.refEnd;
+  entry.differences = alignment.differences;
+  entry.isRC = alignment.isRC;
+  entry.isAmbiguous = alignment.isAmbiguous;
+  entry.isRepetitive = alignment.isRepetitive;
+  alignments.push_back(entry);
+}
+
+void AlignmentFilter::filter(bool flagAmbiguous) {
+  std::sort(alignments.begin(), alignments.end());
+
+  // Compact each read's run of alignments in place
+  uint32_t kept = 0;
+  uint32_t runStart = 0;
+  while (runStart < alignments.size()) {
+    int32_t readID = alignments[runStart].readID;
+    uint32_t keptStart = kept;
+    bool ambiguous = false;
+    bool repetitive = false;
+    Alignment marker;
+    uint32_t i = runStart;
+    for (; i < alignments.size() && alignments[i].readID == readID; i++) {
+      if (alignments[i].isRepetitive && alignments[i].refID < 0) {
+        // Markers are kept aside, and may be overwritten by compaction
+        marker = alignments[i];
+        repetitive = true;
+        continue;
+      }
+      if (i > runStart && alignments[i] == alignments[i - 1]) {
+        continue;
+      }
+      if (maxAlignments == 0 || kept - keptStart < maxAlignments) {
+        alignments[kept++] = alignments[i];
+      } else if (alignments[i].differences ==
+                 alignments[kept - 1].differences) {
+        ambiguous = true;
+      }
+    }
+    // An alignment that was already ambiguous stays ambiguous
+    for (uint32_t k = keptStart; k < kept; k++) {
+      alignments[k].isAmbiguous =
+        alignments[k].isAmbiguous || (flagAmbiguous && ambiguous);
+      alignments[k].isRepetitive = alignments[k].isRepetitive || repetitive;
+    }
+    if (repetitive) {
+      // The marker was skipped, so there is room for it before the next read
+      alignments[kept++] = marker;
+    }
+    runStart = i;
+  }
+  alignments.resize(kept);
+}
+
+void AlignmentFilter::get(uint32_t i, AlignmentRecord& alignment) const {
+  const Alignment& entry = alignments[i];
+  alignment.refID = entry.refID;
+  alignment.refStart = entry.refStart;
+  alignment.refEnd = entry.refEnd;
+  alignment.differences = entry.differences;
+  alignment.isRC = entry.isRC;
+  alignment.isAmbiguous = entry.isAmbiguous;
+  alignment.isRepetitive = entry.isRepetitive;
+}
+
+void AlignmentFilter::clear() {
+  alignments.clear();
+}
+
+bool AlignmentFilter::Alignment::operator<(const Alignment& other) const {
+  if (readID != other.readID) {
+    return readID < other.readID;
+  }
+  if (differences != other.differences) {
+    return differences < other.differences;
+  }
+  if (refID != other.refID) {
+    return refID < other.refID;
+  }
+  if (refStart != other.refStart) {
+    return refStart < other.refStart;
+  }
+  if (refEnd != other.refEnd) {
+    return refEnd < other.refEnd;
+  }
+  return isRC < other.isRC;
+}
+
+bool AlignmentFilter::Alignment::operator==(const Alignment& other) const {
+  return readID == other.readID && refID == other.refID &&
+    refStart == other.refStart && refEnd == other.refEnd &&
+    differences == other.differences && isRC == other.isRC;
+}
@@ -0,0 +1,99 @@
+#ifndef _ALIGNMENT_FILTER_H_
+#define _ALIGNMENT_FILTER_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "AlignmentRecord.h"
+
+/**
+   Keeps the best alignments of each read, after the original CloudBurst
+   FilterAlignments step.
+
+   Alignments are added along with the id of the read they align, and filter()
+   sorts each read's alignments by number of differences (then by reference
+   position, so the order is total), drops duplicates, which CloudBurst finds
+   once for every seed an alignment shares with the reference, and keeps the
+   first maxAlignments. If an alignment that was dropped has as few
+   differences as the worst one kept, the choice between them is arbitrary,
+   and the read's kept alignments can be flagged ambiguous.
+
+   Repetitive read markers (\sa AlignmentRecord::isRepetitiveMarker) do not
+   count against maxAlignments: a read with any markers keeps one, and its
+   kept alignments are flagged repetitive.
+
+   Since the order is total, any subset of a read's alignments ranks each of
+   its members at least as high as the full set does. Filtering each seed
+   group down to maxAlignments + 1 alignments before a final filter to
+   maxAlignments therefore loses nothing the final filter would keep, and
+   still lets it detect ties.
+ */
+class AlignmentFilter {
+public:
+  /// Constructor
+  /**
+     \param maxAlignments the number of alignments to keep per read, or 0 to
+     keep every distinct alignment
+   */
+  AlignmentFilter(uint32_t maxAlignments);
+
+  /**
+     Add an alignment.
+
+     \param readID the id of the aligned read
+
+     \param alignment the alignment
+   */
+  void add(int32_t readID, const AlignmentRecord& alignment);
+
+  /**
+     Sort and deduplicate the alignments, keeping the best maxAlignments of
+     each read.
+
+     \param flagAmbiguous if true, flag a read's kept alignments ambiguous if
+     an alignment that was dropped ties with them
+   */
+  void filter(bool flagAmbiguous);
+
+  /// \return the number of alignments held
+  inline uint32_t size() const {
+    return alignments.size();
+  }
+
+  /// \return the read id of the i'th alignment
+  inline int32_t readID(uint32_t i) const {
+    return alignments[i].readID;
+  }
+
+  /**
+     Copy the i'th alignment into an AlignmentRecord.
+
+     \param i the index of the alignment
+
+     \param[out] alignment the record to copy into
+   */
+  void get(uint32_t i, AlignmentRecord& alignment) const;
+
+  /// Drop all alignments
+  void clear();
+
+private:
+  struct Alignment {
+    int32_t readID;
+    int64_t refID;
+    int64_t refStart;
+    int64_t refEnd;
+    int32_t differences;
+    bool isRC;
+    bool isAmbiguous;
+    bool isRepetitive;
+
+    bool operator<(const Alignment& other) const;
+    bool operator==(const Alignment& other) const;
+  };
+
+  const uint32_t maxAlignments;
+  std::vector<Alignment> alignments;
+};
+
+#endif  // _ALIGNMENT_FILTER_H_
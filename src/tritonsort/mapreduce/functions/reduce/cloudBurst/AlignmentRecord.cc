@@ -1,15 +1,35 @@
 #include "AlignmentRecord.h"
 #include "core/MemoryUtils.h"
 
-// size 17 comes from the total size of the output format
-// which if of form number, number, number, number, flag
+const byte AlignmentRecord::RC_FLAG;
+const byte AlignmentRecord::AMBIGUOUS_FLAG;
+const byte AlignmentRecord::REPETITIVE_FLAG;
+const byte AlignmentRecord::WIDE_FLAG;
+const int32_t AlignmentRecord::NARROW_OUTPUT_SIZE;
+const int32_t AlignmentRecord::WIDE_OUTPUT_SIZE;
+
+namespace {
+  inline bool fitsInt32(int64_t value) {
+    return static_cast<int32_t>(value) == value;
+  }
+
+  template <typename T> inline const byte* readField(const byte* in, T& value) {
+    memcpy(&value, in, sizeof(value));
+    return in + sizeof(value);
+  }
+
+  template <typename T> inline byte* writeField(byte* out, T value) {
+    memcpy(out, &value, sizeof(value));
+    return out + sizeof(value);
+  }
+}
+
+// sbuffer is sized for the wide format so either format can be written
 AlignmentRecord::AlignmentRecord()
-  : outputSize(17),
-    refIDIndex(1),
-    refStartIndex(5),
-    refEndIndex(9),
-    refDifferencesIndex(13) {
-  sbuffer = new (themis::memcheck) byte[outputSize];
+  : outputSize(NARROW_OUTPUT_SIZE),
+    isAmbiguous(false),
+    isRepetitive(false) {
+  sbuffer = new (themis::memcheck) byte[WIDE_OUTPUT_SIZE];
 }
 
 AlignmentRecord::~AlignmentRecord() {
@@ -19,57 +39,51 @@ AlignmentRecord::~AlignmentRecord() {
 AlignmentRecord& AlignmentRecord::operator= (const AlignmentRecord& that) {
   if (this != &that) {
     if (that.sbuffer != NULL) {
-      memcpy(sbuffer, that.sbuffer, outputSize);
+      memcpy(sbuffer, that.sbuffer, WIDE_OUTPUT_SIZE);
     }
+    outputSize = that.outputSize;
     refID = that.refID;
     refStart = that.refStart;
     refEnd = that.refEnd;
     differences = that.differences;
     isRC = that.isRC;
+    isAmbiguous = that.isAmbiguous;
+    isRepetitive = that.isRepetitive;
   }
   return *this;
 }
 
-// size 17 comes from the total size of the output format
 AlignmentRecord::AlignmentRecord(
-  int32_t _refID, int32_t _refStart, int32_t _refEnd, int32_t _differences,
+  int64_t _refID, int64_t _refStart, int64_t _refEnd, int32_t _differences,
   bool _isRC)
-  : outputSize(17),
-    refIDIndex(1),
-    refStartIndex(5),
-    refEndIndex(9),
-    refDifferencesIndex(13),
+  : outputSize(NARROW_OUTPUT_SIZE),
     refID(_refID),
     refStart(_refStart),
     refEnd(_refEnd),
     differences(_differences),
-    isRC(_isRC) {
-  sbuffer = new (themis::memcheck) byte[outputSize];
+    isRC(_isRC),
+    isAmbiguous(false),
+    isRepetitive(false) {
+  sbuffer = new (themis::memcheck) byte[WIDE_OUTPUT_SIZE];
 }
 
 
-// size 17 comes from the total size of the output format
-AlignmentRecord::AlignmentRecord(AlignmentRecord& other)
-  : outputSize(17),
-    refIDIndex(1),
-    refStartIndex(5),
-    refEndIndex(9),
-    refDifferencesIndex(13) {
+AlignmentRecord::AlignmentRecord(const AlignmentRecord& other)
+  : outputSize(other.outputSize) {
+  sbuffer = new (themis::memcheck) byte[WIDE_OUTPUT_SIZE];
   refID = other.refID;
   refStart = other.refStart;
   refEnd = other.refEnd;
   differences = other.differences;
   isRC = other.isRC;
+  isAmbiguous = other.isAmbiguous;
+  isRepetitive = other.isRepetitive;
 }
 
 
-// size 17 comes from the total size of the output format
-AlignmentRecord::AlignmentRecord(byte* b)
-  : outputSize(17),
-    refIDIndex(1),
-    refStartIndex(5),
-    refEndIndex(9),
-    refDifferencesIndex(13) {
+AlignmentRecord::AlignmentRecord(const byte* b)
+  : outputSize(NARROW_OUTPUT_SIZE) {
+  sbuffer = new (themis::memcheck) byte[WIDE_OUTPUT_SIZE];
   fromBytes(b);
 }
 
@@ -79,21 +93,52 @@ void AlignmentRecord::set(AlignmentRecord other) {
   refEnd = other.refEnd;
   differences = other.differences;
   isRC = other.isRC;
+  isAmbiguous = other.isAmbiguous;
+  isRepetitive = other.isRepetitive;
+}
+
+byte AlignmentRecord::flags() const {
+  return (isRC ? RC_FLAG : 0) | (isAmbiguous ? AMBIGUOUS_FLAG : 0) |
+    (isRepetitive ? REPETITIVE_FLAG : 0);
 }
 
 byte* AlignmentRecord:: toBytes() {
-  sbuffer[0] = (byte) (isRC ? 1 : 0);
-  *(reinterpret_cast<int32_t*>(sbuffer + refIDIndex)) = refID;
-  *(reinterpret_cast<int32_t*>(sbuffer + refStartIndex)) = refStart;
-  *(reinterpret_cast<int32_t*>(sbuffer + refEndIndex)) = refEnd;
-  *(reinterpret_cast<int32_t*>(sbuffer + refDifferencesIndex)) = differences;
+  bool wide =
+    !fitsInt32(refID) || !fitsInt32(refStart) || !fitsInt32(refEnd);
+  sbuffer[0] = flags() | (wide ? WIDE_FLAG : 0);
+  byte* out = sbuffer + 1;
+  if (wide) {
+    out = writeField(out, refID);
+    out = writeField(out, refStart);
+    out = writeField(out, refEnd);
+  } else {
+    out = writeField(out, static_cast<int32_t>(refID));
+    out = writeField(out, static_cast<int32_t>(refStart));
+    out = writeField(out, static_cast<int32_t>(refEnd));
+  }
+  out = writeField(out, differences);
+  outputSize = out - sbuffer;
   return sbuffer;
 }
 
-void AlignmentRecord:: fromBytes(byte* raw) {
-  isRC = (raw[0] == 1);
-  memcpy(&refID, &raw[refIDIndex], sizeof(refID));
-  memcpy(&refStart, &raw[refStartIndex], sizeof(refStart));
-  memcpy(&refEnd, &raw[refEndIndex], sizeof(refEnd));
-  memcpy(&differences, &raw[refDifferencesIndex], sizeof(differences));
+void AlignmentRecord:: fromBytes(const byte* raw) {
+  isRC = (raw[0] & RC_FLAG) != 0;
+  isAmbiguous = (raw[0] & AMBIGUOUS_FLAG) != 0;
+  isRepetitive = (raw[0] & REPETITIVE_FLAG) != 0;
+  const byte* in = raw + 1;
+  if (raw[0] & WIDE_FLAG) {
+    in = readField(in, refID);
+    in = readField(in, refStart);
+    in = readField(in, refEnd);
+  } else {
+    int32_t narrow;
+    in = readField(in, narrow);
+    refID = narrow;
+    in = readField(in, narrow);
+    refStart = narrow;
+    in = readField(in, narrow);
+    refEnd = narrow;
+  }
+  readField(in, differences);
+  outputSize = sizeOf(raw[0]);
 }
@@ -7,28 +7,59 @@ typedef uint8_t byte;
 
 class AlignmentRecord {
 public:
+  /// Flag byte bits of the output format
+  static const byte RC_FLAG = 0x01;
+  static const byte AMBIGUOUS_FLAG = 0x02;
+  static const byte REPETITIVE_FLAG = 0x04;
+  /// Set when the reference id and positions are 8 bytes wide
+  static const byte WIDE_FLAG = 0x08;
+
+  /// Output format sizes: flag, reference id, start, end, differences with
+  /// 4 or 8 byte reference fields
+  static const int32_t NARROW_OUTPUT_SIZE = 17;
+  static const int32_t WIDE_OUTPUT_SIZE = 29;
+
   byte* sbuffer;
-  const int32_t outputSize;
-  const int32_t refIDIndex;
-  const int32_t refStartIndex;
-  const int32_t refEndIndex;
-  const int32_t refDifferencesIndex;
-  int32_t refID;
-  int32_t refStart;
-  int32_t refEnd;
+  // The size of the last toBytes() result. Records whose reference id and
+  // positions fit in 32 bits keep the original 17 byte format.
+  int32_t outputSize;
+  int64_t refID;
+  int64_t refStart;
+  int64_t refEnd;
   int32_t differences;
   bool isRC;
+  // Set by the alignment filter when the read's best alignments tie with
+  // alignments that were dropped
+  bool isAmbiguous;
+  // Set when the read hit the reducer's per-seed cap, so some of its
+  // alignments may be missing. The reducer writes a marker record with this
+  // flag and no reference position when the cap is hit.
+  bool isRepetitive;
   AlignmentRecord();
-  AlignmentRecord(AlignmentRecord& other);
-  AlignmentRecord(byte* b);
+  AlignmentRecord(const AlignmentRecord& other);
+  AlignmentRecord(const byte* b);
   virtual ~AlignmentRecord();
   AlignmentRecord& operator= (const AlignmentRecord& that);
   AlignmentRecord(
-    int32_t refid, int32_t refstart, int32_t refend,
+    int64_t refid, int64_t refstart, int64_t refend,
     int32_t differences, bool rc);
   void set(AlignmentRecord other);
   byte* toBytes();
-  void fromBytes(byte* raw);
+  void fromBytes(const byte* raw);
+
+  /// \return the flag bits of this record, without WIDE_FLAG
+  byte flags() const;
+
+  /// \return the size of a serialized record that starts with this flag byte
+  static inline int32_t sizeOf(byte flagByte) {
+    return (flagByte & WIDE_FLAG) ? WIDE_OUTPUT_SIZE : NARROW_OUTPUT_SIZE;
+  }
+
+  /// \return true if this is a repetitive read marker rather than an
+  /// alignment
+  inline bool isRepetitiveMarker() const {
+    return isRepetitive && refID < 0;
+  }
 private:
 };
 #endif  //  _ALIGNMENT_RECORD_H
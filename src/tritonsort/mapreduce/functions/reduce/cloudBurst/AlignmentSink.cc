@@ -0,0 +1,15 @@
+#include "AlignmentSink.h"
+#include "mapreduce/common/KVPairWriterInterface.h"
+#include "mapreduce/common/KeyValuePair.h"
+
+KVPairAlignmentSink::KVPairAlignmentSink(KVPairWriterInterface& _writer)
+  : writer(_writer) {
+}
+
+void KVPairAlignmentSink::write(int32_t readID, AlignmentRecord& alignment) {
+  KeyValuePair outputKVPair;
+  outputKVPair.setKey(reinterpret_cast<uint8_t*>(&readID), sizeof(readID));
+  byte* value = alignment.toBytes();
+  outputKVPair.setValue(static_cast<uint8_t*>(value), alignment.outputSize);
+  writer.write(outputKVPair);
+}
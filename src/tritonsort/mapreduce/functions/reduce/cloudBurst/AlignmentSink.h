@@ -0,0 +1,47 @@
+#ifndef _ALIGNMENT_SINK_H_
+#define _ALIGNMENT_SINK_H_
+
+#include <stdint.h>
+
+#include "AlignmentRecord.h"
+
+class KVPairWriterInterface;
+
+/**
+   Receives the alignments a CloudBurstAligner finds.
+ */
+class AlignmentSink {
+public:
+  /// Destructor
+  virtual ~AlignmentSink() {}
+
+  /**
+     Take an alignment.
+
+     \param readID the id of the aligned read
+
+     \param alignment the alignment
+   */
+  virtual void write(int32_t readID, AlignmentRecord& alignment) = 0;
+};
+
+/**
+   Writes each alignment as an AlignmentRecord tuple keyed by the id of the
+   aligned read, which is how the CloudBurst reducer has always emitted them.
+ */
+class KVPairAlignmentSink : public AlignmentSink {
+public:
+  /// Constructor
+  /**
+     \param writer the writer to write alignment tuples to
+   */
+  KVPairAlignmentSink(KVPairWriterInterface& writer);
+
+  /// \sa AlignmentSink::write
+  void write(int32_t readID, AlignmentRecord& alignment);
+
+private:
+  KVPairWriterInterface& writer;
+};
+
+#endif  // _ALIGNMENT_SINK_H_
@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <unistd.h>
+
+#include "BlockSizeTuner.h"
+
+// Fallbacks for platforms that don't report their cache sizes.
+static const uint64_t DEFAULT_L1_BYTES = 32 * 1024;
+static const uint64_t DEFAULT_L2_BYTES = 256 * 1024;
+
+// Tiles are never smaller than this, so per-tile overhead stays negligible.
+static const uint32_t MIN_BLOCK_SIZE = 8;
+static const uint32_t MAX_BLOCK_SIZE = 8192;
+
+// Each candidate is measured over at least this many pairs, so timer
+// resolution and one-off stalls don't decide the outcome.
+static const uint64_t MIN_PAIRS_PER_CANDIDATE = 1 << 20;
+
+static uint64_t cacheBytes(int name, uint64_t defaultBytes) {
+  long bytes = sysconf(name);
+  return bytes > 0 ? bytes : defaultBytes;
+}
+
+static uint32_t clampBlockSize(uint64_t blockSize) {
+  return std::max<uint64_t>(
+    MIN_BLOCK_SIZE, std::min<uint64_t>(blockSize, MAX_BLOCK_SIZE));
+}
+
+BlockSizeTuner::BlockSizeTuner()
+  : l1Bytes(cacheBytes(_SC_LEVEL1_DCACHE_SIZE, DEFAULT_L1_BYTES)),
+    l2Bytes(cacheBytes(_SC_LEVEL2_CACHE_SIZE, DEFAULT_L2_BYTES)),
+    currentCandidate(0),
+    isInitialized(false),
+    isTuning(false) {
+}
+
+void BlockSizeTuner::initialize(
+  uint64_t queryTupleBytes, uint64_t referenceTupleBytes) {
+  queryTupleBytes = std::max<uint64_t>(queryTupleBytes, 1);
+  referenceTupleBytes = std::max<uint64_t>(referenceTupleBytes, 1);
+
+  uint32_t referenceBlockSize =
+    clampBlockSize((l1Bytes / 2) / referenceTupleBytes);
+  uint64_t referenceTileBytes = referenceBlockSize * referenceTupleBytes;
+  uint64_t queryTileBytes = l2Bytes / 2 > referenceTileBytes ?
+    l2Bytes / 2 - referenceTileBytes : 0;
+  uint32_t queryBlockSize = clampBlockSize(queryTileBytes / queryTupleBytes);
+
+  // Measure the cache-derived sizes first, then halve and double each side.
+  candidates.clear();
+  addCandidate(queryBlockSize, referenceBlockSize);
+  addCandidate(queryBlockSize, clampBlockSize(referenceBlockSize / 2));
+  addCandidate(queryBlockSize, clampBlockSize(referenceBlockSize * 2));
+  addCandidate(clampBlockSize(queryBlockSize / 2), referenceBlockSize);
+  addCandidate(clampBlockSize(queryBlockSize * 2), referenceBlockSize);
+
+  currentCandidate = 0;
+  isInitialized = true;
+  isTuning = candidates.size() > 1;
+}
+
+bool BlockSizeTuner::initialized() const {
+  return isInitialized;
+}
+
+bool BlockSizeTuner::tuning() const {
+  return isTuning;
+}
+
+uint32_t BlockSizeTuner::queryBlockSize() const {
+  return candidates[currentCandidate].queryBlockSize;
+}
+
+uint32_t BlockSizeTuner::referenceBlockSize() const {
+  return candidates[currentCandidate].referenceBlockSize;
+}
+
+bool BlockSizeTuner::recordBatch(uint64_t pairs, uint64_t elapsedMicros) {
+  if (!isTuning) {
+    return false;
+  }
+
+  Candidate& candidate = candidates[currentCandidate];
+  candidate.pairs += pairs;
+  candidate.elapsedMicros += elapsedMicros;
+  if (candidate.pairs < MIN_PAIRS_PER_CANDIDATE) {
+    return false;
+  }
+
+  if (currentCandidate + 1 < candidates.size()) {
+    ++currentCandidate;
+    return false;
+  }
+
+  // Every candidate has been measured; keep the fastest. Comparing
+  // pairs_a / micros_a > pairs_b / micros_b without dividing.
+  uint32_t best = 0;
+  for (uint32_t i = 1; i < candidates.size(); i++) {
+    const Candidate& a = candidates[i];
+    const Candidate& b = candidates[best];
+    if (a.pairs * std::max<uint64_t>(b.elapsedMicros, 1) >
+        b.pairs * std::max<uint64_t>(a.elapsedMicros, 1)) {
+      best = i;
+    }
+  }
+  currentCandidate = best;
+  isTuning = false;
+  return true;
+}
+
+uint64_t BlockSizeTuner::l1CacheBytes() const {
+  return l1Bytes;
+}
+
+uint64_t BlockSizeTuner::l2CacheBytes() const {
+  return l2Bytes;
+}
+
+void BlockSizeTuner::addCandidate(
+  uint32_t queryBlockSize, uint32_t referenceBlockSize) {
+  for (std::vector<Candidate>::iterator iter = candidates.begin();
+       iter != candidates.end(); iter++) {
+    if (iter->queryBlockSize == queryBlockSize &&
+        iter->referenceBlockSize == referenceBlockSize) {
+      // Clamping can make neighbours collapse onto the same sizes.
+      return;
+    }
+  }
+
+  Candidate candidate;
+  candidate.queryBlockSize = queryBlockSize;
+  candidate.referenceBlockSize = referenceBlockSize;
+  candidate.pairs = 0;
+  candidate.elapsedMicros = 0;
+  candidates.push_back(candidate);
+}
@@ -0,0 +1,82 @@
+#ifndef _BLOCK_SIZE_TUNER_H
+#define _BLOCK_SIZE_TUNER_H
+
+#include <stdint.h>
+#include <vector>
+
+/**
+   Chooses the query and reference tile sizes used by
+   CloudBurstReduceFunction::alignBatch.
+
+   Initial sizes come from the per-tuple footprint and the detected cache
+   sizes: a reference tile is rescanned once per query, so it is sized to fit
+   in half of L1, and a query tile plus a reference tile are sized to fit in
+   half of L2. The tuner then times the first batches with the initial sizes
+   and a few neighbouring sizes, and settles on the one with the best measured
+   pairs per second.
+ */
+class BlockSizeTuner {
+public:
+  /// Constructor
+  BlockSizeTuner();
+
+  /**
+     Compute the initial tile sizes.
+
+     \param queryTupleBytes the average in-memory size of a query tuple,
+     including its flanks
+
+     \param referenceTupleBytes the average in-memory size of a reference
+     tuple, including its flanks
+   */
+  void initialize(uint64_t queryTupleBytes, uint64_t referenceTupleBytes);
+
+  /// \return true if initialize() has been called
+  bool initialized() const;
+
+  /// \return true while sizes are still being measured
+  bool tuning() const;
+
+  /// \return the number of query tuples per tile
+  uint32_t queryBlockSize() const;
+
+  /// \return the number of reference tuples per tile
+  uint32_t referenceBlockSize() const;
+
+  /**
+     Record the throughput of a batch aligned with the current tile sizes.
+
+     \param pairs the number of query/reference pairs in the batch
+
+     \param elapsedMicros the time taken to align the batch
+
+     \return true if this batch completed tuning and the final sizes were
+     just chosen
+   */
+  bool recordBatch(uint64_t pairs, uint64_t elapsedMicros);
+
+  /// \return the detected L1 data cache size in bytes
+  uint64_t l1CacheBytes() const;
+
+  /// \return the detected L2 cache size in bytes
+  uint64_t l2CacheBytes() const;
+
+private:
+  struct Candidate {
+    uint32_t queryBlockSize;
+    uint32_t referenceBlockSize;
+    uint64_t pairs;
+    uint64_t elapsedMicros;
+  };
+
+  void addCandidate(uint32_t queryBlockSize, uint32_t referenceBlockSize);
+
+  uint64_t l1Bytes;
+  uint64_t l2Bytes;
+  std::vector<Candidate> candidates;
+  uint32_t currentCandidate;
+  bool isInitialized;
+  bool isTuning;
+};
+
+#endif // _BLOCK_SIZE_TUNER_H
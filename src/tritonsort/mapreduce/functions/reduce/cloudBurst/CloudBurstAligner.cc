@@ -0,0 +1,270 @@
+#include "CloudBurstAligner.h"
+#include "core/MemoryUtils.h"
+#include "core/Timer.h"
+#include "mapreduce/functions/reduce/cloudBurst/AlignInfo.h"
+
+CloudBurstAligner::CloudBurstAligner(
+  uint32_t _maxAlignDiff, uint32_t _seedLength, bool _allowDifferences,
+  const std::string& _seedMasks, int32_t minReadLen, int32_t maxReadLen,
+  const std::string& _readLengthClasses, uint32_t maxAlignmentsPerRead,
+  uint32_t _maxHitsPerSeed)
+  : noalignment(-1, -1, -1, -1, true),
+    maxAlignDiff(_maxAlignDiff),
+    seedLength(_seedLength),
+    allowDifferences(_allowDifferences),
+    filterAlignments(maxAlignmentsPerRead > 0),
+    // One more than the filter keeps, so that it can still detect ties
+    alignmentFilter(maxAlignmentsPerRead + 1),
+    numAlignmentsFound(0),
+    numAlignmentsWritten(0),
+    maxHitsPerSeed(_maxHitsPerSeed),
+    repetitiveMarker(-1, -1, -1, _maxHitsPerSeed, false),
+    numRepetitiveQueryTuples(0),
+    numPairsAttempted(0),
+    numPairsAligned(0),
+    numBaezaYatesRejections(0),
+    totalExtendMicros(0) {
+  landauVishkinObj.configure(maxAlignDiff);
+  SeedMask::parseMasks(_seedMasks, seedMasks);
+  ReadLengthClass::parseClasses(
+    _readLengthClasses, minReadLen, maxReadLen, maxAlignDiff, lengthClasses);
+  differencePositions = new (themis::memcheck) int32_t[2 * (maxAlignDiff + 1)];
+  differenceKinds = new (themis::memcheck) int32_t[2 * (maxAlignDiff + 1)];
+  repetitiveMarker.isRepetitive = true;
+}
+
+CloudBurstAligner::~CloudBurstAligner() {
+  delete[] differencePositions;
+  delete[] differenceKinds;
+}
+
+void CloudBurstAligner::startBatch(uint32_t numQueryTuples) {
+  if (maxHitsPerSeed > 0) {
+    queryHits.assign(numQueryTuples, 0);
+  }
+}
+
+void CloudBurstAligner::alignBlock(
+  const std::vector<MerRecord>& queries,
+  const std::vector<MerRecord>& references, uint32_t queryBlockSize,
+  uint32_t referenceBlockSize, AlignmentSink& sink) {
+  int32_t numRefTuples = references.size();
+  int32_t numQueryTuples = queries.size();
+
+  // join together the query-ref shared mers
+  if ((numRefTuples != 0) && (numQueryTuples != 0)) {
+    Timer timer;
+    timer.start();
+    // Align reads to the references in blocks of
+    // queryBlockSize x referenceBlockSize to improve cache locality
+    // define a qry block between [queryTuplesIndex, lastQueryTupleIndex)
+    for (int32_t queryTuplesIndex = 0; queryTuplesIndex < numQueryTuples;
+      queryTuplesIndex += queryBlockSize) {
+      int32_t lastQueryTupleIndex = queryTuplesIndex + queryBlockSize;
+      if (lastQueryTupleIndex > numQueryTuples) {
+        lastQueryTupleIndex = numQueryTuples;
+      }
+      // define a ref block between [startRefTupleIndex, lastRefTupleIndex)
+      for (int32_t startRefTupleIndex = 0; startRefTupleIndex < numRefTuples;
+        startRefTupleIndex += referenceBlockSize) {
+        int32_t lastRefTupleIndex = startRefTupleIndex + referenceBlockSize;
+        if (lastRefTupleIndex > numRefTuples) {
+          lastRefTupleIndex = numRefTuples;
+        }
+        // for each element in [queryTuplesIndex, lastQueryTupleIndex)
+        for (int32_t curq = queryTuplesIndex; curq < lastQueryTupleIndex;
+          curq++) {
+          const MerRecord& queryRecord = queries[curq];
+          int32_t queryID = static_cast<int32_t>(queryRecord.id);
+          // for each element in [startRefTupleIndex, lastRefTupleIndex)
+          for (int32_t curr = startRefTupleIndex; curr < lastRefTupleIndex;
+            curr++) {
+            if (maxHitsPerSeed > 0 && queryHits[curq] >= maxHitsPerSeed) {
+              if (queryHits[curq] == maxHitsPerSeed) {
+                // The cap was reached with reference tuples left to check
+                queryHits[curq]++;
+                numRepetitiveQueryTuples++;
+                emit(queryID, repetitiveMarker, sink);
+              }
+              break;
+            }
+            AlignmentRecord* rec =
+              extend(queryRecord, references[curr]);
+            numPairsAttempted++;
+            if (rec->differences == -1) {
+              continue;
+            }
+            numPairsAligned++;
+            emit(queryID, *rec, sink);
+            if (maxHitsPerSeed > 0) {
+              queryHits[curq]++;
+            }
+          }
+        }
+      }
+    }
+    timer.stop();
+    totalExtendMicros += timer.getElapsed();
+  }
+}
+
+void CloudBurstAligner::finishBatch(AlignmentSink& sink) {
+  if (filterAlignments) {
+    // Every alignment of the batch's queries against this seed is known
+    numAlignmentsFound += alignmentFilter.size();
+    alignmentFilter.filter(false);
+    for (uint32_t i = 0; i < alignmentFilter.size(); i++) {
+      alignmentFilter.get(i, filteredAlignment);
+      sink.write(alignmentFilter.readID(i), filteredAlignment);
+    }
+    numAlignmentsWritten += alignmentFilter.size();
+    alignmentFilter.clear();
+  }
+}
+
+void CloudBurstAligner::emit(
+  int32_t readID, AlignmentRecord& alignment, AlignmentSink& sink) {
+  if (filterAlignments) {
+    alignmentFilter.add(readID, alignment);
+  } else {
+    sink.write(readID, alignment);
+  }
+}
+
+AlignmentRecord* CloudBurstAligner::extend(
+  const MerRecord& qrytuple, const MerRecord& reftuple) {
+  // A spaced seed's right flank starts at the seed itself
+  bool spaced = !seedMasks.empty();
+  int32_t classSeedLength = lengthClasses.size() > 1 ?
+    lengthClasses[reftuple.seedClass].seedLength() : seedLength;
+  int64_t refStart    = reftuple.offset;
+  int64_t refEnd      = reftuple.offset + (spaced ? 0 : classSeedLength);
+  int32_t differences = 0;
+  int32_t numLeftPositions = 0;
+  int32_t numPositions = 0;
+
+  // With canonical seeds, a query and reference can share a key while their
+  // seeds are reverse complements of each other. The read then aligns to the
+  // other strand: the complement of its right flank lies to the left of the
+  // reference seed and the complement of its left flank to the right.
+  bool flip = qrytuple.isSeedRC != reftuple.isSeedRC;
+  const PackedFlank& refFlankForQueryLeft =
+    flip ? reftuple.rightFlank : reftuple.leftFlank;
+  const PackedFlank& refFlankForQueryRight =
+    flip ? reftuple.leftFlank : reftuple.rightFlank;
+
+  if (qrytuple.leftFlank.length != 0) {
+    // at least 1 read base on the left needs to be aligned
+    // aligned the pre-reversed strings!
+    AlignInfo& a = landauVishkinObj.extend(
+      refFlankForQueryLeft, qrytuple.leftFlank, maxAlignDiff,
+      allowDifferences, flip);
+
+    if (a.alignlen == -1) {
+      return &noalignment;
+    }  // alignment failed
+    if (spaced) {
+      // The next extend() overwrites a, so keep its differences for the
+      // leftmost seed check.
+      numLeftPositions =
+        a.differencePositions(differencePositions, differenceKinds);
+      numPositions = numLeftPositions;
+    } else if (!a.isBazeaYatesSeed(
+                 qrytuple.leftFlank.length, classSeedLength)) {
+      // The read's own left flank decides whether this is its leftmost seed,
+      // whichever strand it aligned to.
+      numBaezaYatesRejections++;
+      return &noalignment;
+    }
+    if (flip) {
+      refEnd += a.alignlen;
+    } else {
+      refStart -= a.alignlen;
+    }
+    differences = a.differences;
+  }
+  if (qrytuple.rightFlank.length != 0) {
+    AlignInfo& b = landauVishkinObj.extend(
+      refFlankForQueryRight, qrytuple.rightFlank, maxAlignDiff - differences,
+      allowDifferences, flip);
+
+    if (b.alignlen == -1) {
+      return &noalignment;
+    }  // alignment failed
+    if (flip) {
+      refStart -= b.alignlen;
+    } else {
+      refEnd += b.alignlen;
+    }
+    differences += b.differences;
+    if (spaced) {
+      numPositions += b.differencePositions(
+        differencePositions + numLeftPositions,
+        differenceKinds + numLeftPositions);
+    }
+  }
+  if (spaced &&
+      !isLeftmostSpacedSeed(qrytuple, numLeftPositions, numPositions)) {
+    numBaezaYatesRejections++;
+    return &noalignment;
+  }
+  fullalignment.refID = reftuple.id;
+  fullalignment.refStart = refStart;
+  fullalignment.refEnd = refEnd;
+  fullalignment.differences = differences;
+  fullalignment.isRC = qrytuple.isRC != flip;
+  return &fullalignment;
+}
+
+bool CloudBurstAligner::isLeftmostSpacedSeed(
+  const MerRecord& queryTuple, int32_t numLeftPositions,
+  int32_t numPositions) {
+  // Flag every read position that differs from the reference. The left flank
+  // reads outward from the seed, so its positions count down from the seed.
+  int32_t seedStart = queryTuple.leftFlank.length;
+  int32_t readLength = seedStart + queryTuple.rightFlank.length;
+  badReadPositions.assign(readLength + 1, 0);
+  for (int32_t i = 0; i < numPositions; i++) {
+    bool left = i < numLeftPositions;
+    int32_t position = left ?
+      seedStart - 1 - differencePositions[i] :
+      seedStart + differencePositions[i];
+    if (differenceKinds[i] == -1) {
+      // A reference base is missing from the read, so the alignment changes
+      // diagonal between this position and the one before it in flank order.
+      position += left ? 1 : 0;
+      if (position >= 0 && position <= readLength) {
+        badReadPositions[position] |= SeedMask::DIAGONAL_CHANGE;
+      }
+    } else if (position >= 0 && position < readLength) {
+      // A mismatch, or an extra read base that also changes the diagonal
+      badReadPositions[position] |= SeedMask::DIFFERENT_BASE;
+      if (differenceKinds[i] == 1) {
+        badReadPositions[position] |= SeedMask::DIAGONAL_CHANGE;
+      }
+    }
+  }
+  // A window with an N at a care position was never emitted as a seed.
+  for (uint32_t i = 0; i < queryTuple.leftFlank.numExceptions; i++) {
+    badReadPositions[seedStart - 1 - queryTuple.leftFlank.exception(i)] |=
+      SeedMask::DIFFERENT_BASE;
+  }
+  for (uint32_t i = 0; i < queryTuple.rightFlank.numExceptions; i++) {
+    badReadPositions[seedStart + queryTuple.rightFlank.exception(i)] |=
+      SeedMask::DIFFERENT_BASE;
+  }
+
+  for (int32_t start = 0; start <= seedStart; start++) {
+    for (uint32_t m = 0; m < seedMasks.size(); m++) {
+      if (start == seedStart && m >= queryTuple.seedClass) {
+        return true;
+      }
+      const SeedMask& mask = seedMasks[m];
+      if (start + static_cast<int32_t>(mask.span()) <= readLength &&
+          mask.hits(badReadPositions, start)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
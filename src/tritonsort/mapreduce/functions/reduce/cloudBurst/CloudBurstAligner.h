@@ -0,0 +1,228 @@
+#ifndef _CLOUD_BURST_ALIGNER_H_
+#define _CLOUD_BURST_ALIGNER_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "mapreduce/functions/map/cloudBurst/MerRecord.h"
+#include "mapreduce/functions/map/cloudBurst/ReadLengthClass.h"
+#include "mapreduce/functions/map/cloudBurst/SeedMask.h"
+#include "mapreduce/functions/reduce/cloudBurst/AlignmentFilter.h"
+#include "mapreduce/functions/reduce/cloudBurst/AlignmentRecord.h"
+#include "mapreduce/functions/reduce/cloudBurst/AlignmentSink.h"
+#include "mapreduce/functions/reduce/cloudBurst/LandauVishkin.h"
+
+/**
+   The CloudBurst seed join: extends query tuples against reference tuples
+   that share their seed and passes the alignments within maxAlignDiff
+   differences to an AlignmentSink. It knows nothing about where the tuples
+   come from, so the reducer, which groups them by sorting, and the broadcast
+   map function, which looks them up in an in-memory index, share it.
+
+   Tuples are aligned in batches. A batch is a set of query tuples with the
+   same seed, aligned against one or more blocks of that seed's reference
+   tuples between startBatch() and finishBatch(). The per-seed hit cap counts
+   a query tuple's alignments across the whole batch, and with a filter the
+   batch's alignments are held until finishBatch() and only those a top-N
+   filter could keep are passed on.
+ */
+class CloudBurstAligner {
+public:
+  /// Constructor
+  /**
+     \param maxAlignDiff the maximum number of differences to allow
+
+     \param seedLength the length of a contiguous seed
+
+     \param allowDifferences whether indels are allowed, or only mismatches
+
+     \param seedMasks the comma-separated spaced seed masks the map function
+     used, or an empty string for contiguous seeds
+
+     \param minReadLen the length of the shortest read
+
+     \param maxReadLen the length of the longest read
+
+     \param readLengthClasses the read length classes the map function used,
+     or an empty string for a single class with seeds of seedLength
+
+     \param maxAlignmentsPerRead if not 0, each batch passes on only the
+     alignments a CloudBurstFilterReduceFunction keeping this many alignments
+     per read could keep
+
+     \param maxHitsPerSeed if not 0, a query tuple stops being extended once
+     it has this many alignments in a batch, and a repetitive read marker is
+     passed on for it instead of the rest
+   */
+  CloudBurstAligner(
+    uint32_t maxAlignDiff, uint32_t seedLength, bool allowDifferences,
+    const std::string& seedMasks, int32_t minReadLen, int32_t maxReadLen,
+    const std::string& readLengthClasses, uint32_t maxAlignmentsPerRead,
+    uint32_t maxHitsPerSeed);
+
+  /// Destructor
+  virtual ~CloudBurstAligner();
+
+  /**
+     Start a batch.
+
+     \param numQueryTuples the number of query tuples in the batch
+   */
+  void startBatch(uint32_t numQueryTuples);
+
+  /**
+     Align a batch's query tuples to a block of reference tuples, tiling the
+     two sides by queryBlockSize and referenceBlockSize to improve cache
+     locality.
+
+     \param queries the batch's query tuples
+
+     \param references the reference tuples to align against
+
+     \param queryBlockSize the number of query tuples per tile
+
+     \param referenceBlockSize the number of reference tuples per tile
+
+     \param sink the sink to pass alignments to
+   */
+  void alignBlock(
+    const std::vector<MerRecord>& queries,
+    const std::vector<MerRecord>& references, uint32_t queryBlockSize,
+    uint32_t referenceBlockSize, AlignmentSink& sink);
+
+  /**
+     Finish a batch, passing on the alignments held for the filter.
+
+     \param sink the sink to pass alignments to
+   */
+  void finishBatch(AlignmentSink& sink);
+
+  /// \return true if batches are filtered
+  inline bool filtersAlignments() const {
+    return filterAlignments;
+  }
+
+  /// \return true if query tuples' hits are capped
+  inline bool capsHits() const {
+    return maxHitsPerSeed > 0;
+  }
+
+  /// \return the number of alignments found in filtered batches
+  inline uint64_t alignmentsFound() const {
+    return numAlignmentsFound;
+  }
+
+  /// \return the number of alignments filtered batches passed on
+  inline uint64_t alignmentsWritten() const {
+    return numAlignmentsWritten;
+  }
+
+  /// \return the number of query tuples that reached the hit cap
+  inline uint64_t repetitiveQueryTuples() const {
+    return numRepetitiveQueryTuples;
+  }
+
+  /// \return the number of query and reference tuple pairs extended
+  inline uint64_t pairsAttempted() const {
+    return numPairsAttempted;
+  }
+
+  /// \return the number of pairs that aligned within maxAlignDiff
+  inline uint64_t pairsAligned() const {
+    return numPairsAligned;
+  }
+
+  /// \return the number of pairs dropped because an earlier seed of the
+  /// read finds any alignment they could give
+  inline uint64_t baezaYatesRejections() const {
+    return numBaezaYatesRejections;
+  }
+
+  /// \return the time spent in alignBlock() in microseconds
+  inline uint64_t extendMicros() const {
+    return totalExtendMicros;
+  }
+
+private:
+  /**
+     Extend seeds using the flank information in the tuple value, and compare
+     the extended query and reference records.
+
+     \param queryTuple the MerRecord representation of a query tuple to compare
+
+     \param referenceTuple the MerRecord representation of a reference tuple to
+     compare
+
+     \return an AlignmentRecord that has the differences field set to -1 if the
+     records do NOT align
+   */
+  AlignmentRecord* extend(
+    const MerRecord& queryTuple, const MerRecord& referenceTuple);
+
+  /**
+     With spaced seeds every window of a read is a seed, so an alignment is
+     found once for every window that matches the reference exactly. Decide
+     whether the query tuple's window is the first of those, by position and
+     then by mask, so that each alignment is reported once.
+
+     \param queryTuple the aligned query tuple
+
+     \param numLeftPositions the number of entries at the front of
+     differencePositions that belong to the left flank alignment
+
+     \param numPositions the total number of entries in differencePositions
+
+     \return true if no earlier window of the read matches the reference
+   */
+  bool isLeftmostSpacedSeed(
+    const MerRecord& queryTuple, int32_t numLeftPositions,
+    int32_t numPositions);
+
+  /**
+     Pass an alignment of the batch on, or hold it for the filter.
+   */
+  void emit(int32_t readID, AlignmentRecord& alignment, AlignmentSink& sink);
+
+  AlignmentRecord noalignment;
+  AlignmentRecord fullalignment;
+  LandauVishkin landauVishkinObj;
+  const uint32_t maxAlignDiff;
+  const uint32_t seedLength;
+  const bool allowDifferences;
+
+  // If filtering, a batch's alignments are collected here and only those a
+  // top-N filter could keep are passed on
+  const bool filterAlignments;
+  AlignmentFilter alignmentFilter;
+  AlignmentRecord filteredAlignment;
+  uint64_t numAlignmentsFound;
+  uint64_t numAlignmentsWritten;
+
+  // Per-seed hit cap. queryHits counts the alignments of each tuple in the
+  // current batch, and passes the cap once its marker is written.
+  const uint32_t maxHitsPerSeed;
+  std::vector<uint32_t> queryHits;
+  AlignmentRecord repetitiveMarker;
+  uint64_t numRepetitiveQueryTuples;
+
+  // Join statistics. Extensions are timed a block at a time, since timing
+  // each one would cost about as much as the extension.
+  uint64_t numPairsAttempted;
+  uint64_t numPairsAligned;
+  uint64_t numBaezaYatesRejections;
+  uint64_t totalExtendMicros;
+
+  // Spaced seed masks, and buffers for working out which of a read's windows
+  // match the reference
+  std::vector<SeedMask> seedMasks;
+  int32_t* differencePositions;
+  int32_t* differenceKinds;
+  std::vector<uint8_t> badReadPositions;
+
+  // Read length classes; tuples of each class are seeded with that class's
+  // seed length
+  std::vector<ReadLengthClass> lengthClasses;
+};
+
+#endif  // _CLOUD_BURST_ALIGNER_H_
@@ -0,0 +1,85 @@
+#include <string.h>
+
+#include "CloudBurstCoordinateReduceFunction.h"
+#include "mapreduce/common/KeyValuePair.h"
+
+CloudBurstCoordinateReduceFunction::CloudBurstCoordinateReduceFunction(
+  uint32_t _blockHits)
+  : blockHits(_blockHits),
+    blockLength(0),
+    hitsInBlock(0),
+    logger("CloudBurstCoordinateReduceFunction"),
+    hits(0),
+    blocks(0),
+    bytesWritten(0) {
+  ABORT_IF(blockHits == 0, "Coordinate blocks must hold at least one hit");
+  blockBytes.resize(blockHits * AlignmentCodec::MAX_BLOCK_HIT_LENGTH);
+  blockValue.resize(Varint::MAX_LENGTH + blockBytes.size());
+}
+
+void CloudBurstCoordinateReduceFunction::reduce(
+  const uint8_t* key, uint64_t keyLength,
+  KVPairIterator& iterator, KVPairWriterInterface& writer) {
+  ABORT_IF(keyLength != AlignmentCodec::COORDINATE_KEY_LENGTH, "Expected a "
+           "%u byte coordinate key, but got %llu bytes",
+           AlignmentCodec::COORDINATE_KEY_LENGTH, keyLength);
+
+  CoordinateHit hit;
+  AlignmentCodec::decodeCoordinateKey(key, hit.refID, hit.refStart);
+
+  KeyValuePair kvPair;
+  while (iterator.next(kvPair)) {
+    if (hitsInBlock == blockHits) {
+      writeBlock(writer);
+    }
+    if (hitsInBlock == 0) {
+      // The first hit is encoded relative to the block key
+      memcpy(blockKey, key, keyLength);
+      previousHit = hit;
+    }
+
+    const uint8_t* value = kvPair.getValue();
+    uint64_t field;
+    uint32_t offset = Varint::decode(value, field);
+    hit.readID = field;
+    offset += Varint::decode(value + offset, field);
+    hit.refEnd = hit.refStart + field;
+    offset += Varint::decode(value + offset, field);
+    hit.differences = field;
+    hit.flags = value[offset];
+
+    blockLength += AlignmentCodec::encodeBlockHit(
+      hit, previousHit, &blockBytes[blockLength]);
+    previousHit = hit;
+    hitsInBlock++;
+    hits++;
+  }
+}
+
+void CloudBurstCoordinateReduceFunction::teardown(
+  KVPairWriterInterface& writer) {
+  writeBlock(writer);
+  logger.logDatum("hits", hits);
+  logger.logDatum("blocks", blocks);
+  logger.logDatum("block_bytes_written", bytesWritten);
+}
+
+void CloudBurstCoordinateReduceFunction::writeBlock(
+  KVPairWriterInterface& writer) {
+  if (hitsInBlock == 0) {
+    return;
+  }
+  uint32_t length = Varint::encode(hitsInBlock, &blockValue[0]);
+  memcpy(&blockValue[length], &blockBytes[0], blockLength);
+  length += blockLength;
+
+  KeyValuePair outputKVPair;
+  outputKVPair.setKey(blockKey, sizeof(blockKey));
+  outputKVPair.setValue(&blockValue[0], length);
+  writer.write(outputKVPair);
+
+  blocks++;
+  bytesWritten += sizeof(blockKey) + length;
+  blockLength = 0;
+  hitsInBlock = 0;
+}
@@ -0,0 +1,59 @@
+#ifndef CLOUD_BURST_COORDINATE_REDUCE_FUNCTION_H
+#define CLOUD_BURST_COORDINATE_REDUCE_FUNCTION_H
+
+#include <vector>
+
+#include "core/StatLogger.h"
+#include "mapreduce/functions/reduce/ReduceFunction.h"
+#include "mapreduce/functions/reduce/cloudBurst/AlignmentCodec.h"
+
+/**
+   Reduce side of the job that lays CloudBurst alignments out by reference
+   coordinate. Hits arrive in coordinate order (see
+   CloudBurstCoordinateMapFunction) and are delta encoded into blocks of a
+   fixed number of hits, each written as one record keyed by its first hit's
+   coordinates. \sa AlignmentCodec
+ */
+class CloudBurstCoordinateReduceFunction : public ReduceFunction {
+public:
+  /// Constructor
+  /**
+     \param blockHits the number of hits per block; smaller blocks make range
+     queries read less and larger ones compress better
+   */
+  CloudBurstCoordinateReduceFunction(uint32_t blockHits);
+
+  /// \sa ReduceFunction::reduce
+  void reduce(
+    const uint8_t* key, uint64_t keyLength,
+    KVPairIterator& iterator, KVPairWriterInterface& writer);
+
+  /// Write the last block and log statistics
+  void teardown(KVPairWriterInterface& writer);
+
+private:
+  /**
+     Write the current block, if it has any hits, and start a new one.
+
+     \param writer the KVPairWriterInterface associated with the Reducer
+   */
+  void writeBlock(KVPairWriterInterface& writer);
+
+  const uint32_t blockHits;
+
+  // The block being built: its key, encoded hits and the last hit added.
+  // The hit count prefix is only known when the block is written.
+  uint8_t blockKey[AlignmentCodec::COORDINATE_KEY_LENGTH];
+  std::vector<uint8_t> blockBytes;
+  uint32_t blockLength;
+  uint32_t hitsInBlock;
+  CoordinateHit previousHit;
+  std::vector<uint8_t> blockValue;
+
+  StatLogger logger;
+  uint64_t hits;
+  uint64_t blocks;
+  uint64_t bytesWritten;
+};
+
+#endif // CLOUD_BURST_COORDINATE_REDUCE_FUNCTION_H
@@ -0,0 +1,92 @@
+#include <string.h>
+
+#include "CloudBurstFilterReduceFunction.h"
+#include "mapreduce/common/KeyValuePair.h"
+
+CloudBurstFilterReduceFunction::CloudBurstFilterReduceFunction(
+  uint32_t maxAlignmentsPerRead, const std::string& _outputFormat)
+  : alignmentFilter(maxAlignmentsPerRead),
+    outputFormat(AlignmentCodec::parseFormat(_outputFormat)),
+    logger("CloudBurstFilterReduceFunction"),
+    reads(0),
+    ambiguousReads(0),
+    repetitiveReads(0),
+    alignmentsRead(0),
+    alignmentsWritten(0),
+    bytesWritten(0) {
+}
+
+void CloudBurstFilterReduceFunction::reduce(
+  const uint8_t* key, uint64_t keyLength,
+  KVPairIterator& iterator, KVPairWriterInterface& writer) {
+  int32_t readID;
+  ABORT_IF(keyLength != sizeof(readID), "Expected a %u byte read id key, but "
+           "got %llu bytes", static_cast<uint32_t>(sizeof(readID)), keyLength);
+  memcpy(&readID, key, sizeof(readID));
+
+  KeyValuePair kvPair;
+  while (iterator.next(kvPair)) {
+    ABORT_IF(kvPair.getValueLength() == 0 ||
+             kvPair.getValueLength() != static_cast<uint64_t>(
+               AlignmentRecord::sizeOf(kvPair.getValue()[0])),
+             "Alignment record of read %d has the wrong length %llu", readID,
+             kvPair.getValueLength());
+    alignment.fromBytes(kvPair.getValue());
+    alignmentFilter.add(readID, alignment);
+    alignmentsRead++;
+  }
+
+  alignmentFilter.filter(true);
+  bool ambiguous = false;
+  bool repetitive = false;
+  uint32_t groupLength = 0;
+  if (outputFormat == AlignmentCodec::GROUPED) {
+    groupBytes.resize(Varint::MAX_LENGTH +
+                      alignmentFilter.size() * AlignmentCodec::MAX_HIT_LENGTH);
+    groupLength = Varint::encode(alignmentFilter.size(), &groupBytes[0]);
+  }
+  for (uint32_t i = 0; i < alignmentFilter.size(); i++) {
+    alignmentFilter.get(i, alignment);
+    ambiguous = ambiguous || alignment.isAmbiguous;
+    repetitive = repetitive || alignment.isRepetitive;
+    if (outputFormat == AlignmentCodec::GROUPED) {
+      groupLength += AlignmentCodec::encodeHit(
+        alignment, &groupBytes[groupLength]);
+    } else {
+      KeyValuePair outputKVPair;
+      outputKVPair.setKey(key, keyLength);
+      // toBytes() sets outputSize
+      byte* value = alignment.toBytes();
+      outputKVPair.setValue(value, alignment.outputSize);
+      writer.write(outputKVPair);
+      bytesWritten += alignment.outputSize;
+    }
+  }
+  if (groupLength > 0 && alignmentFilter.size() > 0) {
+    KeyValuePair outputKVPair;
+    outputKVPair.setKey(key, keyLength);
+    outputKVPair.setValue(&groupBytes[0], groupLength);
+    writer.write(outputKVPair);
+    bytesWritten += groupLength;
+  }
+  if (alignmentFilter.size() > 0) {
+    reads++;
+  }
+  if (ambiguous) {
+    ambiguousReads++;
+  }
+  if (repetitive) {
+    repetitiveReads++;
+  }
+  alignmentsWritten += alignmentFilter.size();
+  alignmentFilter.clear();
+}
+
+void CloudBurstFilterReduceFunction::teardown(KVPairWriterInterface& writer) {
+  logger.logDatum("reads", reads);
+  logger.logDatum("ambiguous_reads", ambiguousReads);
+  logger.logDatum("repetitive_reads", repetitiveReads);
+  logger.logDatum("alignments_read", alignmentsRead);
+  logger.logDatum("alignments_written", alignmentsWritten);
+  logger.logDatum("alignment_bytes_written", bytesWritten);
+}
@@ -0,0 +1,61 @@
+#ifndef CLOUD_BURST_FILTER_REDUCE_FUNCTION_H
+#define CLOUD_BURST_FILTER_REDUCE_FUNCTION_H
+
+#include <string>
+#include <vector>
+
+#include "core/StatLogger.h"
+#include "mapreduce/functions/reduce/ReduceFunction.h"
+#include "mapreduce/functions/reduce/cloudBurst/AlignmentCodec.h"
+#include "mapreduce/functions/reduce/cloudBurst/AlignmentFilter.h"
+#include "mapreduce/functions/reduce/cloudBurst/AlignmentRecord.h"
+
+/**
+   Reduce side of the CloudBurst alignment filter stage, after the original
+   CloudBurst FilterAlignments job. Its input is the output of
+   CloudBurstReduceFunction, which keys every alignment by the id of the
+   aligned read, so each call to reduce() sees all of one read's alignments.
+   Duplicates are dropped and only the read's best alignments by number of
+   differences are written, flagged ambiguous if they tie with alignments that
+   were dropped. Reads that hit the reducer's per-seed cap keep one
+   repetitive read marker. \sa AlignmentFilter
+
+   The kept alignments are written either as AlignmentRecords or as a single
+   grouped record per read. \sa AlignmentCodec
+ */
+class CloudBurstFilterReduceFunction : public ReduceFunction {
+public:
+  /// Constructor
+  /**
+     \param maxAlignmentsPerRead the number of alignments to keep per read; 1
+     keeps only the best alignment and 0 keeps every distinct alignment
+
+     \param outputFormat "records" or "grouped"
+   */
+  CloudBurstFilterReduceFunction(
+    uint32_t maxAlignmentsPerRead, const std::string& outputFormat);
+
+  /// \sa ReduceFunction::reduce
+  void reduce(
+    const uint8_t* key, uint64_t keyLength,
+    KVPairIterator& iterator, KVPairWriterInterface& writer);
+
+  /// Log filter statistics
+  void teardown(KVPairWriterInterface& writer);
+
+private:
+  AlignmentFilter alignmentFilter;
+  AlignmentRecord alignment;
+  const AlignmentCodec::Format outputFormat;
+  std::vector<uint8_t> groupBytes;
+
+  StatLogger logger;
+  uint64_t reads;
+  uint64_t ambiguousReads;
+  uint64_t repetitiveReads;
+  uint64_t alignmentsRead;
+  uint64_t alignmentsWritten;
+  uint64_t bytesWritten;
+};
+
+#endif // CLOUD_BURST_FILTER_REDUCE_FUNCTION_H
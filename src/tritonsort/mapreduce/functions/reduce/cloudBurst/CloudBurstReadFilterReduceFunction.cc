@@ -0,0 +1,59 @@
+#include <string.h>
+
+#include "CloudBurstReadFilterReduceFunction.h"
+#include "mapreduce/common/KeyValuePair.h"
+#include "mapreduce/functions/map/cloudBurst/CloudBurstReadFilterMapFunction.h"
+
+CloudBurstReadFilterReduceFunction::CloudBurstReadFilterReduceFunction(
+  uint32_t _maxAlignDiff)
+  : maxAlignDiff(_maxAlignDiff),
+    lastAlignedReadID(0),
+    haveAlignedRead(false),
+    logger("CloudBurstReadFilterReduceFunction"),
+    resolvedReads(0),
+    unresolvedReads(0),
+    alignments(0) {
+}
+
+void CloudBurstReadFilterReduceFunction::reduce(
+  const uint8_t* key, uint64_t keyLength,
+  KVPairIterator& iterator, KVPairWriterInterface& writer) {
+  int32_t readID;
+  ABORT_IF(keyLength != sizeof(readID) + 1, "Expected a %u byte read filter "
+           "key, but got %llu bytes",
+           static_cast<uint32_t>(sizeof(readID) + 1), keyLength);
+  memcpy(&readID, key, sizeof(readID));
+
+  KeyValuePair kvPair;
+  if (key[sizeof(readID)] == CloudBurstReadFilterMapFunction::ALIGNMENT_FLAG) {
+    while (iterator.next(kvPair)) {
+      alignments++;
+    }
+    lastAlignedReadID = readID;
+    haveAlignedRead = true;
+    resolvedReads++;
+    return;
+  }
+
+  if (haveAlignedRead && lastAlignedReadID == readID) {
+    // Aligned in this round
+    return;
+  }
+
+  // Pass the read on with its original key
+  while (iterator.next(kvPair)) {
+    KeyValuePair outputKVPair;
+    outputKVPair.setKey(key, sizeof(readID));
+    outputKVPair.setValue(kvPair.getValue(), kvPair.getValueLength());
+    writer.write(outputKVPair);
+  }
+  unresolvedReads++;
+}
+
+void CloudBurstReadFilterReduceFunction::teardown(
+  KVPairWriterInterface& writer) {
+  logger.logDatum("max_align_diff", maxAlignDiff);
+  logger.logDatum("resolved_reads", resolvedReads);
+  logger.logDatum("unresolved_reads", unresolvedReads);
+  logger.logDatum("alignments", alignments);
+}
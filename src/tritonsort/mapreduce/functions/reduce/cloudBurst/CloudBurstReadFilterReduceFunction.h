@@ -0,0 +1,50 @@
+#ifndef CLOUD_BURST_READ_FILTER_REDUCE_FUNCTION_H
+#define CLOUD_BURST_READ_FILTER_REDUCE_FUNCTION_H
+
+#include "core/StatLogger.h"
+#include "mapreduce/functions/reduce/ReduceFunction.h"
+
+/**
+   Reduce side of the job that runs between rounds of an iterative CloudBurst
+   job. Reads arrive keyed by read id and a flag byte, each just after the
+   alignments the round found for it (see CloudBurstReadFilterMapFunction),
+   and only reads with no alignments are written out, keyed by read id as in
+   the original input, to be aligned by the next round with more differences.
+
+   The numbers of reads the round resolved and left unresolved are logged
+   along with the round's maximum number of differences, which gives a
+   per-round summary of how many reads each K was needed for.
+ */
+class CloudBurstReadFilterReduceFunction : public ReduceFunction {
+public:
+  /// Constructor
+  /**
+     \param maxAlignDiff the maximum number of differences the round that
+     produced the alignments allowed; it is only logged
+   */
+  CloudBurstReadFilterReduceFunction(uint32_t maxAlignDiff);
+
+  /// \sa ReduceFunction::reduce
+  void reduce(
+    const uint8_t* key, uint64_t keyLength,
+    KVPairIterator& iterator, KVPairWriterInterface& writer);
+
+  /// Log the round summary
+  void teardown(KVPairWriterInterface& writer);
+
+private:
+  const uint32_t maxAlignDiff;
+
+  // The last read id seen with alignments. A read's alignments are reduced
+  // just before the read, possibly in the previous buffer, so the id is
+  // copied rather than pointing into the buffer.
+  int32_t lastAlignedReadID;
+  bool haveAlignedRead;
+
+  StatLogger logger;
+  uint64_t resolvedReads;
+  uint64_t unresolvedReads;
+  uint64_t alignments;
+};
+
+#endif // CLOUD_BURST_READ_FILTER_REDUCE_FUNCTION_H
@@ -1,26 +1,118 @@
+#include <algorithm>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+
 #include "CloudBurstReduceFunction.h"
 #include "core/MemoryUtils.h"
+#include "core/Timer.h"
 #include "mapreduce/common/KeyValuePair.h"
-#include "mapreduce/functions/reduce/cloudBurst/AlignInfo.h"
+
+const uint32_t CloudBurstReduceFunction::NUM_HOT_SEEDS;
 
 CloudBurstReduceFunction::CloudBurstReduceFunction(
   uint32_t _maxAlignDiff, uint32_t _seedLength, uint32_t _allowDifferences,
-  uint32_t _blockSize, uint32_t _redundancy)
-  : noalignment(-1, -1, -1, -1, true),
-    maxAlignDiff(_maxAlignDiff),
-    seedLength(_seedLength),
-    blockSize(_blockSize),
+  uint32_t _blockSize, uint32_t _redundancy, uint64_t _referenceMemoryLimit,
+  const std::string& _scratchDirectory, bool _hashGrouping,
+  const std::string& _seedMasks, int32_t minReadLen, int32_t maxReadLen,
+  const std::string& _readLengthClasses, uint32_t maxAlignmentsPerRead,
+  uint32_t _maxHitsPerSeed, const std::string& _referenceCacheDirectory,
+  const std::string& _referenceCacheMode, const std::string& readStoreFile,
+  bool _perfCounters)
+  : blockSize(_blockSize),
+    // With automatic sizing, queries are batched by 128 until the tuner has
+    // seen enough tuples to choose.
+    queryBlockSize(_blockSize > 0 ? _blockSize : 128),
+    referenceBlockSize(_blockSize > 0 ? _blockSize : 128),
     redundancy(_redundancy),
-    allowDifferences(_allowDifferences),
     readingReferenceTuples(false),
-    referenceKey(NULL),
-    referenceKeyLength(0) {
-  landauVishkinObj.configure(maxAlignDiff);
+    aligner(
+      _maxAlignDiff, _seedLength, _allowDifferences, _seedMasks, minReadLen,
+      maxReadLen, _readLengthClasses, maxAlignmentsPerRead, _maxHitsPerSeed),
+    referenceMemoryLimit(_referenceMemoryLimit),
+    scratchDirectory(_scratchDirectory),
+    referencePeakBytes(0),
+    spillFile(NULL),
+    spillFileReading(false),
+    spilledReferenceTuples(0),
+    hashGrouping(_hashGrouping),
+    referenceCacheMode(ReferenceCache::parseMode(_referenceCacheMode)),
+    referenceCacheDirectory(_referenceCacheDirectory),
+    referenceCacheWriter(NULL),
+    referenceCacheReader(NULL),
+    cachedReferenceGroups(0),
+    cachedReferenceTuples(0),
+    readStore(NULL),
+    queryTuplesResolved(0),
+    logger("CloudBurstReduceFunction"),
+    carryOverPending(false),
+    carryOverTuples(0),
+    numReferenceGroupsCarriedOver(0),
+    numReferenceTuplesCarriedOver(0),
+    referenceGroupsSpilled(0),
+    referenceTuplesSpilled(0),
+    groupQueryTuples(0),
+    seedGroups(0),
+    orphanedQueryGroups(0),
+    hotSeeds(NUM_HOT_SEEDS),
+    perfCounters(NULL) {
+  ABORT_IF(hashGrouping && referenceMemoryLimit > 0,
+           "CloudBurst hash grouping holds whole partitions in memory and "
+           "cannot be combined with a reference memory limit");
+  ABORT_IF(hashGrouping && referenceCacheMode != ReferenceCache::NONE,
+           "CloudBurst hash grouping cannot be combined with a reference "
+           "cache");
+  ABORT_IF(referenceCacheMode != ReferenceCache::NONE &&
+           referenceCacheDirectory.empty(),
+           "A CloudBurst reference cache mode was set without a directory");
+  if (referenceCacheMode == ReferenceCache::WRITE) {
+    referenceCacheWriter = new (themis::memcheck) ReferenceCacheWriter(
+      referenceCacheDirectory);
+  }
+  if (!readStoreFile.empty()) {
+    readStore = new (themis::memcheck) ReadStore();
+    readStore->open(readStoreFile);
+  }
+  referenceGroupSizeStatID =
+    logger.registerHistogramStat("reference_tuples_per_group", 1);
+  queryGroupSizeStatID =
+    logger.registerHistogramStat("query_tuples_per_group", 1);
+  if (_perfCounters) {
+    perfCounters = new (themis::memcheck) PerfCounters(NUM_PERF_REGIONS);
+  }
+}
+
+CloudBurstReduceFunction::~CloudBurstReduceFunction() {
+  if (spillFile != NULL) {
+    // The file was unlinked when it was created, so closing it frees it.
+    fclose(spillFile);
+    spillFile = NULL;
+  }
+  delete referenceCacheWriter;
+  delete referenceCacheReader;
+  delete readStore;
+  delete perfCounters;
 }
 
 void CloudBurstReduceFunction::reduce(
   const uint8_t* key, uint64_t keyLength,
   KVPairIterator& iterator, KVPairWriterInterface& writer) {
+  if (perfCounters != NULL) {
+    perfCounters->enter(PARSE_REGION);
+    reduceGroup(key, keyLength, iterator, writer);
+    perfCounters->leave();
+  } else {
+    reduceGroup(key, keyLength, iterator, writer);
+  }
+}
+
+void CloudBurstReduceFunction::reduceGroup(
+  const uint8_t* key, uint64_t keyLength,
+  KVPairIterator& iterator, KVPairWriterInterface& writer) {
+  if (hashGrouping) {
+    groupTuples(key, keyLength, iterator);
+    return;
+  }
 
   uint64_t tuplesRead = 0;
   MerRecord merIn;
@@ -35,36 +127,59 @@ void CloudBurstReduceFunction::reduce(
   uint8_t lastKeyByte = key[keyLength - 1];
   if (lastKeyByte == 0) {
     // Reference tuples should have a 0 in the last byte of the key.
-    readingReferenceTuples = true;
-    // Since we expect reference tuples before query tuples, we know this is a
-    // new seed, so we can clear out any old records.
-    referenceTuples.clear();
+    ABORT_IF(referenceCacheMode == ReferenceCache::READ, "Got reference "
+             "tuples while reading the reference from a cache; the map "
+             "function should drop the reference");
     ASSERT(queryTuples.empty(),
            "Got a new reference seed but the set of query tuples is non-empty. "
            "Query tuples should be written and cleared at the end of reduce()");
-    // Set the reference key so we can check if future query records have the
-    // same seed.
-    referenceKey = key;
-    referenceKeyLength = keyLength;
+    if (readingReferenceTuples && keyLength == referenceKey.size() &&
+        memcmp(key, referenceKey.data(), keyLength) == 0) {
+      // This is the rest of a reference group that was carried over from the
+      // previous buffer, so keep the tuples we already have.
+    } else {
+      // Since we expect reference tuples before query tuples, we know this is
+      // a new seed, so we can clear out any old records.
+      clearState();
+      // Set the reference key so we can check if future query records have
+      // the same seed.
+      referenceKey.assign(key, key + keyLength);
+    }
+    readingReferenceTuples = true;
   } else if (lastKeyByte == 1) {
     // Query tuples should have a 1 in the last byte of the key.
     readingReferenceTuples = false;
-    if (referenceTuples.empty()) {
+    if (referenceCacheMode == ReferenceCache::READ) {
+      loadCachedReferenceGroup(key, keyLength);
+    }
+    if (referenceTuples.empty() && spilledReferenceTuples == 0) {
       // There are no reference tuples for this seed, so just return.
+      ++orphanedQueryGroups;
       return;
     } else {
       // Verify that the query seed matches the previous reference seed, which
-      // is the key minus the last 2 bytes.
-      ASSERT(referenceKey != NULL,
-             "Reference key should not be NULL if reference records exist.");
-      if (keyLength != referenceKeyLength ||
-          memcmp(key, referenceKey, keyLength - 2) != 0) {
+      // is the key minus the last (reference/query flag) byte.
+      ASSERT(!referenceKey.empty(),
+             "Reference key should not be empty if reference records exist.");
+      if (keyLength != referenceKey.size() ||
+          memcmp(key, referenceKey.data(), keyLength - 1) != 0) {
         // These query records don't correspond to the previous reference
         // records, so clear the set of reference records and return.
-        referenceTuples.clear();
+        clearState();
+        ++orphanedQueryGroups;
         return;
       }
     }
+    if (carryOverPending) {
+      // These query tuples are joined with a reference group that was read
+      // before the buffer boundary.
+      ++numReferenceGroupsCarriedOver;
+      numReferenceTuplesCarriedOver += carryOverTuples;
+      carryOverPending = false;
+    }
+    if (groupQueryTuples == 0) {
+      groupKey.assign(key, key + keyLength);
+    }
   } else {
     ABORT("Last byte of the key should be 0 (reference) or 1 (query). Got %u",
           lastKeyByte);
@@ -80,17 +195,21 @@ void CloudBurstReduceFunction::reduce(
                "Got a reference tuple (tuple %llu) but expected only query "
                "tuples", tuplesRead);
 
-      // Store reference tuples in a vector because we don't expect to see any
-      // query tuples until the next invocation of reduce()
-      referenceTuples.push_back(merIn);
+      // Store reference tuples because we don't expect to see any query
+      // tuples until the next invocation of reduce().
+      storeReferenceTuple(merIn, tuple.getValue(), tuple.getValueLength());
+      if (referenceCacheWriter != NULL) {
+        referenceCacheWriter->append(
+          key, keyLength, tuple.getValue(), tuple.getValueLength());
+      }
     } else {
       ABORT_IF(readingReferenceTuples,
                "Got a query tuple (tuple %llu) but expected only reference "
                "tuples", tuplesRead);
 
-      // Store query tuples until we have a batch of size 'blockSize'
-      queryTuples.push_back(merIn);
-      if (queryTuples.size() == blockSize) {
+      // Store query tuples until we have a batch of size 'queryBlockSize'
+      storeQueryTuple(merIn);
+      if (queryTuples.size() >= queryBlockSize) {
         // Perform DNA alignment and write out a batch of records.
         alignBatch(writer);
         queryTuples.clear();
@@ -100,118 +219,456 @@ void CloudBurstReduceFunction::reduce(
     ++tuplesRead;
   }
 
+  if (readingReferenceTuples) {
+    ownReferenceTuples();
+  }
+
   // Write out any left over records.
   if (!queryTuples.empty()) {
     alignBatch(writer);
+    queryTuples.clear();
   }
 
-  // If we just finished aligning query tuples to reference tuples, clear out
-  // everything since we are expecting a new set of reference tuples.
-  if (!readingReferenceTuples) {
+  // Reference tuples are kept after their query group has been aligned, since
+  // the query group may continue in the next buffer. The next reference group
+  // or a query group for a different seed clears them.
+}
+
+void CloudBurstReduceFunction::configure() {
+  if (hashGrouping) {
+    // The table holds copies of the previous buffer's tuples, and their seeds
+    // may still get tuples from this buffer, so the join waits for teardown.
+    return;
+  }
+
+  ASSERT(queryTuples.empty(),
+         "Query tuples should be aligned before the end of a buffer");
+  if (referenceTuples.empty() && spilledReferenceTuples == 0) {
+    // Nothing can be joined across the buffer boundary.
     clearState();
+  } else {
+    // The reference group (or its query group) may continue in this buffer.
+    // Its tuples and key are already owned copies, so they are kept. It only
+    // counts as carried over once a query group for its seed arrives.
+    carryOverPending = true;
+    carryOverTuples = referenceTuples.size() + spilledReferenceTuples;
   }
 }
 
-void CloudBurstReduceFunction::configure() {
-  // Clear state between buffers.
-  clearState();
+void CloudBurstReduceFunction::teardown(KVPairWriterInterface& writer) {
+  if (hashGrouping) {
+    // The table holds the whole partition, so this is its peak size
+    logger.logDatum("hash_grouping_bytes", seedHashTable.bytes());
+    alignHashGroups(writer);
+  }
+  finishGroup();
+  logger.logDatum("seed_groups", seedGroups);
+  logger.logDatum("orphaned_query_groups", orphanedQueryGroups);
+  logger.logDatum("pairs_attempted", aligner.pairsAttempted());
+  logger.logDatum("pairs_aligned", aligner.pairsAligned());
+  logger.logDatum("baeza_yates_rejections", aligner.baezaYatesRejections());
+  logger.logDatum("extend_micros", aligner.extendMicros());
+  if (perfCounters != NULL) {
+    perfCounters->logRegion(
+      logger, PARSE_REGION, "parse", aligner.pairsAttempted(),
+      "attempted_pair");
+    perfCounters->logRegion(
+      logger, EXTEND_REGION, "extend", aligner.pairsAligned(), "aligned_pair");
+  }
+  std::vector<HotSeeds::Seed> hottest;
+  hotSeeds.sorted(hottest);
+  for (uint32_t i = 0; i < hottest.size(); i++) {
+    logger.logDatum("hot_seed_key", hottest[i].hexKey());
+    logger.logDatum("hot_seed_reference_tuples", hottest[i].referenceTuples);
+    logger.logDatum("hot_seed_query_tuples", hottest[i].queryTuples);
+  }
+  logger.logDatum(
+    "reference_groups_carried_over", numReferenceGroupsCarriedOver);
+  logger.logDatum(
+    "reference_tuples_carried_over", numReferenceTuplesCarriedOver);
+  logger.logDatum("reference_groups_spilled", referenceGroupsSpilled);
+  logger.logDatum("reference_tuples_spilled", referenceTuplesSpilled);
+  logger.logDatum("reference_group_peak_bytes", referencePeakBytes);
+  if (aligner.capsHits()) {
+    logger.logDatum("repetitive_query_tuples", aligner.repetitiveQueryTuples());
+  }
+  if (referenceCacheWriter != NULL) {
+    referenceCacheWriter->close();
+    logger.logDatum("reference_cache_runs_written",
+                    referenceCacheWriter->runs());
+    logger.logDatum("reference_cache_extents_written",
+                    referenceCacheWriter->extents());
+    logger.logDatum("reference_cache_tuples_written",
+                    referenceCacheWriter->tuples());
+  }
+  if (referenceCacheReader != NULL) {
+    logger.logDatum("reference_cache_runs", referenceCacheReader->runs());
+    logger.logDatum("reference_cache_extents_scanned",
+                    referenceCacheReader->extentsScanned());
+    logger.logDatum("reference_cache_rewinds",
+                    referenceCacheReader->rewinds());
+    logger.logDatum("reference_cache_groups_loaded", cachedReferenceGroups);
+    logger.logDatum("reference_cache_tuples_loaded", cachedReferenceTuples);
+  }
+  if (readStore != NULL) {
+    logger.logDatum("read_store_tuples_resolved", queryTuplesResolved);
+  }
+  if (aligner.filtersAlignments()) {
+    logger.logDatum("alignments_found", aligner.alignmentsFound());
+    logger.logDatum("alignments_written", aligner.alignmentsWritten());
+  }
 }
 
 void CloudBurstReduceFunction::clearState() {
+  finishGroup();
+  carryOverPending = false;
   referenceTuples.clear();
   queryTuples.clear();
-  referenceKey = NULL;
-  referenceKeyLength = 0;
+  referenceKey.clear();
+  referenceGroupBytes.clear();
+
+  if (spilledReferenceTuples > 0) {
+    // Discard the spilled tuples of the previous seed but keep the file.
+    fflush(spillFile);
+    ABORT_IF(ftruncate(fileno(spillFile), 0) != 0,
+             "Failed to truncate CloudBurst spill file: %s", strerror(errno));
+    rewind(spillFile);
+    spillFileReading = false;
+    spilledReferenceTuples = 0;
+  }
 }
 
-void CloudBurstReduceFunction::alignBatch(KVPairWriterInterface& writer) {
-  int32_t numRefTuples = referenceTuples.size();
-  int32_t numQueryTuples = queryTuples.size();
-
-  // join together the query-ref shared mers
-  if ((numRefTuples != 0) && (numQueryTuples != 0)) {
-    // Align reads to the references in blocks of blockSize x BLOCK_SIZE
-    // to improve cache locality
-    // define a qry block between [queryTuplesIndex, lastQueryTupleIndex)
-    for (int32_t queryTuplesIndex = 0; queryTuplesIndex < numQueryTuples;
-      queryTuplesIndex += blockSize) {
-      int32_t lastQueryTupleIndex = queryTuplesIndex + blockSize;
-      if (lastQueryTupleIndex > numQueryTuples) {
-        lastQueryTupleIndex = numQueryTuples;
+void CloudBurstReduceFunction::finishGroup() {
+  if (groupQueryTuples == 0) {
+    return;
+  }
+  uint64_t groupReferenceTuples =
+    referenceTuples.size() + spilledReferenceTuples;
+  ++seedGroups;
+  logger.logDatum(referenceGroupSizeStatID, groupReferenceTuples);
+  logger.logDatum(queryGroupSizeStatID, groupQueryTuples);
+  hotSeeds.add(
+    &groupKey[0], groupKey.size(), groupReferenceTuples, groupQueryTuples);
+  groupQueryTuples = 0;
+}
+
+void CloudBurstReduceFunction::storeReferenceTuple(
+  const MerRecord& tuple, const uint8_t* value, uint32_t valueLength) {
+  // Once the reducer's copy of the group reaches its memory limit, the rest
+  // of the group goes to the scratch file.
+  uint64_t tupleBytes = sizeof(MerRecord) + valueLength;
+  if (referenceMemoryLimit > 0 &&
+      (spilledReferenceTuples > 0 ||
+       referenceBytesInMemory() + tupleBytes > referenceMemoryLimit)) {
+    spillReferenceTuple(value, valueLength);
+  } else {
+    // The tuple is re-pointed at its copy by ownReferenceTuples()
+    referenceTuples.push_back(tuple);
+    referenceGroupBytes.insert(
+      referenceGroupBytes.end(), value, value + valueLength);
+    referencePeakBytes =
+      std::max<uint64_t>(referencePeakBytes, referenceBytesInMemory());
+  }
+}
+
+uint64_t CloudBurstReduceFunction::referenceBytesInMemory() const {
+  return referenceGroupBytes.size() +
+    referenceTuples.size() * sizeof(MerRecord);
+}
+
+void CloudBurstReduceFunction::loadCachedReferenceGroup(
+  const uint8_t* key, uint64_t keyLength) {
+  if (keyLength == referenceKey.size() &&
+      memcmp(key, referenceKey.data(), keyLength - 1) == 0) {
+    // The group was loaded for an earlier part of this query group
+    return;
+  }
+  clearState();
+
+  if (referenceCacheReader == NULL) {
+    referenceCacheReader = new (themis::memcheck) ReferenceCacheReader(
+      referenceCacheDirectory);
+  }
+
+  // The cached group is keyed by the seed's reference key. Its tuples are
+  // stored one at a time, so the memory limit applies to them as it does to
+  // a group of reference tuples.
+  referenceKey.assign(key, key + keyLength);
+  referenceKey.back() = 0;
+  if (!referenceCacheReader->find(referenceKey.data(), keyLength)) {
+    referenceKey.clear();
+    return;
+  }
+
+  MerRecord merIn;
+  uint64_t tuples = 0;
+  uint32_t length;
+  for (const uint8_t* tuple = referenceCacheReader->next(length);
+       tuple != NULL; tuple = referenceCacheReader->next(length)) {
+    merIn.fromBytes(tuple, length);
+    storeReferenceTuple(merIn, tuple, length);
+    ++tuples;
+  }
+  ownReferenceTuples();
+
+  ++cachedReferenceGroups;
+  cachedReferenceTuples += tuples;
+}
+
+void CloudBurstReduceFunction::ownReferenceTuples() {
+  const uint8_t* tuple = referenceGroupBytes.data();
+  for (std::vector<MerRecord>::iterator iter = referenceTuples.begin();
+       iter != referenceTuples.end(); iter++) {
+    uint32_t length = iter->serializedLength;
+    iter->fromBytes(tuple, length);
+    tuple += length;
+  }
+}
+
+void CloudBurstReduceFunction::spillReferenceTuple(
+  const uint8_t* value, uint32_t valueLength) {
+  if (spillFile == NULL) {
+    std::string path = scratchDirectory + "/cloudburst_spill_XXXXXX";
+    std::vector<char> pathTemplate(path.begin(), path.end());
+    pathTemplate.push_back('\0');
+
+    int fd = mkstemp(&pathTemplate[0]);
+    ABORT_IF(fd == -1, "Failed to create CloudBurst spill file in %s: %s",
+             scratchDirectory.c_str(), strerror(errno));
+    // Unlink right away so the file disappears when the reducer does.
+    unlink(&pathTemplate[0]);
+
+    spillFile = fdopen(fd, "w+b");
+    ABORT_IF(spillFile == NULL, "fdopen() of CloudBurst spill file failed: %s",
+             strerror(errno));
+  }
+
+  if (spillFileReading) {
+    // The C library requires a seek when switching from reading to writing.
+    fseek(spillFile, 0, SEEK_END);
+    spillFileReading = false;
+  }
+
+  if (spilledReferenceTuples == 0) {
+    ++referenceGroupsSpilled;
+  }
+
+  ABORT_IF(fwrite(&valueLength, sizeof(valueLength), 1, spillFile) != 1 ||
+           fwrite(value, valueLength, 1, spillFile) != 1,
+           "Failed to write to CloudBurst spill file: %s", strerror(errno));
+
+  ++spilledReferenceTuples;
+  ++referenceTuplesSpilled;
+}
+
+void CloudBurstReduceFunction::groupTuples(
+  const uint8_t* key, uint64_t keyLength, KVPairIterator& iterator) {
+  uint8_t lastKeyByte = key[keyLength - 1];
+  ABORT_IF(lastKeyByte > 1,
+           "Last byte of the key should be 0 (reference) or 1 (query). Got %u",
+           lastKeyByte);
+
+  // The seed is everything but the reference/query flag.
+  KeyValuePair tuple;
+  while (iterator.next(tuple)) {
+    seedHashTable.insert(
+      key, keyLength - 1, tuple.getValue(), tuple.getValueLength(),
+      lastKeyByte == 0);
+  }
+}
+
+void CloudBurstReduceFunction::alignHashGroups(KVPairWriterInterface& writer) {
+  if (perfCounters != NULL) {
+    // Tuples are parsed as their groups are aligned
+    perfCounters->enter(PARSE_REGION);
+  }
+
+  uint64_t capacity = seedHashTable.capacity();
+  for (uint64_t slot = 0; slot < capacity; slot++) {
+    if (!seedHashTable.occupied(slot) ||
+        seedHashTable.firstReference(slot) == 0 ||
+        seedHashTable.firstQuery(slot) == 0) {
+      // Seeds without both reference and query tuples can't align.
+      if (seedHashTable.occupied(slot) &&
+          seedHashTable.firstQuery(slot) != 0) {
+        ++orphanedQueryGroups;
       }
-      // define a ref block between [startRefTupleIndex, lastRefTupleIndex)
-      for (int32_t startRefTupleIndex = 0; startRefTupleIndex < numRefTuples;
-        startRefTupleIndex += blockSize) {
-        int32_t lastRefTupleIndex = startRefTupleIndex + blockSize;
-        if (lastRefTupleIndex > numRefTuples) {
-          lastRefTupleIndex = numRefTuples;
-        }
-        // for each element in [queryTuplesIndex, lastQueryTupleIndex)
-        for (int32_t curq = queryTuplesIndex; curq < lastQueryTupleIndex;
-          curq++) {
-          MerRecord& queryRecord = queryTuples[curq];
-          int32_t queryID = queryRecord.id;
-          // for each element in [startRefTupleIndex, lastRefTupleIndex)
-          for (int32_t curr = startRefTupleIndex; curr < lastRefTupleIndex;
-            curr++) {
-            AlignmentRecord* rec =
-              extend(queryRecord, referenceTuples[curr]);
-            if (rec->differences == -1) {
-              continue;
-            }
-            KeyValuePair outputKVPair;
-            outputKVPair.setKey(
-              reinterpret_cast<uint8_t*>(&queryID), sizeof(queryID));
-            byte* value = fullalignment.toBytes();
-            outputKVPair.setValue(
-              static_cast<uint8_t*>(value), fullalignment.outputSize);
-            writer.write(outputKVPair);
-          }
-        }
+      continue;
+    }
+    // Table seeds have no reference/query flag, so add a query flag to the
+    // group's key.
+    groupKey.assign(
+      seedHashTable.seed(slot),
+      seedHashTable.seed(slot) + seedHashTable.seedLength(slot));
+    groupKey.push_back(1);
+
+    referenceTuples.clear();
+    for (SeedHashTable::TupleHandle tuple = seedHashTable.firstReference(slot);
+         tuple != 0; tuple = seedHashTable.next(tuple)) {
+      referenceTuples.push_back(MerRecord());
+      referenceTuples.back().fromBytes(
+        seedHashTable.value(tuple), seedHashTable.valueLength(tuple));
+    }
+
+    for (SeedHashTable::TupleHandle tuple = seedHashTable.firstQuery(slot);
+         tuple != 0; tuple = seedHashTable.next(tuple)) {
+      MerRecord merIn;
+      merIn.fromBytes(
+        seedHashTable.value(tuple), seedHashTable.valueLength(tuple));
+      storeQueryTuple(merIn);
+      if (queryTuples.size() >= queryBlockSize) {
+        alignBatch(writer);
+        queryTuples.clear();
       }
     }
+
+    if (!queryTuples.empty()) {
+      alignBatch(writer);
+      queryTuples.clear();
+    }
+    finishGroup();
+  }
+
+  referenceTuples.clear();
+  seedHashTable.clear();
+  if (perfCounters != NULL) {
+    perfCounters->leave();
+  }
+}
+
+void CloudBurstReduceFunction::storeQueryTuple(const MerRecord& tuple) {
+  if (!tuple.isStub) {
+    queryTuples.push_back(tuple);
+    return;
+  }
+
+  ABORT_IF(readStore == NULL, "Got a query tuple stub, but no read store was "
+           "configured to rebuild it from");
+  // Buffers are reused from batch to batch, since each batch is cleared
+  // once aligned
+  uint64_t index = queryTuples.size();
+  if (index == resolvedQueryTuples.size()) {
+    resolvedQueryTuples.push_back(std::vector<uint8_t>());
+  }
+  std::vector<uint8_t>& bytes = resolvedQueryTuples[index];
+  readStore->resolve(tuple, bytes);
+  queryTuples.push_back(MerRecord());
+  queryTuples.back().fromBytes(&bytes[0], bytes.size());
+  ++queryTuplesResolved;
+}
+
+void CloudBurstReduceFunction::alignBatch(KVPairWriterInterface& writer) {
+  if (blockSize == 0 && !blockSizeTuner.initialized()) {
+    initializeBlockSizeTuner();
+  }
+
+  // alignBatch() is only called while tuples are being parsed
+  if (perfCounters != NULL) {
+    perfCounters->enter(EXTEND_REGION);
+  }
+
+  bool measuring = blockSizeTuner.tuning();
+  Timer timer;
+  if (measuring) {
+    timer.start();
+  }
+
+  groupQueryTuples += queryTuples.size();
+  KVPairAlignmentSink sink(writer);
+  aligner.startBatch(queryTuples.size());
+  aligner.alignBlock(
+    queryTuples, referenceTuples, queryBlockSize, referenceBlockSize, sink);
+
+  if (spilledReferenceTuples > 0) {
+    alignSpilledReferenceTuples(sink);
+  }
+
+  aligner.finishBatch(sink);
+
+  if (measuring) {
+    timer.stop();
+    uint64_t pairs = queryTuples.size() *
+      (referenceTuples.size() + spilledReferenceTuples);
+    if (blockSizeTuner.recordBatch(pairs, timer.getElapsed())) {
+      logger.logDatum("query_block_size", blockSizeTuner.queryBlockSize());
+      logger.logDatum(
+        "reference_block_size", blockSizeTuner.referenceBlockSize());
+    }
+    queryBlockSize = blockSizeTuner.queryBlockSize();
+    referenceBlockSize = blockSizeTuner.referenceBlockSize();
+  }
+
+  if (perfCounters != NULL) {
+    perfCounters->enter(PARSE_REGION);
+  }
+}
+
+void CloudBurstReduceFunction::initializeBlockSizeTuner() {
+  uint64_t queryBytes = 0;
+  for (std::vector<MerRecord>::iterator iter = queryTuples.begin();
+       iter != queryTuples.end(); iter++) {
+    queryBytes += sizeof(MerRecord) + iter->serializedLength;
+  }
+  uint64_t referenceBytes = 0;
+  for (std::vector<MerRecord>::iterator iter = referenceTuples.begin();
+       iter != referenceTuples.end(); iter++) {
+    referenceBytes += sizeof(MerRecord) + iter->serializedLength;
   }
+
+  uint64_t queryTupleBytes = queryBytes / std::max<uint64_t>(
+    queryTuples.size(), 1);
+  // If every reference tuple was spilled, assume they look like the queries.
+  uint64_t referenceTupleBytes = referenceTuples.empty() ? queryTupleBytes :
+    referenceBytes / referenceTuples.size();
+
+  blockSizeTuner.initialize(queryTupleBytes, referenceTupleBytes);
+  queryBlockSize = blockSizeTuner.queryBlockSize();
+  referenceBlockSize = blockSizeTuner.referenceBlockSize();
+
+  logger.logDatum("l1_cache_bytes", blockSizeTuner.l1CacheBytes());
+  logger.logDatum("l2_cache_bytes", blockSizeTuner.l2CacheBytes());
+  logger.logDatum("initial_query_block_size", queryBlockSize);
+  logger.logDatum("initial_reference_block_size", referenceBlockSize);
 }
 
-AlignmentRecord* CloudBurstReduceFunction::extend(
-  const MerRecord& qrytuple, const MerRecord& reftuple) {
-  int32_t refStart    = reftuple.offset;
-  int32_t refEnd      = reftuple.offset + seedLength;
-  int32_t differences = 0;
+void CloudBurstReduceFunction::alignSpilledReferenceTuples(
+  AlignmentSink& sink) {
+  fflush(spillFile);
+  rewind(spillFile);
+  spillFileReading = true;
 
-  if (qrytuple.leftFlankLength != 0) {
-    // at least 1 read base on the left needs to be aligned
-    int32_t realleftflanklen =
-      dnaStringObj.dnaArrLen(qrytuple.leftFlank, qrytuple.leftFlankLength);
-    // aligned the pre-reversed strings!
-    AlignInfo& a = landauVishkinObj.extend(
-      reftuple.leftFlank, reftuple.leftFlankLength, qrytuple.leftFlank,
-      qrytuple.leftFlankLength, maxAlignDiff, allowDifferences);
+  uint64_t tuplesRemaining = spilledReferenceTuples;
+  std::vector<uint32_t> tupleOffsets;
+  while (tuplesRemaining > 0) {
+    // Read the next referenceBlockSize tuples. Records are parsed only once
+    // the block is complete, since appending may move the block's bytes.
+    uint64_t tuplesInBlock =
+      std::min<uint64_t>(tuplesRemaining, referenceBlockSize);
+    spillBlockBytes.clear();
+    tupleOffsets.clear();
+    for (uint64_t i = 0; i < tuplesInBlock; i++) {
+      uint32_t valueLength = 0;
+      ABORT_IF(fread(&valueLength, sizeof(valueLength), 1, spillFile) != 1,
+               "Failed to read from CloudBurst spill file: %s",
+               strerror(errno));
+      uint32_t offset = spillBlockBytes.size();
+      spillBlockBytes.resize(offset + valueLength);
+      ABORT_IF(fread(&spillBlockBytes[offset], valueLength, 1, spillFile) != 1,
+               "Failed to read from CloudBurst spill file: %s",
+               strerror(errno));
+      tupleOffsets.push_back(offset);
+    }
+    tupleOffsets.push_back(spillBlockBytes.size());
 
-    if (a.alignlen == -1) {
-      return &noalignment;
-    }  // alignment failed
-    if (!a.isBazeaYatesSeed(realleftflanklen, seedLength)) {
-      return &noalignment;
+    spillBlock.resize(tuplesInBlock);
+    for (uint64_t i = 0; i < tuplesInBlock; i++) {
+      spillBlock[i].fromBytes(
+        &spillBlockBytes[tupleOffsets[i]],
+        tupleOffsets[i + 1] - tupleOffsets[i]);
     }
-    refStart -= a.alignlen;
-    differences = a.differences;
-  }
-  if (qrytuple.rightFlankLength != 0) {
-    AlignInfo& b = landauVishkinObj.extend(
-      reftuple.rightFlank, reftuple.rightFlankLength, qrytuple.rightFlank,
-      qrytuple.rightFlankLength, maxAlignDiff - differences, allowDifferences);
-
-    if (b.alignlen == -1) {
-      return &noalignment;
-    }  // alignment failed
-    refEnd += b.alignlen;
-    differences += b.differences;
-  }
-  fullalignment.refID = reftuple.id;
-  fullalignment.refStart = refStart;
-  fullalignment.refEnd = refEnd;
-  fullalignment.differences = differences;
-  fullalignment.isRC = qrytuple.isRC;
-  return &fullalignment;
+
+    aligner.alignBlock(
+      queryTuples, spillBlock, queryBlockSize, referenceBlockSize, sink);
+    tuplesRemaining -= tuplesInBlock;
+  }
 }
@@ -1,13 +1,25 @@
 #ifndef CLOUD_BURST_REDUCE_FUNCTION_H
 #define CLOUD_BURST_REDUCE_FUNCTION_H
 
+#include <deque>
+#include <stdio.h>
+#include <string>
 #include <vector>
 
+#include "core/StatLogger.h"
 #include "mapreduce/functions/reduce/ReduceFunction.h"
 #include "mapreduce/functions/map/cloudBurst/DNAString.h"
 #include "mapreduce/functions/map/cloudBurst/MerRecord.h"
-#include "mapreduce/functions/reduce/cloudBurst/AlignmentRecord.h"
-#include "mapreduce/functions/reduce/cloudBurst/LandauVishkin.h"
+#include "mapreduce/functions/map/cloudBurst/PerfCounters.h"
+#include "mapreduce/functions/reduce/cloudBurst/AlignmentSink.h"
+#include "mapreduce/functions/reduce/cloudBurst/BlockSizeTuner.h"
+#include "mapreduce/functions/reduce/cloudBurst/CloudBurstAligner.h"
+#include "mapreduce/functions/reduce/cloudBurst/HotSeeds.h"
+#include "mapreduce/functions/reduce/cloudBurst/ReadStore.h"
+#include "mapreduce/functions/reduce/cloudBurst/ReferenceCache.h"
+#include "mapreduce/functions/reduce/cloudBurst/ReferenceCacheReader.h"
+#include "mapreduce/functions/reduce/cloudBurst/ReferenceCacheWriter.h"
+#include "mapreduce/functions/reduce/cloudBurst/SeedHashTable.h"
 
 /**
    CloudBurst reduce function and associated helper classes based on the
@@ -30,7 +42,19 @@
    A tuple's value contains information about the sequences on either side of
    the seed, which are referred to as flanks. By definition, flanks are the
    parts of the sequences that are allowed to differ. Seeds are extended with
-   flanks in the extend() function and aligned in the alignBatch() function.
+   flanks and aligned by a CloudBurstAligner in the alignBatch() function.
+
+   With spaced seeds only the seed's care positions are known to match, so
+   the right flank starts at the seed itself and extend() verifies the whole
+   window.
+
+   In hash grouping mode the reducer does not depend on tuple order: tuples are
+   copied into a SeedHashTable by seed as they arrive, with reference and query
+   tuples kept in separate lists. A seed's tuples may arrive in any buffer, so
+   the join runs per bucket at teardown, once the whole partition has been
+   grouped. The whole partition must fit in memory. The framework still sorts
+   the partition, so the mode only pays off with a reduce phase that skips the
+   sort.
  */
 class CloudBurstReduceFunction : public ReduceFunction {
 public:
@@ -44,13 +68,70 @@ public:
      \param allowDifferences whether or not indels (insertions/deletions) should
      be allowed, or simply mismatches
 
-     \param blockSize the number of query tuples to batch up before aligning
+     \param blockSize the number of query tuples to batch up before aligning,
+     which is also the number of reference tuples per tile, or 0 to size the
+     query and reference tiles automatically with a BlockSizeTuner
 
      \param redundancy the number of copies of low complexity seeds to use
+
+     \param referenceMemoryLimit the number of bytes of a seed's reference
+     tuples the reducer may copy into its own memory before spilling the rest
+     to a scratch file, or 0 to copy every reference tuple. The limit counts
+     each copied tuple's bytes and its parsed MerRecord; the tuples in the
+     reduce buffer itself belong to the framework and are not counted
+
+     \param scratchDirectory the directory in which spill files are created
+
+     \param hashGrouping if true, group the partition's tuples by seed in a
+     hash table and join them at teardown, instead of relying on the sort to
+     place each seed's reference tuples before its query tuples
+
+     \param seedMasks the comma-separated spaced seed masks the map function
+     used, or an empty string for contiguous seeds
+
+     \param minReadLen the length of the shortest read
+
+     \param maxReadLen the length of the longest read
+
+     \param readLengthClasses the read length classes the map function used,
+     or an empty string for a single class with seeds of seedLength
+
+     \param maxAlignmentsPerRead if not 0, each query batch writes only the
+     alignments a later CloudBurstFilterReduceFunction keeping this many
+     alignments per read could keep, rather than every alignment
+
+     \param maxHitsPerSeed if not 0, a query tuple stops being extended once
+     it has this many alignments against its seed's reference tuples, and a
+     repetitive read marker is written for it instead of the rest
+
+     \param referenceCacheDirectory the directory of the reference cache, if
+     referenceCacheMode is not empty
+
+     \param referenceCacheMode "write" to also save every reference group to
+     the reference cache, "read" to align query groups against the reference
+     groups in the cache instead of reference tuples, or an empty string for
+     no cache. \sa ReferenceCache
+
+     \param readStoreFile the read store the map function's query tuple stubs
+     are rebuilt from, or an empty string if it emits whole query tuples.
+     \sa ReadStore
+
+     \param perfCounters if true, count cycles, instructions, cache misses
+     and branch misses with hardware counters, separately for reading tuples
+     and for aligning them. \sa PerfCounters
    */
   CloudBurstReduceFunction(
     uint32_t maxAlignDiff, uint32_t seedLength, uint32_t allowDifferences,
-    uint32_t blockSize, uint32_t redundancy);
+    uint32_t blockSize, uint32_t redundancy, uint64_t referenceMemoryLimit,
+    const std::string& scratchDirectory, bool hashGrouping,
+    const std::string& seedMasks, int32_t minReadLen, int32_t maxReadLen,
+    const std::string& readLengthClasses, uint32_t maxAlignmentsPerRead,
+    uint32_t maxHitsPerSeed, const std::string& referenceCacheDirectory,
+    const std::string& referenceCacheMode, const std::string& readStoreFile,
+    bool perfCounters);
+
+  /// Destructor
+  virtual ~CloudBurstReduceFunction();
 
   /// \sa ReduceFunction::reduce
   void reduce(
@@ -58,16 +139,92 @@ public:
     KVPairIterator& iterator, KVPairWriterInterface& writer);
 
   /**
-     Clear state when reducing a new buffer since old pointers may be invalid.
+     Prepare for a new buffer. The previous buffer may already be gone, so
+     nothing that points into it may be read here. Reference tuples are copied
+     into storage owned by the reducer as they are read, so a reference group
+     whose query group starts in the new buffer is kept as it is.
    */
   void configure();
 
+  /// Log reducer statistics and the seeds whose groups were the largest
+  void teardown(KVPairWriterInterface& writer);
+
+  /// \return the number of times a reference group kept across a buffer
+  /// boundary was joined with query tuples from the new buffer
+  inline uint64_t referenceGroupsCarriedOver() const {
+    return numReferenceGroupsCarriedOver;
+  }
+
+  /// \return the number of reference tuples in those carried over groups
+  inline uint64_t referenceTuplesCarriedOver() const {
+    return numReferenceTuplesCarriedOver;
+  }
+
+  /// The number of hottest seeds reported at teardown
+  static const uint32_t NUM_HOT_SEEDS = 20;
+
 private:
+  /**
+     Group the tuples of one key with its seed's other tuples, and align
+     them; reduce() wraps this in the hardware counters' parse region.
+   */
+  void reduceGroup(
+    const uint8_t* key, uint64_t keyLength,
+    KVPairIterator& iterator, KVPairWriterInterface& writer);
+
   /**
      Clear state so a new seed can be aligned.
    */
   void clearState();
 
+  /**
+     Log the size of the seed group that was last aligned, if any. A group's
+     query tuples may be aligned in several batches and buffers, so its size
+     is only known once the next group starts.
+   */
+  void finishGroup();
+
+  /**
+     Point the stored reference tuples at their copies in referenceGroupBytes.
+     Copies are appended as tuples are read, which may move the earlier ones,
+     so this is done once a reduce() call has stored all of its tuples.
+   */
+  void ownReferenceTuples();
+
+  /**
+     Copy a reference tuple of the current seed into referenceGroupBytes, or
+     append it to the scratch file once the reducer's copy of the group would
+     outgrow referenceMemoryLimit. The copy lets the group outlive the buffer
+     it was read from, so a seed whose reference group ends one buffer and
+     whose query group starts the next is still aligned.
+
+     \param tuple the parsed tuple
+
+     \param value the tuple's serialized MerRecord
+
+     \param valueLength the length of the serialized MerRecord
+   */
+  void storeReferenceTuple(
+    const MerRecord& tuple, const uint8_t* value, uint32_t valueLength);
+
+  /**
+     In reference cache read mode, load the reference group for a query
+     group's seed from the cache, unless it is already loaded.
+
+     \param key the query group's key
+
+     \param keyLength the length of the key
+   */
+  void loadCachedReferenceGroup(const uint8_t* key, uint64_t keyLength);
+
+  /**
+     Store a query tuple of the current seed, rebuilding it from the read
+     store first if it is a stub.
+
+     \param tuple the parsed tuple
+   */
+  void storeQueryTuple(const MerRecord& tuple);
+
   /**
      Align stored query tuples to stored reference tuples with the same seed,
      and write out any matches that are within the maximum number of
@@ -78,35 +235,133 @@ private:
   void alignBatch(KVPairWriterInterface& writer);
 
   /**
-     Extend seeds using the flank information in the tuple value, and compare
-     the extended query and reference records.
+     Stream the spilled reference tuples of the current seed back in blocks of
+     referenceBlockSize tuples and align the stored query tuples against each
+     block.
+
+     \param sink the sink for the current batch's alignments
+   */
+  void alignSpilledReferenceTuples(AlignmentSink& sink);
+
+  /**
+     Append a reference tuple to the scratch file, creating the file if this is
+     the first tuple to be spilled.
+
+     \param value the tuple's serialized MerRecord
+
+     \param valueLength the length of the serialized MerRecord
+   */
+  void spillReferenceTuple(const uint8_t* value, uint32_t valueLength);
+
+  /**
+     In hash grouping mode, copy every tuple of a reduce() call into the seed
+     hash table.
 
-     \param queryTuple the MerRecord representation of a query tuple to compare
+     \param key the key shared by the tuples
 
-     \param referenceTuple the MerRecord representation of a reference tuple to
-     compare
+     \param keyLength the length of the key
 
-     \return an AlignmentRecord that has the differences field set to -1 if the
-     records do NOT align
+     \param iterator an iterator over the tuples
    */
-  AlignmentRecord* extend(
-    const MerRecord& queryTuple, const MerRecord& referenceTuple);
+  void groupTuples(
+    const uint8_t* key, uint64_t keyLength, KVPairIterator& iterator);
+
+  /**
+     In hash grouping mode, run the alignment join for every seed in the hash
+     table that has both reference and query tuples, then empty the table.
+
+     \param writer the KVPairWriterInterface associated with the Reducer
+   */
+  void alignHashGroups(KVPairWriterInterface& writer);
+
+  /// \return the bytes of the stored reference group's copies and records
+  uint64_t referenceBytesInMemory() const;
+
+  /**
+     Seed the BlockSizeTuner with the average footprint of the stored tuples.
+   */
+  void initializeBlockSizeTuner();
 
-  AlignmentRecord noalignment;
-  AlignmentRecord fullalignment;
-  LandauVishkin  landauVishkinObj;
   std::vector<MerRecord> referenceTuples;
   std::vector<MerRecord> queryTuples;
   DNAString   dnaStringObj;
-  uint32_t maxAlignDiff;
-  uint32_t seedLength;
   uint32_t blockSize;
+  uint32_t queryBlockSize;
+  uint32_t referenceBlockSize;
+  BlockSizeTuner blockSizeTuner;
   uint32_t redundancy;
-  bool allowDifferences;
-  bool filterAlignments;
   bool readingReferenceTuples;
-  const uint8_t* referenceKey;
-  uint32_t referenceKeyLength;
+
+  // The seed join, which also applies the hit cap and the per-batch filter
+  CloudBurstAligner aligner;
+
+  // The key and serialized tuples of the stored reference group. The
+  // MerRecords in referenceTuples point into referenceGroupBytes once the
+  // reduce() call that read them returns.
+  std::vector<uint8_t> referenceKey;
+  std::vector<uint8_t> referenceGroupBytes;
+
+  // Reference tuples that would take the reducer's copy of a group past
+  // referenceMemoryLimit are spilled to an unlinked scratch file as
+  // (uint32_t length, MerRecord bytes) entries instead of being copied.
+  const uint64_t referenceMemoryLimit;
+  const std::string scratchDirectory;
+  uint64_t referencePeakBytes;
+  FILE* spillFile;
+  bool spillFileReading;
+  uint64_t spilledReferenceTuples;
+  std::vector<uint8_t> spillBlockBytes;
+  std::vector<MerRecord> spillBlock;
+
+  // Hash grouping mode copies every tuple of the partition into the table,
+  // so no buffer needs to outlive its reduce() calls.
+  const bool hashGrouping;
+  SeedHashTable seedHashTable;
+
+  // Persistent reference cache. In read mode, the current seed's reference
+  // group is streamed from the cache and stored like a group of tuples.
+  const ReferenceCache::Mode referenceCacheMode;
+  const std::string referenceCacheDirectory;
+  ReferenceCacheWriter* referenceCacheWriter;
+  ReferenceCacheReader* referenceCacheReader;
+  uint64_t cachedReferenceGroups;
+  uint64_t cachedReferenceTuples;
+
+  // Node-local read store. Rebuilt query tuples are owned by the reducer
+  // until their batch is aligned; a deque keeps them in place as it grows.
+  ReadStore* readStore;
+  std::deque<std::vector<uint8_t> > resolvedQueryTuples;
+  uint64_t queryTuplesResolved;
+
+  StatLogger logger;
+  // Set by configure() when it keeps a reference group, and counted once a
+  // query group for that seed arrives in the new buffer.
+  bool carryOverPending;
+  uint64_t carryOverTuples;
+  uint64_t numReferenceGroupsCarriedOver;
+  uint64_t numReferenceTuplesCarriedOver;
+  uint64_t referenceGroupsSpilled;
+  uint64_t referenceTuplesSpilled;
+
+  // Join statistics. groupKey and groupQueryTuples describe the seed group
+  // being aligned; orphaned query groups have no reference tuples.
+  std::vector<uint8_t> groupKey;
+  uint64_t groupQueryTuples;
+  uint64_t seedGroups;
+  uint64_t orphanedQueryGroups;
+  uint64_t referenceGroupSizeStatID;
+  uint64_t queryGroupSizeStatID;
+  HotSeeds hotSeeds;
+
+  // Hardware counters, or NULL if they are off. The parse region covers
+  // reading, parsing and storing tuples, and the extend region covers
+  // alignBatch().
+  enum PerfRegion {
+    PARSE_REGION,
+    EXTEND_REGION,
+    NUM_PERF_REGIONS
+  };
+  PerfCounters* perfCounters;
 };
 
 #endif // CLOUD_BURST_REDUCE_FUNCTION_H
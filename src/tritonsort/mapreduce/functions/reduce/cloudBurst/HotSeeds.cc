@@ -0,0 +1,69 @@
+#include <algorithm>
+
+#include "HotSeeds.h"
+
+/// Orders seeds hottest first, so the heap's front is its coolest seed
+static bool hotter(const HotSeeds::Seed& first, const HotSeeds::Seed& second) {
+  if (first.pairs != second.pairs) {
+    return first.pairs > second.pairs;
+  }
+  return first.key < second.key;
+}
+
+std::string HotSeeds::Seed::hexKey() const {
+  static const char digits[] = "0123456789abcdef";
+  std::string hex;
+  for (uint32_t i = 0; i + 1 < key.size(); i++) {
+    hex.push_back(digits[key[i] >> 4]);
+    hex.push_back(digits[key[i] & 0xF]);
+  }
+  return hex;
+}
+
+HotSeeds::HotSeeds(uint32_t _maxSeeds)
+  : maxSeeds(_maxSeeds) {
+}
+
+void HotSeeds::add(
+  const uint8_t* key, uint32_t keyLength, uint64_t referenceTuples,
+  uint64_t queryTuples) {
+  uint64_t pairs = referenceTuples * queryTuples;
+  if (maxSeeds == 0 ||
+      (seeds.size() == maxSeeds && pairs <= seeds.front().pairs)) {
+    // Most groups are not hot, so check before copying the key
+    return;
+  }
+  Seed seed;
+  seed.key.assign(key, key + keyLength);
+  seed.referenceTuples = referenceTuples;
+  seed.queryTuples = queryTuples;
+  seed.pairs = pairs;
+  add(seed);
+}
+
+void HotSeeds::add(const HotSeeds& other) {
+  for (uint32_t i = 0; i < other.seeds.size(); i++) {
+    add(other.seeds[i]);
+  }
+}
+
+void HotSeeds::add(const Seed& seed) {
+  if (seeds.size() == maxSeeds) {
+    if (!hotter(seed, seeds.front())) {
+      return;
+    }
+    std::pop_heap(seeds.begin(), seeds.end(), hotter);
+    seeds.pop_back();
+  }
+  seeds.push_back(seed);
+  std::push_heap(seeds.begin(), seeds.end(), hotter);
+}
+
+void HotSeeds::sorted(std::vector<Seed>& hottest) const {
+  hottest = seeds;
+  std::sort(hottest.begin(), hottest.end(), hotter);
+}
+
+void HotSeeds::clear() {
+  seeds.clear();
+}
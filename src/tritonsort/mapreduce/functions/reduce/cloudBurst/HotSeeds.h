@@ -0,0 +1,76 @@
+#ifndef _HOT_SEEDS_H_
+#define _HOT_SEEDS_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+   Keeps the seeds whose groups cost the join the most, for a report at the
+   end of the join. A seed group with R reference tuples and Q query tuples
+   costs R * Q extensions, so a handful of repetitive seeds often dominate
+   the join; the report says which ones, so they can be masked or given more
+   redundancy.
+
+   The hottest seeds are kept in a min-heap of bounded size, so adding a group
+   that is not among them costs one comparison.
+ */
+class HotSeeds {
+public:
+  /// A seed and the size of its group
+  struct Seed {
+    std::vector<uint8_t> key;
+    uint64_t referenceTuples;
+    uint64_t queryTuples;
+    uint64_t pairs;
+
+    /// \return the seed's key in hex, without its reference/query flag byte
+    std::string hexKey() const;
+  };
+
+  /// Constructor
+  /**
+     \param maxSeeds the number of seeds to keep
+   */
+  HotSeeds(uint32_t maxSeeds);
+
+  /**
+     Add a seed group.
+
+     \param key the seed's key
+
+     \param keyLength the length of the key
+
+     \param referenceTuples the number of reference tuples in the group
+
+     \param queryTuples the number of query tuples in the group
+   */
+  void add(
+    const uint8_t* key, uint32_t keyLength, uint64_t referenceTuples,
+    uint64_t queryTuples);
+
+  /**
+     Add the seeds another HotSeeds kept.
+
+     \param other the seeds to add
+   */
+  void add(const HotSeeds& other);
+
+  /**
+     Get the seeds kept, hottest first.
+
+     \param[out] hottest set to the seeds kept
+   */
+  void sorted(std::vector<Seed>& hottest) const;
+
+  /// Drop every seed kept
+  void clear();
+
+private:
+  void add(const Seed& seed);
+
+  const uint32_t maxSeeds;
+  std::vector<Seed> seeds;
+};
+
+#endif  // _HOT_SEEDS_H_
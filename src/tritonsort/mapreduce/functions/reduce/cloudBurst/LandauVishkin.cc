@@ -121,19 +121,29 @@ AlignInfo& LandauVishkin::kdifference(
 //  extend
 //  align the strings either for either k-mismatch or k-difference
 AlignInfo& LandauVishkin::extend(
-  const byte* refbin, int32_t refLength, const byte* qrybin,
-  int32_t qryLength, int32_t k, bool allowDiff) {
+  const PackedFlank& ref, const PackedFlank& qry, int32_t k, bool allowDiff,
+  bool complementQuery) {
   if (allowDiff) {
-    if(refLength < 1 || qryLength < 1) {
+    if (ref.length < 1 || qry.length < 1) {
       return badAlignment;
     }
-    byte* ref = dnaStringObj.dnaToArr(refbin, refLength);
-    byte* qry = dnaStringObj.dnaToArr(refbin, qryLength);
-    AlignInfo& a = kdifference(ref, refLength, qry, qryLength, k);
-    delete[] ref;
-    delete[] qry;
-    return a;
+    // k-difference works on letters, so unpack both flanks.
+    refLetters.resize(ref.length);
+    qryLetters.resize(qry.length);
+    dnaStringObj.packedToArr(
+      ref.bases, ref.length, ref.exceptions, ref.numExceptions,
+      &refLetters[0]);
+    dnaStringObj.packedToArr(
+      qry.bases, qry.length, qry.exceptions, qry.numExceptions,
+      &qryLetters[0]);
+    if (complementQuery) {
+      for (uint32_t i = 0; i < qry.length; i++) {
+        qryLetters[i] = dnaStringObj.rc(qryLetters[i]);
+      }
+    }
+    return kdifference(
+      &refLetters[0], ref.length, &qryLetters[0], qry.length, k);
   } else {
-    return kmismatch_bin(refbin, refLength, qrybin, qryLength, k);
+    return kmismatch_bin(ref, qry, k, complementQuery);
   }
 }
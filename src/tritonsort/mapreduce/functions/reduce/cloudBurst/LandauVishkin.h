@@ -1,9 +1,13 @@
 #ifndef _LANDAU_VISHKIN_H
 #define _LANDAU_VISHKIN_H
 
+#include <string.h>
+#include <vector>
+
 #include "AlignInfo.h"
 #include "AlignmentRecord.h"
 #include "mapreduce/functions/map/cloudBurst/DNAString.h"
+#include "mapreduce/functions/map/cloudBurst/MerRecord.h"
 
 class LandauVishkin {
 public:
@@ -25,113 +29,96 @@ public:
     int32_t patternLength, int32_t k);
 
   AlignInfo& extend(
-    const byte* refbin, int32_t refLength, const byte* qrybin,
-    int32_t qryLength, int32_t K, bool ALLOW_DIFFERENCES);
+    const PackedFlank& ref, const PackedFlank& qry, int32_t K,
+    bool ALLOW_DIFFERENCES, bool complementQuery = false);
 
-  // Ever so slightly optimized version of kmismatch_bin, inlined for
-  // performance
-  // text corresponds to reference and pattern corresponds to query
+  // k-mismatch alignment of two 2-bit packed flanks, inlined for performance.
+  // text corresponds to reference and pattern corresponds to query. An N
+  // mismatches every base but matches another N. If complementPattern is set,
+  // the pattern's bases are complemented before comparing.
   inline AlignInfo& kmismatch_bin(
-    const byte* text, int32_t textLength, const byte* pattern,
-    int32_t patternLength, int32_t k) {
+    const PackedFlank& text, const PackedFlank& pattern, int32_t k,
+    bool complementPattern = false) {
+    // Complementing a 2-bit base code is XOR with 3.
+    uint8_t patternMask = complementPattern ? 0xFF : 0x00;
+
+    int32_t patternLength = pattern.length;
     if (patternLength == 0) {
       // 0-length query patterns should be considered as if they did not align.
       return noAlignment;
-    } else if (textLength < patternLength) {
+    } else if (static_cast<int32_t>(text.length) < patternLength) {
       // The reference (text) must be long enough to fully contain the query.
       return badAlignment;
     }
 
-    int32_t alignmentLength = std::min<int32_t>(textLength, patternLength);
-
     int32_t distanceFromLastDifference = 0;
     int32_t differences = 0;
 
-    const byte* lastTextByte = text + alignmentLength - 1;
-    // Convert alignment length to base pairs.
-    alignmentLength *= 2;
-
-    // Check the last byte separately since it might contain an odd number of
-    // base pairs.
-    while (text < lastTextByte) {
-      // Each byte encodes 2 sets of base pairs, so we need to compare 4 bit
-      // nibbles. The most efficient way to do this is to XOR the two bytes and
-      // check if a left or right shift is 0.
-      uint8_t byteXOR = *text ^ *pattern;
-
-      // Check high bits
-      if ((byteXOR >> 4) != 0) {
-        if (differences >= k) {
-          return badAlignment;
+    if (text.numExceptions == 0 && pattern.numExceptions == 0) {
+      // Fast path: XOR whole bytes of 4 bases and only look at individual
+      // bases when the bytes differ.
+      int32_t fullBytes = patternLength / 4;
+      for (int32_t i = 0; i < fullBytes; i++) {
+        uint8_t byteXOR = text.bases[i] ^ pattern.bases[i] ^ patternMask;
+        if (byteXOR == 0) {
+          distanceFromLastDifference += 4;
+          continue;
         }
-        dist[differences] = distanceFromLastDifference;
-        distanceFromLastDifference = 1;
-        ++differences;
-      } else {
-        ++distanceFromLastDifference;
-      }
-
-      // Check low bits
-      if ((byteXOR & 0x0F) != 0) {
-        if (differences >= k) {
-          return badAlignment;
+        for (int32_t shift = 6; shift >= 0; shift -= 2) {
+          if (((byteXOR >> shift) & 0x03) != 0) {
+            if (!addDifference(differences, distanceFromLastDifference, k)) {
+              return badAlignment;
+            }
+          } else {
+            ++distanceFromLastDifference;
+          }
         }
-        dist[differences] = distanceFromLastDifference;
-        distanceFromLastDifference = 1;
-        ++differences;
-      } else {
-        ++distanceFromLastDifference;
       }
 
-      // Advance to the next byte.
-      ++text;
-      ++pattern;
-    }
-
-    // Check the last byte, which might have a space in the second nibble.
-    uint8_t byteXOR = *text ^ *pattern;
-    if ((*text & 0x0F) == dnaStringObj.space ||
-        ((*pattern & 0x0F) == dnaStringObj.space)) {
-      // One of the strings has a space in the second nibble, so only compare the
-      // first set of base pairs.
-
-      // Check high bits
-      if ((byteXOR >> 4) != 0) {
-        if (differences >= k) {
-          return badAlignment;
+      // The last byte may hold fewer than 4 bases.
+      int32_t remaining = patternLength % 4;
+      if (remaining > 0) {
+        uint8_t byteXOR =
+          text.bases[fullBytes] ^ pattern.bases[fullBytes] ^ patternMask;
+        for (int32_t shift = 6; shift > 6 - 2 * remaining; shift -= 2) {
+          if (((byteXOR >> shift) & 0x03) != 0) {
+            if (!addDifference(differences, distanceFromLastDifference, k)) {
+              return badAlignment;
+            }
+          } else {
+            ++distanceFromLastDifference;
+          }
         }
-        dist[differences] = distanceFromLastDifference;
-        distanceFromLastDifference = 1;
-        ++differences;
-      } else {
-        ++distanceFromLastDifference;
       }
-
-      // Since the last base pair set is ignored, reduce the alignment by 1.
-      --alignmentLength;
     } else {
-      // Check high bits
-      if ((byteXOR >> 4) != 0) {
-        if (differences >= k) {
-          return badAlignment;
+      // Slow path: walk the exception lists, which are sorted by position,
+      // alongside the bases.
+      uint32_t textException = 0;
+      uint32_t patternException = 0;
+      for (int32_t i = 0; i < patternLength; i++) {
+        bool textN = textException < text.numExceptions &&
+          text.exception(textException) == i;
+        bool patternN = patternException < pattern.numExceptions &&
+          pattern.exception(patternException) == i;
+        textException += textN;
+        patternException += patternN;
+
+        bool mismatch;
+        if (textN || patternN) {
+          mismatch = !(textN && patternN);
+        } else {
+          int32_t shift = 6 - 2 * (i % 4);
+          mismatch = (((text.bases[i / 4] ^ pattern.bases[i / 4] ^
+                        patternMask) >> shift) & 0x03) != 0;
         }
-        dist[differences] = distanceFromLastDifference;
-        distanceFromLastDifference = 1;
-        ++differences;
-      } else {
-        ++distanceFromLastDifference;
-      }
 
-      // Check low bits
-      if ((byteXOR & 0x0F) != 0) {
-        if (differences >= k) {
-          return badAlignment;
+        if (mismatch) {
+          if (!addDifference(differences, distanceFromLastDifference, k)) {
+            return badAlignment;
+          }
+        } else {
+          ++distanceFromLastDifference;
         }
-        dist[differences] = distanceFromLastDifference;
-        distanceFromLastDifference = 1;
-        ++differences;
-      } else {
-        distanceFromLastDifference++;
       }
     }
 
@@ -143,8 +130,25 @@ public:
     what[differences] = 2;
 
     goodAlignment.setVals(
-      alignmentLength, differences, dist, what, differences + 1);
+      patternLength, differences, dist, what, differences + 1);
     return goodAlignment;
   }
+
+private:
+  // Record a mismatch for kmismatch_bin; returns false if it is one too many.
+  inline bool addDifference(
+    int32_t& differences, int32_t& distanceFromLastDifference, int32_t k) {
+    if (differences >= k) {
+      return false;
+    }
+    dist[differences] = distanceFromLastDifference;
+    distanceFromLastDifference = 1;
+    ++differences;
+    return true;
+  }
+
+  // Letter buffers for k-difference alignment of packed flanks
+  std::vector<byte> refLetters;
+  std::vector<byte> qryLetters;
 };
 #endif
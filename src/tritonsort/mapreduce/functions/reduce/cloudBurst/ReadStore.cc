@@ -0,0 +1,174 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ReadStore.h"
+#include "core/TritonSortAssert.h"
+#include "mapreduce/common/KeyValuePair.h"
+#include "mapreduce/functions/map/cloudBurst/DNAString.h"
+#include "mapreduce/functions/map/cloudBurst/FastaRecord.h"
+#include "mapreduce/functions/map/cloudBurst/MerRecord.h"
+#include "mapreduce/functions/map/cloudBurst/TupleFile.h"
+
+const uint32_t ReadStore::VERSION = 1;
+
+static const uint8_t MAGIC[4] = {'C', 'B', 'R', 'S'};
+
+/// \return the read id keying a query input tuple
+static uint64_t readID(const KeyValuePair& kvPair, const std::string& path) {
+  ABORT_IF(kvPair.getKeyLength() != sizeof(int32_t), "Expected a 4-byte read "
+           "id key in %s, but got %u bytes", path.c_str(),
+           kvPair.getKeyLength());
+  int32_t id;
+  memcpy(&id, kvPair.getKey(), sizeof(id));
+  ABORT_IF(id < 0, "Read id %d in %s is negative", id, path.c_str());
+  return id;
+}
+
+ReadStore::ReadStore()
+  : image(NULL),
+    length(0),
+    reads(0),
+    offsets(NULL),
+    records(NULL) {
+}
+
+ReadStore::~ReadStore() {
+  close();
+}
+
+void ReadStore::build(
+  const std::vector<std::string>& queryPaths, const std::string& path) {
+  // The first pass sizes every read's record, so that the second can write
+  // the records in id order whatever order the files hold them in.
+  std::vector<uint64_t> recordLengths;
+  KeyValuePair kvPair;
+  for (uint32_t i = 0; i < queryPaths.size(); i++) {
+    TupleFile file;
+    file.load(queryPaths[i]);
+    for (uint64_t tuple = 0; tuple < file.size(); tuple++) {
+      file.get(tuple, kvPair);
+      uint64_t id = readID(kvPair, queryPaths[i]);
+      FastaRecord record(kvPair.getValue(), kvPair.getValueLength());
+      delete[] record.sequence;
+      ABORT_IF(!record.lastChunk || record.offset != 0, "Read %llu in %s is "
+               "split into chunks, which a read store cannot hold", id,
+               queryPaths[i].c_str());
+      if (id >= recordLengths.size()) {
+        recordLengths.resize(id + 1, 0);
+      }
+      ABORT_IF(recordLengths[id] != 0, "Read id %llu appears more than once",
+               id);
+      recordLengths[id] = kvPair.getValueLength();
+    }
+  }
+
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.reads = recordLengths.size();
+
+  std::vector<uint64_t> recordOffsets(header.reads + 1, 0);
+  for (uint64_t id = 0; id < header.reads; id++) {
+    recordOffsets[id + 1] = recordOffsets[id] + recordLengths[id];
+  }
+  std::vector<uint8_t> recordBytes(recordOffsets[header.reads]);
+  for (uint32_t i = 0; i < queryPaths.size(); i++) {
+    TupleFile file;
+    file.load(queryPaths[i]);
+    for (uint64_t tuple = 0; tuple < file.size(); tuple++) {
+      file.get(tuple, kvPair);
+      memcpy(&recordBytes[recordOffsets[readID(kvPair, queryPaths[i])]],
+             kvPair.getValue(), kvPair.getValueLength());
+    }
+  }
+
+  FILE* file = fopen(path.c_str(), "wb");
+  ABORT_IF(file == NULL, "Failed to open %s: %s", path.c_str(),
+           strerror(errno));
+  ABORT_IF(fwrite(&header, sizeof(header), 1, file) != 1 ||
+           fwrite(&recordOffsets[0], sizeof(uint64_t), recordOffsets.size(),
+                  file) != recordOffsets.size() ||
+           (!recordBytes.empty() &&
+            fwrite(&recordBytes[0], recordBytes.size(), 1, file) != 1),
+           "Failed to write %s: %s", path.c_str(), strerror(errno));
+  ABORT_IF(fclose(file) != 0, "Failed to close %s: %s", path.c_str(),
+           strerror(errno));
+}
+
+void ReadStore::open(const std::string& path) {
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  ABORT_IF(fd < 0, "Failed to open CloudBurst read store %s: %s",
+           path.c_str(), strerror(errno));
+  struct stat fileStat;
+  ABORT_IF(fstat(fd, &fileStat) != 0, "Failed to stat %s: %s", path.c_str(),
+           strerror(errno));
+  length = fileStat.st_size;
+  ABORT_IF(length < sizeof(Header), "%s is too short to be a read store",
+           path.c_str());
+  void* mapping = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+  ABORT_IF(mapping == MAP_FAILED, "Failed to map %s: %s", path.c_str(),
+           strerror(errno));
+  ::close(fd);
+  image = static_cast<const uint8_t*>(mapping);
+
+  const Header* header = reinterpret_cast<const Header*>(image);
+  ABORT_IF(memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0,
+           "%s is not a CloudBurst read store", path.c_str());
+  ABORT_IF(header->version != VERSION, "Read store version %u is not "
+           "supported; expected version %u", header->version, VERSION);
+  reads = header->reads;
+  offsets = reinterpret_cast<const uint64_t*>(image + sizeof(Header));
+  records = reinterpret_cast<const uint8_t*>(offsets + reads + 1);
+  ABORT_IF(sizeof(Header) + (reads + 1) * sizeof(uint64_t) > length ||
+           sizeof(Header) + (reads + 1) * sizeof(uint64_t) + offsets[reads] >
+           length, "Read store %s is truncated", path.c_str());
+}
+
+void ReadStore::resolve(
+  const MerRecord& stub, std::vector<uint8_t>& tuple) const {
+  ABORT_IF(stub.id < 0 || static_cast<uint64_t>(stub.id) >= reads ||
+           offsets[stub.id] == offsets[stub.id + 1],
+           "Read %lld is not in the read store", stub.id);
+  FastaRecord record(
+    records + offsets[stub.id], offsets[stub.id + 1] - offsets[stub.id]);
+  byte* seq = record.sequence;
+  int32_t seqLen = record.sequenceLength;
+  if (stub.isRC) {
+    // Offsets and flanks of reverse strand tuples are relative to the
+    // reverse complemented read, as the map function seeded it
+    record.dnaStringObj.reverseComplementSequenceInPlace(seq, seqLen);
+  }
+  ABORT_IF(static_cast<int32_t>(
+             stub.leftFlank.length + stub.rightFlank.length) > seqLen,
+           "Stub of read %lld has %u flank bases, but the read has only %d",
+           stub.id, stub.leftFlank.length + stub.rightFlank.length, seqLen);
+
+  MerRecord resolved(stub);
+  int32_t leftLength = stub.leftFlank.length;
+  int32_t rightLength = stub.rightFlank.length;
+  int32_t rightStart = seqLen - rightLength;
+  byte* bytes = resolved.toBytes(seq, 0, leftLength, rightStart, rightLength);
+  tuple.assign(bytes, bytes + resolved.toBytesLen(
+                 seq, 0, leftLength, rightStart, rightLength));
+  delete[] bytes;
+  delete[] seq;
+}
+
+void ReadStore::close() {
+  if (image != NULL) {
+    munmap(const_cast<uint8_t*>(image), length);
+  }
+  image = NULL;
+  length = 0;
+  reads = 0;
+  offsets = NULL;
+  records = NULL;
+}
@@ -0,0 +1,87 @@
+#ifndef _READ_STORE_H_
+#define _READ_STORE_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class MerRecord;
+
+/**
+   A job's reads, packed and indexed by read id in a file that is copied to
+   every node and memory-mapped by the reducers there. With a read store the
+   map function emits query tuple stubs, which carry a read's id, strand and
+   seed position but none of its bases, and the reducer rebuilds each query
+   tuple from the store, so a read is shuffled once per seed as a few bytes
+   rather than as a copy of the whole read.
+
+   The store keeps each read as its converted FastaRecord, 2 bases per byte:
+
+     magic            4 bytes  "CBRS"
+     version          uint32
+     reads            uint64   one more than the largest read id
+     offsets          uint64 each, reads + 1 of them, relative to the end
+                      of the offsets; a read's record runs to the next
+                      read's offset, and ids with no read have no bytes
+     records
+ */
+class ReadStore {
+public:
+  /// Constructor
+  ReadStore();
+
+  /// Destructor
+  virtual ~ReadStore();
+
+  /**
+     Write a store holding the reads in converted query input files.
+
+     \param queryPaths the converted query input files. \sa TupleFile
+
+     \param path the store's path
+   */
+  static void build(
+    const std::vector<std::string>& queryPaths, const std::string& path);
+
+  /**
+     Memory-map a store file.
+
+     \param path the file's path
+   */
+  void open(const std::string& path);
+
+  /**
+     Rebuild a query tuple from its stub.
+
+     \param stub the query tuple's stub
+
+     \param[out] tuple the buffer to write the serialized query tuple to,
+     replacing what it held
+   */
+  void resolve(const MerRecord& stub, std::vector<uint8_t>& tuple) const;
+
+  /// \return the number of read ids the store covers
+  inline uint64_t numReads() const {
+    return reads;
+  }
+
+private:
+  struct Header {
+    uint8_t magic[4];
+    uint32_t version;
+    uint64_t reads;
+  };
+
+  static const uint32_t VERSION;
+
+  /// Release the mapping.
+  void close();
+
+  const uint8_t* image;
+  uint64_t length;
+  uint64_t reads;
+  const uint64_t* offsets;
+  const uint8_t* records;
+};
+
+#endif  // _READ_STORE_H_
@@ -0,0 +1,33 @@
+#include <algorithm>
+#include <string.h>
+
+#include "ReferenceCache.h"
+#include "core/TritonSortAssert.h"
+
+const uint32_t ReferenceCache::MAGIC;
+const uint32_t ReferenceCache::FORMAT_VERSION;
+const uint32_t ReferenceCache::HEADER_LENGTH;
+const uint32_t ReferenceCache::FOOTER_LENGTH;
+const char* const ReferenceCache::RUN_SUFFIX = ".run";
+
+ReferenceCache::Mode ReferenceCache::parseMode(const std::string& name) {
+  if (name.empty()) {
+    return NONE;
+  } else if (name == "write") {
+    return WRITE;
+  } else if (name == "read") {
+    return READ;
+  }
+  ABORT("Unknown CloudBurst reference cache mode '%s'; expected 'write' or "
+        "'read'", name.c_str());
+  return NONE;
+}
+
+int ReferenceCache::compareKeys(
+  const uint8_t* a, uint32_t aLength, const uint8_t* b, uint32_t bLength) {
+  int result = memcmp(a, b, std::min(aLength, bLength));
+  if (result != 0) {
+    return result;
+  }
+  return aLength < bLength ? -1 : (aLength > bLength ? 1 : 0);
+}
@@ -0,0 +1,84 @@
+#ifndef _REFERENCE_CACHE_H_
+#define _REFERENCE_CACHE_H_
+
+#include <stdint.h>
+#include <string>
+
+/**
+   A persistent cache of a reference's seed tuples. A job in WRITE mode
+   aligns as usual, and its reducers also save every reference group they
+   receive. Later jobs against the same reference and seed parameters run in
+   READ mode: the map function drops the reference, so only reads are mapped,
+   shuffled and sorted, and the reducer joins each query group with the
+   reference group it streams from the cache.
+
+   A reducer sees each of its partitions as one ascending run of keys, and it
+   writes each such run of reference groups to its own run file, starting a
+   new run whenever the keys it appends stop ascending. A run holds extents,
+   each a piece of a single seed's reference group, in key order:
+
+     header     magic (4 bytes), FORMAT_VERSION (4), MerRecord::VERSION (4)
+     extents    key length (4), key, (uint32_t length, MerRecord bytes) per
+                tuple, then a zero length (4)
+     footer     extent count (8), magic (4)
+
+   Integers are in host byte order, like the reducer's spill files. Runs are
+   written under a temporary name and renamed once complete.
+
+   A READ mode reducer merges every run alongside its query groups, which
+   arrive in the same key order, so it holds no index. Partition boundaries
+   come from each job's own sample, and a READ mode job samples only reads,
+   so its partitions need not match the runs; a seed's group is found in
+   whichever run holds it. The runs are read forward while a partition's
+   keys ascend and from their start again for each partition, so each of a
+   reducer's partitions reads the cache once. Every reducer opens every run,
+   so the cache directory must be visible to every node, and it must be
+   named for the reference's checksum and the seed parameters, since the
+   runs record neither.
+ */
+class ReferenceCache {
+public:
+  /// Reference cache modes
+  enum Mode {
+    /// No cache
+    NONE,
+    /// Align as usual and write the reference groups to the cache
+    WRITE,
+    /// Align against the reference groups in the cache
+    READ
+  };
+
+  /// Magic number of run files: "CBRC"
+  static const uint32_t MAGIC = 0x43524243;
+
+  /// The version of the run file layout
+  static const uint32_t FORMAT_VERSION = 2;
+
+  /// The length of a run file's header
+  static const uint32_t HEADER_LENGTH = 12;
+
+  /// The length of a run file's footer
+  static const uint32_t FOOTER_LENGTH = 12;
+
+  /// The file name suffix of a complete run
+  static const char* const RUN_SUFFIX;
+
+  /**
+     \param name "", "write" or "read"
+
+     \return the mode with that name
+   */
+  static Mode parseMode(const std::string& name);
+
+  /**
+     Compare two keys in the order the job sorts them: byte by byte, with a
+     key that is a prefix of another first.
+
+     \return a negative number, 0 or a positive number if a sorts before, with
+     or after b
+   */
+  static int compareKeys(
+    const uint8_t* a, uint32_t aLength, const uint8_t* b, uint32_t bLength);
+};
+
+#endif  // _REFERENCE_CACHE_H_
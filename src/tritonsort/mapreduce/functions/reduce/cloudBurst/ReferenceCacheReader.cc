@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <dirent.h>
+#include <errno.h>
+#include <string.h>
+
+#include "ReferenceCache.h"
+#include "ReferenceCacheReader.h"
+#include "core/TritonSortAssert.h"
+#include "mapreduce/functions/map/cloudBurst/MerRecord.h"
+
+ReferenceCacheReader::ReferenceCacheReader(const std::string& _directory)
+  : directory(_directory),
+    groupCursor(0),
+    numExtentsScanned(0),
+    numRewinds(0) {
+  DIR* dir = opendir(directory.c_str());
+  ABORT_IF(dir == NULL, "Failed to open CloudBurst reference cache %s: %s",
+           directory.c_str(), strerror(errno));
+
+  std::vector<std::string> names;
+  std::string suffix(ReferenceCache::RUN_SUFFIX);
+  for (struct dirent* entry = readdir(dir); entry != NULL;
+       entry = readdir(dir)) {
+    std::string name(entry->d_name);
+    if (name.size() > suffix.size() &&
+        name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+      names.push_back(name);
+    }
+  }
+  closedir(dir);
+  ABORT_IF(names.empty(), "CloudBurst reference cache %s has no runs; write "
+           "it with a job in reference cache write mode first",
+           directory.c_str());
+
+  // Open runs in name order so that every reducer searches them in the same
+  // order
+  std::sort(names.begin(), names.end());
+  cursors.reserve(names.size());
+  for (std::vector<std::string>::iterator iter = names.begin();
+       iter != names.end(); iter++) {
+    openRun(directory + "/" + *iter);
+  }
+  rewindAll();
+}
+
+ReferenceCacheReader::~ReferenceCacheReader() {
+  for (std::vector<Cursor>::iterator iter = cursors.begin();
+       iter != cursors.end(); iter++) {
+    fclose(iter->file);
+  }
+}
+
+bool ReferenceCacheReader::Cursor::Greater::operator()(
+  const Cursor* a, const Cursor* b) const {
+  return ReferenceCache::compareKeys(
+    a->key.data(), a->key.size(), b->key.data(), b->key.size()) > 0;
+}
+
+bool ReferenceCacheReader::find(const uint8_t* key, uint32_t keyLength) {
+  // The previous group's cursors are still at its key
+  for (std::vector<Cursor*>::iterator iter = groupCursors.begin();
+       iter != groupCursors.end(); iter++) {
+    heap.push_back(*iter);
+    std::push_heap(heap.begin(), heap.end(), Cursor::Greater());
+  }
+  groupCursors.clear();
+  groupCursor = 0;
+
+  if (!lastKey.empty() && ReferenceCache::compareKeys(
+        key, keyLength, lastKey.data(), lastKey.size()) < 0) {
+    // The runs were read past this key for the previous partition
+    rewindAll();
+    ++numRewinds;
+  }
+  lastKey.assign(key, key + keyLength);
+
+  // Only the runs positioned before this key are read forward to it. A run
+  // left at this key holds part of the group, unless it was read already.
+  bool found = false;
+  while (!heap.empty() && ReferenceCache::compareKeys(
+           heap.front()->key.data(), heap.front()->key.size(), key,
+           keyLength) <= 0) {
+    std::pop_heap(heap.begin(), heap.end(), Cursor::Greater());
+    Cursor* cursor = heap.back();
+    heap.pop_back();
+    found = seek(*cursor, key, keyLength) || found;
+    if (cursor->key.empty()) {
+      continue;
+    }
+    if (ReferenceCache::compareKeys(
+          cursor->key.data(), cursor->key.size(), key, keyLength) == 0) {
+      groupCursors.push_back(cursor);
+    } else {
+      heap.push_back(cursor);
+      std::push_heap(heap.begin(), heap.end(), Cursor::Greater());
+    }
+  }
+  // Read the group's pieces in run name order, like every other reducer
+  std::sort(groupCursors.begin(), groupCursors.end());
+  return found;
+}
+
+const uint8_t* ReferenceCacheReader::next(uint32_t& length) {
+  while (groupCursor < groupCursors.size()) {
+    Cursor& cursor = *groupCursors[groupCursor];
+    if (readTupleLength(cursor, length)) {
+      tuple.resize(std::max<size_t>(tuple.size(), length));
+      read(cursor, &tuple[0], length);
+      return &tuple[0];
+    }
+    ++groupCursor;
+  }
+  return NULL;
+}
+
+void ReferenceCacheReader::openRun(const std::string& path) {
+  Cursor cursor;
+  cursor.path = path;
+  cursor.extentsRead = 0;
+  cursor.inExtent = false;
+  cursor.file = fopen(path.c_str(), "rb");
+  ABORT_IF(cursor.file == NULL, "Failed to open CloudBurst reference cache "
+           "run %s: %s", path.c_str(), strerror(errno));
+
+  uint32_t header[3];
+  ABORT_IF(fread(header, sizeof(header), 1, cursor.file) != 1, "Failed to "
+           "read the header of CloudBurst reference cache run %s",
+           path.c_str());
+  ABORT_IF(header[0] != ReferenceCache::MAGIC, "%s is not a CloudBurst "
+           "reference cache run", path.c_str());
+  ABORT_IF(header[1] != ReferenceCache::FORMAT_VERSION ||
+           header[2] != MerRecord::VERSION, "CloudBurst reference cache run "
+           "%s has format version %u and MerRecord version %u, but expected "
+           "%u and %u; rebuild the cache", path.c_str(), header[1], header[2],
+           ReferenceCache::FORMAT_VERSION, MerRecord::VERSION);
+
+  uint32_t magic;
+  ABORT_IF(fseeko(cursor.file,
+                  -static_cast<off_t>(ReferenceCache::FOOTER_LENGTH),
+                  SEEK_END) != 0 ||
+           fread(&cursor.extents, sizeof(cursor.extents), 1,
+                 cursor.file) != 1 ||
+           fread(&magic, sizeof(magic), 1, cursor.file) != 1 ||
+           magic != ReferenceCache::MAGIC, "CloudBurst reference cache run "
+           "%s is truncated", path.c_str());
+
+  cursors.push_back(cursor);
+}
+
+void ReferenceCacheReader::rewind(Cursor& cursor) {
+  ABORT_IF(fseeko(cursor.file, ReferenceCache::HEADER_LENGTH, SEEK_SET) != 0,
+           "Failed to seek in CloudBurst reference cache run %s: %s",
+           cursor.path.c_str(), strerror(errno));
+  cursor.extentsRead = 0;
+  cursor.key.clear();
+  cursor.inExtent = false;
+  nextExtent(cursor);
+}
+
+void ReferenceCacheReader::rewindAll() {
+  heap.clear();
+  groupCursors.clear();
+  groupCursor = 0;
+  for (std::vector<Cursor>::iterator iter = cursors.begin();
+       iter != cursors.end(); iter++) {
+    rewind(*iter);
+    if (!iter->key.empty()) {
+      heap.push_back(&*iter);
+    }
+  }
+  std::make_heap(heap.begin(), heap.end(), Cursor::Greater());
+}
+
+bool ReferenceCacheReader::seek(
+  Cursor& cursor, const uint8_t* key, uint32_t keyLength) {
+  while (!cursor.key.empty()) {
+    int order = ReferenceCache::compareKeys(
+      cursor.key.data(), cursor.key.size(), key, keyLength);
+    if (order == 0) {
+      return cursor.inExtent;
+    } else if (order > 0) {
+      return false;
+    }
+    // Skip the rest of an extent before this key
+    uint32_t length;
+    while (readTupleLength(cursor, length)) {
+      ABORT_IF(fseeko(cursor.file, length, SEEK_CUR) != 0, "Failed to seek "
+               "in CloudBurst reference cache run %s: %s",
+               cursor.path.c_str(), strerror(errno));
+    }
+    nextExtent(cursor);
+  }
+  return false;
+}
+
+void ReferenceCacheReader::nextExtent(Cursor& cursor) {
+  ASSERT(!cursor.inExtent, "Cannot move to the next extent of CloudBurst "
+         "reference cache run %s before reading the current one",
+         cursor.path.c_str());
+  if (cursor.extentsRead == cursor.extents) {
+    cursor.key.clear();
+    return;
+  }
+
+  uint32_t keyLength;
+  read(cursor, &keyLength, sizeof(keyLength));
+  ABORT_IF(keyLength == 0, "CloudBurst reference cache run %s has an empty "
+           "key", cursor.path.c_str());
+  nextKey.resize(keyLength);
+  read(cursor, &nextKey[0], keyLength);
+  ABORT_IF(!cursor.key.empty() && ReferenceCache::compareKeys(
+             cursor.key.data(), cursor.key.size(), nextKey.data(),
+             keyLength) >= 0, "The extents of CloudBurst reference cache run "
+           "%s are out of order", cursor.path.c_str());
+  cursor.key.swap(nextKey);
+  cursor.extentsRead++;
+  cursor.inExtent = true;
+  ++numExtentsScanned;
+}
+
+bool ReferenceCacheReader::readTupleLength(Cursor& cursor, uint32_t& length) {
+  if (!cursor.inExtent) {
+    return false;
+  }
+  read(cursor, &length, sizeof(length));
+  if (length == 0) {
+    cursor.inExtent = false;
+    return false;
+  }
+  return true;
+}
+
+void ReferenceCacheReader::read(
+  Cursor& cursor, void* data, uint64_t length) {
+  ABORT_IF(fread(data, length, 1, cursor.file) != 1, "Failed to read "
+           "CloudBurst reference cache run %s: %s", cursor.path.c_str(),
+           feof(cursor.file) ? "unexpected end of file" : strerror(errno));
+}
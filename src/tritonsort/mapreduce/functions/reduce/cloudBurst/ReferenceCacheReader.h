@@ -0,0 +1,110 @@
+#ifndef _REFERENCE_CACHE_READER_H_
+#define _REFERENCE_CACHE_READER_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/**
+   Streams reference groups from the runs of a reference cache alongside a
+   reducer's query groups. The runs are merged by key, so a group is found in
+   whichever runs hold it, and each run is only read forward while the groups
+   asked for ascend. A key that sorts before the previous one, as the first
+   key of a reducer's next partition usually does, reads every run from its
+   start again.
+   \sa ReferenceCache
+ */
+class ReferenceCacheReader {
+public:
+  /**
+     \param directory the cache directory, which must hold at least one
+     complete run
+   */
+  explicit ReferenceCacheReader(const std::string& directory);
+
+  /// Destructor
+  virtual ~ReferenceCacheReader();
+
+  /**
+     Find the reference group with the given key, and start reading its
+     tuples from every run that holds part of it.
+
+     \param key the group's key
+
+     \param keyLength the length of the key
+
+     \return true if the cache holds a group with this key
+   */
+  bool find(const uint8_t* key, uint32_t keyLength);
+
+  /**
+     Read the next tuple of the group that was found last.
+
+     \param[out] length the length of the tuple
+
+     \return the tuple's serialized MerRecord, which is valid until the next
+     call, or NULL if the group has no more tuples
+   */
+  const uint8_t* next(uint32_t& length);
+
+  /// \return the number of runs in the cache
+  uint32_t runs() const {
+    return cursors.size();
+  }
+
+  /// \return the number of extents read or skipped
+  uint64_t extentsScanned() const {
+    return numExtentsScanned;
+  }
+
+  /// \return the number of times every run was read from its start again
+  uint64_t rewinds() const {
+    return numRewinds;
+  }
+
+private:
+  /// A run and the extent it is positioned at
+  struct Cursor {
+    /// Orders cursors by their current key, with the smallest at the top of
+    /// a heap
+    struct Greater {
+      bool operator()(const Cursor* a, const Cursor* b) const;
+    };
+
+    FILE* file;
+    std::string path;
+    uint64_t extents;
+    uint64_t extentsRead;
+    // The current extent's key, empty once the run is exhausted
+    std::vector<uint8_t> key;
+    // True until the current extent's tuples have all been read
+    bool inExtent;
+  };
+
+  void openRun(const std::string& path);
+  void rewind(Cursor& cursor);
+  void rewindAll();
+  bool seek(Cursor& cursor, const uint8_t* key, uint32_t keyLength);
+  void nextExtent(Cursor& cursor);
+  bool readTupleLength(Cursor& cursor, uint32_t& length);
+  void read(Cursor& cursor, void* data, uint64_t length);
+
+  const std::string directory;
+  std::vector<Cursor> cursors;
+
+  // The cursors that are not exhausted, other than those of the group being
+  // read, ordered by key
+  std::vector<Cursor*> heap;
+  // The cursors of the group being read, and the one being read
+  std::vector<Cursor*> groupCursors;
+  uint32_t groupCursor;
+  std::vector<uint8_t> lastKey;
+  std::vector<uint8_t> nextKey;
+  std::vector<uint8_t> tuple;
+
+  uint64_t numExtentsScanned;
+  uint64_t numRewinds;
+};
+
+#endif  // _REFERENCE_CACHE_READER_H_
@@ -0,0 +1,130 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ReferenceCache.h"
+#include "ReferenceCacheWriter.h"
+#include "core/TritonSortAssert.h"
+#include "mapreduce/functions/map/cloudBurst/MerRecord.h"
+
+// Create a directory and any missing parents
+static void makeDirectories(const std::string& directory) {
+  for (std::string::size_type slash = directory.find('/', 1);
+       slash != std::string::npos; slash = directory.find('/', slash + 1)) {
+    mkdir(directory.substr(0, slash).c_str(), 0777);
+  }
+  ABORT_IF(mkdir(directory.c_str(), 0777) != 0 && errno != EEXIST,
+           "Failed to create CloudBurst reference cache directory %s: %s",
+           directory.c_str(), strerror(errno));
+}
+
+ReferenceCacheWriter::ReferenceCacheWriter(const std::string& _directory)
+  : directory(_directory),
+    file(NULL),
+    runsWritten(0),
+    extentsWritten(0),
+    tuplesWritten(0),
+    runExtents(0) {
+}
+
+ReferenceCacheWriter::~ReferenceCacheWriter() {
+  if (file != NULL) {
+    fclose(file);
+    unlink(path.c_str());
+  }
+}
+
+void ReferenceCacheWriter::append(
+  const uint8_t* key, uint32_t keyLength, const uint8_t* tuple,
+  uint32_t tupleLength) {
+  ASSERT(tupleLength > 0, "Reference cache tuples cannot be empty, since a "
+         "zero length ends an extent");
+  int order = 1;
+  if (file != NULL) {
+    order = ReferenceCache::compareKeys(
+      key, keyLength, extentKey.data(), extentKey.size());
+    if (order < 0) {
+      // The reducer has moved on to its next partition
+      close();
+    }
+  }
+  if (file == NULL) {
+    open();
+  }
+
+  if (order != 0) {
+    finishExtent();
+    extentKey.assign(key, key + keyLength);
+    write(&keyLength, sizeof(keyLength));
+    write(key, keyLength);
+    runExtents++;
+    extentsWritten++;
+  }
+
+  write(&tupleLength, sizeof(tupleLength));
+  write(tuple, tupleLength);
+  tuplesWritten++;
+}
+
+void ReferenceCacheWriter::close() {
+  if (file == NULL) {
+    return;
+  }
+
+  finishExtent();
+  write(&runExtents, sizeof(runExtents));
+  write(&ReferenceCache::MAGIC, sizeof(ReferenceCache::MAGIC));
+
+  ABORT_IF(fclose(file) != 0, "Failed to close CloudBurst reference cache "
+           "run %s: %s", path.c_str(), strerror(errno));
+  file = NULL;
+
+  // Only complete runs carry the run suffix
+  std::string runPath = path + ReferenceCache::RUN_SUFFIX;
+  ABORT_IF(rename(path.c_str(), runPath.c_str()) != 0, "Failed to rename "
+           "CloudBurst reference cache run %s: %s", path.c_str(),
+           strerror(errno));
+  runsWritten++;
+  runExtents = 0;
+  extentKey.clear();
+}
+
+void ReferenceCacheWriter::finishExtent() {
+  if (extentKey.empty()) {
+    return;
+  }
+  // A zero tuple length ends the extent, so it is written in one pass
+  uint32_t end = 0;
+  write(&end, sizeof(end));
+  extentKey.clear();
+}
+
+void ReferenceCacheWriter::open() {
+  makeDirectories(directory);
+  std::string pathTemplate = directory + "/run_XXXXXX";
+  std::vector<char> pathBuffer(pathTemplate.begin(), pathTemplate.end());
+  pathBuffer.push_back('\0');
+  int fd = mkstemp(&pathBuffer[0]);
+  ABORT_IF(fd == -1, "Failed to create CloudBurst reference cache run in %s: "
+           "%s", directory.c_str(), strerror(errno));
+  path = &pathBuffer[0];
+  // mkstemp() creates the file readable only by its owner, but every node
+  // of a later job reads it
+  ABORT_IF(fchmod(fd, 0644) != 0, "Failed to set the mode of CloudBurst "
+           "reference cache run %s: %s", path.c_str(), strerror(errno));
+  file = fdopen(fd, "wb");
+  ABORT_IF(file == NULL, "fdopen() of CloudBurst reference cache run failed: "
+           "%s", strerror(errno));
+
+  uint32_t header[3] = {
+    ReferenceCache::MAGIC, ReferenceCache::FORMAT_VERSION, MerRecord::VERSION};
+  write(header, sizeof(header));
+}
+
+void ReferenceCacheWriter::write(const void* data, uint64_t length) {
+  ABORT_IF(fwrite(data, 1, length, file) != length, "Failed to write "
+           "CloudBurst reference cache run %s: %s", path.c_str(),
+           strerror(errno));
+}
@@ -0,0 +1,80 @@
+#ifndef _REFERENCE_CACHE_WRITER_H_
+#define _REFERENCE_CACHE_WRITER_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/**
+   Writes one reducer's reference groups to the run files of a reference
+   cache, one run per ascending run of keys.
+   \sa ReferenceCache
+ */
+class ReferenceCacheWriter {
+public:
+  /**
+     \param directory the cache directory, which is created along with its
+     parents if it does not exist
+   */
+  explicit ReferenceCacheWriter(const std::string& directory);
+
+  /// Destructor; discards the current run if it was not closed
+  virtual ~ReferenceCacheWriter();
+
+  /**
+     Append a reference tuple. Consecutive tuples with the same key form one
+     extent, so a group that spans several reduce() calls is not split. A
+     key that sorts before the previous one starts a new run.
+
+     \param key the tuple's key
+
+     \param keyLength the length of the key
+
+     \param tuple the tuple's serialized MerRecord
+
+     \param tupleLength the length of the serialized MerRecord
+   */
+  void append(
+    const uint8_t* key, uint32_t keyLength, const uint8_t* tuple,
+    uint32_t tupleLength);
+
+  /**
+     Finish the current run and give it its final name. Does nothing if no
+     tuples were appended since the last run was closed.
+   */
+  void close();
+
+  /// \return the number of runs written
+  uint64_t runs() const {
+    return runsWritten;
+  }
+
+  /// \return the number of extents written
+  uint64_t extents() const {
+    return extentsWritten;
+  }
+
+  /// \return the number of tuples written
+  uint64_t tuples() const {
+    return tuplesWritten;
+  }
+
+private:
+  void open();
+  void finishExtent();
+  void write(const void* data, uint64_t length);
+
+  const std::string directory;
+  std::string path;
+  FILE* file;
+  uint64_t runsWritten;
+  uint64_t extentsWritten;
+  uint64_t tuplesWritten;
+
+  // The current run's extent count and the current extent's key
+  uint64_t runExtents;
+  std::vector<uint8_t> extentKey;
+};
+
+#endif  // _REFERENCE_CACHE_WRITER_H_
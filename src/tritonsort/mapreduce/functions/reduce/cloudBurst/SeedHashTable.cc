@@ -0,0 +1,151 @@
+#include <string.h>
+
+#include "SeedHashTable.h"
+
+// Tables start small and double whenever they become half full.
+static const uint64_t INITIAL_CAPACITY = 1024;
+
+SeedHashTable::SeedHashTable()
+  : slots(INITIAL_CAPACITY),
+    arena(1, 0),
+    seeds(0),
+    mask(INITIAL_CAPACITY - 1) {
+}
+
+void SeedHashTable::insert(
+  const uint8_t* seed, uint32_t seedLength, const uint8_t* value,
+  uint32_t valueLength, bool isReference) {
+  if ((seeds + 1) * 2 > slots.size()) {
+    grow();
+  }
+
+  uint64_t hash = hashSeed(seed, seedLength);
+  uint64_t slot = findSlot(hash, seed, seedLength);
+  Entry& entry = slots[slot];
+  if (entry.seedLength == 0) {
+    entry.hash = hash;
+    entry.seedOffset = arena.size();
+    entry.seedLength = seedLength;
+    entry.references = 0;
+    entry.queries = 0;
+    arena.insert(arena.end(), seed, seed + seedLength);
+    ++seeds;
+  }
+
+  // Push the tuple onto the front of the appropriate list.
+  TupleHandle& head = isReference ? entry.references : entry.queries;
+  TupleHandle tuple = arena.size();
+  arena.resize(tuple + sizeof(TupleHandle) + sizeof(uint32_t) + valueLength);
+  memcpy(&arena[tuple], &head, sizeof(TupleHandle));
+  memcpy(&arena[tuple + sizeof(TupleHandle)], &valueLength, sizeof(uint32_t));
+  memcpy(&arena[tuple + sizeof(TupleHandle) + sizeof(uint32_t)], value,
+         valueLength);
+  head = tuple;
+}
+
+uint64_t SeedHashTable::capacity() const {
+  return slots.size();
+}
+
+uint64_t SeedHashTable::find(
+  const uint8_t* seed, uint32_t seedLength) const {
+  uint64_t slot = findSlot(hashSeed(seed, seedLength), seed, seedLength);
+  return occupied(slot) ? slot : slots.size();
+}
+
+bool SeedHashTable::occupied(uint64_t slot) const {
+  return slots[slot].seedLength != 0;
+}
+
+const uint8_t* SeedHashTable::seed(uint64_t slot) const {
+  return &arena[slots[slot].seedOffset];
+}
+
+uint32_t SeedHashTable::seedLength(uint64_t slot) const {
+  return slots[slot].seedLength;
+}
+
+SeedHashTable::TupleHandle SeedHashTable::firstReference(uint64_t slot) const {
+  return slots[slot].references;
+}
+
+SeedHashTable::TupleHandle SeedHashTable::firstQuery(uint64_t slot) const {
+  return slots[slot].queries;
+}
+
+SeedHashTable::TupleHandle SeedHashTable::next(TupleHandle tuple) const {
+  TupleHandle nextTuple;
+  memcpy(&nextTuple, &arena[tuple], sizeof(TupleHandle));
+  return nextTuple;
+}
+
+const uint8_t* SeedHashTable::value(TupleHandle tuple) const {
+  return &arena[tuple + sizeof(TupleHandle) + sizeof(uint32_t)];
+}
+
+uint32_t SeedHashTable::valueLength(TupleHandle tuple) const {
+  uint32_t length;
+  memcpy(&length, &arena[tuple + sizeof(TupleHandle)], sizeof(uint32_t));
+  return length;
+}
+
+uint64_t SeedHashTable::numSeeds() const {
+  return seeds;
+}
+
+uint64_t SeedHashTable::bytes() const {
+  return arena.size() + slots.size() * sizeof(Entry);
+}
+
+void SeedHashTable::clear() {
+  if (seeds > 0) {
+    memset(&slots[0], 0, slots.size() * sizeof(Entry));
+  }
+  arena.resize(1);
+  seeds = 0;
+}
+
+uint64_t SeedHashTable::hashSeed(
+  const uint8_t* seed, uint32_t seedLength) const {
+  // 64-bit FNV-1a
+  uint64_t hash = 14695981039346656037ULL;
+  for (uint32_t i = 0; i < seedLength; i++) {
+    hash ^= seed[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+uint64_t SeedHashTable::findSlot(
+  uint64_t hash, const uint8_t* seed, uint32_t seedLength) const {
+  // Linear probing; the table is never more than half full, so this
+  // terminates at either the seed's entry or an empty slot.
+  uint64_t slot = hash & mask;
+  while (true) {
+    const Entry& entry = slots[slot];
+    if (entry.seedLength == 0 ||
+        (entry.hash == hash && entry.seedLength == seedLength &&
+         memcmp(&arena[entry.seedOffset], seed, seedLength) == 0)) {
+      return slot;
+    }
+    slot = (slot + 1) & mask;
+  }
+}
+
+void SeedHashTable::grow() {
+  std::vector<Entry> oldSlots(slots.size() * 2);
+  oldSlots.swap(slots);
+  mask = slots.size() - 1;
+
+  for (std::vector<Entry>::iterator iter = oldSlots.begin();
+       iter != oldSlots.end(); iter++) {
+    if (iter->seedLength == 0) {
+      continue;
+    }
+    uint64_t slot = iter->hash & mask;
+    while (slots[slot].seedLength != 0) {
+      slot = (slot + 1) & mask;
+    }
+    slots[slot] = *iter;
+  }
+}
@@ -0,0 +1,111 @@
+#ifndef _SEED_HASH_TABLE_H
+#define _SEED_HASH_TABLE_H
+
+#include <stdint.h>
+#include <vector>
+
+/**
+   An open-addressing hash table that groups CloudBurst tuples by seed without
+   sorting them. Each entry keeps separate lists of reference and query tuples
+   for its seed, so the alignment join can be run one bucket at a time.
+
+   Seeds and tuple values are copied into an arena owned by the table, so the
+   buffers they came from can be released once they have been inserted.
+ */
+class SeedHashTable {
+public:
+  /// Identifies a tuple stored in the table; 0 terminates a tuple list.
+  typedef uint64_t TupleHandle;
+
+  /// Constructor
+  SeedHashTable();
+
+  /**
+     Copy a tuple into the table, adding an entry for its seed if necessary.
+
+     \param seed the seed, which is the tuple's key minus the reference/query
+     flag byte
+
+     \param seedLength the length of the seed in bytes
+
+     \param value the tuple's serialized MerRecord
+
+     \param valueLength the length of the serialized MerRecord
+
+     \param isReference true if the tuple is a reference tuple
+   */
+  void insert(
+    const uint8_t* seed, uint32_t seedLength, const uint8_t* value,
+    uint32_t valueLength, bool isReference);
+
+  /// \return the number of slots in the table, occupied or not
+  uint64_t capacity() const;
+
+  /**
+     Look up a seed.
+
+     \param seed the seed
+
+     \param seedLength the length of the seed in bytes
+
+     \return the slot holding the seed, or capacity() if the table does not
+     hold it
+   */
+  uint64_t find(const uint8_t* seed, uint32_t seedLength) const;
+
+  /// \return true if the slot at the given index holds a seed
+  bool occupied(uint64_t slot) const;
+
+  /// \return the seed in the given slot
+  const uint8_t* seed(uint64_t slot) const;
+
+  /// \return the length of the seed in the given slot
+  uint32_t seedLength(uint64_t slot) const;
+
+  /// \return the first reference tuple of the seed in the given slot
+  TupleHandle firstReference(uint64_t slot) const;
+
+  /// \return the first query tuple of the seed in the given slot
+  TupleHandle firstQuery(uint64_t slot) const;
+
+  /// \return the tuple after the given tuple in its list
+  TupleHandle next(TupleHandle tuple) const;
+
+  /// \return the serialized MerRecord of a tuple
+  const uint8_t* value(TupleHandle tuple) const;
+
+  /// \return the length of the serialized MerRecord of a tuple
+  uint32_t valueLength(TupleHandle tuple) const;
+
+  /// \return the number of distinct seeds in the table
+  uint64_t numSeeds() const;
+
+  /// \return the number of bytes of seeds and tuples held by the table
+  uint64_t bytes() const;
+
+  /// Remove every seed and tuple, keeping the allocated memory for reuse.
+  void clear();
+
+private:
+  struct Entry {
+    uint64_t hash;
+    uint64_t seedOffset;
+    uint32_t seedLength;
+    TupleHandle references;
+    TupleHandle queries;
+  };
+
+  uint64_t hashSeed(const uint8_t* seed, uint32_t seedLength) const;
+  uint64_t findSlot(
+    uint64_t hash, const uint8_t* seed, uint32_t seedLength) const;
+  void grow();
+
+  std::vector<Entry> slots;
+  // Tuples are stored as (TupleHandle next, uint32_t valueLength, value).
+  // Offset 0 holds a placeholder byte so that 0 can terminate lists.
+  std::vector<uint8_t> arena;
+  uint64_t seeds;
+  uint64_t mask;
+};
+
+#endif // _SEED_HASH_TABLE_H